@@ -0,0 +1,65 @@
+# Profile-guided and link-time optimization of all subprojects.
+#
+# SPINE_PGO selects the stage of a profile-guided build:
+#   OFF      - a plain build (default).
+#   GENERATE - an instrumented build, which writes execution profiles to
+#              SPINE_PGO_DIR when the programs exit.
+#   USE      - an optimized build using the profiles in SPINE_PGO_DIR.
+# GCC matches the profiles to the object files by path, so the GENERATE and
+# USE stages must be configured in the same build directory. Clang writes raw
+# profiles, which must be merged into ${SPINE_PGO_DIR}/default.profdata with
+# llvm-profdata before the USE stage. The selection/scripts/pgo_build.py
+# driver runs the stages on a synthetic training workload and reports the
+# speedup against the plain release build.
+#
+# SPINE_LTO enables link-time optimization when the toolchain supports it.
+# The flags are directory options, so they apply to the libraries and
+# executables of all subprojects, but not to the selection libraries compiled
+# at runtime (see selection/include/codegen.h).
+
+set(SPINE_PGO "OFF" CACHE STRING "Profile-guided optimization stage (OFF, GENERATE, or USE)")
+set_property(CACHE SPINE_PGO PROPERTY STRINGS OFF GENERATE USE)
+set(SPINE_PGO_DIR "${CMAKE_BINARY_DIR}/pgo" CACHE PATH "Directory of the profiles of the profile-guided build")
+option(SPINE_LTO "Build with link-time optimization" OFF)
+
+if(NOT SPINE_PGO STREQUAL "OFF")
+    if(NOT CMAKE_CXX_COMPILER_ID MATCHES "GNU|Clang")
+        message(FATAL_ERROR "SPINE_PGO requires GCC or Clang (found ${CMAKE_CXX_COMPILER_ID}).")
+    endif()
+    if(SPINE_PGO STREQUAL "GENERATE")
+        # The selection runs on several threads, so the counters are updated
+        # atomically to keep the profiles consistent.
+        file(MAKE_DIRECTORY ${SPINE_PGO_DIR})
+        add_compile_options(-fprofile-generate=${SPINE_PGO_DIR} -fprofile-update=atomic)
+        add_link_options(-fprofile-generate=${SPINE_PGO_DIR})
+    elseif(SPINE_PGO STREQUAL "USE")
+        # Code not reached by the training workload (e.g., error handling)
+        # keeps its regular optimization instead of being optimized for size.
+        if(CMAKE_CXX_COMPILER_ID STREQUAL "GNU")
+            set(SPINE_PGO_PROFILE ${SPINE_PGO_DIR})
+            add_compile_options(-fprofile-use=${SPINE_PGO_PROFILE} -fprofile-partial-training -fprofile-correction
+                                -Wno-missing-profile -Wno-error=coverage-mismatch)
+        else()
+            set(SPINE_PGO_PROFILE ${SPINE_PGO_DIR}/default.profdata)
+            add_compile_options(-fprofile-use=${SPINE_PGO_PROFILE} -Wno-profile-instr-unprofiled -Wno-profile-instr-out-of-date)
+        endif()
+        if(NOT EXISTS ${SPINE_PGO_PROFILE})
+            message(FATAL_ERROR "No profiles in ${SPINE_PGO_PROFILE}; run the instrumented (GENERATE) build first.")
+        endif()
+        add_link_options(-fprofile-use=${SPINE_PGO_PROFILE})
+    else()
+        message(FATAL_ERROR "Illegal SPINE_PGO stage '${SPINE_PGO}' (expected OFF, GENERATE, or USE).")
+    endif()
+    message(STATUS "Profile-guided optimization: ${SPINE_PGO} (${SPINE_PGO_DIR})")
+endif()
+
+if(SPINE_LTO)
+    include(CheckIPOSupported)
+    check_ipo_supported(RESULT SPINE_LTO_SUPPORTED OUTPUT SPINE_LTO_ERROR LANGUAGES CXX)
+    if(SPINE_LTO_SUPPORTED)
+        set(CMAKE_INTERPROCEDURAL_OPTIMIZATION ON)
+        message(STATUS "Link-time optimization: ON")
+    else()
+        message(WARNING "Link-time optimization is not supported: ${SPINE_LTO_ERROR}")
+    endif()
+endif()
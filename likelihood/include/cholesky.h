@@ -0,0 +1,119 @@
+/**
+ * @file cholesky.h
+ * @brief Header file for the Cholesky factorization used by the binned
+ * likelihood engine.
+ * @details The covariance matrix of a binned fit is symmetric and positive
+ * definite, so it is factorized once as C = L L^T and every evaluation only
+ * solves two triangular systems (O(n^2)) instead of inverting the matrix
+ * (O(n^3)). When a systematic block of low rank r is added to or removed
+ * from the covariance, the factor is updated with r rank-one updates or
+ * downdates (O(r n^2)) instead of being recomputed.
+ * @author mueller@fnal.gov
+ */
+#ifndef CHOLESKY_H
+#define CHOLESKY_H
+#include <vector>
+#include <cstddef>
+
+/**
+ * @namespace likelihood
+ * @brief Namespace for the binned likelihood engine.
+ * @details This namespace contains the components of the binned likelihood
+ * engine: the Cholesky factorization of the covariance matrix, the models
+ * of the binned prediction, the likelihood itself, and its loader.
+ */
+namespace likelihood
+{
+    /**
+     * @class Cholesky
+     * @brief Cholesky factorization of a symmetric positive definite matrix
+     * with rank-one updates.
+     * @details The matrices are dense and stored row-major in a vector of
+     * n * n elements. Only the lower triangle of the input is read.
+     */
+    class Cholesky
+    {
+        public:
+            /**
+             * @brief Default constructor for the Cholesky class.
+             * @details The factorization is empty until @ref factorize is
+             * called.
+             */
+            Cholesky() = default;
+
+            /**
+             * @brief Factorize a matrix.
+             * @param matrix The matrix (n * n, row-major).
+             * @param n The dimension of the matrix.
+             * @return void
+             * @throw std::runtime_error if the matrix is not positive definite.
+             */
+            void factorize(const std::vector<double> & matrix, size_t n);
+
+            /**
+             * @brief Update the factorization to that of A + v v^T.
+             * @param v The vector of the update (n elements).
+             * @return void
+             */
+            void update(std::vector<double> v);
+
+            /**
+             * @brief Update the factorization to that of A - v v^T.
+             * @details The factorization is unchanged if the result would not
+             * be positive definite (e.g., because of the accumulated rounding
+             * of many updates), in which case the caller should factorize the
+             * matrix anew.
+             * @param v The vector of the downdate (n elements).
+             * @return True if the downdate succeeded.
+             */
+            bool downdate(std::vector<double> v);
+
+            /**
+             * @brief Solve L y = x in place.
+             * @param x The right-hand side, overwritten by the solution.
+             * @return void
+             */
+            void solve_lower(double * x) const;
+
+            /**
+             * @brief Solve L^T z = y in place.
+             * @param y The right-hand side, overwritten by the solution.
+             * @return void
+             */
+            void solve_upper(double * y) const;
+
+            /**
+             * @brief Get the logarithm of the determinant of the matrix.
+             * @return The log-determinant, 2 * sum(log(L_ii)).
+             */
+            double log_determinant() const;
+
+            /**
+             * @brief Get the dimension of the factorized matrix.
+             * @return The dimension.
+             */
+            size_t size() const { return n_; }
+
+            /**
+             * @brief Compute a low-rank factor of a symmetric positive
+             * semi-definite matrix.
+             * @details The pivoted Cholesky factorization selects the largest
+             * remaining diagonal element at each step and stops once all
+             * remaining diagonal elements are below @p tolerance times the
+             * largest diagonal element of the matrix. The result satisfies
+             * A ~= sum_k c_k c_k^T. Covariance matrices estimated from a
+             * limited number of universes have a rank of at most the number
+             * of universes, which this recovers.
+             * @param matrix The matrix (n * n, row-major).
+             * @param n The dimension of the matrix.
+             * @param tolerance The relative tolerance on the diagonal.
+             * @return The columns c_k of the factor (n elements each).
+             */
+            static std::vector<std::vector<double>> low_rank(const std::vector<double> & matrix, size_t n, double tolerance);
+
+        private:
+            size_t n_ = 0;
+            std::vector<double> l_;
+    };
+}
+#endif // CHOLESKY_H
@@ -0,0 +1,237 @@
+/**
+ * @file likelihood.h
+ * @brief Header file for the binned likelihood of the likelihood engine.
+ * @details The likelihood compares the binned prediction of a @ref Model to
+ * the observed data with either a chi-squared statistic with a covariance
+ * matrix or a Poisson likelihood ratio, plus optional Gaussian priors on the
+ * parameters. The covariance matrix is the sum of a diagonal statistical term
+ * and of the enabled systematic blocks. Its Cholesky factorization is cached
+ * and, when a block of low rank is toggled, updated with rank-one updates
+ * instead of being recomputed. Both statistics are evaluated with their
+ * analytic gradients, for a single point or for many points in parallel.
+ * @author mueller@fnal.gov
+ */
+#ifndef LIKELIHOOD_H
+#define LIKELIHOOD_H
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include "cholesky.h"
+#include "model.h"
+
+namespace likelihood
+{
+    /**
+     * @enum Statistic
+     * @brief The test statistics of the likelihood.
+     * @details Chi2 is (d - mu)^T C^-1 (d - mu) with the covariance matrix C.
+     * Poisson is the likelihood ratio -2 ln(L(mu) / L(d)) =
+     * 2 sum(mu - d + d ln(d / mu)), which does not use the covariance matrix.
+     */
+    enum class Statistic { Chi2, Poisson };
+
+    /**
+     * @struct Result
+     * @brief The value and gradient of the likelihood at a point.
+     */
+    struct Result
+    {
+        double value;                   ///< The value of the test statistic.
+        std::vector<double> gradient;   ///< The gradient with respect to the parameters.
+    };
+
+    /**
+     * @class Likelihood
+     * @brief Binned likelihood with a cached covariance factorization.
+     */
+    class Likelihood
+    {
+        public:
+            /**
+             * @brief Constructor for the Likelihood class.
+             * @param model The model of the prediction.
+             * @param data The observed data (one element per bin).
+             * @param statistic The test statistic.
+             * @throw std::runtime_error if the number of bins does not match.
+             */
+            Likelihood(std::shared_ptr<const Model> model, std::vector<double> data, Statistic statistic);
+
+            /**
+             * @brief Set the diagonal statistical term of the covariance.
+             * @param variance The variance of each bin.
+             * @return void
+             * @throw std::runtime_error if the number of bins does not match.
+             */
+            void set_statistical(std::vector<double> variance);
+
+            /**
+             * @brief Add a systematic block to the covariance from its matrix.
+             * @details The low-rank factor of the block is computed with the
+             * pivoted Cholesky factorization (see @ref Cholesky::low_rank).
+             * @param name The name of the block.
+             * @param covariance The covariance matrix of the block (bins *
+             * bins, row-major).
+             * @param enabled Whether the block is enabled.
+             * @param tolerance The relative tolerance of the low-rank factor.
+             * @return void
+             * @throw std::runtime_error if the block exists or the dimension
+             * does not match.
+             */
+            void add_block(const std::string & name, const std::vector<double> & covariance, bool enabled, double tolerance = 1e-10);
+
+            /**
+             * @brief Add a systematic block to the covariance from its
+             * low-rank factor.
+             * @details The covariance of the block is sum_k c_k c_k^T. For a
+             * block estimated from N universes u_k around the nominal
+             * prediction n, c_k = (u_k - n) / sqrt(N).
+             * @param name The name of the block.
+             * @param columns The columns c_k of the factor (one element per
+             * bin each).
+             * @param enabled Whether the block is enabled.
+             * @return void
+             * @throw std::runtime_error if the block exists or the dimension
+             * does not match.
+             */
+            void add_block_factor(const std::string & name, std::vector<std::vector<double>> columns, bool enabled);
+
+            /**
+             * @brief Enable or disable a systematic block.
+             * @details The cached factorization is updated with one rank-one
+             * update (or downdate) per column of the factor of the block if
+             * its rank is below the configured fraction of the number of bins
+             * (see @ref set_update_fraction), and recomputed otherwise or if
+             * a downdate fails.
+             * @param name The name of the block.
+             * @param enabled Whether the block is enabled.
+             * @return void
+             * @throw std::runtime_error if the block does not exist.
+             */
+            void enable(const std::string & name, bool enabled);
+
+            /**
+             * @brief Set the largest rank of a block, as a fraction of the
+             * number of bins, toggled with rank-one updates.
+             * @details A full factorization costs n^3 / 3 operations and the
+             * updates of a block of rank r cost about 2 r n^2, so the
+             * updates are faster for r < n / 6. The default is 0.15.
+             * @param fraction The fraction.
+             * @return void
+             */
+            void set_update_fraction(double fraction) { update_fraction_ = fraction; }
+
+            /**
+             * @brief Add a Gaussian prior on a parameter.
+             * @details The term ((theta_j - center) / sigma)^2 is added to the
+             * test statistic.
+             * @param j The index of the parameter.
+             * @param center The center of the prior.
+             * @param sigma The width of the prior.
+             * @return void
+             */
+            void set_prior(size_t j, double center, double sigma);
+
+            /**
+             * @brief Evaluate the likelihood at a point.
+             * @param theta The parameters.
+             * @param gradient The gradient (written if not null).
+             * @return The value of the test statistic.
+             */
+            double evaluate(const double * theta, double * gradient) const;
+
+            /**
+             * @brief Evaluate the likelihood of other data at a point.
+             * @details The covariance matrix (including its statistical term)
+             * is that of the likelihood, so that many pseudo-experiments can
+             * be evaluated concurrently against one cached factorization.
+             * @param theta The parameters.
+             * @param data The data (one element per bin).
+             * @param gradient The gradient (written if not null).
+             * @param work The workspace of the calling thread (resized as
+             * needed).
+             * @return The value of the test statistic.
+             */
+            double evaluate(const double * theta, const double * data, double * gradient, std::vector<double> & work) const;
+
+            /**
+             * @brief Evaluate the likelihood at many points in parallel.
+             * @details The points are distributed dynamically across
+             * @p nthreads threads, each with its own workspace.
+             * @param points The points (parameters() elements each).
+             * @param nthreads The number of threads (zero for the number of
+             * hardware threads).
+             * @param gradient Whether to compute the gradients.
+             * @return The results, in the order of the points.
+             */
+            std::vector<Result> evaluate(const std::vector<std::vector<double>> & points, size_t nthreads, bool gradient = true) const;
+
+            /**
+             * @brief Get the model of the prediction.
+             * @return The model.
+             */
+            const Model & model() const { return *model_; }
+
+            /**
+             * @brief Get the names of the systematic blocks.
+             * @return The names, in order of addition.
+             */
+            std::vector<std::string> blocks() const { return order_; }
+
+            /**
+             * @brief Get the number of full factorizations.
+             * @return The number of factorizations since construction.
+             */
+            size_t factorizations() const { return factorizations_; }
+
+            /**
+             * @brief Get the number of rank-one updates and downdates.
+             * @return The number of updates since construction.
+             */
+            size_t updates() const { return updates_; }
+
+        private:
+            /**
+             * @struct Block
+             * @brief A systematic block of the covariance.
+             */
+            struct Block
+            {
+                std::vector<double> covariance;             ///< The covariance matrix.
+                std::vector<std::vector<double>> columns;   ///< The low-rank factor.
+                bool enabled;                               ///< Whether the block is enabled.
+            };
+
+            /**
+             * @brief Recompute the factorization of the covariance if it is
+             * out of date.
+             * @details This is called by the evaluation, so that several
+             * blocks can be added or toggled before the factorization is
+             * recomputed once.
+             * @return void
+             * @throw std::runtime_error if the covariance is not positive
+             * definite.
+             */
+            void refactorize() const;
+
+            std::shared_ptr<const Model> model_;
+            std::vector<double> data_;
+            Statistic statistic_;
+            std::vector<double> variance_;
+            std::map<std::string, Block> blocks_;
+            std::vector<std::string> order_;
+            std::vector<double> prior_center_;
+            std::vector<double> prior_weight_;
+            mutable Cholesky cholesky_;
+            mutable std::mutex mutex_;
+            mutable std::atomic<bool> dirty_{true};
+            mutable size_t factorizations_ = 0;
+            double update_fraction_ = 0.15;
+            size_t updates_ = 0;
+    };
+}
+#endif // LIKELIHOOD_H
@@ -0,0 +1,73 @@
+/**
+ * @file loader.h
+ * @brief Header file for the loading of binned likelihoods from ROOT files.
+ * @details The inputs of a fit (the nominal prediction, the data, the
+ * response templates of the parameters, and the covariance blocks of the
+ * systematics) are read from a ROOT file as described by a TOML-based
+ * configuration:
+ * @code
+ * [likelihood]
+ * path = "fit_inputs.root"
+ * nominal = "nominal"          # TH1 of the nominal prediction
+ * data = "data"                # TH1 of the data (default: the nominal)
+ * statistic = "chi2"           # "chi2" or "poisson"
+ * stat_variance = "cnp"        # "cnp", "data", "prediction", or "none"
+ *
+ * [[parameter]]
+ * name = "numu_norm"
+ * type = "scale"               # "scale" or "shift"
+ * template = "numu_response"   # TH1 (default for "scale": uniform one)
+ * prior = 0.1                  # width of the Gaussian prior (optional)
+ *
+ * [[block]]
+ * name = "flux"
+ * covariance = "flux_cov"      # TMatrixDSym, TMatrixD, or TH2
+ * # universes = "flux_univ"    # or a TH2 of the universes (x: bin, y: universe)
+ * enabled = true
+ * @endcode
+ * @see cfg::ConfigurationTable
+ * @author mueller@fnal.gov
+ */
+#ifndef LOADER_H
+#define LOADER_H
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "configuration.h"
+#include "likelihood.h"
+
+class TFile;
+
+namespace likelihood
+{
+    /**
+     * @brief Read the contents of a histogram.
+     * @param file The input file.
+     * @param name The name of the histogram.
+     * @return The contents of the bins (without under- and overflow).
+     * @throw std::runtime_error if there is no such histogram.
+     */
+    std::vector<double> read_histogram(TFile * file, const std::string & name);
+
+    /**
+     * @brief Read a covariance matrix.
+     * @param file The input file.
+     * @param name The name of the matrix (TMatrixDSym, TMatrixD, or TH2).
+     * @param n The expected dimension.
+     * @return The matrix (n * n, row-major).
+     * @throw std::runtime_error if there is no such matrix or its dimension
+     * does not match.
+     */
+    std::vector<double> read_matrix(TFile * file, const std::string & name, size_t n);
+
+    /**
+     * @brief Load a binned likelihood from a ROOT file.
+     * @param config The configuration (see loader.h).
+     * @return The likelihood, with a @ref TemplateModel.
+     * @throw cfg::ConfigurationError if the configuration is invalid.
+     * @throw std::runtime_error if the file or an object cannot be read.
+     */
+    std::unique_ptr<Likelihood> load(const cfg::ConfigurationTable & config);
+}
+#endif // LOADER_H
@@ -0,0 +1,57 @@
+/**
+ * @file minimizer.h
+ * @brief Header file for the local minimizer of the likelihood engine.
+ * @details The fits of the pseudo-experiments have few parameters and an
+ * analytic gradient, so a projected quasi-Newton method (BFGS restricted to
+ * the parameters that are not held at a bound) converges in a handful of
+ * iterations from a good starting point, such as the best point of a coarse
+ * scan.
+ * @author mueller@fnal.gov
+ */
+#ifndef MINIMIZER_H
+#define MINIMIZER_H
+#include <vector>
+#include <cstddef>
+#include <functional>
+
+namespace likelihood
+{
+    /**
+     * @brief The objective of the minimizer.
+     * @details The function returns the value at a point and writes the
+     * gradient.
+     */
+    using Objective = std::function<double(const double * x, double * gradient)>;
+
+    /**
+     * @struct Minimum
+     * @brief The result of a minimization.
+     */
+    struct Minimum
+    {
+        std::vector<double> x;  ///< The position of the minimum.
+        double value;           ///< The value at the minimum.
+        size_t evaluations;     ///< The number of evaluations of the objective.
+        bool converged;         ///< Whether the tolerance was reached.
+    };
+
+    /**
+     * @brief Minimize a function within bounds.
+     * @details Each iteration moves along the quasi-Newton direction of the
+     * free parameters (those not at a bound with the gradient pointing
+     * outwards), projects the step onto the bounds, and backtracks until
+     * the Armijo condition holds. The inverse Hessian is reset whenever its
+     * direction is not a descent direction.
+     * @param objective The function.
+     * @param start The starting point.
+     * @param lower The lower bounds.
+     * @param upper The upper bounds.
+     * @param tolerance The tolerance on the projected gradient and on the
+     * relative change of the value.
+     * @param iterations The largest number of iterations.
+     * @return The minimum.
+     */
+    Minimum minimize(const Objective & objective, std::vector<double> start, const std::vector<double> & lower,
+                     const std::vector<double> & upper, double tolerance = 1e-6, size_t iterations = 100);
+}
+#endif // MINIMIZER_H
@@ -0,0 +1,114 @@
+/**
+ * @file model.h
+ * @brief Header file for the models of the binned prediction used by the
+ * likelihood engine.
+ * @details A model maps a point in parameter space to the predicted content
+ * of each bin and, for the analytic gradients of the likelihood, to the
+ * Jacobian of the prediction with respect to the parameters. The
+ * @ref TemplateModel builds the prediction from a nominal histogram and
+ * per-parameter response templates. Other models (e.g., an oscillation
+ * prediction computed in C++) implement the same interface.
+ * @author mueller@fnal.gov
+ */
+#ifndef MODEL_H
+#define MODEL_H
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace likelihood
+{
+    /**
+     * @class Model
+     * @brief Interface of the models of the binned prediction.
+     * @details The prediction is evaluated concurrently by several threads,
+     * so implementations must not modify their state in @ref predict.
+     */
+    class Model
+    {
+        public:
+            virtual ~Model() = default;
+
+            /**
+             * @brief Get the number of bins of the prediction.
+             * @return The number of bins.
+             */
+            virtual size_t bins() const = 0;
+
+            /**
+             * @brief Get the number of parameters of the model.
+             * @return The number of parameters.
+             */
+            virtual size_t parameters() const = 0;
+
+            /**
+             * @brief Get the name of a parameter.
+             * @param j The index of the parameter.
+             * @return The name of the parameter.
+             */
+            virtual const std::string & name(size_t j) const = 0;
+
+            /**
+             * @brief Evaluate the prediction at a point in parameter space.
+             * @param theta The parameters (parameters() elements).
+             * @param mu The prediction (bins() elements, written).
+             * @param jacobian The derivatives of the prediction, stored as
+             * jacobian[j * bins() + i] = d mu_i / d theta_j (written if not
+             * null).
+             * @return void
+             */
+            virtual void predict(const double * theta, double * mu, double * jacobian) const = 0;
+    };
+
+    /**
+     * @class TemplateModel
+     * @brief Model built from a nominal prediction and response templates.
+     * @details The prediction in bin i is
+     *   mu_i = (n_i + sum_j theta_j s_ji) * prod_k (1 + theta_k r_ki),
+     * where n is the nominal prediction, s_j the additive shift of the
+     * "shift" parameters per unit of the parameter, and r_k the fractional
+     * response of the "scale" parameters (e.g., a uniform response of one for
+     * a normalization). The Jacobian is computed analytically.
+     */
+    class TemplateModel : public Model
+    {
+        public:
+            /**
+             * @brief Constructor for the TemplateModel class.
+             * @param nominal The nominal prediction.
+             */
+            explicit TemplateModel(std::vector<double> nominal);
+
+            /**
+             * @brief Add an additive ("shift") parameter.
+             * @param name The name of the parameter.
+             * @param shift The change of the prediction per unit of the
+             * parameter (one element per bin).
+             * @return void
+             * @throw std::runtime_error if the number of bins does not match.
+             */
+            void add_shift(const std::string & name, std::vector<double> shift);
+
+            /**
+             * @brief Add a multiplicative ("scale") parameter.
+             * @param name The name of the parameter.
+             * @param response The fractional change of the prediction per unit
+             * of the parameter (one element per bin).
+             * @return void
+             * @throw std::runtime_error if the number of bins does not match.
+             */
+            void add_scale(const std::string & name, std::vector<double> response);
+
+            size_t bins() const override { return nominal_.size(); }
+            size_t parameters() const override { return names_.size(); }
+            const std::string & name(size_t j) const override { return names_[j]; }
+            void predict(const double * theta, double * mu, double * jacobian) const override;
+
+        private:
+            std::vector<double> nominal_;
+            std::vector<std::string> names_;
+            std::vector<bool> scale_;
+            std::vector<std::vector<double>> templates_;
+    };
+}
+#endif // MODEL_H
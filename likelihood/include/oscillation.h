@@ -0,0 +1,55 @@
+/**
+ * @file oscillation.h
+ * @brief Header file for the two-flavor disappearance model of the
+ * likelihood engine.
+ * @details The prediction is built from a response matrix that maps bins of
+ * true L/E to the reconstructed bins of the analysis. Each true bin is
+ * weighted by the survival probability
+ *   P = 1 - sin^2(2 theta) sin^2(1.267 dm^2 L / E),
+ * with dm^2 in eV^2 and L / E in km/GeV (or m/MeV), so that the prediction
+ * and its analytic Jacobian are cheap to evaluate at any point of the
+ * (sin^2(2 theta), dm^2) plane.
+ * @author mueller@fnal.gov
+ */
+#ifndef OSCILLATION_H
+#define OSCILLATION_H
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include "model.h"
+
+namespace likelihood
+{
+    /**
+     * @class DisappearanceModel
+     * @brief Two-flavor disappearance prediction.
+     * @details The parameters are sin^2(2 theta) and log10(dm^2 / eV^2), so
+     * that the usual logarithmic grid in dm^2 is uniform in the parameter.
+     */
+    class DisappearanceModel : public Model
+    {
+        public:
+            /**
+             * @brief Constructor for the DisappearanceModel class.
+             * @param response The unoscillated prediction of each
+             * (reconstructed, true) pair of bins (bins * true bins,
+             * row-major).
+             * @param l_over_e The L / E of each true bin (km/GeV).
+             * @throw std::runtime_error if the dimensions do not match.
+             */
+            DisappearanceModel(std::vector<double> response, std::vector<double> l_over_e);
+
+            size_t bins() const override { return bins_; }
+            size_t parameters() const override { return 2; }
+            const std::string & name(size_t j) const override { return names_[j]; }
+            void predict(const double * theta, double * mu, double * jacobian) const override;
+
+        private:
+            size_t bins_;
+            std::vector<double> response_;
+            std::vector<double> l_over_e_;
+            std::vector<std::string> names_;
+    };
+}
+#endif // OSCILLATION_H
@@ -0,0 +1,157 @@
+/**
+ * @file philox.h
+ * @brief Header file for the counter-based random number generator used by
+ * the pseudo-experiments of the likelihood engine.
+ * @details Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy
+ * as 1, 2, 3", SC'11) maps a 128-bit counter and a 64-bit key to 128 random
+ * bits with ten rounds of multiplications and xors. There is no state
+ * besides the counter, so the random numbers of a pseudo-experiment are a
+ * pure function of (seed, grid point, toy): they are identical whatever the
+ * number of threads, the order of the toys, or the splitting of the grid in
+ * shards, and a shard can be restarted from a checkpoint without replaying
+ * the earlier toys.
+ * @author mueller@fnal.gov
+ */
+#ifndef PHILOX_H
+#define PHILOX_H
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+namespace likelihood
+{
+    /**
+     * @brief Apply the Philox4x32-10 bijection.
+     * @param counter The counter.
+     * @param key The key.
+     * @return The four random 32-bit words.
+     */
+    inline std::array<uint32_t, 4> philox4x32(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key)
+    {
+        for(int round(0); round < 10; ++round)
+        {
+            const uint64_t p0(uint64_t(0xD2511F53) * counter[0]);
+            const uint64_t p1(uint64_t(0xCD9E8D57) * counter[2]);
+            counter = {uint32_t(p1 >> 32) ^ counter[1] ^ key[0], uint32_t(p1),
+                       uint32_t(p0 >> 32) ^ counter[3] ^ key[1], uint32_t(p0)};
+            key[0] += 0x9E3779B9;
+            key[1] += 0xBB67AE85;
+        }
+        return counter;
+    }
+
+    /**
+     * @class Philox
+     * @brief Stream of random numbers of one pseudo-experiment.
+     * @details The key is the seed, and the counter is made of the index of
+     * the stream (e.g., the grid point), the index of the pseudo-experiment,
+     * and a block index that is incremented every four words.
+     */
+    class Philox
+    {
+        public:
+            /**
+             * @brief Constructor for the Philox class.
+             * @param seed The seed of the generator.
+             * @param stream The index of the stream.
+             * @param toy The index of the pseudo-experiment.
+             */
+            Philox(uint64_t seed, uint64_t stream, uint32_t toy)
+                : key_{uint32_t(seed), uint32_t(seed >> 32)}, stream_(stream), toy_(toy) {}
+
+            /**
+             * @brief Draw a random 32-bit word.
+             * @return The word.
+             */
+            uint32_t next()
+            {
+                if(used_ == 4)
+                {
+                    words_ = philox4x32({block_++, toy_, uint32_t(stream_), uint32_t(stream_ >> 32)}, key_);
+                    used_ = 0;
+                }
+                return words_[used_++];
+            }
+
+            /**
+             * @brief Draw a uniform random number in (0, 1).
+             * @return The number, with 53 random bits.
+             */
+            double uniform()
+            {
+                const uint64_t hi(next());
+                const uint64_t lo(next());
+                const uint64_t bits((hi << 32 | lo) >> 11);
+                return (bits + 0.5) * 0x1p-53;
+            }
+
+            /**
+             * @brief Draw a standard normal random number.
+             * @details The Box-Muller transformation draws two numbers at a
+             * time, and the second is kept for the next call.
+             * @return The number.
+             */
+            double normal()
+            {
+                if(has_spare_)
+                {
+                    has_spare_ = false;
+                    return spare_;
+                }
+                const double r(std::sqrt(-2 * std::log(uniform()))), phi(2 * M_PI * uniform());
+                spare_ = r * std::sin(phi);
+                has_spare_ = true;
+                return r * std::cos(phi);
+            }
+
+            /**
+             * @brief Draw a Poisson random number.
+             * @details Small means use the inversion by sequential search and
+             * larger means the transformed rejection of Hörmann (PTRS, 1993),
+             * whose cost does not grow with the mean.
+             * @param mean The mean (non-negative).
+             * @return The number.
+             */
+            double poisson(double mean)
+            {
+                if(mean <= 0)
+                    return 0;
+                if(mean < 10)
+                {
+                    const double limit(std::exp(-mean));
+                    double product(uniform()), k(0);
+                    while(product > limit)
+                    {
+                        product *= uniform();
+                        ++k;
+                    }
+                    return k;
+                }
+                const double slam(std::sqrt(mean)), loglam(std::log(mean));
+                const double b(0.931 + 2.53 * slam), a(-0.059 + 0.02483 * b);
+                const double invalpha(1.1239 + 1.1328 / (b - 3.4)), vr(0.9277 - 3.6224 / (b - 2));
+                while(true)
+                {
+                    const double u(uniform() - 0.5), v(uniform()), us(0.5 - std::abs(u));
+                    const double k(std::floor((2 * a / us + b) * u + mean + 0.43));
+                    if(us >= 0.07 && v <= vr)
+                        return k;
+                    if(k < 0 || (us < 0.013 && v > us))
+                        continue;
+                    if(std::log(v) + std::log(invalpha) - std::log(a / (us * us) + b) <= -mean + k * loglam - std::lgamma(k + 1))
+                        return k;
+                }
+            }
+
+        private:
+            std::array<uint32_t, 2> key_;
+            uint64_t stream_;
+            uint32_t toy_;
+            uint32_t block_ = 0;
+            std::array<uint32_t, 4> words_{};
+            int used_ = 4;
+            double spare_ = 0;
+            bool has_spare_ = false;
+    };
+}
+#endif // PHILOX_H
@@ -0,0 +1,203 @@
+/**
+ * @file toys.h
+ * @brief Header file for the Feldman-Cousins pseudo-experiments of the
+ * likelihood engine.
+ * @details The Feldman-Cousins construction needs, at each point of a grid
+ * in parameter space, the distribution of
+ *   dchi2 = chi2(true point) - min chi2
+ * over pseudo-experiments generated at that point. The pseudo-experiments
+ * fluctuate the prediction at the true point with the systematic covariance
+ * (a multivariate normal from the low-rank factor of the covariance) and
+ * then with Poisson statistics. Each one is fit with a coarse scan of the
+ * grid followed by a bounded quasi-Newton minimization with the analytic
+ * gradient. The random numbers come from a counter-based generator keyed by
+ * the seed, the grid point, and the toy (see philox.h), so that the results
+ * do not depend on the number of threads or on the sharding of the grid.
+ * The results of each grid point are written to a checkpoint file as soon
+ * as the point is complete, so that an interrupted shard resumes where it
+ * stopped.
+ * @author mueller@fnal.gov
+ */
+#ifndef TOYS_H
+#define TOYS_H
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+
+#include "likelihood.h"
+#include "minimizer.h"
+
+namespace likelihood
+{
+    /**
+     * @struct Grid
+     * @brief A uniform two-dimensional grid of parameter points.
+     * @details The points are the centers of the cells of the grid, indexed
+     * by g = j * nx + i for the cell (i, j).
+     */
+    struct Grid
+    {
+        size_t nx;      ///< The number of cells of the first parameter.
+        double x_low;   ///< The lower edge of the first parameter.
+        double x_high;  ///< The upper edge of the first parameter.
+        size_t ny;      ///< The number of cells of the second parameter.
+        double y_low;   ///< The lower edge of the second parameter.
+        double y_high;  ///< The upper edge of the second parameter.
+
+        /**
+         * @brief Get the number of points of the grid.
+         * @return The number of points.
+         */
+        size_t size() const { return nx * ny; }
+
+        /**
+         * @brief Get a point of the grid.
+         * @param g The index of the point.
+         * @return The parameters of the point.
+         */
+        std::vector<double> point(size_t g) const
+        {
+            return {x_low + (g % nx + 0.5) * (x_high - x_low) / nx, y_low + (g / nx + 0.5) * (y_high - y_low) / ny};
+        }
+    };
+
+    /**
+     * @struct PointResult
+     * @brief The pseudo-experiments of one grid point.
+     */
+    struct PointResult
+    {
+        size_t index;                       ///< The index of the grid point.
+        std::vector<double> delta_chi2;     ///< The dchi2 of each pseudo-experiment.
+        double data_delta_chi2;             ///< The dchi2 of the data (NaN without data).
+        double seconds;                     ///< The wall time spent on the point.
+    };
+
+    /**
+     * @class FeldmanCousins
+     * @brief Generator and fitter of the pseudo-experiments of a grid.
+     * @details The covariance of the chi-squared statistic is evaluated at
+     * the true point of each grid point (Pearson statistical term plus the
+     * fractional systematic covariance scaled by the prediction) and shared
+     * by all the pseudo-experiments of the point, so that it is factorized
+     * once per grid point.
+     */
+    class FeldmanCousins
+    {
+        public:
+            /**
+             * @brief Constructor for the FeldmanCousins class.
+             * @param model The model of the prediction (two parameters).
+             * @param fractional The fractional systematic covariance (bins *
+             * bins, row-major; empty for none).
+             * @param statistic The test statistic of the fits.
+             * @param grid The grid of true points, whose range also bounds
+             * the fits.
+             * @param seed The seed of the random numbers.
+             * @throw std::runtime_error if the dimensions do not match.
+             */
+            FeldmanCousins(std::shared_ptr<const Model> model, std::vector<double> fractional, Statistic statistic, Grid grid, uint64_t seed);
+
+            /**
+             * @brief Set the observed data.
+             * @details The dchi2 of the data is computed at each grid point
+             * along with the pseudo-experiments.
+             * @param data The data (one element per bin).
+             * @return void
+             * @throw std::runtime_error if the number of bins does not match.
+             */
+            void set_data(std::vector<double> data);
+
+            /**
+             * @brief Set the stride of the coarse scan of the fits.
+             * @details The fits start from the best of every stride-th grid
+             * point in each direction and of the true point. The default is
+             * two.
+             * @param stride The stride.
+             * @return void
+             */
+            void set_fit_stride(size_t stride) { stride_ = std::max<size_t>(1, stride); }
+
+            /**
+             * @brief Generate and fit the pseudo-experiments of a grid point.
+             * @param g The index of the grid point.
+             * @param toys The number of pseudo-experiments.
+             * @param nthreads The number of threads (zero for the number of
+             * hardware threads).
+             * @return The results of the grid point.
+             */
+            PointResult run(size_t g, size_t toys, size_t nthreads) const;
+
+            /**
+             * @brief Get the grid.
+             * @return The grid.
+             */
+            const Grid & grid() const { return grid_; }
+
+        private:
+            /**
+             * @brief Get the systematic covariance at a true point.
+             * @param mu The prediction at the true point.
+             * @return The covariance (bins * bins, row-major).
+             */
+            std::vector<double> systematic(const std::vector<double> & mu) const;
+
+            /**
+             * @brief Build the likelihood with the covariance of a true point.
+             * @param mu The prediction at the true point.
+             * @return The likelihood.
+             */
+            std::unique_ptr<Likelihood> at(const std::vector<double> & mu) const;
+
+            /**
+             * @brief Fit data with a likelihood.
+             * @param lh The likelihood.
+             * @param data The data.
+             * @param truth The true point, which is also a starting point.
+             * @param work The workspace of the calling thread.
+             * @return The minimum.
+             */
+            Minimum fit(const Likelihood & lh, const double * data, const std::vector<double> & truth, std::vector<double> & work) const;
+
+            std::shared_ptr<const Model> model_;
+            std::vector<double> fractional_;
+            Statistic statistic_;
+            Grid grid_;
+            uint64_t seed_;
+            std::vector<double> data_;
+            size_t stride_ = 2;
+    };
+
+    /**
+     * @brief Write the results of a grid point to a checkpoint.
+     * @details Each grid point is one line: the index, the dchi2 of the
+     * data, the wall time, the number of pseudo-experiments, and their
+     * dchi2, separated by whitespace.
+     * @param output The checkpoint stream (flushed).
+     * @param result The results of the grid point.
+     * @return void
+     */
+    void write_checkpoint(std::ostream & output, const PointResult & result);
+
+    /**
+     * @brief Read the results of the grid points from a checkpoint.
+     * @details An incomplete last line (e.g., from an interrupted job) is
+     * ignored, so that the grid point is generated again.
+     * @param path The path of the checkpoint file (missing files are empty).
+     * @return The results, by index of the grid point.
+     */
+    std::map<size_t, PointResult> read_checkpoint(const std::string & path);
+
+    /**
+     * @brief Get the critical value of a dchi2 distribution.
+     * @param delta_chi2 The dchi2 of the pseudo-experiments.
+     * @param level The confidence level (e.g., 0.9).
+     * @return The quantile of the distribution at the confidence level.
+     */
+    double critical_value(std::vector<double> delta_chi2, double level);
+}
+#endif // TOYS_H
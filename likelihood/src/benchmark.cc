@@ -0,0 +1,304 @@
+/**
+ * @file benchmark.cc
+ * @brief Benchmark of the binned likelihood engine.
+ * @details This program measures the throughput of the likelihood engine in
+ * evaluations per second, for each test statistic with and without the
+ * gradient and for an increasing number of threads. It also measures the
+ * cost of a full factorization of the covariance against that of toggling a
+ * systematic block with rank-one updates, and checks the analytic gradient
+ * against central finite differences. The likelihood is either loaded from
+ * the inputs of a fit (see loader.h) or, by default, a synthetic problem
+ * whose size is configured by an optional [benchmark] table:
+ * @code
+ * [benchmark]
+ * bins = 200          # number of bins
+ * parameters = 20     # number of parameters (half scale, half shift)
+ * blocks = 4          # number of systematic blocks
+ * rank = 20           # rank of each block
+ * points = 20000      # number of points per measurement
+ * seed = 1            # seed of the synthetic problem and of the points
+ * @endcode
+ * @author mueller@fnal.gov
+ */
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+
+#include "configuration.h"
+#include "likelihood.h"
+#include "loader.h"
+
+namespace
+{
+    /**
+     * @struct Problem
+     * @brief The inputs of a synthetic binned likelihood.
+     */
+    struct Problem
+    {
+        std::shared_ptr<likelihood::TemplateModel> model;   ///< The model of the prediction.
+        std::vector<double> data;                           ///< The pseudo-data.
+        std::vector<double> variance;                       ///< The statistical variance.
+        std::vector<std::vector<std::vector<double>>> blocks; ///< The low-rank factors of the blocks.
+    };
+
+    /**
+     * @brief Build a synthetic problem.
+     * @details The nominal prediction is a falling spectrum. The scale
+     * parameters have smooth responses of 5-20% and the shift parameters
+     * move a few percent of the prediction. The blocks have random low-rank
+     * factors of a few percent of the prediction, and the pseudo-data is a
+     * Gaussian fluctuation of the nominal prediction.
+     * @param bins The number of bins.
+     * @param parameters The number of parameters.
+     * @param blocks The number of systematic blocks.
+     * @param rank The rank of each block.
+     * @param random The random number generator.
+     * @return The problem.
+     */
+    Problem synthetic(size_t bins, size_t parameters, size_t blocks, size_t rank, std::mt19937_64 & random)
+    {
+        std::uniform_real_distribution<double> uniform(0, 1);
+        std::normal_distribution<double> normal(0, 1);
+        Problem problem;
+        std::vector<double> nominal(bins);
+        for(size_t i(0); i < bins; ++i)
+            nominal[i] = 50 + 1000 * std::exp(-3.0 * i / bins);
+        problem.model = std::make_shared<likelihood::TemplateModel>(nominal);
+        for(size_t j(0); j < parameters; ++j)
+        {
+            const double phase(2 * M_PI * uniform(random)), amplitude(0.05 + 0.15 * uniform(random));
+            std::vector<double> shape(bins);
+            for(size_t i(0); i < bins; ++i)
+                shape[i] = amplitude * (0.5 + 0.5 * std::sin(phase + 4.0 * M_PI * i / bins));
+            if(j % 2 == 0)
+                problem.model->add_scale("scale_" + std::to_string(j), shape);
+            else
+            {
+                for(size_t i(0); i < bins; ++i)
+                    shape[i] *= 0.3 * nominal[i];
+                problem.model->add_shift("shift_" + std::to_string(j), shape);
+            }
+        }
+        problem.variance = nominal;
+        problem.data.resize(bins);
+        for(size_t i(0); i < bins; ++i)
+            problem.data[i] = std::max(0.0, std::round(nominal[i] + std::sqrt(nominal[i]) * normal(random)));
+        for(size_t b(0); b < blocks; ++b)
+        {
+            std::vector<std::vector<double>> columns(rank, std::vector<double>(bins));
+            for(std::vector<double> & c : columns)
+                for(size_t i(0); i < bins; ++i)
+                    c[i] = 0.05 * nominal[i] * normal(random) / std::sqrt(rank);
+            problem.blocks.push_back(std::move(columns));
+        }
+        return problem;
+    }
+
+    /**
+     * @brief Draw random points in parameter space.
+     * @param count The number of points.
+     * @param parameters The number of parameters.
+     * @param random The random number generator.
+     * @return The points, uniform in [-1, 1] for each parameter.
+     */
+    std::vector<std::vector<double>> draw(size_t count, size_t parameters, std::mt19937_64 & random)
+    {
+        std::uniform_real_distribution<double> uniform(-1, 1);
+        std::vector<std::vector<double>> points(count, std::vector<double>(parameters));
+        for(std::vector<double> & point : points)
+            for(double & x : point)
+                x = uniform(random);
+        return points;
+    }
+
+    /**
+     * @brief Get the number of seconds elapsed since a time point.
+     * @param start The time point.
+     * @return The number of seconds.
+     */
+    double since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /**
+     * @brief Check the analytic gradient against central finite differences.
+     * @param lh The likelihood.
+     * @param point The point of the check.
+     * @return The largest difference relative to the largest component of
+     * the gradient.
+     */
+    double check_gradient(const likelihood::Likelihood & lh, std::vector<double> point)
+    {
+        const size_t p(point.size());
+        std::vector<double> gradient(p);
+        lh.evaluate(point.data(), gradient.data());
+        double largest(0), difference(0);
+        for(size_t j(0); j < p; ++j)
+        {
+            const double x(point[j]), h(1e-5 * std::max(1.0, std::abs(x)));
+            point[j] = x + h;
+            const double up(lh.evaluate(point.data(), nullptr));
+            point[j] = x - h;
+            const double down(lh.evaluate(point.data(), nullptr));
+            point[j] = x;
+            largest = std::max(largest, std::abs(gradient[j]));
+            difference = std::max(difference, std::abs(gradient[j] - (up - down) / (2 * h)));
+        }
+        return largest > 0 ? difference / largest : difference;
+    }
+
+    /**
+     * @brief Measure the throughput of a likelihood.
+     * @details The points are evaluated with and without the gradient for
+     * 1, 2, 4, ... threads up to the number of hardware threads.
+     * @param label The label of the likelihood in the report.
+     * @param lh The likelihood.
+     * @param points The points.
+     * @return void
+     */
+    void measure(const std::string & label, const likelihood::Likelihood & lh, const std::vector<std::vector<double>> & points)
+    {
+        const size_t hardware(std::max(1u, std::thread::hardware_concurrency()));
+        std::vector<size_t> threads;
+        for(size_t t(1); t < hardware; t *= 2)
+            threads.push_back(t);
+        threads.push_back(hardware);
+
+        for(bool gradient : {false, true})
+        {
+            double single(0);
+            for(size_t t : threads)
+            {
+                const auto start(std::chrono::steady_clock::now());
+                lh.evaluate(points, t, gradient);
+                const double rate(points.size() / since(start));
+                if(t == 1)
+                    single = rate;
+                std::cout << std::left << std::setw(10) << label << std::setw(10) << (gradient ? "gradient" : "value")
+                          << std::right << std::setw(8) << t << std::setw(16) << std::fixed << std::setprecision(0) << rate
+                          << std::setw(10) << std::setprecision(2) << rate / single << std::endl;
+            }
+        }
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    if(argc > 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " [configuration.toml]" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        cfg::ConfigurationTable config;
+        if(argc == 2)
+            config.set_config(argv[1]);
+        const size_t count(argc == 2 ? config.get_int_field("benchmark.points", 20000) : 20000);
+        std::mt19937_64 random(argc == 2 ? config.get_int_field("benchmark.seed", 1) : 1);
+
+        /**
+         * @brief Build the likelihoods.
+         * @details The inputs of a fit are loaded if the configuration has a
+         * [likelihood] table, with the statistic it configures. Otherwise,
+         * a synthetic problem is built and benchmarked with both statistics.
+         */
+        std::vector<std::pair<std::string, std::unique_ptr<likelihood::Likelihood>>> likelihoods;
+        if(argc == 2 && config.has_field("likelihood"))
+        {
+            std::unique_ptr<likelihood::Likelihood> lh(likelihood::load(config));
+            const std::string statistic(config.get_string_field("likelihood.statistic", "chi2"));
+            likelihoods.emplace_back(statistic, std::move(lh));
+        }
+        else
+        {
+            auto size = [&](const std::string & field, int64_t value)
+            {
+                return static_cast<size_t>(argc == 2 ? config.get_int_field("benchmark." + field, value) : value);
+            };
+            const Problem problem(synthetic(size("bins", 200), size("parameters", 20), size("blocks", 4), size("rank", 20), random));
+            for(likelihood::Statistic statistic : {likelihood::Statistic::Chi2, likelihood::Statistic::Poisson})
+            {
+                auto lh(std::make_unique<likelihood::Likelihood>(problem.model, problem.data, statistic));
+                lh->set_statistical(problem.variance);
+                for(size_t b(0); b < problem.blocks.size(); ++b)
+                    lh->add_block_factor("block_" + std::to_string(b), problem.blocks[b], true);
+                likelihoods.emplace_back(statistic == likelihood::Statistic::Chi2 ? "chi2" : "poisson", std::move(lh));
+            }
+            std::cout << "Synthetic problem: " << problem.data.size() << " bins, " << problem.model->parameters()
+                      << " parameters, " << problem.blocks.size() << " covariance blocks." << std::endl;
+        }
+
+        const likelihood::Model & model(likelihoods.front().second->model());
+        const std::vector<std::vector<double>> points(draw(count, model.parameters(), random));
+        const std::vector<double> origin(model.parameters(), 0.0);
+
+        /**
+         * @brief Compare a full factorization with the toggling of a block.
+         * @details Each block is toggled off and on again with rank-one
+         * downdates and updates (or a factorization if its rank is too
+         * large), then a full factorization is timed on its own. The value at the origin after the toggles is
+         * compared to that with a fresh factorization.
+         */
+        for(auto & [label, lh] : likelihoods)
+        {
+            if(label != "chi2" || lh->blocks().empty())
+                continue;
+            const double reference(lh->evaluate(origin.data(), nullptr));
+            const size_t factorizations(lh->factorizations()), updates(lh->updates());
+            auto start(std::chrono::steady_clock::now());
+            for(const std::string & block : lh->blocks())
+            {
+                lh->enable(block, false);
+                lh->evaluate(origin.data(), nullptr);
+                lh->enable(block, true);
+                lh->evaluate(origin.data(), nullptr);
+            }
+            const double toggle(since(start) / (2 * lh->blocks().size()));
+            const double toggled(lh->evaluate(origin.data(), nullptr));
+            std::cout << "Block toggle:  " << std::scientific << std::setprecision(3) << toggle << " s ("
+                      << lh->updates() - updates << " rank-one updates, " << lh->factorizations() - factorizations
+                      << " factorizations, relative difference " << std::abs(toggled - reference) / reference << ")" << std::endl;
+
+            // With a vanishing update fraction, toggling a block only marks
+            // the factorization out of date.
+            lh->set_update_fraction(0);
+            start = std::chrono::steady_clock::now();
+            const size_t repeats(10);
+            for(size_t r(0); r < repeats; ++r)
+            {
+                lh->enable(lh->blocks().front(), false);
+                lh->enable(lh->blocks().front(), true);
+                lh->evaluate(origin.data(), nullptr);
+            }
+            lh->set_update_fraction(0.15);
+            std::cout << "Factorization: " << std::scientific << std::setprecision(3) << since(start) / repeats << " s" << std::endl;
+        }
+
+        // The analytic gradients against finite differences.
+        for(auto & [label, lh] : likelihoods)
+            std::cout << "Gradient check (" << label << "): largest relative difference " << std::scientific
+                      << std::setprecision(2) << check_gradient(*lh, points.front()) << std::endl;
+
+        // The throughput in evaluations per second.
+        std::cout << std::left << std::setw(10) << "Statistic" << std::setw(10) << "Mode" << std::right << std::setw(8)
+                  << "Threads" << std::setw(16) << "Evaluations/s" << std::setw(10) << "Speedup" << std::endl;
+        for(auto & [label, lh] : likelihoods)
+            measure(label, *lh, points);
+    }
+    catch(const std::exception & e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
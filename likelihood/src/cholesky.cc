@@ -0,0 +1,163 @@
+/**
+ * @file cholesky.cc
+ * @brief Implementation of the Cholesky factorization used by the binned
+ * likelihood engine.
+ * @details This file contains the factorization, the rank-one updates and
+ * downdates, the triangular solves, and the pivoted low-rank factorization
+ * declared in cholesky.h.
+ * @author mueller@fnal.gov
+ */
+#include <cmath>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+
+#include "cholesky.h"
+
+namespace likelihood
+{
+    // Factorize a matrix.
+    void Cholesky::factorize(const std::vector<double> & matrix, size_t n)
+    {
+        if(matrix.size() != n * n)
+            throw std::runtime_error("Cholesky factorization of a matrix of size " + std::to_string(matrix.size())
+                                     + " with dimension " + std::to_string(n) + ".");
+        std::vector<double> l(n * n, 0.0);
+        for(size_t i(0); i < n; ++i)
+        {
+            const double * li(&l[i * n]);
+            for(size_t j(0); j <= i; ++j)
+            {
+                const double * lj(&l[j * n]);
+                double s(matrix[i * n + j]);
+                for(size_t k(0); k < j; ++k)
+                    s -= li[k] * lj[k];
+                if(i == j)
+                {
+                    if(!(s > 0))
+                        throw std::runtime_error("Matrix is not positive definite (pivot " + std::to_string(i) + ").");
+                    l[i * n + i] = std::sqrt(s);
+                }
+                else
+                    l[i * n + j] = s / lj[j];
+            }
+        }
+        n_ = n;
+        l_.swap(l);
+    }
+
+    // Update the factorization to that of A + v v^T.
+    void Cholesky::update(std::vector<double> v)
+    {
+        for(size_t k(0); k < n_; ++k)
+        {
+            double & lkk(l_[k * n_ + k]);
+            const double r(std::hypot(lkk, v[k]));
+            const double c(r / lkk), s(v[k] / lkk);
+            lkk = r;
+            for(size_t i(k + 1); i < n_; ++i)
+            {
+                double & lik(l_[i * n_ + k]);
+                lik = (lik + s * v[i]) / c;
+                v[i] = c * v[i] - s * lik;
+            }
+        }
+    }
+
+    // Update the factorization to that of A - v v^T.
+    bool Cholesky::downdate(std::vector<double> v)
+    {
+        std::vector<double> l(l_);
+        for(size_t k(0); k < n_; ++k)
+        {
+            double & lkk(l[k * n_ + k]);
+            const double d(lkk * lkk - v[k] * v[k]);
+            if(!(d > 0))
+                return false;
+            const double r(std::sqrt(d));
+            const double c(r / lkk), s(v[k] / lkk);
+            lkk = r;
+            for(size_t i(k + 1); i < n_; ++i)
+            {
+                double & lik(l[i * n_ + k]);
+                lik = (lik - s * v[i]) / c;
+                v[i] = c * v[i] - s * lik;
+            }
+        }
+        l_.swap(l);
+        return true;
+    }
+
+    // Solve L y = x in place.
+    void Cholesky::solve_lower(double * x) const
+    {
+        for(size_t i(0); i < n_; ++i)
+        {
+            const double * li(&l_[i * n_]);
+            double s(x[i]);
+            for(size_t k(0); k < i; ++k)
+                s -= li[k] * x[k];
+            x[i] = s / li[i];
+        }
+    }
+
+    // Solve L^T z = y in place.
+    void Cholesky::solve_upper(double * y) const
+    {
+        // Column-oriented back substitution, so that the rows of L are read
+        // contiguously.
+        for(size_t i(n_); i-- > 0;)
+        {
+            const double * li(&l_[i * n_]);
+            y[i] /= li[i];
+            for(size_t k(0); k < i; ++k)
+                y[k] -= li[k] * y[i];
+        }
+    }
+
+    // Get the logarithm of the determinant of the matrix.
+    double Cholesky::log_determinant() const
+    {
+        double result(0);
+        for(size_t i(0); i < n_; ++i)
+            result += 2 * std::log(l_[i * n_ + i]);
+        return result;
+    }
+
+    // Compute a low-rank factor of a symmetric positive semi-definite matrix.
+    std::vector<std::vector<double>> Cholesky::low_rank(const std::vector<double> & matrix, size_t n, double tolerance)
+    {
+        std::vector<double> d(n);
+        double dmax(0);
+        for(size_t i(0); i < n; ++i)
+        {
+            d[i] = matrix[i * n + i];
+            dmax = std::max(dmax, d[i]);
+        }
+
+        std::vector<std::vector<double>> columns;
+        std::vector<bool> chosen(n, false);
+        while(columns.size() < n)
+        {
+            const size_t p(std::max_element(d.begin(), d.end()) - d.begin());
+            if(!(d[p] > tolerance * dmax))
+                break;
+            std::vector<double> c(n, 0.0);
+            c[p] = std::sqrt(d[p]);
+            for(size_t i(0); i < n; ++i)
+            {
+                if(chosen[i] || i == p)
+                    continue;
+                double s(matrix[i * n + p]);
+                for(const std::vector<double> & prev : columns)
+                    s -= prev[i] * prev[p];
+                c[i] = s / c[p];
+            }
+            chosen[p] = true;
+            for(size_t i(0); i < n; ++i)
+                d[i] = chosen[i] ? 0.0 : d[i] - c[i] * c[i];
+            columns.push_back(std::move(c));
+        }
+        return columns;
+    }
+}
@@ -0,0 +1,292 @@
+/**
+ * @file fc.cc
+ * @brief Main function of the Feldman-Cousins pseudo-experiment engine.
+ * @details This program generates and fits the pseudo-experiments of a
+ * (sin^2(2 theta), dm^2) grid for a two-flavor disappearance analysis and
+ * writes the critical dchi2 values of each grid point (and, with data, the
+ * dchi2 of the data) to a ROOT file for the production of contours. The
+ * grid can be split in shards run as independent jobs, and each job writes
+ * the results of each grid point to its checkpoint as soon as the point is
+ * complete:
+ * @code
+ * fc_toys config.toml          # the full grid, then the summary
+ * fc_toys config.toml 3/20     # shard 3 of 20 (grid points g % 20 == 3)
+ * fc_toys config.toml merge    # the summary of the checkpoints of all shards
+ * @endcode
+ * The configuration is a TOML file with a [fc] table:
+ * @code
+ * [fc]
+ * path = 'fc_inputs.root'
+ * response = 'response'               # TH2 (x: reco bin, y: true L/E in km/GeV)
+ * systematics = 'fractional_covariance' # TMatrixDSym, TMatrixD, or TH2 (optional)
+ * data = 'data'                       # TH1 of the data (optional)
+ * statistic = 'chi2'                  # "chi2" or "poisson"
+ * sin2_2theta = [20, 0.0, 1.0]        # cells, low edge, high edge
+ * log_dm2 = [20, -1.0, 2.0]           # cells, low edge, high edge (log10 eV^2)
+ * toys = 2000                         # pseudo-experiments per grid point
+ * seed = 1
+ * threads = 0                         # zero for all hardware threads
+ * fit_stride = 2                      # stride of the coarse scan of the fits
+ * confidence_levels = [0.6827, 0.90, 0.95, 0.9973]
+ * checkpoint = 'fc_toys.txt'          # shards append ".<shard>"
+ * output = 'fc_contours.root'
+ * @endcode
+ * @author mueller@fnal.gov
+ */
+#include <map>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <filesystem>
+
+#include "TFile.h"
+#include "TH2.h"
+#include "TH2D.h"
+#include "TROOT.h"
+
+#include "configuration.h"
+#include "loader.h"
+#include "oscillation.h"
+#include "toys.h"
+
+namespace
+{
+    /**
+     * @brief Read the response matrix of the disappearance model.
+     * @param file The input file.
+     * @param name The name of the TH2 (x: reconstructed bin, y: true L/E).
+     * @param l_over_e The L / E of the centers of the true bins (written).
+     * @return The response matrix (reco bins * true bins, row-major).
+     * @throw std::runtime_error if there is no such histogram.
+     */
+    std::vector<double> read_response(TFile * file, const std::string & name, std::vector<double> & l_over_e)
+    {
+        TH2 * h(dynamic_cast<TH2 *>(file->Get(name.c_str())));
+        if(!h)
+            throw std::runtime_error("No response histogram " + name + " in " + file->GetName() + ".");
+        const size_t n(h->GetNbinsX()), m(h->GetNbinsY());
+        std::vector<double> response(n * m);
+        l_over_e.resize(m);
+        for(size_t k(0); k < m; ++k)
+            l_over_e[k] = h->GetYaxis()->GetBinCenter(k + 1);
+        for(size_t i(0); i < n; ++i)
+            for(size_t k(0); k < m; ++k)
+                response[i * m + k] = h->GetBinContent(i + 1, k + 1);
+        return response;
+    }
+
+    /**
+     * @brief Read the grid of a parameter.
+     * @param config The configuration.
+     * @param field The field of the grid ([cells, low edge, high edge]).
+     * @return The grid values.
+     * @throw cfg::ConfigurationError if the grid is not valid.
+     */
+    std::vector<double> read_axis(const cfg::ConfigurationTable & config, const std::string & field)
+    {
+        const std::vector<double> axis(config.get_double_vector(field));
+        if(axis.size() != 3 || axis[0] < 1 || !(axis[2] > axis[1]))
+            throw cfg::ConfigurationError("Field " + field + " must be [cells, low edge, high edge].");
+        return axis;
+    }
+
+    /**
+     * @brief Write the summary of the grid to a ROOT file.
+     * @param path The path of the output file.
+     * @param grid The grid.
+     * @param results The results of the grid points.
+     * @param levels The confidence levels.
+     * @return void
+     */
+    void summarize(const std::string & path, const likelihood::Grid & grid, const std::map<size_t, likelihood::PointResult> & results,
+                   const std::vector<double> & levels)
+    {
+        TFile output(path.c_str(), "RECREATE");
+        auto histogram = [&](const std::string & name, const std::string & title)
+        {
+            TH2D * h(new TH2D(name.c_str(), (title + ";sin^{2}(2#theta);log_{10}(#Deltam^{2}/eV^{2})").c_str(),
+                              grid.nx, grid.x_low, grid.x_high, grid.ny, grid.y_low, grid.y_high));
+            h->SetDirectory(&output);
+            return h;
+        };
+        TH2D * toys(histogram("toys", "Pseudo-experiments"));
+        TH2D * data(histogram("delta_chi2_data", "#Delta#chi^{2} of the data"));
+        TH2D * seconds(histogram("seconds", "Wall time (s)"));
+        std::vector<TH2D *> critical;
+        for(double level : levels)
+        {
+            std::ostringstream name;
+            name << "critical_" << std::fixed << std::setprecision(2) << 100 * level;
+            std::string label(name.str());
+            std::replace(label.begin(), label.end(), '.', 'p');
+            critical.push_back(histogram(label, "Critical #Delta#chi^{2} at " + name.str().substr(9) + "% CL"));
+        }
+
+        bool has_data(false);
+        for(const auto & [g, result] : results)
+        {
+            const int i(g % grid.nx + 1), j(g / grid.nx + 1);
+            toys->SetBinContent(i, j, result.delta_chi2.size());
+            seconds->SetBinContent(i, j, result.seconds);
+            if(!std::isnan(result.data_delta_chi2))
+            {
+                data->SetBinContent(i, j, result.data_delta_chi2);
+                has_data = true;
+            }
+            for(size_t l(0); l < levels.size(); ++l)
+                critical[l]->SetBinContent(i, j, likelihood::critical_value(result.delta_chi2, levels[l]));
+        }
+        if(!has_data)
+            delete data;
+        output.Write();
+        output.Close();
+        std::cout << "Wrote the critical values of " << results.size() << " of " << grid.size() << " grid points to " << path << "." << std::endl;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    gErrorIgnoreLevel = kError;
+    if(argc < 2 || argc > 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <configuration.toml> [<shard>/<shards> | merge]" << std::endl;
+        return 1;
+    }
+
+    cfg::ConfigurationTable config;
+    try
+    {
+        config.set_config(argv[1]);
+    }
+    catch(const cfg::ConfigurationError & e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        // The grid, the sharding, and the checkpoint.
+        const std::vector<double> x(read_axis(config, "fc.sin2_2theta")), y(read_axis(config, "fc.log_dm2"));
+        const likelihood::Grid grid{size_t(x[0]), x[1], x[2], size_t(y[0]), y[1], y[2]};
+        const std::string checkpoint(config.get_string_field("fc.checkpoint", "fc_toys.txt"));
+        const std::vector<double> levels(config.get_double_vector("fc.confidence_levels"));
+        const std::string mode(argc == 3 ? argv[2] : "");
+        size_t shard(0), shards(1);
+        if(!mode.empty() && mode != "merge")
+        {
+            const size_t slash(mode.find('/'));
+            if(slash == std::string::npos)
+                throw std::runtime_error("Invalid shard " + mode + " (expected <shard>/<shards> or merge).");
+            shard = std::stoul(mode.substr(0, slash));
+            shards = std::stoul(mode.substr(slash + 1));
+            if(shards == 0 || shard >= shards)
+                throw std::runtime_error("Invalid shard " + mode + ".");
+        }
+
+        // The merge of the checkpoints of all shards.
+        if(mode == "merge")
+        {
+            std::map<size_t, likelihood::PointResult> results(likelihood::read_checkpoint(checkpoint));
+            const std::filesystem::path base(checkpoint);
+            const std::filesystem::path directory(base.has_parent_path() ? base.parent_path() : std::filesystem::path("."));
+            for(const auto & entry : std::filesystem::directory_iterator(directory))
+            {
+                const std::string name(entry.path().filename().string());
+                if(name.rfind(base.filename().string() + ".", 0) != 0 || entry.path().extension() == ".tmp")
+                    continue;
+                for(auto & [g, result] : likelihood::read_checkpoint(entry.path().string()))
+                    results[g] = std::move(result);
+            }
+            summarize(config.get_string_field("fc.output", "fc_contours.root"), grid, results, levels);
+            return 0;
+        }
+
+        // The model, the systematics, and the data.
+        const std::string path(config.get_string_field("fc.path"));
+        TFile * file(TFile::Open(path.c_str(), "READ"));
+        if(!file || file->IsZombie())
+            throw std::runtime_error("Unable to open Feldman-Cousins inputs " + path + ".");
+        std::vector<double> l_over_e;
+        std::vector<double> response(read_response(file, config.get_string_field("fc.response"), l_over_e));
+        auto model(std::make_shared<likelihood::DisappearanceModel>(std::move(response), std::move(l_over_e)));
+        const std::string systematics(config.get_string_field("fc.systematics", ""));
+        std::vector<double> fractional;
+        if(!systematics.empty())
+            fractional = likelihood::read_matrix(file, systematics, model->bins());
+        const std::string data(config.get_string_field("fc.data", ""));
+        std::vector<double> observed;
+        if(!data.empty())
+            observed = likelihood::read_histogram(file, data);
+        file->Close();
+        delete file;
+
+        const std::string statistic(config.get_string_field("fc.statistic", "chi2"));
+        if(statistic != "chi2" && statistic != "poisson")
+            throw cfg::ConfigurationError("Unknown statistic '" + statistic + "' (expected chi2 or poisson).");
+        likelihood::FeldmanCousins fc(model, std::move(fractional), statistic == "chi2" ? likelihood::Statistic::Chi2 : likelihood::Statistic::Poisson,
+                                      grid, config.get_int_field("fc.seed", 1));
+        if(!observed.empty())
+            fc.set_data(std::move(observed));
+        fc.set_fit_stride(config.get_int_field("fc.fit_stride", 2));
+        const size_t toys(config.get_int_field("fc.toys"));
+        const size_t threads(config.get_int_field("fc.threads", 0));
+
+        /**
+         * @brief Resume from the checkpoint.
+         * @details The complete grid points of the checkpoint are kept and
+         * the checkpoint is rewritten without an interrupted last line, so
+         * that new grid points can be appended to it. The rewrite goes to
+         * "<checkpoint>.tmp", which then replaces the checkpoint in one
+         * rename, so that an interruption leaves either the old or the new
+         * checkpoint intact.
+         */
+        const std::string shard_checkpoint(shards > 1 ? checkpoint + "." + std::to_string(shard) : checkpoint);
+        std::map<size_t, likelihood::PointResult> results(likelihood::read_checkpoint(shard_checkpoint));
+        {
+            const std::string temporary(shard_checkpoint + ".tmp");
+            std::ofstream rewrite(temporary, std::ios::trunc);
+            for(const auto & [g, result] : results)
+                likelihood::write_checkpoint(rewrite, result);
+            rewrite.close();
+            if(!rewrite || std::rename(temporary.c_str(), shard_checkpoint.c_str()) != 0)
+                throw std::runtime_error("Unable to write the checkpoint " + shard_checkpoint + ".");
+        }
+        std::ofstream output(shard_checkpoint, std::ios::app);
+        if(!output)
+            throw std::runtime_error("Unable to write the checkpoint " + shard_checkpoint + ".");
+        if(!results.empty())
+            std::cout << "Resuming from " << shard_checkpoint << " with " << results.size() << " complete grid points." << std::endl;
+
+        // The pseudo-experiments of the grid points of the shard.
+        for(size_t g(shard); g < grid.size(); g += shards)
+        {
+            if(results.count(g))
+                continue;
+            likelihood::PointResult result(fc.run(g, toys, threads));
+            likelihood::write_checkpoint(output, result);
+            const std::vector<double> point(grid.point(g));
+            std::cout << "Grid point " << g << " (sin2_2theta = " << point[0] << ", log10_dm2 = " << point[1] << "): " << toys
+                      << " toys in " << std::fixed << std::setprecision(2) << result.seconds << " s ("
+                      << std::setprecision(0) << toys / result.seconds << " toys/s)" << std::defaultfloat << std::endl;
+            results[g] = std::move(result);
+        }
+
+        if(shards == 1)
+            summarize(config.get_string_field("fc.output", "fc_contours.root"), grid, results, levels);
+        else
+            std::cout << "Shard " << shard << "/" << shards << " complete; run with 'merge' once all shards are complete." << std::endl;
+    }
+    catch(const std::exception & e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
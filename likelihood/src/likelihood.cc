@@ -0,0 +1,274 @@
+/**
+ * @file likelihood.cc
+ * @brief Implementation of the binned likelihood of the likelihood engine.
+ * @details This file contains the management of the covariance blocks and
+ * of the cached factorization, and the evaluation of the test statistics
+ * and their gradients declared in likelihood.h.
+ * @author mueller@fnal.gov
+ */
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#include "likelihood.h"
+
+namespace likelihood
+{
+    // Constructor for the Likelihood class.
+    Likelihood::Likelihood(std::shared_ptr<const Model> model, std::vector<double> data, Statistic statistic)
+        : model_(std::move(model)), data_(std::move(data)), statistic_(statistic),
+          prior_center_(model_->parameters(), 0.0), prior_weight_(model_->parameters(), 0.0)
+    {
+        if(data_.size() != model_->bins())
+            throw std::runtime_error("Data has " + std::to_string(data_.size()) + " bins (expected "
+                                     + std::to_string(model_->bins()) + ").");
+    }
+
+    // Set the diagonal statistical term of the covariance.
+    void Likelihood::set_statistical(std::vector<double> variance)
+    {
+        if(variance.size() != data_.size())
+            throw std::runtime_error("Statistical variance has " + std::to_string(variance.size()) + " bins (expected "
+                                     + std::to_string(data_.size()) + ").");
+        variance_ = std::move(variance);
+        dirty_ = true;
+    }
+
+    // Add a systematic block to the covariance from its matrix.
+    void Likelihood::add_block(const std::string & name, const std::vector<double> & covariance, bool enabled, double tolerance)
+    {
+        const size_t n(data_.size());
+        if(blocks_.count(name))
+            throw std::runtime_error("Duplicate covariance block " + name + ".");
+        if(covariance.size() != n * n)
+            throw std::runtime_error("Covariance block " + name + " has " + std::to_string(covariance.size())
+                                     + " elements (expected " + std::to_string(n * n) + ").");
+        blocks_[name] = Block{covariance, Cholesky::low_rank(covariance, n, tolerance), enabled};
+        order_.push_back(name);
+        dirty_ = dirty_ || enabled;
+    }
+
+    // Add a systematic block to the covariance from its low-rank factor.
+    void Likelihood::add_block_factor(const std::string & name, std::vector<std::vector<double>> columns, bool enabled)
+    {
+        const size_t n(data_.size());
+        if(blocks_.count(name))
+            throw std::runtime_error("Duplicate covariance block " + name + ".");
+        std::vector<double> covariance(n * n, 0.0);
+        for(const std::vector<double> & c : columns)
+        {
+            if(c.size() != n)
+                throw std::runtime_error("Covariance block " + name + " has a column of " + std::to_string(c.size())
+                                         + " bins (expected " + std::to_string(n) + ").");
+            for(size_t i(0); i < n; ++i)
+                for(size_t j(0); j < n; ++j)
+                    covariance[i * n + j] += c[i] * c[j];
+        }
+        blocks_[name] = Block{std::move(covariance), std::move(columns), enabled};
+        order_.push_back(name);
+        dirty_ = dirty_ || enabled;
+    }
+
+    // Enable or disable a systematic block.
+    void Likelihood::enable(const std::string & name, bool enabled)
+    {
+        auto it(blocks_.find(name));
+        if(it == blocks_.end())
+            throw std::runtime_error("No covariance block " + name + ".");
+        Block & block(it->second);
+        if(block.enabled == enabled)
+            return;
+        block.enabled = enabled;
+
+        // The factorization is recomputed on the next evaluation if it is
+        // already out of date, unused, or cheaper than the updates.
+        if(dirty_ || statistic_ != Statistic::Chi2 || block.columns.size() > update_fraction_ * data_.size())
+        {
+            dirty_ = true;
+            return;
+        }
+        for(const std::vector<double> & c : block.columns)
+        {
+            if(enabled)
+                cholesky_.update(c);
+            else if(!cholesky_.downdate(c))
+            {
+                // The downdate lost positive definiteness to rounding; the
+                // partially downdated factor is discarded.
+                dirty_ = true;
+                return;
+            }
+            ++updates_;
+        }
+    }
+
+    // Add a Gaussian prior on a parameter.
+    void Likelihood::set_prior(size_t j, double center, double sigma)
+    {
+        if(j >= prior_center_.size())
+            throw std::runtime_error("No parameter " + std::to_string(j) + " for the prior.");
+        if(!(sigma > 0))
+            throw std::runtime_error("The width of the prior on " + model_->name(j) + " must be positive.");
+        prior_center_[j] = center;
+        prior_weight_[j] = 1.0 / (sigma * sigma);
+    }
+
+    // Recompute the factorization of the covariance if it is out of date.
+    void Likelihood::refactorize() const
+    {
+        if(statistic_ != Statistic::Chi2 || !dirty_.load(std::memory_order_acquire))
+            return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(!dirty_)
+            return;
+        const size_t n(data_.size());
+        std::vector<double> covariance(n * n, 0.0);
+        for(size_t i(0); i < n && !variance_.empty(); ++i)
+            covariance[i * n + i] = variance_[i];
+        for(const auto & [name, block] : blocks_)
+        {
+            if(!block.enabled)
+                continue;
+            for(size_t k(0); k < n * n; ++k)
+                covariance[k] += block.covariance[k];
+        }
+        cholesky_.factorize(covariance, n);
+        ++factorizations_;
+        dirty_.store(false, std::memory_order_release);
+    }
+
+    // Evaluate the likelihood at a point.
+    double Likelihood::evaluate(const double * theta, double * gradient) const
+    {
+        std::vector<double> work;
+        return evaluate(theta, data_.data(), gradient, work);
+    }
+
+    // Evaluate the likelihood of other data at a point.
+    double Likelihood::evaluate(const double * theta, const double * data, double * gradient, std::vector<double> & work) const
+    {
+        refactorize();
+        const size_t n(data_.size()), p(model_->parameters());
+        work.resize(2 * n + (gradient ? p * n : 0));
+        double * mu(work.data());
+        double * r(mu + n);
+        double * jacobian(gradient ? r + n : nullptr);
+        model_->predict(theta, mu, jacobian);
+
+        double value(0);
+        if(statistic_ == Statistic::Chi2)
+        {
+            // chi2 = |L^-1 (d - mu)|^2, and its gradient is
+            // -2 (C^-1 (d - mu))^T dmu/dtheta.
+            for(size_t i(0); i < n; ++i)
+                r[i] = data[i] - mu[i];
+            cholesky_.solve_lower(r);
+            for(size_t i(0); i < n; ++i)
+                value += r[i] * r[i];
+            if(gradient)
+            {
+                cholesky_.solve_upper(r);
+                for(size_t i(0); i < n; ++i)
+                    r[i] *= -2;
+            }
+        }
+        else
+        {
+            // -2 ln(L(mu) / L(d)) and its derivative 2 (1 - d / mu) per bin.
+            for(size_t i(0); i < n; ++i)
+            {
+                if(mu[i] <= 0)
+                {
+                    if(mu[i] < 0 || data[i] > 0)
+                    {
+                        if(gradient)
+                            std::fill(gradient, gradient + p, 0.0);
+                        return std::numeric_limits<double>::infinity();
+                    }
+                    r[i] = 2;
+                    continue;
+                }
+                value += 2 * (mu[i] - data[i] + (data[i] > 0 ? data[i] * std::log(data[i] / mu[i]) : 0.0));
+                r[i] = 2 * (1 - data[i] / mu[i]);
+            }
+        }
+
+        if(gradient)
+        {
+            for(size_t j(0); j < p; ++j)
+            {
+                const double * dj(jacobian + j * n);
+                double g(0);
+                for(size_t i(0); i < n; ++i)
+                    g += r[i] * dj[i];
+                gradient[j] = g;
+            }
+        }
+
+        // The Gaussian priors on the parameters.
+        for(size_t j(0); j < p; ++j)
+        {
+            if(prior_weight_[j] == 0)
+                continue;
+            const double d(theta[j] - prior_center_[j]);
+            value += prior_weight_[j] * d * d;
+            if(gradient)
+                gradient[j] += 2 * prior_weight_[j] * d;
+        }
+        return value;
+    }
+
+    // Evaluate the likelihood at many points in parallel.
+    std::vector<Result> Likelihood::evaluate(const std::vector<std::vector<double>> & points, size_t nthreads, bool gradient) const
+    {
+        const size_t p(model_->parameters());
+        for(const std::vector<double> & point : points)
+            if(point.size() != p)
+                throw std::runtime_error("Point with " + std::to_string(point.size()) + " parameters (expected "
+                                         + std::to_string(p) + ").");
+        refactorize();
+
+        std::vector<Result> results(points.size());
+        std::atomic<size_t> next(0);
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        auto worker = [&]()
+        {
+            std::vector<double> work;
+            size_t i;
+            while((i = next.fetch_add(1)) < points.size())
+            {
+                try
+                {
+                    Result & result(results[i]);
+                    if(gradient)
+                        result.gradient.resize(p);
+                    result.value = evaluate(points[i].data(), data_.data(), gradient ? result.gradient.data() : nullptr, work);
+                }
+                catch(...)
+                {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    next.store(points.size());
+                    if(!error)
+                        error = std::current_exception();
+                }
+            }
+        };
+
+        if(nthreads == 0)
+            nthreads = std::max(1u, std::thread::hardware_concurrency());
+        nthreads = std::min(nthreads, points.size());
+        std::vector<std::thread> threads;
+        for(size_t t(1); t < nthreads; ++t)
+            threads.emplace_back(worker);
+        worker();
+        for(std::thread & t : threads)
+            t.join();
+        if(error)
+            std::rethrow_exception(error);
+        return results;
+    }
+}
@@ -0,0 +1,187 @@
+/**
+ * @file loader.cc
+ * @brief Implementation of the loading of binned likelihoods from ROOT files.
+ * @details This file contains the reading of the histograms and matrices of
+ * the inputs of a fit and the construction of the likelihood declared in
+ * loader.h.
+ * @author mueller@fnal.gov
+ */
+#include <cmath>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <stdexcept>
+
+#include "TFile.h"
+#include "TH1.h"
+#include "TH2.h"
+#include "TMatrixD.h"
+#include "TMatrixDSym.h"
+
+#include "loader.h"
+
+namespace
+{
+    /**
+     * @brief Read the universes of a systematic as the low-rank factor of its
+     * covariance.
+     * @param file The input file.
+     * @param name The name of the TH2 of the universes (x: bin, y: universe).
+     * @param nominal The nominal prediction.
+     * @return The columns (u_k - nominal) / sqrt(N) of the factor.
+     * @throw std::runtime_error if there is no such histogram or its number
+     * of bins does not match.
+     */
+    std::vector<std::vector<double>> read_universes(TFile * file, const std::string & name, const std::vector<double> & nominal)
+    {
+        TH2 * h(dynamic_cast<TH2 *>(file->Get(name.c_str())));
+        if(!h)
+            throw std::runtime_error("No universe histogram " + name + " in " + file->GetName() + ".");
+        if(static_cast<size_t>(h->GetNbinsX()) != nominal.size())
+            throw std::runtime_error("Universe histogram " + name + " has " + std::to_string(h->GetNbinsX())
+                                     + " bins (expected " + std::to_string(nominal.size()) + ").");
+        const size_t universes(h->GetNbinsY());
+        std::vector<std::vector<double>> columns(universes, std::vector<double>(nominal.size()));
+        for(size_t k(0); k < universes; ++k)
+            for(size_t i(0); i < nominal.size(); ++i)
+                columns[k][i] = (h->GetBinContent(i + 1, k + 1) - nominal[i]) / std::sqrt(universes);
+        return columns;
+    }
+}
+
+namespace likelihood
+{
+    // Read the contents of a histogram.
+    std::vector<double> read_histogram(TFile * file, const std::string & name)
+    {
+        TH1 * h(dynamic_cast<TH1 *>(file->Get(name.c_str())));
+        if(!h || h->GetDimension() != 1)
+            throw std::runtime_error("No histogram " + name + " in " + file->GetName() + ".");
+        std::vector<double> result(h->GetNbinsX());
+        for(size_t i(0); i < result.size(); ++i)
+            result[i] = h->GetBinContent(i + 1);
+        return result;
+    }
+
+    // Read a covariance matrix.
+    std::vector<double> read_matrix(TFile * file, const std::string & name, size_t n)
+    {
+        TObject * object(file->Get(name.c_str()));
+        std::vector<double> result(n * n);
+        auto check = [&](size_t rows, size_t cols)
+        {
+            if(rows != n || cols != n)
+                throw std::runtime_error("Matrix " + name + " is " + std::to_string(rows) + "x" + std::to_string(cols)
+                                         + " (expected " + std::to_string(n) + "x" + std::to_string(n) + ").");
+        };
+        if(TMatrixDSym * m = dynamic_cast<TMatrixDSym *>(object))
+        {
+            check(m->GetNrows(), m->GetNcols());
+            for(size_t i(0); i < n; ++i)
+                for(size_t j(0); j < n; ++j)
+                    result[i * n + j] = (*m)(m->GetRowLwb() + i, m->GetColLwb() + j);
+        }
+        else if(TMatrixD * m = dynamic_cast<TMatrixD *>(object))
+        {
+            check(m->GetNrows(), m->GetNcols());
+            for(size_t i(0); i < n; ++i)
+                for(size_t j(0); j < n; ++j)
+                    result[i * n + j] = (*m)(m->GetRowLwb() + i, m->GetColLwb() + j);
+        }
+        else if(TH2 * h = dynamic_cast<TH2 *>(object))
+        {
+            check(h->GetNbinsX(), h->GetNbinsY());
+            for(size_t i(0); i < n; ++i)
+                for(size_t j(0); j < n; ++j)
+                    result[i * n + j] = h->GetBinContent(i + 1, j + 1);
+        }
+        else
+            throw std::runtime_error("No covariance matrix " + name + " in " + file->GetName() + ".");
+        return result;
+    }
+
+    // Load a binned likelihood from a ROOT file.
+    std::unique_ptr<Likelihood> load(const cfg::ConfigurationTable & config)
+    {
+        const std::string path(config.get_string_field("likelihood.path"));
+        TFile * file(TFile::Open(path.c_str(), "READ"));
+        if(!file || file->IsZombie())
+            throw std::runtime_error("Unable to open likelihood inputs " + path + ".");
+
+        // The nominal prediction and the parameters of the model.
+        const std::vector<double> nominal(read_histogram(file, config.get_string_field("likelihood.nominal")));
+        std::shared_ptr<TemplateModel> model(std::make_shared<TemplateModel>(nominal));
+        std::vector<cfg::ConfigurationTable> parameters;
+        if(config.has_field("parameter"))
+            parameters = config.get_subtables("parameter");
+        for(const cfg::ConfigurationTable & parameter : parameters)
+        {
+            const std::string name(parameter.get_string_field("name"));
+            const std::string type(parameter.get_string_field("type", "scale"));
+            if(type == "scale")
+            {
+                model->add_scale(name, parameter.has_field("template") ? read_histogram(file, parameter.get_string_field("template"))
+                                                                       : std::vector<double>(nominal.size(), 1.0));
+            }
+            else if(type == "shift")
+                model->add_shift(name, read_histogram(file, parameter.get_string_field("template")));
+            else
+                throw cfg::ConfigurationError("Unknown type '" + type + "' of parameter " + name + " (expected scale or shift).");
+        }
+
+        // The data (an Asimov data set by default) and the statistic.
+        const std::string data_name(config.get_string_field("likelihood.data", ""));
+        const std::vector<double> data(data_name.empty() ? nominal : read_histogram(file, data_name));
+        const std::string statistic(config.get_string_field("likelihood.statistic", "chi2"));
+        if(statistic != "chi2" && statistic != "poisson")
+            throw cfg::ConfigurationError("Unknown statistic '" + statistic + "' (expected chi2 or poisson).");
+        std::unique_ptr<Likelihood> result(std::make_unique<Likelihood>(model, data, statistic == "chi2" ? Statistic::Chi2 : Statistic::Poisson));
+        result->set_update_fraction(config.get_double_field("likelihood.update_fraction", 0.15));
+
+        for(size_t j(0); j < parameters.size(); ++j)
+            if(parameters[j].has_field("prior"))
+                result->set_prior(j, parameters[j].get_double_field("center", 0.0), parameters[j].get_double_field("prior"));
+
+        // The statistical term of the covariance. The combined Neyman-Pearson
+        // variance (Ji et al., 2020) is used by default; it falls back to
+        // half the prediction in empty bins.
+        const std::string stat(config.get_string_field("likelihood.stat_variance", "cnp"));
+        if(stat != "none")
+        {
+            std::vector<double> variance(nominal.size());
+            for(size_t i(0); i < variance.size(); ++i)
+            {
+                if(stat == "data")
+                    variance[i] = data[i];
+                else if(stat == "prediction")
+                    variance[i] = nominal[i];
+                else if(stat == "cnp")
+                    variance[i] = data[i] > 0 && nominal[i] > 0 ? 3.0 / (1.0 / data[i] + 2.0 / nominal[i]) : nominal[i] / 2;
+                else
+                    throw cfg::ConfigurationError("Unknown statistical variance '" + stat + "' (expected cnp, data, prediction, or none).");
+            }
+            result->set_statistical(variance);
+        }
+
+        // The systematic blocks of the covariance.
+        std::vector<cfg::ConfigurationTable> blocks;
+        if(config.has_field("block"))
+            blocks = config.get_subtables("block");
+        for(const cfg::ConfigurationTable & block : blocks)
+        {
+            const std::string name(block.get_string_field("name"));
+            const bool enabled(block.get_bool_field("enabled", true));
+            if(block.has_field("universes"))
+                result->add_block_factor(name, read_universes(file, block.get_string_field("universes"), nominal), enabled);
+            else
+                result->add_block(name, read_matrix(file, block.get_string_field("covariance"), nominal.size()), enabled,
+                                  block.get_double_field("tolerance", 1e-10));
+        }
+
+        file->Close();
+        delete file;
+        std::cout << "Loaded likelihood from " << path << ": " << nominal.size() << " bins, " << model->parameters()
+                  << " parameters, " << blocks.size() << " covariance blocks." << std::endl;
+        return result;
+    }
+}
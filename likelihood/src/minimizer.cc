@@ -0,0 +1,123 @@
+/**
+ * @file minimizer.cc
+ * @brief Implementation of the local minimizer of the likelihood engine.
+ * @details This file contains the projected quasi-Newton minimization
+ * declared in minimizer.h.
+ * @author mueller@fnal.gov
+ */
+#include <cmath>
+#include <algorithm>
+
+#include "minimizer.h"
+
+namespace likelihood
+{
+    // Minimize a function within bounds.
+    Minimum minimize(const Objective & objective, std::vector<double> start, const std::vector<double> & lower,
+                     const std::vector<double> & upper, double tolerance, size_t iterations)
+    {
+        const size_t p(start.size());
+        Minimum result{std::move(start), 0, 0, false};
+        std::vector<double> & x(result.x);
+        for(size_t j(0); j < p; ++j)
+            x[j] = std::clamp(x[j], lower[j], upper[j]);
+
+        std::vector<double> g(p), trial(p), g_trial(p), d(p), s(p), y(p), hy(p);
+        std::vector<double> h(p * p, 0.0);
+        auto reset = [&]() { std::fill(h.begin(), h.end(), 0.0); for(size_t j(0); j < p; ++j) h[j * p + j] = 1; };
+        reset();
+        double f(objective(x.data(), g.data()));
+        ++result.evaluations;
+
+        for(size_t iteration(0); iteration < iterations; ++iteration)
+        {
+            // The free parameters and the projected gradient.
+            std::vector<bool> free(p);
+            double projected(0);
+            for(size_t j(0); j < p; ++j)
+            {
+                free[j] = !((x[j] <= lower[j] && g[j] > 0) || (x[j] >= upper[j] && g[j] < 0));
+                if(free[j])
+                    projected = std::max(projected, std::abs(g[j]));
+            }
+            if(projected < tolerance)
+            {
+                result.converged = true;
+                break;
+            }
+
+            // The quasi-Newton direction in the free parameters, or the
+            // steepest descent if it is not a descent direction.
+            double slope(0);
+            for(size_t j(0); j < p; ++j)
+            {
+                d[j] = 0;
+                if(!free[j])
+                    continue;
+                for(size_t k(0); k < p; ++k)
+                    if(free[k])
+                        d[j] -= h[j * p + k] * g[k];
+                slope += d[j] * g[j];
+            }
+            if(slope >= 0)
+            {
+                reset();
+                for(size_t j(0); j < p; ++j)
+                    d[j] = free[j] ? -g[j] : 0;
+            }
+
+            // Backtracking along the projected path.
+            double step(iteration == 0 ? std::min(1.0, 1.0 / projected) : 1.0), f_trial(f);
+            bool accepted(false);
+            for(int k(0); k < 40 && !accepted; ++k, step /= 2)
+            {
+                double decrease(0);
+                for(size_t j(0); j < p; ++j)
+                {
+                    trial[j] = std::clamp(x[j] + step * d[j], lower[j], upper[j]);
+                    decrease += g[j] * (trial[j] - x[j]);
+                }
+                f_trial = objective(trial.data(), g_trial.data());
+                ++result.evaluations;
+                accepted = std::isfinite(f_trial) && f_trial <= f + 1e-4 * decrease;
+            }
+            if(!accepted)
+                break;
+
+            // The BFGS update of the inverse Hessian.
+            double sy(0);
+            for(size_t j(0); j < p; ++j)
+            {
+                s[j] = trial[j] - x[j];
+                y[j] = g_trial[j] - g[j];
+                sy += s[j] * y[j];
+            }
+            if(sy > 1e-12)
+            {
+                double yhy(0);
+                for(size_t j(0); j < p; ++j)
+                {
+                    hy[j] = 0;
+                    for(size_t k(0); k < p; ++k)
+                        hy[j] += h[j * p + k] * y[k];
+                    yhy += y[j] * hy[j];
+                }
+                for(size_t j(0); j < p; ++j)
+                    for(size_t k(0); k < p; ++k)
+                        h[j * p + k] += ((sy + yhy) * s[j] * s[k]) / (sy * sy) - (hy[j] * s[k] + s[j] * hy[k]) / sy;
+            }
+
+            const bool small(std::abs(f - f_trial) <= tolerance * (1 + std::abs(f)));
+            x.swap(trial);
+            g.swap(g_trial);
+            f = f_trial;
+            if(small)
+            {
+                result.converged = true;
+                break;
+            }
+        }
+        result.value = f;
+        return result;
+    }
+}
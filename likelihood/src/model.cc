@@ -0,0 +1,80 @@
+/**
+ * @file model.cc
+ * @brief Implementation of the models of the binned prediction.
+ * @details This file contains the implementation of the template model
+ * declared in model.h.
+ * @author mueller@fnal.gov
+ */
+#include <stdexcept>
+
+#include "model.h"
+
+namespace likelihood
+{
+    // Constructor for the TemplateModel class.
+    TemplateModel::TemplateModel(std::vector<double> nominal)
+        : nominal_(std::move(nominal)) {}
+
+    // Add an additive ("shift") parameter.
+    void TemplateModel::add_shift(const std::string & name, std::vector<double> shift)
+    {
+        if(shift.size() != nominal_.size())
+            throw std::runtime_error("Shift template of parameter " + name + " has " + std::to_string(shift.size())
+                                     + " bins (expected " + std::to_string(nominal_.size()) + ").");
+        names_.push_back(name);
+        scale_.push_back(false);
+        templates_.push_back(std::move(shift));
+    }
+
+    // Add a multiplicative ("scale") parameter.
+    void TemplateModel::add_scale(const std::string & name, std::vector<double> response)
+    {
+        if(response.size() != nominal_.size())
+            throw std::runtime_error("Scale template of parameter " + name + " has " + std::to_string(response.size())
+                                     + " bins (expected " + std::to_string(nominal_.size()) + ").");
+        names_.push_back(name);
+        scale_.push_back(true);
+        templates_.push_back(std::move(response));
+    }
+
+    // Evaluate the prediction at a point in parameter space.
+    void TemplateModel::predict(const double * theta, double * mu, double * jacobian) const
+    {
+        const size_t n(nominal_.size()), p(names_.size());
+        thread_local std::vector<double> suffix;
+        suffix.resize(p + 1);
+        for(size_t i(0); i < n; ++i)
+        {
+            // The additive part and the product of the scale factors.
+            double base(nominal_[i]), factor(1);
+            for(size_t j(0); j < p; ++j)
+            {
+                if(scale_[j])
+                    factor *= 1 + theta[j] * templates_[j][i];
+                else
+                    base += theta[j] * templates_[j][i];
+            }
+            mu[i] = base * factor;
+            if(!jacobian)
+                continue;
+
+            // The derivative with respect to a scale parameter is the product
+            // of the other factors, computed from prefix and suffix products
+            // so that a vanishing factor is handled exactly.
+            suffix[p] = 1;
+            for(size_t j(p); j-- > 0;)
+                suffix[j] = scale_[j] ? suffix[j + 1] * (1 + theta[j] * templates_[j][i]) : suffix[j + 1];
+            double prefix(1);
+            for(size_t j(0); j < p; ++j)
+            {
+                if(!scale_[j])
+                {
+                    jacobian[j * n + i] = templates_[j][i] * factor;
+                    continue;
+                }
+                jacobian[j * n + i] = base * templates_[j][i] * prefix * suffix[j + 1];
+                prefix *= 1 + theta[j] * templates_[j][i];
+            }
+        }
+    }
+}
@@ -0,0 +1,58 @@
+/**
+ * @file oscillation.cc
+ * @brief Implementation of the two-flavor disappearance model.
+ * @details This file contains the implementation of the disappearance model
+ * declared in oscillation.h.
+ * @author mueller@fnal.gov
+ */
+#include <cmath>
+#include <stdexcept>
+
+#include "oscillation.h"
+
+namespace likelihood
+{
+    // Constructor for the DisappearanceModel class.
+    DisappearanceModel::DisappearanceModel(std::vector<double> response, std::vector<double> l_over_e)
+        : bins_(l_over_e.empty() ? 0 : response.size() / l_over_e.size()), response_(std::move(response)),
+          l_over_e_(std::move(l_over_e)), names_{"sin2_2theta", "log10_dm2"}
+    {
+        if(l_over_e_.empty() || response_.size() != bins_ * l_over_e_.size())
+            throw std::runtime_error("Response matrix has " + std::to_string(response_.size()) + " elements, which is not a multiple of "
+                                     + std::to_string(l_over_e_.size()) + " true bins.");
+    }
+
+    // Evaluate the prediction at a point in parameter space.
+    void DisappearanceModel::predict(const double * theta, double * mu, double * jacobian) const
+    {
+        const size_t m(l_over_e_.size());
+        const double s(theta[0]), dm2(std::pow(10.0, theta[1]));
+        thread_local std::vector<double> probability, derivative;
+        probability.resize(m);
+        derivative.resize(m);
+        for(size_t k(0); k < m; ++k)
+        {
+            // d sin^2(phi) / d log10(dm^2) = sin(2 phi) phi ln(10).
+            const double phi(1.267 * dm2 * l_over_e_[k]), sine(std::sin(phi));
+            probability[k] = sine * sine;
+            derivative[k] = std::sin(2 * phi) * phi * M_LN10;
+        }
+        for(size_t i(0); i < bins_; ++i)
+        {
+            const double * r(&response_[i * m]);
+            double total(0), oscillated(0), slope(0);
+            for(size_t k(0); k < m; ++k)
+            {
+                total += r[k];
+                oscillated += r[k] * probability[k];
+                slope += r[k] * derivative[k];
+            }
+            mu[i] = total - s * oscillated;
+            if(jacobian)
+            {
+                jacobian[i] = -oscillated;
+                jacobian[bins_ + i] = -s * slope;
+            }
+        }
+    }
+}
@@ -0,0 +1,231 @@
+/**
+ * @file toys.cc
+ * @brief Implementation of the Feldman-Cousins pseudo-experiments.
+ * @details This file contains the generation and fitting of the
+ * pseudo-experiments and the checkpoint format declared in toys.h.
+ * @author mueller@fnal.gov
+ */
+#include <cmath>
+#include <chrono>
+#include <limits>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <cstdlib>
+#include <algorithm>
+#include <sstream>
+#include <fstream>
+#include <exception>
+#include <stdexcept>
+
+#include "toys.h"
+#include "philox.h"
+
+namespace likelihood
+{
+    // Constructor for the FeldmanCousins class.
+    FeldmanCousins::FeldmanCousins(std::shared_ptr<const Model> model, std::vector<double> fractional, Statistic statistic, Grid grid, uint64_t seed)
+        : model_(std::move(model)), fractional_(std::move(fractional)), statistic_(statistic), grid_(grid), seed_(seed)
+    {
+        const size_t n(model_->bins());
+        if(model_->parameters() != 2)
+            throw std::runtime_error("The Feldman-Cousins grid needs a model with two parameters (got "
+                                     + std::to_string(model_->parameters()) + ").");
+        if(!fractional_.empty() && fractional_.size() != n * n)
+            throw std::runtime_error("Fractional covariance has " + std::to_string(fractional_.size()) + " elements (expected "
+                                     + std::to_string(n * n) + ").");
+        if(grid_.size() == 0)
+            throw std::runtime_error("The Feldman-Cousins grid is empty.");
+    }
+
+    // Set the observed data.
+    void FeldmanCousins::set_data(std::vector<double> data)
+    {
+        if(data.size() != model_->bins())
+            throw std::runtime_error("Data has " + std::to_string(data.size()) + " bins (expected "
+                                     + std::to_string(model_->bins()) + ").");
+        data_ = std::move(data);
+    }
+
+    // Get the systematic covariance at a true point.
+    std::vector<double> FeldmanCousins::systematic(const std::vector<double> & mu) const
+    {
+        const size_t n(mu.size());
+        std::vector<double> covariance(n * n);
+        for(size_t i(0); i < n; ++i)
+            for(size_t j(0); j < n; ++j)
+                covariance[i * n + j] = fractional_[i * n + j] * mu[i] * mu[j];
+        return covariance;
+    }
+
+    // Build the likelihood with the covariance of a true point.
+    std::unique_ptr<Likelihood> FeldmanCousins::at(const std::vector<double> & mu) const
+    {
+        const size_t n(mu.size());
+        std::unique_ptr<Likelihood> lh(std::make_unique<Likelihood>(model_, mu, statistic_));
+        std::vector<double> variance(n);
+        for(size_t i(0); i < n; ++i)
+            variance[i] = std::max(mu[i], 1e-6);
+        lh->set_statistical(std::move(variance));
+        if(!fractional_.empty())
+        {
+            lh->add_block("systematics", systematic(mu), true);
+        }
+        return lh;
+    }
+
+    // Fit data with a likelihood.
+    Minimum FeldmanCousins::fit(const Likelihood & lh, const double * data, const std::vector<double> & truth, std::vector<double> & work) const
+    {
+        // The coarse scan, which includes the true point.
+        std::vector<double> best(truth);
+        double best_value(lh.evaluate(truth.data(), data, nullptr, work));
+        for(size_t j(0); j < grid_.ny; j += stride_)
+        {
+            for(size_t i(0); i < grid_.nx; i += stride_)
+            {
+                const std::vector<double> point(grid_.point(j * grid_.nx + i));
+                const double value(lh.evaluate(point.data(), data, nullptr, work));
+                if(value < best_value)
+                {
+                    best_value = value;
+                    best = point;
+                }
+            }
+        }
+
+        // The local minimization from the best point of the scan.
+        auto objective = [&](const double * x, double * gradient) { return lh.evaluate(x, data, gradient, work); };
+        Minimum minimum(minimize(objective, best, {grid_.x_low, grid_.y_low}, {grid_.x_high, grid_.y_high}));
+        if(!(minimum.value <= best_value))
+        {
+            minimum.x = best;
+            minimum.value = best_value;
+        }
+        return minimum;
+    }
+
+    // Generate and fit the pseudo-experiments of a grid point.
+    PointResult FeldmanCousins::run(size_t g, size_t toys, size_t nthreads) const
+    {
+        const auto start(std::chrono::steady_clock::now());
+        const size_t n(model_->bins());
+        const std::vector<double> truth(grid_.point(g));
+        std::vector<double> mu(n);
+        model_->predict(truth.data(), mu.data(), nullptr);
+        const std::unique_ptr<Likelihood> lh(at(mu));
+
+        // The low-rank factor of the systematic covariance at the true point
+        // correlates the fluctuations of the pseudo-experiments.
+        std::vector<std::vector<double>> columns;
+        if(!fractional_.empty())
+        {
+            columns = Cholesky::low_rank(systematic(mu), n, 1e-10);
+        }
+
+        PointResult result{g, std::vector<double>(toys), std::numeric_limits<double>::quiet_NaN(), 0};
+        if(!data_.empty())
+        {
+            std::vector<double> work;
+            result.data_delta_chi2 = lh->evaluate(truth.data(), data_.data(), nullptr, work) - fit(*lh, data_.data(), truth, work).value;
+        }
+
+        std::atomic<size_t> next(0);
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        auto worker = [&]()
+        {
+            std::vector<double> work, mean(n), data(n);
+            size_t t;
+            while((t = next.fetch_add(1)) < toys)
+            {
+                try
+                {
+                    Philox random(seed_, g, t);
+                    mean = mu;
+                    for(const std::vector<double> & c : columns)
+                    {
+                        const double z(random.normal());
+                        for(size_t i(0); i < n; ++i)
+                            mean[i] += z * c[i];
+                    }
+                    for(size_t i(0); i < n; ++i)
+                        data[i] = random.poisson(std::max(mean[i], 0.0));
+                    const double at_truth(lh->evaluate(truth.data(), data.data(), nullptr, work));
+                    result.delta_chi2[t] = std::max(0.0, at_truth - fit(*lh, data.data(), truth, work).value);
+                }
+                catch(...)
+                {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    next.store(toys);
+                    if(!error)
+                        error = std::current_exception();
+                }
+            }
+        };
+
+        if(nthreads == 0)
+            nthreads = std::max(1u, std::thread::hardware_concurrency());
+        nthreads = std::max<size_t>(1, std::min(nthreads, toys));
+        std::vector<std::thread> threads;
+        for(size_t t(1); t < nthreads; ++t)
+            threads.emplace_back(worker);
+        worker();
+        for(std::thread & t : threads)
+            t.join();
+        if(error)
+            std::rethrow_exception(error);
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+
+    // Write the results of a grid point to a checkpoint.
+    void write_checkpoint(std::ostream & output, const PointResult & result)
+    {
+        std::ostringstream line;
+        line.precision(8);
+        line << result.index << ' ' << result.data_delta_chi2 << ' ' << result.seconds << ' ' << result.delta_chi2.size();
+        for(double x : result.delta_chi2)
+            line << ' ' << x;
+        output << line.str() << '\n' << std::flush;
+    }
+
+    // Read the results of the grid points from a checkpoint.
+    std::map<size_t, PointResult> read_checkpoint(const std::string & path)
+    {
+        std::map<size_t, PointResult> results;
+        std::ifstream input(path);
+        std::string line;
+        while(std::getline(input, line))
+        {
+            // A line without its newline or with missing values was cut by
+            // an interruption.
+            if(input.eof())
+                break;
+            std::istringstream fields(line);
+            PointResult result;
+            std::string data;
+            size_t toys;
+            if(!(fields >> result.index >> data >> result.seconds >> toys))
+                continue;
+            result.data_delta_chi2 = std::strtod(data.c_str(), nullptr);
+            result.delta_chi2.resize(toys);
+            size_t t(0);
+            while(t < toys && fields >> result.delta_chi2[t])
+                ++t;
+            if(t == toys)
+                results[result.index] = std::move(result);
+        }
+        return results;
+    }
+
+    // Get the critical value of a dchi2 distribution.
+    double critical_value(std::vector<double> delta_chi2, double level)
+    {
+        if(delta_chi2.empty())
+            return std::numeric_limits<double>::quiet_NaN();
+        const size_t k(std::min(delta_chi2.size() - 1, static_cast<size_t>(std::max(0.0, std::ceil(level * delta_chi2.size()) - 1))));
+        std::nth_element(delta_chi2.begin(), delta_chi2.begin() + k, delta_chi2.end());
+        return delta_chi2[k];
+    }
+}
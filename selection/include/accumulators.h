@@ -0,0 +1,217 @@
+/**
+ * @file accumulators.h
+ * @brief Header file declaring the in-pass sufficient-statistics
+ * accumulators of the SPINE analysis framework.
+ * @details Energy-scale and resolution studies fit linear relations and
+ * widths of a reconstructed quantity against its true counterpart in bins of
+ * some variable. Everything these fits need is contained in a few sufficient
+ * statistics per bin, so an accumulator collects them from the rows of an
+ * output tree during the pass instead of writing the full tree. For each bin
+ * of the binning variable, the accumulator keeps the number of rows, the sum
+ * of the weights and of their squares, the weighted means of the reco and
+ * true values, and their centered second moments and co-moment. The moments
+ * are updated with the weighted form of Welford's algorithm, so they do not
+ * suffer from the cancellation of raw sums of squares, and accumulators of
+ * separate jobs merge exactly (see @ref Bin::merge). Optionally, each bin
+ * also keeps a histogram sketch of the residual (reco - true, absolute or
+ * relative to true), from which the median and other robust quantiles are
+ * obtained to the precision of its bins.
+ *
+ * Accumulators are attached to a tree in the configuration, naming branches
+ * of the tree:
+ * @code
+ * [[tree]]
+ * name = 'numu_resolution'
+ * write = false                  # only the accumulators are written
+ * ...
+ * [[tree.accumulator]]
+ * name = 'energy'
+ * reco = 'reco_visible_energy'
+ * true = 'true_visible_energy'
+ * bin = 'true_visible_energy'    # binning branch
+ * edges = [0.0, 200.0, 400.0, 600.0, 800.0, 1000.0, 1500.0, 2000.0]
+ * weight = 'true_cv_weight'      # optional weight branch
+ * sketch = [200, -1.0, 1.0]      # optional: bins, low, high of the residual
+ * residual = 'relative'          # "relative" (default) or "difference"
+ * @endcode
+ * The statistics are written to the sample directory as the tree
+ * "<tree>_<name>" with one entry per bin, and the sketch as the TH2D
+ * "<tree>_<name>_sketch" (x: bin, y: residual).
+ * @author mueller@fnal.gov
+ */
+#ifndef ACCUMULATORS_H
+#define ACCUMULATORS_H
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+
+#include "sbnana/CAFAna/Core/MultiVar.h"
+#include "configuration.h"
+
+#include "TDirectory.h"
+
+/**
+ * @namespace accumulators
+ * @brief Namespace for the in-pass sufficient-statistics accumulators.
+ */
+namespace accumulators
+{
+    /**
+     * @struct Config
+     * @brief The configuration of an accumulator.
+     */
+    struct Config
+    {
+        std::string name;           ///< The name of the accumulator.
+        std::string reco;           ///< The branch of the reco value.
+        std::string truth;          ///< The branch of the true value.
+        std::string bin;            ///< The branch of the binning variable.
+        std::string weight;         ///< The branch of the weight (empty for unit weights).
+        std::vector<double> edges;  ///< The bin edges (increasing).
+        size_t sketch_bins = 0;     ///< The number of bins of the residual sketch (zero for none).
+        double sketch_low = 0;      ///< The lower edge of the residual sketch.
+        double sketch_high = 0;     ///< The upper edge of the residual sketch.
+        bool relative = true;       ///< Whether the residual is relative to the true value.
+    };
+
+    /**
+     * @brief Read the configuration of an accumulator.
+     * @param table The [[tree.accumulator]] table.
+     * @return The configuration.
+     * @throw cfg::ConfigurationError if the configuration is not valid.
+     */
+    Config configure(const cfg::ConfigurationTable & table);
+
+    /**
+     * @struct Bin
+     * @brief The sufficient statistics of the (reco, true) pairs of a bin.
+     */
+    struct Bin
+    {
+        uint64_t count = 0;         ///< The number of rows.
+        double sum_w = 0;           ///< The sum of the weights.
+        double sum_w2 = 0;          ///< The sum of the squared weights.
+        double mean_reco = 0;       ///< The weighted mean of the reco value.
+        double mean_true = 0;       ///< The weighted mean of the true value.
+        double m2_reco = 0;         ///< The weighted sum of squared deviations of the reco value.
+        double m2_true = 0;         ///< The weighted sum of squared deviations of the true value.
+        double c_reco_true = 0;     ///< The weighted sum of the products of the deviations.
+        std::vector<double> sketch; ///< The residual sketch (underflow, bins, overflow).
+
+        /**
+         * @brief Add a (reco, true) pair.
+         * @param reco The reco value.
+         * @param truth The true value.
+         * @param w The weight.
+         * @return void
+         */
+        void add(double reco, double truth, double w);
+
+        /**
+         * @brief Merge the statistics of another bin.
+         * @param other The other bin (with the same sketch binning).
+         * @return void
+         */
+        void merge(const Bin & other);
+
+        /**
+         * @brief Get the weighted mean of reco - true.
+         * @return The bias.
+         */
+        double bias() const { return mean_reco - mean_true; }
+
+        /**
+         * @brief Get the weighted standard deviation of reco - true.
+         * @return The resolution.
+         */
+        double resolution() const;
+
+        /**
+         * @brief Get the slope of the weighted least-squares regression of
+         * the reco value on the true value.
+         * @return The slope (NaN without spread in the true value).
+         */
+        double slope() const;
+
+        /**
+         * @brief Get the intercept of the weighted least-squares regression
+         * of the reco value on the true value.
+         * @return The intercept.
+         */
+        double intercept() const { return mean_reco - slope() * mean_true; }
+    };
+
+    /**
+     * @brief Get a quantile of a residual sketch.
+     * @details The quantile is interpolated linearly within the bin that
+     * contains it. Quantiles falling in the underflow (overflow) return the
+     * lower (upper) edge of the sketch.
+     * @param config The configuration of the accumulator.
+     * @param bin The bin.
+     * @param q The quantile (between zero and one).
+     * @return The quantile of the residual (NaN without a sketch or rows).
+     */
+    double quantile(const Config & config, const Bin & bin, double q);
+
+    /**
+     * @class Accumulator
+     * @brief The sufficient statistics of one tree of one sample.
+     */
+    class Accumulator
+    {
+        public:
+            /**
+             * @brief Constructor for the Accumulator class.
+             * @param tree The name of the tree.
+             * @param config The configuration.
+             */
+            Accumulator(std::string tree, Config config);
+
+            /**
+             * @brief Wrap the SpillMultiVars of the tree to accumulate their
+             * values.
+             * @details The tree evaluates each of its SpillMultiVars once per
+             * spill, in order (see @ref ana::ExportVars). The wrappers of the
+             * configured branches keep their values, and the wrapper of the
+             * last branch adds the rows of the spill. The values are returned
+             * unchanged. Rows with a NaN value, a zero weight, or a binning
+             * value outside the edges are skipped.
+             * @param names The names of the branches of the tree.
+             * @param vars The SpillMultiVars of the tree.
+             * @return The wrapped SpillMultiVars.
+             * @throw std::runtime_error if a configured branch is not in the
+             * tree.
+             */
+            std::vector<ana::SpillMultiVar> wrap(const std::vector<std::string> & names, const std::vector<ana::SpillMultiVar> & vars);
+
+            /**
+             * @brief Write the statistics (and the sketch) to a directory.
+             * @param dir The directory.
+             * @return The name of the tree of the statistics.
+             */
+            std::string SaveTo(TDirectory * dir) const;
+
+            /**
+             * @brief Get the statistics of the bins.
+             * @return The bins.
+             */
+            const std::vector<Bin> & bins() const { return bins_; }
+
+        private:
+            /**
+             * @brief Add the rows of the values kept for a spill.
+             * @return void
+             */
+            void flush();
+
+            std::string tree_;
+            Config config_;
+            std::vector<Bin> bins_;
+            std::vector<double> reco_;
+            std::vector<double> truth_;
+            std::vector<double> bin_;
+            std::vector<double> weight_;
+    };
+}
+#endif // ACCUMULATORS_H
@@ -17,14 +17,44 @@
 #define ANALYSIS_H
 #include <vector>
 #include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <iostream>
+#include <algorithm>
+#include <exception>
+#include <set>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <cmath>
+#include <fstream>
+#include <glob.h>
+#include <sys/stat.h>
 
 #include "sbnana/CAFAna/Core/SpectrumLoader.h"
 #include "sbnana/CAFAna/Core/Tree.h"
 #include "sbnana/CAFAna/Core/Cut.h"
 #include "sbnana/CAFAna/Core/Spectrum.h"
+#include "sbnanaobj/StandardRecord/Proxy/SRProxy.h"
 
 #include "TDirectory.h"
 #include "TFile.h"
+#include "TROOT.h"
+#include "TTree.h"
+#include "TLeaf.h"
+#include "TKey.h"
+#include "TH1.h"
+
+#include "manifest.h"
+#include "placement.h"
+#include "memo.h"
+#include "trace.h"
+#include "columnar.h"
+#include "monitor.h"
+#include "reader.h"
+#include "accumulators.h"
 
 /**
  * @namespace ana
@@ -43,13 +73,20 @@ namespace ana
      * analysis, including the name of the sample, the SpectrumLoader object
      * representing the sample, and a boolean indicating whether the sample is
      * a simulation sample. The simulation flag is used to determine if truth
-     * information is available for the sample.
+     * information is available for the sample. In follow mode, the sample is
+     * instead described by the path (wildcard) of its input files, and a
+     * SpectrumLoader is created for each batch of new files. A sample without
+     * a SpectrumLoader is run with the SpectrumLoader-free tree writer (see
+     * reader.h) over its input files, or over the files matching its path if
+     * there are none.
      */
     struct Sample
     {
         std::string name;
         ana::SpectrumLoader * loader;
         bool is_sim;
+        std::string path;
+        std::vector<std::string> files;
     };
 
     /**
@@ -72,6 +109,175 @@ namespace ana
         bool is_sim;
     };
 
+    /**
+     * @brief Wrap a SpillMultiVar with the branch evaluation tracepoints.
+     * @details If the tracepoints are compiled in (see trace.h), the returned
+     * SpillMultiVar fires the "branch_enter" and "branch_exit" probes around
+     * the evaluation of @p var, with the id of @p name and the number of
+     * values produced. Otherwise, @p var is returned unchanged.
+     * @param name The name of the branch ("<tree>/<branch>").
+     * @param var The SpillMultiVar to wrap.
+     * @return The (possibly) wrapped SpillMultiVar.
+     */
+    ana::SpillMultiVar TracedVar(const std::string & name, const ana::SpillMultiVar & var)
+    {
+        if constexpr(!trace::enabled)
+            return var;
+        uint32_t id(trace::name_id(name));
+        return ana::SpillMultiVar([var, id](const caf::Proxy<caf::StandardRecord> * sr) -> std::vector<double>
+        {
+            SPINE_PROBE1(branch_enter, id);
+            std::vector<double> values(var(sr));
+            SPINE_PROBE2(branch_exit, id, values.size());
+            return values;
+        });
+    }
+
+    /**
+     * @brief Wrap the SpillMultiVars of a Tree to also capture their values
+     * in a columnar table.
+     * @details The Tree evaluates each of its SpillMultiVars once per spill,
+     * in order, and each produces the same number of rows. The first wrapped
+     * SpillMultiVar also appends the index columns (run, subrun, event) of
+     * the rows. The values are returned unchanged, so the ROOT output is not
+     * affected.
+     * @param table The table to append the values to.
+     * @param vars The SpillMultiVars of the Tree.
+     * @return The wrapped SpillMultiVars.
+     */
+    std::vector<ana::SpillMultiVar> ExportVars(const std::shared_ptr<columnar::Table> & table, const std::vector<ana::SpillMultiVar> & vars)
+    {
+        std::vector<ana::SpillMultiVar> result;
+        for(size_t k(0); k < vars.size(); ++k)
+        {
+            ana::SpillMultiVar var(vars[k]);
+            result.push_back(ana::SpillMultiVar([var, table, k](const caf::Proxy<caf::StandardRecord> * sr) -> std::vector<double>
+            {
+                std::vector<double> values(var(sr));
+                if(k == 0)
+                    table->append_index((int32_t)sr->hdr.run, (int32_t)sr->hdr.subrun, (int32_t)sr->hdr.evt, values.size());
+                table->append(k, values);
+                return values;
+            }));
+        }
+        return result;
+    }
+
+    /**
+     * @struct Prescale
+     * @brief The prescale policy of a tree.
+     * @details Rows whose category (the value of the category branch) has a
+     * prescale factor N are kept with probability 1/N and given a weight of
+     * N; all other rows (e.g., signal, or a NaN category) are kept with a
+     * weight of one. The choice is a deterministic function of the seed, the
+     * run, subrun, and event numbers of the spill, and the index of the row
+     * in the spill, so the same rows are kept in every run of a
+     * configuration.
+     */
+    struct Prescale
+    {
+        std::string branch;
+        std::map<double, uint64_t> factors;
+        uint64_t seed;
+    };
+
+    /**
+     * @brief Mix the bits of a 64-bit integer (the splitmix64 finalizer).
+     * @param x The integer.
+     * @return The mixed integer.
+     */
+    inline uint64_t Mix(uint64_t x)
+    {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    /**
+     * @brief Apply a prescale policy to the SpillMultiVars of a Tree.
+     * @details The Tree evaluates each of its SpillMultiVars once per spill,
+     * in order. The first wrapped SpillMultiVar also evaluates the category
+     * branch and decides which rows of the spill are kept; every wrapped
+     * SpillMultiVar then returns the values of the kept rows only. The
+     * category branch itself is not evaluated a second time. The compensating
+     * weights of the kept rows are added as the "prescale_weight" branch.
+     * @param prescale The prescale policy.
+     * @param t The Tree.
+     * @return The Tree with the prescaled SpillMultiVars.
+     * @throw std::runtime_error if the category branch is not in the Tree.
+     */
+    TreeSet PrescaleVars(const Prescale & prescale, const TreeSet & t)
+    {
+        auto it(std::find(t.names.begin(), t.names.end(), prescale.branch));
+        if(it == t.names.end())
+            throw std::runtime_error("Prescale branch " + prescale.branch + " is not in tree " + t.name + ".");
+        const size_t c(it - t.names.begin());
+
+        struct State
+        {
+            std::vector<double> category;
+            std::vector<char> keep;
+            std::vector<double> weight;
+        };
+        std::shared_ptr<State> state(std::make_shared<State>());
+        auto filter = [state](const std::vector<double> & values, const std::string & name) -> std::vector<double>
+        {
+            if(values.size() != state->keep.size())
+                throw std::runtime_error("Branch " + name + " has " + std::to_string(values.size()) + " rows in a spill (expected "
+                                         + std::to_string(state->keep.size()) + ").");
+            std::vector<double> kept;
+            for(size_t r(0); r < values.size(); ++r)
+                if(state->keep[r])
+                    kept.push_back(values[r]);
+            return kept;
+        };
+
+        TreeSet result{t.name, t.names, {}, t.is_sim};
+        const ana::SpillMultiVar category(t.vars[c]);
+        for(size_t k(0); k < t.vars.size(); ++k)
+        {
+            const ana::SpillMultiVar var(t.vars[k]);
+            const std::string name(t.names[k]);
+            result.vars.push_back(ana::SpillMultiVar([state, filter, prescale, category, var, name, k, c](const caf::Proxy<caf::StandardRecord> * sr) -> std::vector<double>
+            {
+                std::vector<double> values;
+                if(k == 0)
+                {
+                    // Decide which rows of the spill are kept.
+                    values = var(sr);
+                    state->category = (c == 0) ? values : category(sr);
+                    const size_t n(state->category.size());
+                    state->keep.assign(n, 1);
+                    state->weight.assign(n, 1.0);
+                    const uint64_t spill(Mix(Mix(Mix(prescale.seed ^ Mix(static_cast<uint64_t>(sr->hdr.run))) ^ static_cast<uint64_t>(sr->hdr.subrun))
+                                             ^ static_cast<uint64_t>(sr->hdr.evt)));
+                    for(size_t r(0); r < n; ++r)
+                    {
+                        // A NaN category (no match) has no factor; note
+                        // that std::map::find(NaN) would match a key.
+                        if(std::isnan(state->category[r]))
+                            continue;
+                        auto factor(prescale.factors.find(state->category[r]));
+                        if(factor == prescale.factors.end() || factor->second <= 1)
+                            continue;
+                        state->keep[r] = (Mix(spill ^ r) % factor->second == 0);
+                        state->weight[r] = static_cast<double>(factor->second);
+                    }
+                }
+                else
+                    values = (k == c) ? state->category : var(sr);
+                return filter(values, name);
+            }));
+        }
+        result.names.push_back("prescale_weight");
+        result.vars.push_back(ana::SpillMultiVar([state, filter](const caf::Proxy<caf::StandardRecord> *) -> std::vector<double>
+        {
+            return filter(state->weight, "prescale_weight");
+        }));
+        return result;
+    }
+
     /**
      * @class Analysis
      * @brief Class designed to streamline the running of multiple samples
@@ -90,15 +296,43 @@ namespace ana
     {
         public:
             Analysis(std::string name);
-            void AddLoader(std::string name, ana::SpectrumLoader * loader, bool is_sim);
+            void AddLoader(std::string name, ana::SpectrumLoader * loader, bool is_sim, std::string path = "");
             void AddTree(std::string name, std::map<std::string, ana::SpillMultiVar> & vars, bool is_sim);
             void AddTreeForSample(std::string sname, std::string name, std::map<std::string, ana::SpillMultiVar> & vars, bool is_sim);
+            void AddSample(std::string name, std::string path, bool is_sim);
+            void SetOutputMode(std::string mode, size_t nthreads);
+            void SetClustering(std::string tree, std::string branch);
+            void SetPrescale(std::string tree, Prescale prescale);
+            void SetTreeOutput(std::string tree, bool write);
+            void AddAccumulator(std::string sname, std::string tree, accumulators::Config config);
+            void SetExport(std::string prefix);
+            void SetReader(std::string backend, long long cache_bytes);
+            std::shared_ptr<const columnar::Table> GetTable(std::string sample, std::string tree);
+            size_t GetSpills() const;
             void Go();
+            void Follow(size_t interval, size_t settle, size_t max_files, size_t iterations);
+            void Benchmark();
         private:
+            std::vector<std::string> RunSample(const Sample & s, TDirectory * subdir);
+            void GoSingle(const std::string & file_name);
+            cfg::Manifest::Entry WriteSample(const Sample & s, const std::string & file_name);
+            void GoPerSample();
             std::string name;
+            bool per_sample = false;
+            size_t sample_threads = 1;
             std::vector<Sample> samples;
             std::vector<TreeSet> trees;
             std::map<std::pair<std::string, std::string>, TreeSet> trees_map;
+            std::map<std::string, std::string> cluster_by;
+            std::set<std::string> unwritten;
+            std::map<std::string, Prescale> prescales;
+            std::map<std::pair<std::string, std::string>, std::vector<accumulators::Config>> accumulator_configs;
+            std::string export_prefix;
+            bool treewriter = false;
+            long long reader_cache = 100 * 1024 * 1024;
+            std::map<std::pair<std::string, std::string>, std::shared_ptr<columnar::Table>> tables;
+            std::mutex tables_mutex;
+            std::atomic<size_t> spills{0};
     };
 
     /**
@@ -126,11 +360,31 @@ namespace ana
      * @param is_sim A boolean indicating whether the SpectrumLoader represents
      * a simulation sample, which is principally used to determine if truth
      * information is available.
+     * @param path The path (wildcard) of the input files of the sample, which
+     * is only needed to run the sample with the tree writer for comparison
+     * (see @ref Benchmark).
+     * @return void
+     */
+    void Analysis::AddLoader(std::string name, ana::SpectrumLoader * loader, bool is_sim, std::string path)
+    {
+        samples.push_back({name, loader, is_sim, path});
+    }
+
+    /**
+     * @brief Add a sample to the Analysis class by the path of its files.
+     * @details This function registers a sample without a SpectrumLoader for
+     * use with the follow mode (see @ref Follow). The path is a wildcard
+     * matching the input files of the sample, which is polled for new files.
+     * @param name The name of the sample.
+     * @param path The wildcard matching the input files of the sample.
+     * @param is_sim A boolean indicating whether the sample is a simulation
+     * sample, which is principally used to determine if truth information is
+     * available.
      * @return void
      */
-    void Analysis::AddLoader(std::string name, ana::SpectrumLoader * loader, bool is_sim)
+    void Analysis::AddSample(std::string name, std::string path, bool is_sim)
     {
-        samples.push_back({name, loader, is_sim});
+        samples.push_back({name, nullptr, is_sim, path});
     }
 
     /**
@@ -152,10 +406,10 @@ namespace ana
     {
         std::vector<std::string> n;
         std::vector<ana::SpillMultiVar> v;
-        for(const auto & [name, var] : vars)
+        for(const auto & [branch, var] : vars)
         {
-            n.push_back(name);
-            v.push_back(var);
+            n.push_back(branch);
+            v.push_back(TracedVar(name + "/" + branch, var));
         }
         trees.push_back({name, n, v, is_sim});
     }
@@ -179,14 +433,444 @@ namespace ana
     {
         std::vector<std::string> n;
         std::vector<ana::SpillMultiVar> v;
-        for(const auto & [name, var] : vars)
+        for(const auto & [branch, var] : vars)
         {
-            n.push_back(name);
-            v.push_back(var);
+            n.push_back(branch);
+            v.push_back(TracedVar(name + "/" + branch, var));
         }
         trees_map[std::make_pair(sname, name)] = {name, n, v, is_sim};
     }
 
+    /**
+     * @brief Configure the output mode of the analysis.
+     * @details The default ("single") mode writes all samples to a single
+     * output file, <name>.root, with a subdirectory "events/<sample>" per
+     * sample. The "per_sample" mode instead writes each sample to its own
+     * file, <name>_<sample>.root, with the same internal layout, and indexes
+     * the files in a manifest, <name>.manifest.toml. In the "per_sample" mode,
+     * up to @p nthreads samples are processed concurrently.
+     * @param mode The output mode ("single" or "per_sample").
+     * @param nthreads The number of samples to process concurrently.
+     * @return void
+     * @throw std::runtime_error if the mode is not recognized.
+     */
+    void Analysis::SetOutputMode(std::string mode, size_t nthreads)
+    {
+        if(mode == "single")
+            per_sample = false;
+        else if(mode == "per_sample")
+            per_sample = true;
+        else
+            throw std::runtime_error("Illegal output mode '" + mode + "'.");
+        sample_threads = std::max<size_t>(nthreads, 1);
+    }
+
+    /**
+     * @brief Cluster the rows of an output tree by a category branch.
+     * @details Readers of the output (e.g., spineplot) typically process a
+     * single category at a time. This function writes the rows of the tree
+     * @p tree from @p source to @p target, ordered by the value of the
+     * @p branch branch (stably, so the original order is kept within a
+     * category; NaN values are placed last). The baskets are flushed at each
+     * category boundary, so that each category starts a new cluster and no
+     * basket holds rows of more than one category. A companion tree,
+     * "<tree>_index", holds one row per category with the branches
+     * "category," "first," and "count," giving the range of rows of the
+     * category. All other objects in @p source (e.g., the POT and Livetime
+     * histograms) are copied to @p target unchanged.
+     * @param source The directory holding the unclustered tree.
+     * @param target The directory to write the clustered tree to.
+     * @param tree The name of the tree.
+     * @param branch The name of the category branch.
+     * @return void
+     * @throw std::runtime_error if the tree does not have the branch.
+     */
+    void ClusterTree(TDirectory * source, TDirectory * target, const std::string & tree, const std::string & branch)
+    {
+        // Copy everything but the tree itself.
+        for(TObject * obj : *source->GetListOfKeys())
+        {
+            TKey * key(static_cast<TKey *>(obj));
+            if(tree == key->GetName())
+                continue;
+            TObject * o(key->ReadObj());
+            target->WriteTObject(o, key->GetName(), "Overwrite");
+            delete o;
+        }
+
+        TTree * input(source->Get<TTree>(tree.c_str()));
+        if(input == nullptr)
+            return;
+        TLeaf * leaf(input->GetLeaf(branch.c_str()));
+        if(leaf == nullptr)
+            throw std::runtime_error("Tree " + tree + " does not have the category branch '" + branch + "'.");
+
+        // Read only the category branch to determine the order of the rows.
+        const Long64_t n(input->GetEntries());
+        std::vector<std::pair<double, Long64_t>> order(n);
+        for(Long64_t i(0); i < n; ++i)
+        {
+            leaf->GetBranch()->GetEntry(i);
+            order[i] = std::make_pair(leaf->GetValue(), i);
+        }
+        std::stable_sort(order.begin(), order.end(), [](const auto & a, const auto & b)
+        {
+            return !std::isnan(a.first) && (std::isnan(b.first) || a.first < b.first);
+        });
+
+        // Write the rows in order, starting a new cluster with each category.
+        target->cd();
+        TTree * output(input->CloneTree(0));
+        output->SetDirectory(target);
+        double category(0);
+        Long64_t first(0), count(0);
+        TTree * index(new TTree((tree + "_index").c_str(), (tree + " category index").c_str()));
+        index->SetDirectory(target);
+        index->Branch("category", &category);
+        index->Branch("first", &first);
+        index->Branch("count", &count);
+        auto same = [](double a, double b) { return a == b || (std::isnan(a) && std::isnan(b)); };
+        for(Long64_t k(0); k < n; ++k)
+        {
+            if(k > 0 && !same(order[k].first, category))
+            {
+                index->Fill();
+                output->FlushBaskets();
+                first = k;
+                count = 0;
+            }
+            category = order[k].first;
+            input->GetEntry(order[k].second);
+            output->Fill();
+            ++count;
+        }
+        if(n > 0)
+            index->Fill();
+        output->Write(tree.c_str(), TObject::kOverwrite);
+        index->Write(nullptr, TObject::kOverwrite);
+        delete output;
+        delete index;
+        delete input;
+    }
+
+    /**
+     * @brief Configure the clustering of the rows of a tree by category.
+     * @details The rows of the tree are written ordered by the value of the
+     * category branch, along with an index of the row range of each category
+     * (see @ref ClusterTree). This allows readers to fetch only the baskets
+     * of the categories they need. The unclustered tree is spooled to a
+     * temporary file next to the output
+     * ("<output>.<sample>.<tree>.scratch.root"), which is removed once the
+     * tree is rewritten, so the directory of the output needs room for a
+     * second copy of the tree.
+     * @param tree The name of the tree.
+     * @param branch The name of the category branch (e.g., "category").
+     * @return void
+     */
+    void Analysis::SetClustering(std::string tree, std::string branch)
+    {
+        cluster_by[tree] = branch;
+    }
+
+    /**
+     * @brief Prescale the rows of a tree by category.
+     * @details Background-dominated trees are written with only a fraction
+     * of the rows of the chosen categories, and a "prescale_weight" branch
+     * compensating for the dropped rows (see @ref Prescale). The prescaled
+     * rows are also the rows seen by the accumulators and the columnar
+     * export of the tree.
+     * @param tree The name of the tree.
+     * @param prescale The prescale policy.
+     * @return void
+     */
+    void Analysis::SetPrescale(std::string tree, Prescale prescale)
+    {
+        prescales[tree] = std::move(prescale);
+    }
+
+    /**
+     * @brief Configure whether a tree is written to the output.
+     * @details A tree that only feeds accumulators (see @ref AddAccumulator)
+     * need not be written. It is still run, and its columnar table (if any)
+     * is still exported. Trees are written by default.
+     * @param tree The name of the tree.
+     * @param write Whether the tree is written.
+     * @return void
+     */
+    void Analysis::SetTreeOutput(std::string tree, bool write)
+    {
+        if(write)
+            unwritten.erase(tree);
+        else
+            unwritten.insert(tree);
+    }
+
+    /**
+     * @brief Attach a sufficient-statistics accumulator to a tree.
+     * @details The accumulator collects the binned statistics of a pair of
+     * branches of the tree during the pass (see accumulators.h). It is
+     * written to the directory of the sample along with the trees.
+     * @param sname The name of the sample.
+     * @param tree The name of the tree.
+     * @param config The configuration of the accumulator.
+     * @return void
+     */
+    void Analysis::AddAccumulator(std::string sname, std::string tree, accumulators::Config config)
+    {
+        accumulator_configs[std::make_pair(sname, tree)].push_back(std::move(config));
+    }
+
+    /**
+     * @brief Enable the columnar export of the output trees.
+     * @details The rows of each output tree are captured in memory as they
+     * are produced (see @ref ExportVars) and, once a sample is done, the
+     * table of each tree is published to the POSIX shared memory segment
+     * "/<prefix>_<sample>_<tree>" (see @ref columnar::publish). In follow
+     * mode, the tables accumulate the rows of all batches and are published
+     * again after each batch. The rows are in the order in which they were
+     * produced, irrespective of the clustering of the ROOT output.
+     * @param prefix The prefix of the shared memory segment names.
+     * @return void
+     */
+    void Analysis::SetExport(std::string prefix)
+    {
+        export_prefix = prefix;
+    }
+
+    /**
+     * @brief Select the backend reading the input files of the samples.
+     * @details The "spectrumloader" backend runs the samples through
+     * ana::SpectrumLoader and ana::Tree. The "treewriter" backend runs all samples
+     * with the SpectrumLoader-free tree writer (see reader.h), which
+     * delivers the same SRProxy records to the same SpillMultiVars and writes
+     * the same output layout without the spectrum and systematic machinery
+     * of CAFAna. Samples added without a SpectrumLoader always use the tree
+     * writer.
+     * @param backend The backend ("spectrumloader" or "treewriter").
+     * @param cache_bytes The size of the TTreeCache of the tree writer.
+     * @return void
+     * @throw std::runtime_error if the backend is not known.
+     */
+    void Analysis::SetReader(std::string backend, long long cache_bytes)
+    {
+        if(backend == "spectrumloader")
+            treewriter = false;
+        else if(backend == "treewriter")
+            treewriter = true;
+        else
+            throw std::runtime_error("Illegal reader backend '" + backend + "'.");
+        reader_cache = cache_bytes;
+    }
+
+    /**
+     * @brief Get the columnar table of an output tree of a sample.
+     * @details The table can be exported in-process through the Arrow C Data
+     * Interface (see @ref columnar::export_table). It is only filled if the
+     * export is enabled (see @ref SetExport).
+     * @param sample The name of the sample.
+     * @param tree The name of the tree.
+     * @return The table, or nullptr if the tree has not been run.
+     */
+    std::shared_ptr<const columnar::Table> Analysis::GetTable(std::string sample, std::string tree)
+    {
+        std::lock_guard<std::mutex> lock(tables_mutex);
+        auto it(tables.find(std::make_pair(sample, tree)));
+        return it == tables.end() ? nullptr : it->second;
+    }
+
+    /**
+     * @brief Get the number of spills processed.
+     * @details The spills of all samples run so far are counted, once per
+     * spill regardless of the number of Trees.
+     * @return The number of spills processed.
+     */
+    size_t Analysis::GetSpills() const
+    {
+        return spills.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Run the analysis on a single sample.
+     * @details This function creates the Trees for the sample, runs the
+     * SpectrumLoader of the sample (or the tree writer, if the sample has no
+     * SpectrumLoader) to populate the Trees, and saves the Trees to the
+     * specified directory, followed by the accumulators of the Trees.
+     * @param s The sample to run.
+     * @param subdir The directory to save the Trees to.
+     * @return The names of the Trees that were saved.
+     */
+    std::vector<std::string> Analysis::RunSample(const Sample & s, TDirectory * subdir)
+    {
+        std::vector<std::string> names;
+        std::vector<std::unique_ptr<accumulators::Accumulator>> sample_accumulators;
+        std::vector<std::unique_ptr<ana::Tree>> sbruce_trees;
+        std::vector<std::unique_ptr<reader::Tree>> writer_trees;
+        std::unique_ptr<reader::Loader> writer_loader;
+        if(treewriter || s.loader == nullptr)
+        {
+            if(s.files.empty() && s.path.empty())
+                throw std::runtime_error("Sample '" + s.name + "' has no input path for the SpectrumLoader-free tree writer.");
+            writer_loader = std::make_unique<reader::Loader>(s.files.empty() ? reader::expand(s.path) : s.files);
+            writer_loader->SetCache(reader_cache, 10);
+        }
+
+        // With the slow-spill detector, the processing time of each tree is
+        // measured spill by spill. With the columnar export, the values of
+        // the variables are also captured in the (persistent) table of the
+        // tree. The first variable of the first tree also counts the spills
+        // and the last variable of the last tree closes the spill.
+        bool counted(false);
+        auto vars = [&](const TreeSet & t, bool last) -> std::vector<ana::SpillMultiVar>
+        {
+            std::vector<ana::SpillMultiVar> result(monitor::enabled() ? monitor::wrap(s.name, t.name, t.vars) : t.vars);
+            if(!counted && !result.empty())
+            {
+                ana::SpillMultiVar first(result[0]);
+                std::atomic<size_t> * count(&spills);
+                result[0] = ana::SpillMultiVar([first, count](const caf::Proxy<caf::StandardRecord> * sr) -> std::vector<double>
+                {
+                    count->fetch_add(1, std::memory_order_relaxed);
+                    return first(sr);
+                });
+                counted = true;
+            }
+            auto acc(accumulator_configs.find(std::make_pair(s.name, t.name)));
+            if(acc != accumulator_configs.end())
+            {
+                for(const accumulators::Config & config : acc->second)
+                {
+                    sample_accumulators.push_back(std::make_unique<accumulators::Accumulator>(t.name, config));
+                    result = sample_accumulators.back()->wrap(t.names, result);
+                }
+            }
+            if(!export_prefix.empty())
+            {
+                std::lock_guard<std::mutex> lock(tables_mutex);
+                std::shared_ptr<columnar::Table> & table(tables[std::make_pair(s.name, t.name)]);
+                if(!table)
+                    table = std::make_shared<columnar::Table>(s.name + "/" + t.name, t.names);
+                result = ExportVars(table, result);
+            }
+            if(last && !result.empty())
+            {
+                ana::SpillMultiVar closing(result.back());
+                result.back() = ana::SpillMultiVar([closing](const caf::Proxy<caf::StandardRecord> * sr) -> std::vector<double>
+                {
+                    std::vector<double> values(closing(sr));
+                    memo::SpillContext::current().end_spill();
+                    return values;
+                });
+            }
+            return result;
+        };
+        // The per-spill caches (memoized results, selections, matches, and
+        // multi-output variables) are invalidated once per record by a
+        // SpillCut shared by all trees of the sample. The SpectrumLoader
+        // groups the variables by SpillCut, so the shared cut is evaluated
+        // once per record, before any variable of any tree. The invalidation
+        // cannot be derived from the content of the record: the proxies are
+        // reused and two records may share their header.
+        const ana::SpillCut begin_spill([](const caf::Proxy<caf::StandardRecord> *) -> bool
+        {
+            memo::SpillContext::current().begin_spill();
+            return true;
+        });
+        auto add = [&](const TreeSet & tree, bool last)
+        {
+            auto prescale(prescales.find(tree.name));
+            const TreeSet t(prescale == prescales.end() ? tree : PrescaleVars(prescale->second, tree));
+            if(writer_loader)
+                writer_trees.push_back(std::make_unique<reader::Tree>(t.name, t.names, *writer_loader, vars(t, last)));
+            else
+                sbruce_trees.push_back(std::make_unique<ana::Tree>(t.name, t.names, *s.loader, vars(t, last), begin_spill, true));
+            names.push_back(t.name);
+        };
+        auto save = [&](size_t i, TDirectory * dir)
+        {
+            if(writer_loader)
+                writer_trees[i]->SaveTo(dir);
+            else
+                sbruce_trees[i]->SaveTo(dir);
+        };
+        std::vector<const TreeSet *> selected;
+        for(const TreeSet & t : trees)
+        {
+            if(t.is_sim && !s.is_sim)
+                continue;
+            selected.push_back(&t);
+        }
+        for(const auto & [name, t] : trees_map)
+        {
+            if((t.is_sim && !s.is_sim) || name.first != s.name)
+                continue;
+            selected.push_back(&t);
+        }
+        for(size_t i(0); i < selected.size(); ++i)
+            add(*selected[i], i + 1 == selected.size());
+
+        SPINE_PROBE1(sample_begin, s.name.c_str());
+        if(writer_loader)
+            writer_loader->Go();
+        else
+            s.loader->Go();
+        memo::SpillContext::current().end_spill();
+        SPINE_PROBE1(sample_end, s.name.c_str());
+        if(monitor::enabled())
+            monitor::flush(s.name);
+        std::vector<std::string> written;
+        for(size_t i(0); i < names.size(); ++i)
+        {
+            if(unwritten.count(names[i]) == 0)
+            {
+                SPINE_PROBE1(tree_write, names[i].c_str());
+                written.push_back(names[i]);
+                auto cluster(cluster_by.find(names[i]));
+                if(cluster == cluster_by.end())
+                    save(i, subdir);
+                else
+                {
+                    // The tree is first written to a scratch file next to
+                    // the output (it may not fit in memory) and then
+                    // rewritten in category order to the output.
+                    const std::string output(subdir->GetFile() ? subdir->GetFile()->GetName() : name + ".root");
+                    const std::string path(output + "." + s.name + "." + names[i] + ".scratch.root");
+                    try
+                    {
+                        TFile scratch(path.c_str(), "RECREATE");
+                        if(scratch.IsZombie())
+                            throw std::runtime_error("Unable to write the scratch file " + path + ".");
+                        save(i, &scratch);
+                        ClusterTree(&scratch, subdir, names[i], cluster->second);
+                        scratch.Close();
+                    }
+                    catch(...)
+                    {
+                        std::remove(path.c_str());
+                        throw;
+                    }
+                    std::remove(path.c_str());
+                }
+            }
+            if(writer_loader)
+                writer_trees[i].reset();
+            else
+                sbruce_trees[i].reset();
+        }
+        for(const auto & accumulator : sample_accumulators)
+            accumulator->SaveTo(subdir);
+
+        // Publish the tables of the sample to shared memory.
+        if(!export_prefix.empty())
+        {
+            for(const std::string & tree : names)
+            {
+                std::shared_ptr<const columnar::Table> table(GetTable(s.name, tree));
+                columnar::publish(*table, columnar::segment_name(export_prefix, s.name, tree));
+            }
+        }
+        return written;
+    }
+
     /**
      * @brief Run the analysis on the specified samples.
      * @details This function runs the analysis on the configured samples by
@@ -194,42 +878,375 @@ namespace ana
      * running the analysis on the sample to populate the Trees with the
      * results of the analysis. The results are stored in a TFile in the output
      * ROOT file in a parent directory named "events" and a subdirectory for
-     * each sample.
+     * each sample. See @ref SetOutputMode for the per-sample output mode.
      * @return void
      */
     void Analysis::Go()
     {
-        TFile * f = new TFile(std::string(name + ".root").c_str(), "RECREATE");
+        if(per_sample)
+        {
+            GoPerSample();
+            return;
+        }
+        GoSingle(name + ".root");
+    }
+
+    /**
+     * @brief Run the analysis on all samples into a single file.
+     * @details The samples are written to "events/<sample>" directories of
+     * @p file_name (see @ref Go).
+     * @param file_name The name of the output file.
+     * @return void
+     */
+    void Analysis::GoSingle(const std::string & file_name)
+    {
+        TFile * f = new TFile(file_name.c_str(), "RECREATE");
+        SPINE_PROBE1(file_open, f->GetName());
         TDirectory * dir = f->mkdir("events");
         dir->cd();
 
-        for(const Sample & s : samples)
+        for(size_t i(0); i < samples.size(); ++i)
         {
+            const Sample & s(samples[i]);
+            placement::place_sample(i);
             TDirectory * subdir = dir->mkdir(s.name.c_str());
             subdir->cd();
-            std::vector<ana::Tree*> sbruce_trees;
-            for(const TreeSet & t : trees)
+            RunSample(s, subdir);
+            dir->cd();
+        }
+        SPINE_PROBE1(file_close, f->GetName());
+        f->Close();
+    }
+
+    /**
+     * @brief Run the analysis on a single sample and write it to its own file.
+     * @details The sample is written to @p file_name using the same
+     * "events/<sample>" layout as the single-file mode, so the file can also
+     * be read on its own. The returned manifest entry records the trees and
+     * the exposure totals of the file, with the path of the file given
+     * relative to the directory of the analysis output.
+     * @param s The sample to run.
+     * @param file_name The name of the output file.
+     * @return The manifest entry describing the output file.
+     */
+    cfg::Manifest::Entry Analysis::WriteSample(const Sample & s, const std::string & file_name)
+    {
+        TFile * f = new TFile(file_name.c_str(), "RECREATE");
+        SPINE_PROBE1(file_open, file_name.c_str());
+        TDirectory * subdir = f->mkdir("events")->mkdir(s.name.c_str());
+
+        cfg::Manifest::Entry entry;
+        entry.sample = s.name;
+        size_t pos(file_name.find_last_of('/'));
+        entry.path = (pos == std::string::npos) ? file_name : file_name.substr(pos + 1);
+        entry.trees = RunSample(s, subdir);
+
+        // The POT and Livetime histograms are written by the Trees.
+        if(TH1 * pot = subdir->Get<TH1>("POT"))
+            entry.pot = pot->GetBinContent(1);
+        if(TH1 * livetime = subdir->Get<TH1>("Livetime"))
+            entry.livetime = livetime->GetBinContent(1);
+        SPINE_PROBE1(file_close, file_name.c_str());
+        f->Close();
+        delete f;
+        return entry;
+    }
+
+    /**
+     * @brief Run the analysis with one output file per sample.
+     * @details Each sample is written to <name>_<sample>.root using the same
+     * "events/<sample>" layout as the single-file mode, so each file can also
+     * be read on its own. Samples are distributed across up to
+     * sample_threads threads, each of which owns its sample's loader and
+     * output file. With a placement policy (see placement.h), the thread is
+     * placed on the NUMA node of the sample before the sample is opened, so
+     * that its buffers are allocated on that node. Once all samples are done,
+     * the manifest <name>.manifest.toml is written with the file, trees, and
+     * exposure totals of each sample.
+     * @return void
+     */
+    void Analysis::GoPerSample()
+    {
+        // Files are written relative to the directory of the manifest.
+        std::string base(name);
+        size_t pos(name.find_last_of('/'));
+        if(pos != std::string::npos)
+            base = name.substr(pos + 1);
+
+        std::vector<cfg::Manifest::Entry> entries(samples.size());
+        std::atomic<size_t> next(0);
+        std::mutex io_mutex;
+        std::exception_ptr error;
+        auto worker = [&]()
+        {
+            size_t i;
+            while((i = next.fetch_add(1)) < samples.size())
+            try
             {
-                if(t.is_sim && !s.is_sim)
-                    continue;
-                sbruce_trees.push_back(new ana::Tree(t.name, t.names, *s.loader, t.vars, ana::kNoSpillCut, true));
+                const Sample & s(samples[i]);
+                const std::string file_name(name + "_" + s.name + ".root");
+                placement::place_sample(i);
+                entries[i] = WriteSample(s, file_name);
+
+                std::lock_guard<std::mutex> lock(io_mutex);
+                std::cout << "Wrote sample '" << s.name << "' to " << file_name << std::endl;
+            }
+            catch(...)
+            {
+                // Stop handing out samples and report the first error.
+                std::lock_guard<std::mutex> lock(io_mutex);
+                next.store(samples.size());
+                if(!error)
+                    error = std::current_exception();
             }
-            for(const auto & [name, t] : trees_map)
+        };
+
+        size_t nthreads(std::min(sample_threads, samples.size()));
+        if(nthreads > 1)
+        {
+            ROOT::EnableThreadSafety();
+            std::vector<std::thread> threads;
+            for(size_t t(0); t < nthreads; ++t)
+                threads.emplace_back(worker);
+            for(std::thread & t : threads)
+                t.join();
+        }
+        else
+            worker();
+        if(error)
+            std::rethrow_exception(error);
+
+        cfg::Manifest manifest(base);
+        for(const cfg::Manifest::Entry & entry : entries)
+            manifest.add(entry);
+        manifest.write(name + ".manifest.toml");
+    }
+
+    /**
+     * @brief Find the input files of a sample that have not been processed.
+     * @details The files matching the wildcard are listed in lexicographic
+     * order. Files that have already been processed are skipped, as are files
+     * that have been modified within the last @p settle seconds, which may
+     * still be in the process of being written.
+     * @param path The wildcard matching the input files of the sample.
+     * @param processed The set of input files that have been processed.
+     * @param settle The minimum age (in seconds) of a file to be processed.
+     * @return The list of new input files.
+     */
+    std::vector<std::string> FindNewFiles(const std::string & path, const std::set<std::string> & processed, size_t settle)
+    {
+        std::vector<std::string> files;
+        glob_t g;
+        if(glob(path.c_str(), 0, nullptr, &g) == 0)
+        {
+            std::time_t now(std::time(nullptr));
+            for(size_t i(0); i < g.gl_pathc; ++i)
             {
-                if((t.is_sim && !s.is_sim) || name.first != s.name)
+                std::string file(g.gl_pathv[i]);
+                struct stat st;
+                if(processed.count(file) > 0 || stat(file.c_str(), &st) != 0)
                     continue;
-                sbruce_trees.push_back(new ana::Tree(t.name, t.names, *s.loader, t.vars, ana::kNoSpillCut, true));
+                if(now - st.st_mtime >= static_cast<std::time_t>(settle))
+                    files.push_back(file);
             }
+        }
+        globfree(&g);
+        return files;
+    }
 
-            s.loader->Go();
-            for(const ana::Tree * t : sbruce_trees)
+    /**
+     * @brief Merge the histograms of a part file into a running summary.
+     * @details The histograms of the "events/<sample>" directory of @p part
+     * (e.g., the POT and Livetime histograms written by the Trees) are added
+     * to those of the same name in @p summary, and histograms seen for the
+     * first time are copied. The summary uses the same layout as the part
+     * files and is rewritten atomically (written to a temporary file which
+     * is then renamed), so that it always describes the complete set of
+     * finished parts. Objects other than histograms (trees, accumulator
+     * tables) are not merged.
+     * @param part The path of the part file.
+     * @param summary The path of the summary file.
+     * @param sample The name of the sample.
+     * @return void
+     * @throw std::runtime_error if the part file cannot be read or the
+     * summary cannot be written.
+     */
+    void MergeHistograms(const std::string & part, const std::string & summary, const std::string & sample)
+    {
+        const std::string dir_name("events/" + sample);
+        std::vector<std::unique_ptr<TH1>> merged;
+        if(std::ifstream(summary).good())
+        {
+            std::unique_ptr<TFile> previous(TFile::Open(summary.c_str(), "READ"));
+            TDirectory * dir(previous ? previous->GetDirectory(dir_name.c_str()) : nullptr);
+            if(dir == nullptr)
+                throw std::runtime_error("Unable to read the histogram summary " + summary + ".");
+            for(TObject * obj : *dir->GetListOfKeys())
             {
-                t->SaveTo(subdir);
-                delete t;
+                if(TH1 * h = dir->Get<TH1>(obj->GetName()))
+                {
+                    merged.emplace_back(static_cast<TH1 *>(h->Clone()));
+                    merged.back()->SetDirectory(nullptr);
+                }
             }
-            dir->cd();
         }
-        f->Close();
+
+        std::unique_ptr<TFile> input(TFile::Open(part.c_str(), "READ"));
+        TDirectory * dir(input ? input->GetDirectory(dir_name.c_str()) : nullptr);
+        if(dir == nullptr)
+            throw std::runtime_error("Unable to read part file " + part + ".");
+        for(TObject * obj : *dir->GetListOfKeys())
+        {
+            TH1 * h(dir->Get<TH1>(obj->GetName()));
+            if(h == nullptr)
+                continue;
+            auto match = [&](const std::unique_ptr<TH1> & m) { return std::string(m->GetName()) == h->GetName(); };
+            auto it(std::find_if(merged.begin(), merged.end(), match));
+            if(it != merged.end())
+                (*it)->Add(h);
+            else
+            {
+                merged.emplace_back(static_cast<TH1 *>(h->Clone()));
+                merged.back()->SetDirectory(nullptr);
+            }
+        }
+        input->Close();
+
+        const std::string scratch(summary + ".tmp");
+        {
+            TFile output(scratch.c_str(), "RECREATE");
+            if(output.IsZombie())
+                throw std::runtime_error("Unable to write the histogram summary " + scratch + ".");
+            TDirectory * out(output.mkdir("events")->mkdir(sample.c_str()));
+            for(const std::unique_ptr<TH1> & h : merged)
+                out->WriteTObject(h.get(), h->GetName());
+            output.Close();
+        }
+        if(std::rename(scratch.c_str(), summary.c_str()) != 0)
+            throw std::runtime_error("Unable to replace the histogram summary " + summary + ".");
+    }
+
+    /**
+     * @brief Run the analysis in follow mode.
+     * @details The follow mode is intended for near-online monitoring. The
+     * input wildcard of each sample (see @ref AddSample) is polled every
+     * @p interval seconds and only the files that have not yet been processed
+     * are run. Each batch of new files is written to its own part file,
+     * <name>_<sample>_partNNNNN.root, which is appended to the manifest
+     * <name>.manifest.toml along with its exposure and the list of input
+     * files it contains. The manifest is rewritten atomically after each
+     * batch, so it always describes the complete set of finished parts and
+     * serves as the record of progress: on restart, the input files listed in
+     * the manifest are not processed again. Readers of the manifest chain the
+     * trees and sum the exposure across the parts of each sample. The
+     * histograms of each part are also merged into a running summary,
+     * <name>_<sample>_summary.root, after each batch (see
+     * @ref MergeHistograms), so the summed histograms of a sample can be
+     * read without opening every part.
+     * @param interval The polling interval (in seconds).
+     * @param settle The minimum age (in seconds) of an input file to be
+     * processed.
+     * @param max_files The maximum number of files per batch (zero for no
+     * limit).
+     * @param iterations The number of polling iterations (zero to run until
+     * interrupted).
+     * @return void
+     */
+    void Analysis::Follow(size_t interval, size_t settle, size_t max_files, size_t iterations)
+    {
+        std::string base(name);
+        size_t pos(name.find_last_of('/'));
+        if(pos != std::string::npos)
+            base = name.substr(pos + 1);
+
+        // Resume from the manifest of a previous run, if any.
+        const std::string manifest_path(name + ".manifest.toml");
+        cfg::Manifest manifest(base);
+        if(std::ifstream(manifest_path).good())
+            manifest = cfg::Manifest::read(manifest_path);
+        std::vector<std::string> inputs(manifest.get_inputs());
+        std::set<std::string> processed(inputs.begin(), inputs.end());
+        std::cout << "Following " << samples.size() << " samples (" << processed.size() << " files already processed)." << std::endl;
+
+        for(size_t iteration(0); iterations == 0 || iteration < iterations; ++iteration)
+        {
+            if(iteration > 0)
+                std::this_thread::sleep_for(std::chrono::seconds(interval));
+            for(size_t i(0); i < samples.size(); ++i)
+            {
+                const Sample & s(samples[i]);
+                std::vector<std::string> files(FindNewFiles(s.path, processed, settle));
+                if(max_files > 0 && files.size() > max_files)
+                    files.resize(max_files);
+                if(files.empty())
+                    continue;
+
+                placement::place_sample(i);
+                std::unique_ptr<ana::SpectrumLoader> loader(treewriter ? nullptr : std::make_unique<ana::SpectrumLoader>(files));
+                Sample batch{s.name, loader.get(), s.is_sim, s.path, files};
+                char part[16];
+                std::snprintf(part, sizeof(part), "%05zu", manifest.get_entries(s.name).size());
+                const std::string file_name(name + "_" + s.name + "_part" + part + ".root");
+
+                cfg::Manifest::Entry entry(WriteSample(batch, file_name));
+                entry.inputs = files;
+                manifest.add(entry);
+                manifest.write(manifest_path);
+                MergeHistograms(file_name, name + "_" + s.name + "_summary.root", s.name);
+                processed.insert(files.begin(), files.end());
+
+                std::cout << "Processed " << files.size() << " new files for sample '" << s.name
+                          << "' into " << file_name << " (" << entry.pot << " POT, total "
+                          << manifest.get_pot(s.name) << " POT)." << std::endl;
+            }
+        }
+    }
+
+    /**
+     * @brief Compare the SpectrumLoader-free tree writer with the
+     * SpectrumLoader backend.
+     * @details All samples are run twice in the single-file layout: first
+     * with the tree writer to <name>_treewriter.root, then with the
+     * SpectrumLoader of each sample to <name>.root. The tree writer pass runs
+     * first, so that it also warms the page cache for the SpectrumLoader pass
+     * and the measured speedup is conservative. The wall time and spill rate of each pass are
+     * reported, and the two output files are compared object by object (see
+     * @ref reader::compare). The samples must have both a SpectrumLoader and
+     * an input path (see @ref AddLoader).
+     * @return void
+     * @throw std::runtime_error if the outputs of the two backends differ.
+     */
+    void Analysis::Benchmark()
+    {
+        struct Pass
+        {
+            std::string backend;
+            std::string file_name;
+            size_t spills;
+            double seconds;
+        };
+        std::vector<Pass> passes{{"treewriter", name + "_treewriter.root", 0, 0}, {"spectrumloader", name + ".root", 0, 0}};
+        for(Pass & p : passes)
+        {
+            treewriter = (p.backend == "treewriter");
+            const size_t before(GetSpills());
+            const auto start(std::chrono::steady_clock::now());
+            GoSingle(p.file_name);
+            p.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            p.spills = GetSpills() - before;
+            std::cout << "Reader '" << p.backend << "': " << p.spills << " spills in " << p.seconds << " s ("
+                      << (p.seconds > 0 ? p.spills / p.seconds : 0) << " spills/s), written to " << p.file_name << std::endl;
+        }
+        treewriter = false;
+        std::cout << "Speedup of the SpectrumLoader-free tree writer: " << passes[1].seconds / passes[0].seconds << "x" << std::endl;
+
+        std::unique_ptr<TFile> a(TFile::Open(passes[0].file_name.c_str(), "READ")), b(TFile::Open(passes[1].file_name.c_str(), "READ"));
+        if(!a || !b || a->IsZombie() || b->IsZombie())
+            throw std::runtime_error("Unable to open the outputs of the reader benchmark.");
+        const size_t mismatches(reader::compare(a.get(), b.get(), std::cout));
+        if(mismatches > 0)
+            throw std::runtime_error("The outputs of the reader backends differ in " + std::to_string(mismatches) + " objects.");
+        std::cout << "The outputs of the reader backends are identical." << std::endl;
     }
 }
 #endif // ANALYSIS_H
\ No newline at end of file
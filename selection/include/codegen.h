@@ -0,0 +1,139 @@
+/**
+ * @file codegen.h
+ * @brief Header file for the generation of specialized selection libraries in
+ * the SPINE analysis framework.
+ * @details The interpreted selection resolves the cuts and variables of the
+ * configuration by name through the registries and evaluates them through
+ * several layers of std::function (the factory, the binding of the parameters,
+ * and the per-spill memoization). For production configurations that are run
+ * many times unchanged, the components in this file turn the cuts and
+ * variables resolved for a configuration into a C++ translation unit. The unit
+ * calls the registered function templates directly, with the parameters baked
+ * in as constants, and lists the functions in plain arrays. It is compiled
+ * once into a shared library keyed by a hash of the configuration (and of the
+ * executable and its libraries), and the library is loaded by later runs with
+ * the same configuration. The loaded functions replace the registry lookups
+ * (see @ref construct) while the rest of the selection is unchanged, so the
+ * results are bit-identical to the interpreted path.
+ * @author mueller@fnal.gov
+ */
+#ifndef CODEGEN_H
+#define CODEGEN_H
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+#include "framework.h"
+
+/**
+ * @namespace codegen
+ * @brief Namespace for the generation of specialized selection libraries.
+ */
+namespace codegen
+{
+    /**
+     * @struct Entry
+     * @brief A function of a generated library.
+     * @tparam ValueT The return type of the function.
+     * @tparam EventT The type of object the function is applied to.
+     */
+    template<typename ValueT, typename EventT>
+    struct Entry
+    {
+        const char * key;               ///< The key of the function (see @ref key).
+        ValueT (*fn)(const EventT &);   ///< The specialized function.
+    };
+
+    /**
+     * @brief Install the functions of a generated library.
+     * @details The functions are registered in the registry of bound functions
+     * of their type, where they take precedence over the factories of the
+     * interpreted path (see @ref lookup).
+     * @tparam ValueT The return type of the functions.
+     * @tparam EventT The type of object the functions are applied to.
+     * @tparam N The number of functions.
+     * @param entries The functions.
+     * @return void
+     */
+    template<typename ValueT, typename EventT, size_t N>
+    void install(const Entry<ValueT, EventT> (&entries)[N])
+    {
+        for(const Entry<ValueT, EventT> & e : entries)
+            Registry<std::function<ValueT(const EventT&)>>::instance().register_fn(e.key, e.fn);
+    }
+
+    /**
+     * @brief Build the key of a function bound to a parameter set.
+     * @details The parameters are written as hexadecimal floating point
+     * literals, so that the key (and the generated constants) represent the
+     * parameters exactly.
+     * @param name The registered name of the function.
+     * @param params The parameters.
+     * @return The key, "<name>|<p0>,<p1>,...".
+     */
+    std::string key(const std::string & name, const std::vector<double> & params);
+
+    /**
+     * @brief Look up a function bound to a parameter set.
+     * @details The specialized function of a loaded library is returned if
+     * there is one. Otherwise, the function is built by the factory of the
+     * registry, as in the interpreted path. The lookup is recorded if the
+     * recording is enabled (see @ref record).
+     * @tparam ValueT The return type of the function.
+     * @tparam EventT The type of object the function is applied to.
+     * @param name The registered name of the function.
+     * @return A factory binding the function to a parameter set.
+     * @throw std::runtime_error if the name is not registered.
+     */
+    template<typename ValueT, typename EventT>
+    std::function<std::function<ValueT(const EventT&)>(const std::vector<double>&)> lookup(const std::string & name);
+
+    /**
+     * @brief Enable the recording of the functions looked up by the
+     * selection.
+     * @return void
+     */
+    void record();
+
+    /**
+     * @brief Compute the hash identifying the library of a configuration.
+     * @details The hash (FNV-1a) covers the contents of the configuration
+     * file and the size and modification time of the running executable and
+     * of the libraries it has loaded (e.g., the registration library), so
+     * that a library is not reused with a rebuilt executable or library.
+     * @param path The path of the configuration file.
+     * @return The hash, as a hexadecimal string.
+     * @throw std::runtime_error if the configuration file cannot be read.
+     */
+    std::string config_hash(const std::string & path);
+
+    /**
+     * @brief Load a generated library.
+     * @param path The path of the shared library.
+     * @return True if the library was found and loaded.
+     */
+    bool load(const std::string & path);
+
+    /**
+     * @brief Write the translation unit of the recorded functions.
+     * @param path The path of the source file.
+     * @param config The path of the configuration file (for reference).
+     * @return The number of functions written.
+     * @throw std::runtime_error if the source file cannot be written.
+     */
+    size_t generate(const std::string & path, const std::string & config);
+
+    /**
+     * @brief Compile a generated translation unit into a shared library.
+     * @details The compiler command is configured at build time with the
+     * flags and include directories of the selection. The library is written
+     * to a temporary file and moved into place, so that concurrent runs
+     * never load a partial library.
+     * @param source The path of the source file.
+     * @param library The path of the shared library.
+     * @return True if the compilation succeeded.
+     */
+    bool compile(const std::string & source, const std::string & library);
+}
+#endif // CODEGEN_H
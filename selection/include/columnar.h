@@ -0,0 +1,210 @@
+/**
+ * @file columnar.h
+ * @brief Header file for the in-memory columnar export of the selection
+ * results in the SPINE analysis framework.
+ * @details When iterating in a notebook, the analyst waits first on the
+ * selection writing the ROOT output and then on uproot decoding it again. The
+ * components in this file capture the rows of each output tree in memory as
+ * they are produced and export them in the Arrow columnar format, either
+ * in-process through the Arrow C Data Interface or to other processes through
+ * a POSIX shared memory segment. The columns of the segment are stored as
+ * Arrow buffers (64-byte aligned, native endianness), so that pyarrow, numpy,
+ * or pandas can map them without copying or decoding anything (see
+ * spineplot/shm.py).
+ *
+ * The layout of a shared memory segment is:
+ *  - bytes [0, 8): the magic string "SPINEARW",
+ *  - bytes [8, 12): the format version (uint32),
+ *  - bytes [12, 16): reserved,
+ *  - bytes [16, 24): the length of the JSON schema (uint64),
+ *  - bytes [24, 32): the number of rows (uint64),
+ *  - the JSON schema, listing for each column its name, Arrow format string,
+ *    and the offset and length (in bytes) of its data buffer,
+ *  - the data buffers.
+ * @author mueller@fnal.gov
+ */
+#ifndef COLUMNAR_H
+#define COLUMNAR_H
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+/**
+ * @brief The Arrow C Data Interface schema structure.
+ * @details This is the ABI-stable definition from the Arrow specification.
+ */
+struct ArrowSchema
+{
+    const char * format;
+    const char * name;
+    const char * metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema ** children;
+    struct ArrowSchema * dictionary;
+    void (*release)(struct ArrowSchema *);
+    void * private_data;
+};
+
+/**
+ * @brief The Arrow C Data Interface array structure.
+ * @details This is the ABI-stable definition from the Arrow specification.
+ */
+struct ArrowArray
+{
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void ** buffers;
+    struct ArrowArray ** children;
+    struct ArrowArray * dictionary;
+    void (*release)(struct ArrowArray *);
+    void * private_data;
+};
+
+#endif // ARROW_C_DATA_INTERFACE
+
+/**
+ * @namespace columnar
+ * @brief Namespace for the in-memory columnar export of the selection
+ * results.
+ */
+namespace columnar
+{
+    /**
+     * @class Table
+     * @brief In-memory columnar copy of an output tree of the selection.
+     * @details The table has the same columns as the TTree written by the
+     * selection: the integer "Run," "Subrun," and "Evt" columns, followed by
+     * one double-precision column per branch. Rows are appended spill by
+     * spill as the branch variables are evaluated.
+     */
+    class Table
+    {
+        public:
+            /**
+             * @brief Constructor for the Table class.
+             * @param name The name of the table (e.g., "<sample>/<tree>").
+             * @param names The names of the branch columns.
+             */
+            Table(const std::string & name, const std::vector<std::string> & names);
+
+            /**
+             * @brief Append the index columns for the rows of a spill.
+             * @param run The run number of the spill.
+             * @param subrun The subrun number of the spill.
+             * @param event The event number of the spill.
+             * @param n The number of rows produced by the spill.
+             * @return void
+             */
+            void append_index(int32_t run, int32_t subrun, int32_t event, size_t n);
+
+            /**
+             * @brief Append the values of a branch column for a spill.
+             * @param column The index of the branch column.
+             * @param values The values produced by the spill.
+             * @return void
+             */
+            void append(size_t column, const std::vector<double> & values);
+
+            /**
+             * @brief Get the name of the table.
+             * @return The name of the table.
+             */
+            const std::string & name() const { return name_; }
+
+            /**
+             * @brief Get the number of rows in the table.
+             * @return The number of rows.
+             */
+            size_t rows() const { return index_[0].size(); }
+
+            /**
+             * @brief Get the names of all columns (index columns first).
+             * @return The names of the columns.
+             */
+            std::vector<std::string> column_names() const;
+
+            /**
+             * @brief Get the Arrow format string of a column.
+             * @param column The index of the column (index columns first).
+             * @return The format string ("i" for int32, "g" for float64).
+             */
+            const char * format(size_t column) const { return column < 3 ? "i" : "g"; }
+
+            /**
+             * @brief Get the data buffer of a column.
+             * @param column The index of the column (index columns first).
+             * @return A pointer to the values of the column.
+             */
+            const void * data(size_t column) const;
+
+            /**
+             * @brief Get the size of the data buffer of a column.
+             * @param column The index of the column (index columns first).
+             * @return The size of the buffer in bytes.
+             */
+            size_t bytes(size_t column) const;
+
+            /**
+             * @brief Get the total number of columns.
+             * @return The number of columns (index columns included).
+             */
+            size_t columns() const { return 3 + values_.size(); }
+
+        private:
+            std::string name_;
+            std::vector<std::string> names_;
+            std::vector<int32_t> index_[3];
+            std::vector<std::vector<double>> values_;
+    };
+
+    /**
+     * @brief Export a table through the Arrow C Data Interface.
+     * @details The table is exported as a struct array (a record batch) with
+     * one child per column. The buffers are not copied: the exported
+     * structures hold a reference to the table, which is released by the
+     * release callbacks. This allows an embedding process (e.g., a resident
+     * Python interpreter) to import the table with
+     * pyarrow.RecordBatch._import_from_c.
+     * @param table The table to export.
+     * @param schema The schema structure to fill.
+     * @param array The array structure to fill.
+     * @return void
+     */
+    void export_table(const std::shared_ptr<const Table> & table, ArrowSchema * schema, ArrowArray * array);
+
+    /**
+     * @brief Publish a table to a POSIX shared memory segment.
+     * @details Any existing segment with the same name is unlinked first.
+     * Readers that have already mapped the old segment keep a valid view of
+     * it, while new readers see the new segment.
+     * @param table The table to publish.
+     * @param shm_name The name of the segment (e.g., "/spine_<sample>_<tree>").
+     * @return void
+     * @throw std::runtime_error if the segment cannot be created or mapped.
+     */
+    void publish(const Table & table, const std::string & shm_name);
+
+    /**
+     * @brief Build the name of the shared memory segment of a table.
+     * @details Characters that are not allowed in a segment name are
+     * replaced by underscores.
+     * @param prefix The prefix of the segment names.
+     * @param sample The name of the sample.
+     * @param tree The name of the tree.
+     * @return The name of the segment, "/<prefix>_<sample>_<tree>".
+     */
+    std::string segment_name(const std::string & prefix, const std::string & sample, const std::string & tree);
+}
+#endif // COLUMNAR_H
@@ -0,0 +1,19 @@
+/**
+ * @file definitions.h
+ * @brief Header file for the definitions shared by the cuts, variables, and
+ * selectors of the SPINE analysis framework.
+ * @details The headers of the cuts and variables expect these definitions to
+ * be made before they are included. Every translation unit including them
+ * (the registration units, see src/registrations/, the main program, and the
+ * generated selection libraries) must include this file first so that they
+ * all see the same definitions.
+ * @author mueller@fnal.gov
+ */
+#ifndef DEFINITIONS_H
+#define DEFINITIONS_H
+#define PLACEHOLDERVALUE std::numeric_limits<double>::quiet_NaN()
+#define PROTON_BINDING_ENERGY 30.9 // MeV
+#define BEAM_IS_NUMI false
+
+#include <limits>
+#endif // DEFINITIONS_H
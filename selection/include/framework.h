@@ -9,14 +9,19 @@
 #ifndef FRAMEWORK_H
 #define FRAMEWORK_H
 #include <map>
+#include <array>
+#include <memory>
+#include <limits>
 #include <vector>
 #include <string>
+#include <optional>
 #include <functional>
 #include <stdexcept>
 #include <type_traits>
 
 #include "sbnana/CAFAna/Core/MultiVar.h"
 #include "configuration.h"
+#include "memo.h"
 
 /**
  * @brief Type aliases for the event types used in the framework.
@@ -34,6 +39,8 @@ using SpillType = caf::Proxy<caf::SRBNBInfo>;
 
 using NamedSpillMultiVar = std::pair<std::string, ana::SpillMultiVar>;
 
+namespace matching { class Policy; }
+
 // Set a sensible default for a no-match scenario.
 constexpr size_t kNoMatch = std::numeric_limits<size_t>::max();
 constexpr double kNoMatchValue = std::numeric_limits<double>::quiet_NaN();
@@ -147,6 +154,25 @@ using VarFactory = std::function<VarFn<EventT>(const std::vector<double>&)>;
 template<typename EventT>
 using VarFactoryRegistry = Registry<VarFactory<EventT>>;
 
+/**
+ * @struct MultiVar
+ * @brief A multi-output variable: a fixed-size tuple of values computed from
+ * the same intermediate quantities (e.g., the components of the momentum).
+ * @details The tuple and each of its components are registered as regular
+ * variables (see @ref register_multivar), so the registry only keeps the
+ * names of the components, which @ref construct uses to fill one branch per
+ * component from a single branch configuration naming the variable.
+ * @tparam EventT The type of object the variable is applied to.
+ */
+template<typename EventT>
+struct MultiVar
+{
+    std::vector<std::string> components; ///< The names of the components (without prefix).
+};
+
+template<typename EventT>
+using MultiVarRegistry = Registry<MultiVar<EventT>>;
+
 /**
  * @brief A factory function: given params, returns a SelectorFn<EventT>
  */
@@ -162,7 +188,9 @@ using SelectorFactoryRegistry = Registry<SelectorFactory<EventT>>;
  * std::is_invocable_v to check if the function can accept a vector of
  * parameters; if so, it binds the function with the parameters. In either
  * case, it returns a std::function<ValueT(const EventT&)> that can be used to
- * apply the function to an event.
+ * apply the function to an event. The bound function is evaluated through the
+ * per-spill memoization context (see @ref memo::cached), so the result for a
+ * given object and parameter set is computed at most once per spill.
  * @tparam F The function to bind.
  * @tparam EventT The type of event: @ref TType or @ref RType.
  * @tparam ValueT The return type of the function.
@@ -174,9 +202,181 @@ template<auto F, typename EventT, typename ValueT>
 inline std::function<ValueT(const EventT&)> bind(const std::vector<double>& pars)
 {
     if constexpr(std::is_invocable_v<decltype(F), const EventT&, const std::vector<double>&>)
-        return [pars](const EventT& e){ return F(e, pars); };
+        return [pars](const EventT& e){ return memo::cached<F>(e, pars); };
     else
-        return [=](const EventT& e){ return F(e); };
+        return [=](const EventT& e){ return memo::cached<F>(e); };
+}
+
+/**
+ * @brief Get the qualified C++ name of a function.
+ * @details The name is extracted from the signature of this function as
+ * reported by the compiler (__PRETTY_FUNCTION__), which spells out the
+ * template argument @p F. For a function template instantiation, this
+ * includes the template arguments (e.g., "cuts::fiducial_cut<caf::Proxy<...>
+ * >"), so the name can be used to refer to the same function in generated
+ * code (see @ref codegen).
+ * @tparam F The function.
+ * @return The qualified name of the function.
+ */
+template<auto F>
+std::string symbol_name()
+{
+    const std::string pretty(__PRETTY_FUNCTION__);
+    size_t start(pretty.find("F = "));
+    if(start == std::string::npos)
+        return "";
+    start += 4;
+    if(pretty[start] == '&')
+        ++start;
+    int depth(0);
+    size_t end(start);
+    for(; end < pretty.size(); ++end)
+    {
+        const char c(pretty[end]);
+        if(c == '<' || c == '(') ++depth;
+        else if(c == '>' || c == ')') --depth;
+        else if(depth == 0 && (c == ']' || c == ';')) break;
+    }
+    std::string name(pretty.substr(start, end - start));
+    for(const std::string anonymous : {"{anonymous}::", "(anonymous namespace)::"})
+        for(size_t pos(name.find(anonymous)); pos != std::string::npos; pos = name.find(anonymous))
+            name.erase(pos, anonymous.size());
+    return name;
+}
+
+/**
+ * @brief Get the name of a framework type as used in generated code.
+ * @tparam T The type (one of the type aliases of the framework).
+ * @return The name of the type alias (e.g., "TType").
+ */
+template<typename T>
+constexpr const char * type_key()
+{
+    if constexpr(std::is_same_v<T, TType>) return "TType";
+    else if constexpr(std::is_same_v<T, RType>) return "RType";
+    else if constexpr(std::is_same_v<T, MCTruth>) return "MCTruth";
+    else if constexpr(std::is_same_v<T, TParticleType>) return "TParticleType";
+    else if constexpr(std::is_same_v<T, RParticleType>) return "RParticleType";
+    else if constexpr(std::is_same_v<T, EventType>) return "EventType";
+    else if constexpr(std::is_same_v<T, SpillType>) return "SpillType";
+    else if constexpr(std::is_same_v<T, bool>) return "bool";
+    else if constexpr(std::is_same_v<T, double>) return "double";
+    else return "size_t";
+}
+
+/**
+ * @brief Registry of the qualified C++ names of the registered functions.
+ * @details The registry maps "<value type>/<object type>/<name>" (e.g.,
+ * "bool/TType/true_fiducial_cut") to "<qualified name>|<p>", where p is 1 if
+ * the function takes a parameter vector and 0 otherwise. It is used to
+ * generate code calling the registered functions directly (see
+ * @ref codegen).
+ */
+using SymbolRegistry = Registry<std::string>;
+
+/**
+ * @brief Register a function under the specified name.
+ * @details This registers the factory binding the function to a parameter set
+ * (see @ref bind) and the qualified name of the function (see
+ * @ref SymbolRegistry).
+ * @tparam F The function to register.
+ * @tparam EventT The type of object the function is applied to.
+ * @tparam ValueT The return type of the function (bool for cuts, double for
+ * variables, and size_t for selectors).
+ * @param name The name to register the function under.
+ * @return void
+ * @throw std::runtime_error if the name is already registered.
+ */
+template<auto F, typename EventT, typename ValueT>
+void register_function(const std::string & name)
+{
+    using FactoryT = std::function<std::function<ValueT(const EventT&)>(const std::vector<double>&)>;
+    Registry<FactoryT>::instance().register_fn(name, bind<F, EventT, ValueT>);
+    constexpr bool parametrized(std::is_invocable_v<decltype(F), const EventT&, const std::vector<double>&>);
+    SymbolRegistry::instance().register_fn(std::string(type_key<ValueT>()) + "/" + type_key<EventT>() + "/" + name,
+                                           symbol_name<F>() + (parametrized ? "|1" : "|0"));
+}
+
+/**
+ * @brief Check if the components of the multi-output variables share a single
+ * evaluation of their tuple.
+ * @details See @ref set_shared_multivars.
+ * @return True if the tuples are shared.
+ */
+bool shared_multivars();
+
+/**
+ * @brief Get the rows of the multi-output variable being evaluated.
+ * @details The tuple variable of a multi-output variable (see
+ * @ref register_multivar) appends each tuple it computes to the rows of the
+ * calling thread and returns the index of the row instead of a value. The
+ * rows are installed by @ref construct around the evaluation of the single
+ * SpillMultiVar of the variable, whose output is then split into one column
+ * per component.
+ * @return A reference to the rows of the calling thread (null outside the
+ * evaluation of a multi-output variable).
+ */
+std::vector<std::vector<double>> *& multivar_rows();
+
+/**
+ * @brief Register a multi-output variable under the specified name.
+ * @details The function returns a std::array<double, N> of the components.
+ * The tuple is registered as a variable under the name of the multi-output
+ * variable, which appends the tuple to the rows of the calling thread (see
+ * @ref multivar_rows) and returns its index; @ref construct uses it to fill
+ * all component branches from one evaluation of the function per object and
+ * spill. Each component is also registered as a scalar variable under the
+ * name of the component, for the configurations naming the components one
+ * at a time. It evaluates the tuple through the per-spill memoization
+ * context (see @ref memo::cached) and returns its element, so the components
+ * of an object cost a single evaluation of the function between them (or
+ * one evaluation each on the reference path, see
+ * @ref set_shared_multivars). None of these has a
+ * symbol, so they stay on the interpreted path of the generated selection
+ * libraries (see @ref codegen).
+ * @tparam F The function returning the tuple.
+ * @tparam EventT The type of object the function is applied to.
+ * @tparam N The number of components.
+ * @param prefix The prefix of the record type (e.g., "reco_particle_").
+ * @param name The name of the multi-output variable.
+ * @param components The names of the components.
+ * @return void
+ * @throw std::runtime_error if a name is already registered.
+ */
+template<auto F, typename EventT, size_t N>
+void register_multivar(const std::string & prefix, const std::string & name, const std::array<const char *, N> & components)
+{
+    constexpr bool parametrized(std::is_invocable_v<decltype(F), const EventT&, const std::vector<double>&>);
+    auto row = [](const std::array<double, N> & tuple) -> double
+    {
+        std::vector<std::vector<double>> * rows(multivar_rows());
+        if(rows == nullptr)
+            throw std::runtime_error("The tuple of a multi-output variable is evaluated outside of its branches.");
+        rows->emplace_back(tuple.begin(), tuple.end());
+        return static_cast<double>(rows->size() - 1);
+    };
+    VarFactoryRegistry<EventT>::instance().register_fn(prefix + name, [row](const std::vector<double> & pars) -> VarFn<EventT>
+    {
+        if constexpr(parametrized)
+            return [pars, row](const EventT & e) -> double { return row(memo::cached<F>(e, pars)); };
+        else
+            return [row](const EventT & e) -> double { return row(memo::cached<F>(e)); };
+    });
+
+    MultiVar<EventT> multivar;
+    for(size_t k(0); k < N; ++k)
+    {
+        multivar.components.emplace_back(components[k]);
+        VarFactoryRegistry<EventT>::instance().register_fn(prefix + components[k], [k](const std::vector<double> & pars) -> VarFn<EventT>
+        {
+            const bool shared(shared_multivars());
+            if constexpr(parametrized)
+                return [pars, k, shared](const EventT & e) -> double { return shared ? memo::cached<F>(e, pars)[k] : F(e, pars)[k]; };
+            else
+                return [k, shared](const EventT & e) -> double { return shared ? memo::cached<F>(e)[k] : F(e)[k]; };
+        });
+    }
+    MultiVarRegistry<EventT>::instance().register_fn(prefix + name, std::move(multivar));
 }
 
 /**
@@ -190,35 +390,74 @@ enum class RegistrationScope { True, Reco, Both, MCTruth,
                                TrueParticle, RecoParticle, BothParticle,
                                Event, Spill };
 
+/**
+ * @brief Check if a file is a given header.
+ * @param file The path of the file (e.g., __FILE__).
+ * @param header The name of the header (e.g., "cuts.h" or
+ * "muon2024/cuts_muon2024.h").
+ * @return True if the path is the header or ends with "/<header>".
+ */
+constexpr bool registers_header(const char * file, const char * header)
+{
+    size_t nf(0), nh(0);
+    while(file[nf] != '\0') ++nf;
+    while(header[nh] != '\0') ++nh;
+    if(nf < nh || (nf > nh && file[nf - nh - 1] != '/'))
+        return false;
+    for(size_t i(0); i < nh; ++i)
+        if(file[nf - nh + i] != header[i])
+            return false;
+    return true;
+}
+
+/**
+ * @brief Restrict the registration to one header and one record type.
+ * @details The cuts and variables are registered by a set of translation
+ * units, one per header and record type (see src/registrations/), so that
+ * they compile in parallel and a change to one header only recompiles its own
+ * units. Each unit defines SPINE_REGISTER_HEADER (the name of the header) and
+ * SPINE_REGISTER_TYPE (the record type) before including the header. The
+ * registration macros then skip (and do not instantiate) the functions of the
+ * other headers it includes and of the other record types. Without these
+ * definitions, everything is registered.
+ */
+#if defined(SPINE_REGISTER_HEADER) && defined(SPINE_REGISTER_TYPE)
+#define SPINE_REGISTERS(T) (registers_header(__FILE__, SPINE_REGISTER_HEADER) && std::is_same_v<T, SPINE_REGISTER_TYPE>)
+#else
+#define SPINE_REGISTERS(T) true
+#endif
+
+/**
+ * @brief Registration macros.
+ * @details Defining SPINE_NO_REGISTRATION before including the headers of the
+ * cuts and variables disables their registration. This is used by code that
+ * only needs the declarations (e.g., the main program or generated code, see
+ * @ref codegen), which is linked to or loaded into a process that registers
+ * them through the registration library.
+ */
+#ifdef SPINE_NO_REGISTRATION
+#define REGISTER_CUT_SCOPE(scope, name, fn)
+#define REGISTER_VAR_SCOPE(scope, name, fn)
+#define REGISTER_MULTIVAR_SCOPE(scope, name, fn, ...)
+#define REGISTER_SELECTOR(name, fn)
+#else
 // Register a cut with scope, auto‐detecting its signature
 #define REGISTER_CUT_SCOPE(scope, name, fn)                                                \
 namespace                                                                                  \
 {                                                                                          \
     const bool _reg_cut_##name = []{                                                       \
-        if constexpr((scope)==RegistrationScope::True || (scope)==RegistrationScope::Both) \
-            CutFactoryRegistry<TType>::instance().register_fn(                             \
-                "true_" #name, bind<+fn<TType>, TType, bool>                               \
-            );                                                                             \
-        if constexpr((scope)==RegistrationScope::Reco || (scope)==RegistrationScope::Both) \
-            CutFactoryRegistry<RType>::instance().register_fn(                             \
-                "reco_" #name, bind<+fn<RType>, RType, bool>                               \
-            );                                                                             \
-        if constexpr((scope)==RegistrationScope::TrueParticle || (scope)==RegistrationScope::BothParticle) \
-            CutFactoryRegistry<TParticleType>::instance().register_fn(                     \
-                "true_particle_" #name, bind<+fn<TParticleType>, TParticleType, bool>      \
-            );                                                                             \
-        if constexpr((scope)==RegistrationScope::RecoParticle || (scope)==RegistrationScope::BothParticle) \
-            CutFactoryRegistry<RParticleType>::instance().register_fn(                     \
-                "reco_particle_" #name, bind<+fn<RParticleType>, RParticleType, bool>      \
-            );                                                                             \
-        if constexpr((scope)==RegistrationScope::Event)                                    \
-            CutFactoryRegistry<EventType>::instance().register_fn(                         \
-                "event_" #name, bind<+fn<EventType>, EventType, bool>                      \
-            );                                                                             \
-        if constexpr((scope)==RegistrationScope::Spill)                                    \
-            CutFactoryRegistry<SpillType>::instance().register_fn(                         \
-                "spill_" #name, bind<+fn<SpillType>, SpillType, bool>                      \
-            );                                                                             \
+        if constexpr(SPINE_REGISTERS(TType) && ((scope)==RegistrationScope::True || (scope)==RegistrationScope::Both)) \
+            register_function<+fn<TType>, TType, bool>("true_" #name);                     \
+        if constexpr(SPINE_REGISTERS(RType) && ((scope)==RegistrationScope::Reco || (scope)==RegistrationScope::Both)) \
+            register_function<+fn<RType>, RType, bool>("reco_" #name);                     \
+        if constexpr(SPINE_REGISTERS(TParticleType) && ((scope)==RegistrationScope::TrueParticle || (scope)==RegistrationScope::BothParticle)) \
+            register_function<+fn<TParticleType>, TParticleType, bool>("true_particle_" #name); \
+        if constexpr(SPINE_REGISTERS(RParticleType) && ((scope)==RegistrationScope::RecoParticle || (scope)==RegistrationScope::BothParticle)) \
+            register_function<+fn<RParticleType>, RParticleType, bool>("reco_particle_" #name); \
+        if constexpr(SPINE_REGISTERS(EventType) && ((scope)==RegistrationScope::Event))    \
+            register_function<+fn<EventType>, EventType, bool>("event_" #name);            \
+        if constexpr(SPINE_REGISTERS(SpillType) && ((scope)==RegistrationScope::Spill))    \
+            register_function<+fn<SpillType>, SpillType, bool>("spill_" #name);            \
         return true;                                                                       \
     }();                                                                                   \
 }
@@ -228,30 +467,41 @@ namespace
 namespace                                                                                  \
 {                                                                                          \
     const bool _reg_var_##name = []{                                                       \
-        if constexpr((scope)==RegistrationScope::True || (scope)==RegistrationScope::Both) \
-            VarFactoryRegistry<TType>::instance().register_fn(                             \
-                "true_" #name, bind<fn<TType>, TType, double>                              \
-            );                                                                             \
-        if constexpr((scope)==RegistrationScope::Reco || (scope)==RegistrationScope::Both) \
-            VarFactoryRegistry<RType>::instance().register_fn(                             \
-                "reco_" #name, bind<fn<RType>, RType, double>                              \
-            );                                                                             \
-        if constexpr((scope)==RegistrationScope::MCTruth)                                  \
-            VarFactoryRegistry<MCTruth>::instance().register_fn(                           \
-                "true_" #name, bind<fn<MCTruth>, MCTruth, double>                          \
-            );                                                                             \
-        if constexpr((scope)==RegistrationScope::TrueParticle || (scope)==RegistrationScope::BothParticle) \
-            VarFactoryRegistry<TParticleType>::instance().register_fn(                     \
-                "true_particle_" #name, bind<fn<TParticleType>, TParticleType, double>     \
-            );                                                                             \
-        if constexpr((scope)==RegistrationScope::RecoParticle || (scope)==RegistrationScope::BothParticle) \
-            VarFactoryRegistry<RParticleType>::instance().register_fn(                     \
-                "reco_particle_" #name, bind<fn<RParticleType>, RParticleType, double>     \
-            );                                                                             \
-        if constexpr((scope)==RegistrationScope::Event)                                    \
-            VarFactoryRegistry<EventType>::instance().register_fn(                         \
-                "event_" #name, bind<fn<EventType>, EventType, double>                     \
-            );                                                                             \
+        if constexpr(SPINE_REGISTERS(TType) && ((scope)==RegistrationScope::True || (scope)==RegistrationScope::Both)) \
+            register_function<fn<TType>, TType, double>("true_" #name);                    \
+        if constexpr(SPINE_REGISTERS(RType) && ((scope)==RegistrationScope::Reco || (scope)==RegistrationScope::Both)) \
+            register_function<fn<RType>, RType, double>("reco_" #name);                    \
+        if constexpr(SPINE_REGISTERS(MCTruth) && ((scope)==RegistrationScope::MCTruth))    \
+            register_function<fn<MCTruth>, MCTruth, double>("true_" #name);                \
+        if constexpr(SPINE_REGISTERS(TParticleType) && ((scope)==RegistrationScope::TrueParticle || (scope)==RegistrationScope::BothParticle)) \
+            register_function<fn<TParticleType>, TParticleType, double>("true_particle_" #name); \
+        if constexpr(SPINE_REGISTERS(RParticleType) && ((scope)==RegistrationScope::RecoParticle || (scope)==RegistrationScope::BothParticle)) \
+            register_function<fn<RParticleType>, RParticleType, double>("reco_particle_" #name); \
+        if constexpr(SPINE_REGISTERS(EventType) && ((scope)==RegistrationScope::Event))    \
+            register_function<fn<EventType>, EventType, double>("event_" #name);           \
+        return true;                                                                       \
+    }();                                                                                   \
+}
+
+// Register a multi-output variable with scope. The trailing arguments are the
+// names of the components, in the order of the returned tuple.
+#define REGISTER_MULTIVAR_SCOPE(scope, name, fn, ...)                                      \
+namespace                                                                                  \
+{                                                                                          \
+    const bool _reg_multivar_##name = []{                                                  \
+        constexpr std::array components{__VA_ARGS__};                                      \
+        if constexpr(SPINE_REGISTERS(TType) && ((scope)==RegistrationScope::True || (scope)==RegistrationScope::Both)) \
+            register_multivar<fn<TType>, TType>("true_", #name, components);               \
+        if constexpr(SPINE_REGISTERS(RType) && ((scope)==RegistrationScope::Reco || (scope)==RegistrationScope::Both)) \
+            register_multivar<fn<RType>, RType>("reco_", #name, components);               \
+        if constexpr(SPINE_REGISTERS(MCTruth) && ((scope)==RegistrationScope::MCTruth))    \
+            register_multivar<fn<MCTruth>, MCTruth>("true_", #name, components);           \
+        if constexpr(SPINE_REGISTERS(TParticleType) && ((scope)==RegistrationScope::TrueParticle || (scope)==RegistrationScope::BothParticle)) \
+            register_multivar<fn<TParticleType>, TParticleType>("true_particle_", #name, components); \
+        if constexpr(SPINE_REGISTERS(RParticleType) && ((scope)==RegistrationScope::RecoParticle || (scope)==RegistrationScope::BothParticle)) \
+            register_multivar<fn<RParticleType>, RParticleType>("reco_particle_", #name, components); \
+        if constexpr(SPINE_REGISTERS(EventType) && ((scope)==RegistrationScope::Event))    \
+            register_multivar<fn<EventType>, EventType>("event_", #name, components);      \
         return true;                                                                       \
     }();                                                                                   \
 }
@@ -262,15 +512,15 @@ namespace
 namespace                                                                                  \
 {                                                                                          \
     const bool _reg_selector_##name = []{                                                  \
-        SelectorFactoryRegistry<TType>::instance().register_fn(                            \
-            "true_" #name, bind<fn<TType>, TType, size_t>                                  \
-        );                                                                                 \
-        SelectorFactoryRegistry<RType>::instance().register_fn(                            \
-            "reco_" #name, bind<fn<RType>, RType, size_t>                                  \
-        );                                                                                 \
+        if constexpr(SPINE_REGISTERS(TType))                                               \
+            register_function<fn<TType>, TType, size_t>("true_" #name);                    \
+        if constexpr(SPINE_REGISTERS(RType))                                               \
+            register_function<fn<RType>, RType, size_t>("reco_" #name);                    \
         return true;                                                                       \
     }();                                                                                   \
 }
+#endif // SPINE_NO_REGISTRATION
+
 
 /**
  * @brief Operation mode for iteration over data products.
@@ -282,10 +532,56 @@ namespace
 enum class Mode { True = 0, Reco = 1, Event = 2 };
 
 /**
- * @brief Build a single SpillMultiVar for a single branch variable.
+ * @struct ComputeIf
+ * @brief Conditions gating the evaluation of a branch variable.
+ * @details Expensive variables (e.g., selector-based particle variables) are
+ * often only of interest for a sub-category of the rows of a tree. A branch
+ * may therefore carry an optional list of "compute_if" cuts: the row is still
+ * written, but the variable is only evaluated if the cuts pass and is set to
+ * kNoMatchValue otherwise. The cuts on the interactions are applied to the
+ * interaction of the row or to its match, whichever has the type of the cut.
+ * The registered cuts are memoized per spill, so cuts shared with the tree
+ * selection are not evaluated a second time.
+ */
+struct ComputeIf
+{
+    std::optional<CutFn<TType>> true_cut;       ///< The cut on the true interaction (if any).
+    std::optional<CutFn<RType>> reco_cut;       ///< The cut on the reco interaction (if any).
+    std::optional<CutFn<EventType>> event_cut;  ///< The cut on the spill (if any).
+
+    /**
+     * @brief Check if the conditions pass for a row.
+     * @param sr The spill.
+     * @param obj The interaction of the row.
+     * @param match_id The index of the matched interaction in the
+     * complementary collection (or kNoMatch).
+     * @return True if the variable should be evaluated.
+     */
+    bool passes(const EventType & sr, const TType & obj, size_t match_id) const;
+
+    /**
+     * @brief Check if the conditions pass for a row.
+     * @param sr The spill.
+     * @param obj The interaction of the row.
+     * @param match_id The index of the matched interaction in the
+     * complementary collection (or kNoMatch).
+     * @return True if the variable should be evaluated.
+     */
+    bool passes(const EventType & sr, const RType & obj, size_t match_id) const;
+};
+
+/**
+ * @brief Build the SpillMultiVars of the branches of a branch variable.
  * @details Applies the sequence of Cuts from @p cuts to select events, then
  * computes the variable as defined by @p var. Handles "true" and "reco" types
- * by prefixing the branch name and selecting the appropriate event types.
+ * by prefixing the branch name and selecting the appropriate event types. A
+ * branch variable naming a multi-output variable (see @ref MultiVar) fills
+ * one branch per component, named as if each component had been configured
+ * separately (e.g., "momentum" fills "reco_particle_px," "reco_particle_py,"
+ * and "reco_particle_pz"); all other variables fill a single branch. The
+ * branches of a multi-output variable are split from the output of a single
+ * SpillMultiVar, which evaluates the tuple once per selected object and
+ * spill (see @ref set_shared_multivars).
  * @param cuts Vector of [[tree.cut]] subtables with fields:
  *        - name:       string (base cut name)
  *        - type:       string ("true" or "reco")
@@ -294,17 +590,49 @@ enum class Mode { True = 0, Reco = 1, Event = 2 };
  *        - name:       string (base variable name)
  *        - type:       string ("true" or "reco")
  *        - parameters: array of floats (parameters for the variable)
+ *        - compute_if: optional list of cut subtables (types "true," "reco,"
+ *          "event," or "spill") gating the evaluation (see @ref ComputeIf)
  * @param mode The mode to use for the main loop ("true" or "reco").
  * @param override_type The type to use for the variable ("true" or "reco").
  * @param ismc A boolean indicating whether the data is MC (true) or not (false).
- * @return A NamedSpillMultiVar object that applies the cuts and computes the variable.
+ * @param policy The truth-reco interaction matching policy (see
+ * @ref matching::get_policy). The default policy is used if null.
+ * @return The NamedSpillMultiVar objects that apply the cuts and compute the
+ * variable (one per branch).
  * @throw std::runtime_error if a function is not registered.
  */
-NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
-                             const cfg::ConfigurationTable & var,
-                             const std::string & mode,
-                             const std::string & override_type = "",
-                             const bool ismc = true);
+std::vector<NamedSpillMultiVar> construct(const std::vector<cfg::ConfigurationTable> & cuts,
+                                          const cfg::ConfigurationTable & var,
+                                          const std::string & mode,
+                                          const std::string & override_type = "",
+                                          const bool ismc = true,
+                                          const std::shared_ptr<const matching::Policy> & policy = nullptr);
+
+/**
+ * @brief Build the SpillMultiVar of a single branch.
+ * @details This function is intended to be called by the @ref construct
+ * function, once for each branch of the branch variable. The variable is
+ * looked up by @p name instead of the name of @p var, which otherwise
+ * configures the branch (type, parameters, selector, and compute_if).
+ * @param cuts Vector of [[tree.cut]] subtables (see @ref construct).
+ * @param var [[tree.variable]] subtable (see @ref construct).
+ * @param name The base name of the variable of the branch.
+ * @param mode The mode to use for the main loop ("true" or "reco").
+ * @param override_type The type to use for the variable ("true" or "reco").
+ * @param ismc A boolean indicating whether the data is MC (true) or not (false).
+ * @param policy The truth-reco interaction matching policy (see
+ * @ref matching::get_policy). The default policy is used if null.
+ * @return The NamedSpillMultiVar object that applies the cuts and computes
+ * the variable.
+ * @throw std::runtime_error if a function is not registered.
+ */
+NamedSpillMultiVar construct_branch(const std::vector<cfg::ConfigurationTable> & cuts,
+                                    const cfg::ConfigurationTable & var,
+                                    const std::string & name,
+                                    const std::string & mode,
+                                    const std::string & override_type = "",
+                                    const bool ismc = true,
+                                    const std::shared_ptr<const matching::Policy> & policy = nullptr);
 
 /**
  * @brief Helper method for constructing a SpillMultiVar object.
@@ -332,6 +660,16 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
  * @param var The callable that implements the variable on the selected branch.
  * @param event_cut The callable that implements the event cut.
  * @param ismc A boolean indicating whether the data is MC (true) or not (false).
+ * @param policy The truth-reco interaction matching policy used to pair the
+ * broadcast interactions with the complementary collection. The default
+ * policy is used if null.
+ * @param compute_if The conditions gating the evaluation of the variable
+ * (none if null).
+ * @param selection The key of the cut program (see @ref construct). Branch
+ * variables with the same non-empty key share a single selection, which
+ * evaluates the cuts once per spill and caches the indices of the selected
+ * interactions. Each variable then loops over the selected interactions only.
+ * An empty key gives the variable its own selection.
  * @return A SpillMultiVar object that applies the cuts and computes the variable.
  */
 template<typename CutsOn, typename CompsOn, typename PCutsOn, typename VarOn>
@@ -341,9 +679,37 @@ ana::SpillMultiVar spill_multivar_helper(
     const CutFn<PCutsOn> & pcuts,
     const VarFn<VarOn> & var,
     const CutFn<EventType> & event_cut,
-    const bool ismc = true
+    const bool ismc = true,
+    const std::shared_ptr<const matching::Policy> & policy = nullptr,
+    const std::shared_ptr<const ComputeIf> & compute_if = nullptr,
+    const std::string & selection = ""
 );
 
+/**
+ * @brief Enable or disable the sharing of the selections between the branch
+ * variables of a tree.
+ * @details The sharing is enabled by default. Disabling it evaluates the cuts
+ * separately for each branch variable, as a reference for benchmarking.
+ * @param enabled Whether the selections are shared.
+ * @return void
+ */
+void set_shared_selections(bool enabled);
+
+/**
+ * @brief Enable or disable the sharing of the tuples of the multi-output
+ * variables between their components.
+ * @details The sharing is enabled by default: the branches of a multi-output
+ * variable are split from one SpillMultiVar producing all components, and
+ * the components configured one at a time read the tuple memoized per object
+ * and spill. Disabling it builds one SpillMultiVar per component, each
+ * evaluating the tuple for its own element, as the scalar variables of the
+ * families did, as a reference for benchmarking. The setting applies to the
+ * branches built after the call.
+ * @param enabled Whether the tuples are shared.
+ * @return void
+ */
+void set_shared_multivars(bool enabled);
+
 /**
  * @brief Helper method for constructing a SpillMultiVar object when run in the
  * "event" mode.
@@ -352,10 +718,13 @@ ana::SpillMultiVar spill_multivar_helper(
  * when the mode is "event". 
  * @param cut The callable that implements the event cut.
  * @param var The callable that implements the event variable.
+ * @param compute_if The conditions gating the evaluation of the variable
+ * (none if null). Only the event cut is used in this mode.
  * @return A SpillMultiVar object that applies the cuts and computes the event
  * variable.
  */
-ana::SpillMultiVar spill_multivar_helper(const CutFn<EventType> & cut, const VarFn<EventType> & var);
+ana::SpillMultiVar spill_multivar_helper(const CutFn<EventType> & cut, const VarFn<EventType> & var,
+                                         const std::shared_ptr<const ComputeIf> & compute_if = nullptr);
 
 /**
  * @brief Helper method for constructing a set of SpillMultiVar objects that
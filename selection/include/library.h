@@ -0,0 +1,30 @@
+/**
+ * @file library.h
+ * @brief Header file collecting the cuts, variables, and selectors available
+ * to the configuration of the SPINE analysis framework.
+ * @details Including this file registers all cuts, variables, and selectors
+ * (see @ref REGISTER_CUT_SCOPE) unless SPINE_NO_REGISTRATION is defined first.
+ * It is included by the generated selection libraries (see @ref codegen),
+ * which call the functions directly. The registrations themselves are made
+ * by the registration library (see src/registrations/), one translation unit
+ * per header and record type.
+ * @author mueller@fnal.gov
+ */
+#ifndef LIBRARY_H
+#define LIBRARY_H
+#include "definitions.h"
+
+#include "sbnanaobj/StandardRecord/Proxy/SRProxy.h"
+
+#include "framework.h"
+#include "scorers.h"
+#include "cuts.h"
+#include "muon2024/cuts_muon2024.h"
+#include "variables.h"
+#include "muon2024/variables_muon2024.h"
+#include "mctruth.h"
+#include "event_cuts.h"
+#include "event_variables.h"
+#include "spill_cuts.h"
+#include "selectors.h"
+#endif // LIBRARY_H
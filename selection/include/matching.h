@@ -0,0 +1,140 @@
+/**
+ * @file matching.h
+ * @brief Header file declaring the spill-level truth-reco interaction
+ * matching engine of the SPINE analysis framework.
+ * @details SPINE stores, for each true (reco) interaction, the list of
+ * overlapping reco (true) interactions along with their overlaps. The loops
+ * in @ref spill_multivar_helper need a single match for each interaction. The
+ * matching engine derives this match from the overlap data according to a
+ * configurable policy, once per spill, and caches the result as a pair of
+ * index arrays that are shared by all trees and variables using the same
+ * policy. The supported policies are:
+ * - "first": the first listed match (SPINE orders the matches by overlap).
+ * - "iou": the best match with an overlap of at least the threshold.
+ * - "one_to_one": the one-to-one assignment maximizing the total overlap,
+ *   restricted to pairs with an overlap of at least the threshold.
+ * - "best_energy": among the matches with an overlap of at least the
+ *   threshold, the one closest in energy to the interaction.
+ * @author mueller@fnal.gov
+ */
+#ifndef MATCHING_H
+#define MATCHING_H
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+
+#include "framework.h"
+
+/**
+ * @namespace matching
+ * @brief Namespace for the truth-reco interaction matching engine.
+ */
+namespace matching
+{
+    /**
+     * @enum Kind
+     * @brief The matching policies supported by the engine.
+     */
+    enum class Kind { First = 0, IoU = 1, OneToOne = 2, BestEnergy = 3 };
+
+    /**
+     * @struct Matching
+     * @brief The result of the matching for a single spill.
+     * @details The index arrays map the index of each true (reco)
+     * interaction to the index of its matched reco (true) interaction, or to
+     * @ref kNoMatch if there is no match. The indices are guaranteed to be
+     * valid indices into the respective collections of the spill.
+     */
+    struct Matching
+    {
+        std::vector<size_t> true_to_reco;
+        std::vector<size_t> reco_to_true;
+    };
+
+    /**
+     * @class Policy
+     * @brief A configured matching policy.
+     * @details Policies are created through @ref get_policy, which returns a
+     * single shared instance per configuration. The result of the matching is
+     * cached per policy and per spill, so all trees and variables using the
+     * same configuration share a single evaluation per spill.
+     */
+    class Policy
+    {
+        public:
+            /**
+             * @brief Constructor for the Policy class.
+             * @param kind The kind of the policy.
+             * @param threshold The minimum overlap for a pair to be matched.
+             * @param true_energy The energy of a true interaction (used by
+             * the "best_energy" policy only).
+             * @param reco_energy The energy of a reco interaction (used by
+             * the "best_energy" policy only).
+             */
+            Policy(Kind kind, double threshold, VarFn<TType> true_energy, VarFn<RType> reco_energy);
+
+            /**
+             * @brief Get the matching for the spill.
+             * @details The matching is computed on the first call for a spill
+             * and cached until the memoization context moves to the next
+             * spill (see @ref memo::SpillContext::begin_spill).
+             * @param sr The record of the spill.
+             * @return The matching for the spill.
+             */
+            const Matching & match(const EventType & sr) const;
+
+            /**
+             * @brief Get the kind of the policy.
+             * @return The kind of the policy.
+             */
+            Kind kind() const { return kind_; }
+
+        private:
+            void compute(const EventType & sr, Matching & result) const;
+
+            Kind kind_;
+            double threshold_;
+            VarFn<TType> true_energy_;
+            VarFn<RType> reco_energy_;
+    };
+
+    /**
+     * @brief Get the shared policy for a configuration.
+     * @details The policy is parsed from @p name. Repeated calls with the
+     * same configuration return the same instance, which allows the matching
+     * to be shared across trees.
+     * @param name The name of the policy ("first", "iou", "one_to_one", or
+     * "best_energy").
+     * @param threshold The minimum overlap for a pair to be matched.
+     * @param energy The name of the (registered) interaction variable used as
+     * the energy by the "best_energy" policy.
+     * @return The shared policy.
+     * @throw std::runtime_error if the policy name is not recognized or the
+     * energy variable is not registered.
+     */
+    std::shared_ptr<const Policy> get_policy(const std::string & name, double threshold = 0, const std::string & energy = "visible_energy");
+
+    /**
+     * @brief Get the shared policy reproducing the historical behavior.
+     * @details This is the "first" policy with no overlap threshold, which
+     * matches every interaction to the first entry of its match list.
+     * @return The shared default policy.
+     */
+    std::shared_ptr<const Policy> default_policy();
+
+    /**
+     * @brief Solve the assignment problem maximizing the total weight.
+     * @details The weights form a dense @p nrows x @p ncols matrix in
+     * row-major order. The Hungarian (Kuhn-Munkres) algorithm is used with
+     * O(n^2 m) complexity, which is negligible for the handful of
+     * interactions in a spill. Pairs with a weight of zero are never
+     * assigned.
+     * @param weights The row-major weight matrix.
+     * @param nrows The number of rows.
+     * @param ncols The number of columns.
+     * @return The assigned column for each row, or @ref kNoMatch.
+     */
+    std::vector<size_t> assign(const std::vector<double> & weights, size_t nrows, size_t ncols);
+}
+#endif // MATCHING_H
@@ -0,0 +1,290 @@
+/**
+ * @file memo.h
+ * @brief Header file declaring the per-spill memoization context used by the
+ * SPINE analysis framework.
+ * @details Registered cuts and variables frequently call each other (e.g.,
+ * @ref vars::pn calls @ref vars::dpT and @ref vars::dpL, the muon2024
+ * categories call the muon2024 cuts, and the topological cuts call
+ * @ref utilities::count_primaries). Without a shared context, each caller
+ * recomputes the same result for the same object. This file declares a small
+ * memoization context that stores the result of any function, keyed by the
+ * function identity, the bound parameters, and the object it was evaluated
+ * on. The context is invalidated by the loaders each time they deliver a new
+ * record, so every result is computed at most once per spill.
+ * @author mueller@fnal.gov
+ */
+#ifndef MEMO_H
+#define MEMO_H
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+
+/**
+ * @namespace memo
+ * @brief Namespace for the per-spill memoization context.
+ * @details This namespace contains the memoization context and the helper
+ * functions used to route the evaluation of a function through it. The
+ * context is thread-local, so each thread that evaluates a spill keeps its own
+ * set of cached results.
+ */
+namespace memo
+{
+    /**
+     * @struct Key
+     * @brief Key identifying a single memoized result.
+     * @details The key is the combination of the function identity, the
+     * object the function was evaluated on, and a hash of the parameters bound
+     * to the function. The address of the object is used as the object index:
+     * the proxy objects of a spill are stable for the lifetime of the spill,
+     * and the cache is cleared before they are reused for the next one (see
+     * @ref SpillContext::begin_spill).
+     */
+    struct Key
+    {
+        const void * fn;
+        const void * obj;
+        uint64_t params;
+        bool operator==(const Key & other) const
+        {
+            return fn == other.fn && obj == other.obj && params == other.params;
+        }
+    };
+
+    /**
+     * @struct KeyHash
+     * @brief Hash functor for the @ref Key struct.
+     */
+    struct KeyHash
+    {
+        size_t operator()(const Key & k) const
+        {
+            uint64_t h(reinterpret_cast<uintptr_t>(k.fn));
+            h ^= reinterpret_cast<uintptr_t>(k.obj) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+            h ^= k.params + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+            return static_cast<size_t>(h);
+        }
+    };
+
+    /**
+     * @brief Hash a parameter vector for use in a @ref Key.
+     * @details The parameters are hashed bitwise using FNV-1a. Parameters are
+     * bound once at configuration time, so bitwise equality is the correct
+     * notion of equality here.
+     * @param params The parameters to hash.
+     * @return The hash of the parameters.
+     */
+    inline uint64_t hash_params(const std::vector<double> & params)
+    {
+        uint64_t h(0xcbf29ce484222325ULL);
+        for(const double & p : params)
+        {
+            uint64_t bits;
+            std::memcpy(&bits, &p, sizeof(bits));
+            for(size_t i(0); i < sizeof(bits); ++i)
+            {
+                h ^= (bits >> (8 * i)) & 0xff;
+                h *= 0x100000001b3ULL;
+            }
+        }
+        return h;
+    }
+
+    /**
+     * @class SpillContext
+     * @brief The per-spill memoization context.
+     * @details This class counts the spills delivered to the calling thread
+     * and keeps a generation counter which is incremented with every new
+     * spill. The typed result stores compare their own generation to the
+     * context generation and clear themselves lazily when it is stale.
+     * The context is thread-local and global, which avoids threading it
+     * through the signature of every registered function.
+     */
+    class SpillContext
+    {
+        public:
+            /**
+             * @brief Get the context of the calling thread.
+             * @return A reference to the thread-local context.
+             */
+            static SpillContext & current();
+
+            /**
+             * @brief Mark the start of the evaluation of a new spill.
+             * @details This function is called by the loaders once per
+             * record, before any cut or variable is evaluated on it (see
+             * ana::Analysis::RunSample and reader::Loader::Go). It increments
+             * the generation counter, invalidating all cached results. The
+             * invalidation is not derived from the content of the record:
+             * the proxies (and the object addresses the results are keyed
+             * by) are reused from record to record, and consecutive records
+             * may share their header and sizes (e.g., duplicated simulation
+             * headers).
+             * @return void
+             */
+            void begin_spill();
+
+            /**
+             * @brief Mark the end of the evaluation of the current spill.
+             * @details This function is called by the loaders after the last
+             * variable of the last tree has been evaluated on a record, and
+             * once more at the end of each sample. It only closes the spill
+             * interval seen by the tracing probes (the cached results stay
+             * valid until the next @ref begin_spill) and does nothing if no
+             * spill is open.
+             * @return void
+             */
+            void end_spill();
+
+            /**
+             * @brief Get the number of the spill being evaluated.
+             * @return The number of spills started on the calling thread
+             * (zero before the first spill).
+             */
+            uint64_t spill() const { return spill_; }
+
+            /**
+             * @brief Force the invalidation of all cached results.
+             * @return void
+             */
+            void invalidate();
+
+            /**
+             * @brief Get the current generation of the context.
+             * @return The current generation counter.
+             */
+            uint64_t generation() const { return generation_; }
+
+            /**
+             * @brief Enable or disable memoization globally.
+             * @details When disabled, @ref cached evaluates the function
+             * directly. This is intended to be used for validation and
+             * benchmarking purposes.
+             * @param enabled Whether memoization is enabled.
+             * @return void
+             */
+            static void set_enabled(bool enabled);
+
+            /**
+             * @brief Check if memoization is enabled.
+             * @return True if memoization is enabled.
+             */
+            static bool enabled();
+
+        private:
+            uint64_t spill_ = 0;
+            bool open_ = false;
+            uint64_t generation_ = 1;
+    };
+
+    /**
+     * @struct Store
+     * @brief The typed store of memoized results.
+     * @tparam ValueT The type of the stored results.
+     */
+    template<typename ValueT>
+    struct Store
+    {
+        uint64_t generation = 0;
+        std::unordered_map<Key, ValueT, KeyHash> values;
+
+        /**
+         * @brief Synchronize the store with the context generation.
+         * @details Clears the store if it was filled during a previous spill.
+         * @param g The current generation of the context.
+         * @return void
+         */
+        void sync(uint64_t g)
+        {
+            if(generation != g)
+            {
+                values.clear();
+                generation = g;
+            }
+        }
+    };
+
+    /**
+     * @brief Get the thread-local store for results of the given type.
+     * @tparam ValueT The type of the stored results.
+     * @return A reference to the thread-local store.
+     */
+    template<typename ValueT>
+    Store<ValueT> & store()
+    {
+        static thread_local Store<ValueT> s;
+        return s;
+    }
+
+    /**
+     * @brief Unique identity of a function used as a template parameter.
+     * @tparam F The function.
+     */
+    template<auto F>
+    struct Tag { static constexpr char id = 0; };
+
+    /**
+     * @brief Evaluate a function through the memoization context.
+     * @details The result of @p F on @p obj (with parameters @p params) is
+     * looked up in the store of the current spill. If it is not present, the
+     * function is evaluated and the result is stored. Functions evaluated
+     * through this helper may themselves use it, so the full call graph of a
+     * registered function is shared between all of its callers.
+     * @tparam F The function to evaluate.
+     * @tparam T The type of the object the function is evaluated on.
+     * @param obj The object to evaluate the function on.
+     * @param params The parameters bound to the function.
+     * @return The (possibly cached) result of the function.
+     */
+    template<auto F, typename T>
+    auto cached(const T & obj, const std::vector<double> & params)
+    {
+        using ValueT = std::decay_t<decltype(F(obj, params))>;
+        if(!SpillContext::enabled())
+            return ValueT(F(obj, params));
+
+        Store<ValueT> & s(store<ValueT>());
+        s.sync(SpillContext::current().generation());
+        const Key key{&Tag<F>::id, &obj, hash_params(params)};
+        auto it(s.values.find(key));
+        if(it != s.values.end())
+            return it->second;
+
+        // The function may itself insert into the store, so the iterator
+        // must not be held across the evaluation.
+        ValueT value(F(obj, params));
+        s.values.emplace(key, value);
+        return value;
+    }
+
+    /**
+     * @brief Evaluate a parameterless function through the memoization
+     * context.
+     * @details See the overload taking parameters. This overload is used for
+     * functions which do not take a parameter vector.
+     * @tparam F The function to evaluate.
+     * @tparam T The type of the object the function is evaluated on.
+     * @param obj The object to evaluate the function on.
+     * @return The (possibly cached) result of the function.
+     */
+    template<auto F, typename T>
+    auto cached(const T & obj)
+    {
+        using ValueT = std::decay_t<decltype(F(obj))>;
+        if(!SpillContext::enabled())
+            return ValueT(F(obj));
+
+        Store<ValueT> & s(store<ValueT>());
+        s.sync(SpillContext::current().generation());
+        const Key key{&Tag<F>::id, &obj, 0};
+        auto it(s.values.find(key));
+        if(it != s.values.end())
+            return it->second;
+
+        ValueT value(F(obj));
+        s.values.emplace(key, value);
+        return value;
+    }
+}
+#endif // MEMO_H
@@ -0,0 +1,168 @@
+/**
+ * @file monitor.h
+ * @brief Header file for the slow-spill detector of the SPINE analysis
+ * framework.
+ * @details Some runs contain outlier spills (e.g., large cosmic pile-up with
+ * thousands of particles) that dominate the wall time of the selection. These
+ * are hard to identify after the fact. The components in this file track the
+ * distribution of the processing time of each output tree, spill by spill,
+ * and record the identity and size statistics of any spill above a
+ * configurable percentile of the distribution. The recorded spills can be
+ * written to a table and, optionally, copied from the input files to a small
+ * CAF file for offline profiling and benchmarking.
+ * @author mueller@fnal.gov
+ */
+#ifndef MONITOR_H
+#define MONITOR_H
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "sbnana/CAFAna/Core/MultiVar.h"
+
+/**
+ * @namespace monitor
+ * @brief Namespace for the slow-spill detector.
+ */
+namespace monitor
+{
+    /**
+     * @class Quantile
+     * @brief Streaming estimate of a quantile using the P² algorithm.
+     * @details The P² algorithm (Jain and Chlamtac, 1985) maintains five
+     * markers whose heights approximate the minimum, the p/2, p, and (1+p)/2
+     * quantiles, and the maximum of the observations, adjusting them with a
+     * piecewise-parabolic interpolation. It uses constant memory and time per
+     * observation.
+     */
+    class Quantile
+    {
+        public:
+            /**
+             * @brief Constructor for the Quantile class.
+             * @param p The quantile to estimate (in (0, 1)).
+             */
+            explicit Quantile(double p);
+
+            /**
+             * @brief Add an observation.
+             * @param x The observation.
+             * @return void
+             */
+            void add(double x);
+
+            /**
+             * @brief Get the current estimate of the quantile.
+             * @return The estimate (exact for fewer than five observations).
+             */
+            double value() const;
+
+            /**
+             * @brief Get the number of observations.
+             * @return The number of observations.
+             */
+            size_t count() const { return count_; }
+
+        private:
+            double p_;
+            size_t count_ = 0;
+            std::array<double, 5> q_;
+            std::array<double, 5> n_;
+            std::array<double, 5> np_;
+            std::array<double, 5> dn_;
+    };
+
+    /**
+     * @struct Record
+     * @brief Identity and size statistics of a slow spill.
+     */
+    struct Record
+    {
+        std::string sample;     ///< The name of the sample.
+        std::string tree;       ///< The name of the tree.
+        uint32_t run;           ///< The run number of the spill.
+        uint32_t subrun;        ///< The subrun number of the spill.
+        uint32_t event;         ///< The event number of the spill.
+        double time;            ///< The processing time of the tree (ms).
+        double threshold;       ///< The percentile at the time of the spill (ms).
+        size_t interactions;    ///< The number of reco interactions.
+        size_t true_interactions; ///< The number of true interactions.
+        size_t particles;       ///< The number of reco particles.
+        size_t flashes;         ///< The number of optical flashes.
+    };
+
+    /**
+     * @brief Configure the slow-spill detector.
+     * @details The detector is disabled if @p percentile is not in (0, 100).
+     * @param percentile The percentile of the processing time above which a
+     * spill is recorded (e.g., 99).
+     * @param warmup The number of spills of a tree observed before any spill
+     * is recorded.
+     * @param max_records The maximum number of spills recorded per tree.
+     * @return void
+     */
+    void configure(double percentile, size_t warmup, size_t max_records);
+
+    /**
+     * @brief Check if the slow-spill detector is enabled.
+     * @return True if the detector is enabled.
+     */
+    bool enabled();
+
+    /**
+     * @brief Wrap the SpillMultiVars of a tree with the processing time
+     * measurement.
+     * @details The processing time of the tree for a spill is the sum of the
+     * evaluation times of its SpillMultiVars. A spill is complete when the
+     * first SpillMultiVar is evaluated on the next spill (or on @ref flush).
+     * @param sample The name of the sample.
+     * @param tree The name of the tree.
+     * @param vars The SpillMultiVars of the tree.
+     * @return The wrapped SpillMultiVars.
+     */
+    std::vector<ana::SpillMultiVar> wrap(const std::string & sample, const std::string & tree,
+                                         const std::vector<ana::SpillMultiVar> & vars);
+
+    /**
+     * @brief Complete the last spill of the trees of a sample.
+     * @details This also prints a summary of the processing time
+     * distribution of each tree of the sample.
+     * @param sample The name of the sample.
+     * @return void
+     */
+    void flush(const std::string & sample);
+
+    /**
+     * @brief Get the recorded slow spills.
+     * @return The records, in the order they were recorded.
+     */
+    std::vector<Record> records();
+
+    /**
+     * @brief Write the recorded slow spills to a tab-separated table.
+     * @param path The path of the table.
+     * @return void
+     * @throw std::runtime_error if the table cannot be written.
+     */
+    void write(const std::string & path);
+
+    /**
+     * @brief Copy the recorded slow spills of a sample from the input files
+     * to a small CAF file.
+     * @details The spills are selected from the "recTree" of the input files
+     * by their run, subrun, and event numbers. The exposure histograms
+     * written along with the tree (so that the file can be read by a
+     * SpectrumLoader) describe the copied spills only: "TotalEvents" counts
+     * them and "TotalPOT" sums the POT recorded in their headers. For
+     * simulation, where the POT is recorded in the first spill of each
+     * subrun, this is the POT of the copied spills that open a subrun.
+     * @param sample The name of the sample.
+     * @param inputs The path (wildcard) of the input files of the sample.
+     * @param path The path of the output file.
+     * @return The number of spills copied.
+     * @throw std::runtime_error if the output file cannot be written.
+     */
+    size_t dump(const std::string & sample, const std::string & inputs, const std::string & path);
+}
+#endif // MONITOR_H
@@ -15,6 +15,7 @@
 #include <algorithm>
 
 #include "include/utilities.h"
+#include "include/cuts.h"
 
 /**
  * @namespace cuts::muon2024
@@ -41,7 +42,7 @@ namespace cuts::muon2024
     template<class T>
     bool topological_1mu1p_cut(const T & obj)
     {
-        std::vector<uint32_t> c(utilities::count_primaries(obj));
+        std::vector<uint32_t> c(memo::cached<utilities::count_primaries<T>>(obj));
         return c[0] == 0 && c[1] == 0 && c[2] == 1 && c[3] == 0 && c[4] == 1;
     }
     REGISTER_CUT_SCOPE(RegistrationScope::Both, topological_1mu1p_cut, topological_1mu1p_cut);
@@ -58,7 +59,7 @@ namespace cuts::muon2024
     template<class T>
     bool topological_1muNp_cut(const T & obj)
     {
-        std::vector<uint32_t> c(utilities::count_primaries(obj));
+        std::vector<uint32_t> c(memo::cached<utilities::count_primaries<T>>(obj));
         return c[0] == 0 && c[1] == 0 && c[2] == 1 && c[3] == 0 && c[4] >= 1;
     }
     REGISTER_CUT_SCOPE(RegistrationScope::Both, topological_1muNp_cut, topological_1muNp_cut);
@@ -75,7 +76,7 @@ namespace cuts::muon2024
     template<class T>
     bool topological_1muX_cut(const T & obj)
     {
-        std::vector<uint32_t> c(utilities::count_primaries(obj));
+        std::vector<uint32_t> c(memo::cached<utilities::count_primaries<T>>(obj));
         return c[2] == 1 && (c[0] > 0 || c[1] > 0 || c[3] > 0 || c[4] > 0);
     }
     REGISTER_CUT_SCOPE(RegistrationScope::Both, topological_1muX_cut, topological_1muX_cut);
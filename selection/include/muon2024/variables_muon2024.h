@@ -58,12 +58,12 @@ namespace vars::muon2024
     double category(const T & obj)
     {
         double cat(8);
-        if(cuts::muon2024::signal_1mu1p(obj)) cat = 0;
-        else if(cuts::muon2024::nonsignal_1mu1p(obj)) cat = 1;
-        else if(cuts::muon2024::signal_1muNp(obj)) cat = 2;
-        else if(cuts::muon2024::nonsignal_1muNp(obj)) cat = 3;
-        else if(cuts::muon2024::signal_1muX(obj)) cat = 4;
-        else if(cuts::muon2024::nonsignal_1muX(obj)) cat = 5;
+        if(memo::cached<cuts::muon2024::signal_1mu1p<T>>(obj)) cat = 0;
+        else if(memo::cached<cuts::muon2024::nonsignal_1mu1p<T>>(obj)) cat = 1;
+        else if(memo::cached<cuts::muon2024::signal_1muNp<T>>(obj)) cat = 2;
+        else if(memo::cached<cuts::muon2024::nonsignal_1muNp<T>>(obj)) cat = 3;
+        else if(memo::cached<cuts::muon2024::signal_1muX<T>>(obj)) cat = 4;
+        else if(memo::cached<cuts::muon2024::nonsignal_1muX<T>>(obj)) cat = 5;
         else if(cuts::neutrino(obj) && cuts::iscc(obj)) cat = 6;
         else if(cuts::neutrino(obj) && !cuts::iscc(obj)) cat = 7;
         return cat;
@@ -92,12 +92,12 @@ namespace vars::muon2024
     double category_no_containment(const T & obj)
     {
         double cat(8);
-        if(cuts::muon2024::signal_1mu1p_no_containment(obj)) cat = 0;
-        else if(cuts::muon2024::nonsignal_1mu1p_no_containment(obj)) cat = 1;
-        else if(cuts::muon2024::signal_1muNp_no_containment(obj)) cat = 2;
-        else if(cuts::muon2024::nonsignal_1muNp_no_containment(obj)) cat = 3;
-        else if(cuts::muon2024::signal_1muX_no_containment(obj)) cat = 4;
-        else if(cuts::muon2024::nonsignal_1muX_no_containment(obj)) cat = 5;
+        if(memo::cached<cuts::muon2024::signal_1mu1p_no_containment<T>>(obj)) cat = 0;
+        else if(memo::cached<cuts::muon2024::nonsignal_1mu1p_no_containment<T>>(obj)) cat = 1;
+        else if(memo::cached<cuts::muon2024::signal_1muNp_no_containment<T>>(obj)) cat = 2;
+        else if(memo::cached<cuts::muon2024::nonsignal_1muNp_no_containment<T>>(obj)) cat = 3;
+        else if(memo::cached<cuts::muon2024::signal_1muX_no_containment<T>>(obj)) cat = 4;
+        else if(memo::cached<cuts::muon2024::nonsignal_1muX_no_containment<T>>(obj)) cat = 5;
         else if(cuts::neutrino(obj) && cuts::iscc(obj)) cat = 6;
         else if(cuts::neutrino(obj) && !cuts::iscc(obj)) cat = 7;
         return cat;
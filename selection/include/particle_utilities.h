@@ -10,6 +10,8 @@
  */
 #ifndef PARTICLE_UTILITIES_H
 #define PARTICLE_UTILITIES_H
+#include <cmath>
+#include <tuple>
 
 #define MARGIN 5.0
 #define SBND_XMIN -201.3
@@ -39,7 +41,7 @@ namespace utilities
      * @param b the second three-vector.
      * @return the dot product of the two three-vectors.
      */
-    double dot_product(const three_vector & a, const three_vector & b)
+    inline double dot_product(const three_vector & a, const three_vector & b)
     {
         return std::get<0>(a)*std::get<0>(b) + std::get<1>(a)*std::get<1>(b) + std::get<2>(a)*std::get<2>(b);
     }
@@ -51,7 +53,7 @@ namespace utilities
      * @param a the three-vector to calculate the magnitude of.
      * @return the magnitude of the three-vector.
      */
-    double magnitude(const three_vector & a)
+    inline double magnitude(const three_vector & a)
     {
         return std::sqrt(std::pow(std::get<0>(a), 2) + std::pow(std::get<1>(a), 2) + std::pow(std::get<2>(a), 2));
     }
@@ -64,7 +66,7 @@ namespace utilities
      * @param b the second three-vector.
      * @return the sum of the two three-vectors.
      */
-    three_vector add(const three_vector & a, const three_vector & b)
+    inline three_vector add(const three_vector & a, const three_vector & b)
     {
         return std::make_tuple(std::get<0>(a) + std::get<0>(b), std::get<1>(a) + std::get<1>(b), std::get<2>(a) + std::get<2>(b));
     }
@@ -77,7 +79,7 @@ namespace utilities
      * @param b the second three-vector.
      * @return the difference of the two three-vectors.
      */
-    three_vector subtract(const three_vector & a, const three_vector & b)
+    inline three_vector subtract(const three_vector & a, const three_vector & b)
     {
         return std::make_tuple(std::get<0>(a) - std::get<0>(b), std::get<1>(a) - std::get<1>(b), std::get<2>(a) - std::get<2>(b));
     }
@@ -89,7 +91,7 @@ namespace utilities
      * @param a the three-vector to normalize.
      * @return the normalized three-vector.
      */
-    three_vector normalize(const three_vector & a)
+    inline three_vector normalize(const three_vector & a)
     {
         double mag = magnitude(a);
         return std::make_tuple(std::get<0>(a)/mag, std::get<1>(a)/mag, std::get<2>(a)/mag);
@@ -105,7 +107,7 @@ namespace utilities
      * @param vtx the position of the point as a tuple (three-vector).
      * @return true if the point is near a boundary, false otherwise.
      */
-    bool near_boundary(const three_vector & vtx)
+    inline bool near_boundary(const three_vector & vtx)
     {
         return std::get<0>(vtx) < SBND_XMIN + MARGIN || std::get<0>(vtx) > SBND_XMAX - MARGIN ||
                std::get<1>(vtx) < SBND_YMIN + MARGIN || std::get<1>(vtx) > SBND_YMAX - MARGIN ||
@@ -128,7 +130,7 @@ namespace utilities
      * @return the transverse momentum (three-vector) of the particle as a
      * tuple.
      */
-    three_vector transverse_momentum(three_vector & p, three_vector & vtx)
+    inline three_vector transverse_momentum(three_vector & p, three_vector & vtx)
     {
         three_vector unit;
         if constexpr(!BEAM_IS_NUMI)
@@ -158,7 +160,7 @@ namespace utilities
      * @return the longitudinal momentum (three-vector) of the particle as a
      * tuple.
      */
-    three_vector longitudinal_momentum(three_vector & p, three_vector & vtx)
+    inline three_vector longitudinal_momentum(three_vector & p, three_vector & vtx)
     {
         three_vector unit;
         if constexpr(!BEAM_IS_NUMI)
@@ -6,6 +6,9 @@
  * particles. Each variable is implemented as a function which takes a particle
  * object as an argument and returns a double. These variables are intended to
  * be used to define more complex variables which act on interactions.
+ * Families of variables read from the same quantities (e.g., the components
+ * of the momentum) are registered as multi-output variables, which fill the
+ * branches of all components from a single evaluation (see @ref MultiVar).
  * @author mueller@fnal.gov
 */
 #ifndef PARTICLE_VARIABLES_H
@@ -15,6 +18,9 @@
 #define PION_MASS 139.57039
 #define PROTON_MASS 938.2720813
 
+#include <cmath>
+#include <array>
+
 #include "include/particle_utilities.h"
 #include "scorers.h"
 
@@ -302,7 +308,6 @@ namespace pvars
         double wx(0), wy(1), wz(0);
         return std::acos(p.start_dir[0] * wx + p.start_dir[1] * wy + p.start_dir[2] * wz);
     }
-    REGISTER_VAR_SCOPE(RegistrationScope::BothParticle, theta_xw_horizontal, theta_xw_horizontal);
 
     /**
      * @brief Variable for the angle of the particle in the x-wire plane for
@@ -323,7 +328,6 @@ namespace pvars
         double wx(0), wy(0.5 * std::sqrt(3)), wz(0.5);
         return std::acos(p.start_dir[0] * wx + p.start_dir[1] * wy + p.start_dir[2] * wz);
     }
-    REGISTER_VAR_SCOPE(RegistrationScope::BothParticle, theta_xw_p60, theta_xw_p60);
     
     /**
      * @brief Variable for the angle of the particle in the x-wire plane for
@@ -344,7 +348,6 @@ namespace pvars
         double wx(0), wy(-0.5 * std::sqrt(3)), wz(0.5);
         return std::acos(p.start_dir[0] * wx + p.start_dir[1] * wy + p.start_dir[2] * wz);
     }
-    REGISTER_VAR_SCOPE(RegistrationScope::BothParticle, theta_xw_m60, theta_xw_m60);
     
     /**
      * @brief Variable for the angle of the particle in the x-wire plane for
@@ -363,7 +366,6 @@ namespace pvars
         double wx(0), wy(1), wz(0);
         return std::acos(p.start_dir[0] * wx + p.start_dir[1] * wy + p.start_dir[2] * wz);
     }
-    REGISTER_VAR_SCOPE(RegistrationScope::BothParticle, theta_xw_vertical, theta_xw_vertical);
 
     /**
      * @brief Variable for the angle of the particle in the x-wire plane for
@@ -384,7 +386,6 @@ namespace pvars
         double wx(0), wy(0.5), wz(0.5 * std::sqrt(3));
         return std::acos(p.start_dir[0] * wx + p.start_dir[1] * wy + p.start_dir[2] * wz);
     }
-    REGISTER_VAR_SCOPE(RegistrationScope::BothParticle, theta_xw_p30, theta_xw_p30);
 
     /**
      * @brief Variable for the angle of the particle in the x-wire plane for
@@ -405,7 +406,30 @@ namespace pvars
         double wx(0), wy(-0.5), wz(0.5 * std::sqrt(3));
         return std::acos(p.start_dir[0] * wx + p.start_dir[1] * wy + p.start_dir[2] * wz);
     }
-    REGISTER_VAR_SCOPE(RegistrationScope::BothParticle, theta_xw_m30, theta_xw_m30);
+
+    /**
+     * @brief Multi-output variable for the angles of the particle in the
+     * x-wire planes of all anode plane orientations.
+     * @details The start direction is read once and projected on the wire
+     * direction of each orientation, in the order of the components
+     * theta_xw_horizontal, theta_xw_p60, theta_xw_m60, theta_xw_vertical,
+     * theta_xw_p30, and theta_xw_m30 (see the single-angle variables above).
+     * @tparam T the type of particle (true or reco).
+     * @param p the particle to apply the variable on.
+     * @return the angles of the particle in the x-wire planes.
+     */
+    template<class T>
+    std::array<double, 6> theta_xw(const T & p)
+    {
+        // Wire orientations (the wire direction has no x-component). The
+        // x-direction still enters with a zero weight, so that a NaN
+        // direction gives NaN angles as in the single-angle variables.
+        const double dx(p.start_dir[0] * 0), dy(p.start_dir[1]), dz(p.start_dir[2]);
+        const double c30(0.5 * std::sqrt(3));
+        return {std::acos(dx + dy + dz * 0), std::acos(dx + c30 * dy + 0.5 * dz), std::acos(dx - c30 * dy + 0.5 * dz),
+                std::acos(dx + dy + dz * 0), std::acos(dx + 0.5 * dy + c30 * dz), std::acos(dx - 0.5 * dy + c30 * dz)};
+    }
+    REGISTER_MULTIVAR_SCOPE(RegistrationScope::BothParticle, theta_xw, theta_xw, "theta_xw_horizontal", "theta_xw_p60", "theta_xw_m60", "theta_xw_vertical", "theta_xw_p30", "theta_xw_m30");
 
     /**
      * @brief Variable for the x-coordinate of the particle starting point.
@@ -420,7 +444,6 @@ namespace pvars
     {
         return p.start_point[0];
     }
-    REGISTER_VAR_SCOPE(RegistrationScope::BothParticle, start_x, start_x);
 
     /**
      * @brief Variable for the y-coordinate of the particle starting point.
@@ -435,7 +458,6 @@ namespace pvars
     {
         return p.start_point[1];
     }
-    REGISTER_VAR_SCOPE(RegistrationScope::BothParticle, start_y, start_y);
 
     /**
      * @brief Variable for the z-coordinate of the particle starting point.
@@ -450,7 +472,21 @@ namespace pvars
     {
         return p.start_point[2];
     }
-    REGISTER_VAR_SCOPE(RegistrationScope::BothParticle, start_z, start_z);
+
+    /**
+     * @brief Multi-output variable for the coordinates of the particle
+     * starting point.
+     * @details Fills the components start_x, start_y, and start_z.
+     * @tparam T the type of particle (true or reco).
+     * @param p the particle to apply the variable on.
+     * @return the coordinates of the particle starting point.
+     */
+    template<class T>
+    std::array<double, 3> start_point(const T & p)
+    {
+        return {p.start_point[0], p.start_point[1], p.start_point[2]};
+    }
+    REGISTER_MULTIVAR_SCOPE(RegistrationScope::BothParticle, start_point, start_point, "start_x", "start_y", "start_z");
 
     /**
      * @brief Variable for the x-coordinate of the particle end point.
@@ -464,7 +500,6 @@ namespace pvars
     {
         return std::isinf(p.end_point[0]) ? PLACEHOLDERVALUE : (double)p.end_point[0];
     }
-    REGISTER_VAR_SCOPE(RegistrationScope::BothParticle, end_x, end_x);
 
     /**
      * @brief Variable for the y-coordinate of the particle end point.
@@ -478,7 +513,6 @@ namespace pvars
     {
         return std::isinf(p.end_point[1]) ? PLACEHOLDERVALUE : (double)p.end_point[1];
     }
-    REGISTER_VAR_SCOPE(RegistrationScope::BothParticle, end_y, end_y);
     
     /**
      * @brief Variable for the z-coordinate of the particle end point.
@@ -492,7 +526,26 @@ namespace pvars
     {
         return std::isinf(p.end_point[2]) ? PLACEHOLDERVALUE : (double)p.end_point[2];
     }
-    REGISTER_VAR_SCOPE(RegistrationScope::BothParticle, end_z, end_z);
+
+    /**
+     * @brief Multi-output variable for the coordinates of the particle end
+     * point.
+     * @details Fills the components end_x, end_y, and end_z. As for the
+     * single coordinates, an infinite coordinate is replaced by the
+     * placeholder value.
+     * @tparam T the type of particle (true or reco).
+     * @param p the particle to apply the variable on.
+     * @return the coordinates of the particle end point.
+     */
+    template<class T>
+    std::array<double, 3> end_point(const T & p)
+    {
+        std::array<double, 3> result;
+        for(size_t i(0); i < 3; ++i)
+            result[i] = std::isinf(p.end_point[i]) ? PLACEHOLDERVALUE : (double)p.end_point[i];
+        return result;
+    }
+    REGISTER_MULTIVAR_SCOPE(RegistrationScope::BothParticle, end_point, end_point, "end_x", "end_y", "end_z");
 
     /**
      * @brief Variable for the x-component of the particle start direction.
@@ -507,7 +560,6 @@ namespace pvars
     {
         return p.start_dir[0];
     }
-    REGISTER_VAR_SCOPE(RegistrationScope::BothParticle, start_dir_x, start_dir_x);
     
     /**
      * @brief Variable for the y-component of the particle start direction.
@@ -522,7 +574,6 @@ namespace pvars
     {
         return p.start_dir[1];
     }
-    REGISTER_VAR_SCOPE(RegistrationScope::BothParticle, start_dir_y, start_dir_y);
 
     /**
      * @brief Variable for the z-component of the particle start direction.
@@ -537,7 +588,21 @@ namespace pvars
     {
         return p.start_dir[2];
     }
-    REGISTER_VAR_SCOPE(RegistrationScope::BothParticle, start_dir_z, start_dir_z);
+
+    /**
+     * @brief Multi-output variable for the particle start direction.
+     * @details Fills the components start_dir_x, start_dir_y, and
+     * start_dir_z.
+     * @tparam T the type of particle (true or reco).
+     * @param p the particle to apply the variable on.
+     * @return the components of the particle start direction.
+     */
+    template<class T>
+    std::array<double, 3> start_dir(const T & p)
+    {
+        return {p.start_dir[0], p.start_dir[1], p.start_dir[2]};
+    }
+    REGISTER_MULTIVAR_SCOPE(RegistrationScope::BothParticle, start_dir, start_dir, "start_dir_x", "start_dir_y", "start_dir_z");
 
     /**
      * @brief Variable for the x-component of the particle end direction.
@@ -552,7 +617,6 @@ namespace pvars
     {
         return p.end_dir[0];
     }
-    REGISTER_VAR_SCOPE(RegistrationScope::BothParticle, end_dir_x, end_dir_x);
 
     /**
      * @brief Variable for the y-component of the particle end direction.
@@ -567,7 +631,6 @@ namespace pvars
     {
         return p.end_dir[1];
     }
-    REGISTER_VAR_SCOPE(RegistrationScope::BothParticle, end_dir_y, end_dir_y);
 
     /**
      * @brief Variable for the z-component of the particle end direction.
@@ -582,7 +645,20 @@ namespace pvars
     {
         return p.end_dir[2];
     }
-    REGISTER_VAR_SCOPE(RegistrationScope::BothParticle, end_dir_z, end_dir_z);
+
+    /**
+     * @brief Multi-output variable for the particle end direction.
+     * @details Fills the components end_dir_x, end_dir_y, and end_dir_z.
+     * @tparam T the type of particle (true or reco).
+     * @param p the particle to apply the variable on.
+     * @return the components of the particle end direction.
+     */
+    template<class T>
+    std::array<double, 3> end_dir(const T & p)
+    {
+        return {p.end_dir[0], p.end_dir[1], p.end_dir[2]};
+    }
+    REGISTER_MULTIVAR_SCOPE(RegistrationScope::BothParticle, end_dir, end_dir, "end_dir_x", "end_dir_y", "end_dir_z");
 
     /**
      * @brief Variable for the x-component of the particle momentum.
@@ -596,7 +672,6 @@ namespace pvars
     {
         return p.momentum[0];
     }
-    REGISTER_VAR_SCOPE(RegistrationScope::BothParticle, px, px);
     
     /**
      * @brief Variable for the y-component of the particle momentum.
@@ -610,7 +685,6 @@ namespace pvars
     {
         return p.momentum[1];
     }
-    REGISTER_VAR_SCOPE(RegistrationScope::BothParticle, py, py);
 
     /**
      * @brief Variable for the z-component of the particle momentum.
@@ -624,7 +698,20 @@ namespace pvars
     {
         return p.momentum[2];
     }
-    REGISTER_VAR_SCOPE(RegistrationScope::BothParticle, pz, pz);
+
+    /**
+     * @brief Multi-output variable for the particle momentum.
+     * @details Fills the components px, py, and pz.
+     * @tparam T the type of particle (true or reco).
+     * @param p the particle to apply the variable on.
+     * @return the components of the particle momentum.
+     */
+    template<class T>
+    std::array<double, 3> momentum(const T & p)
+    {
+        return {p.momentum[0], p.momentum[1], p.momentum[2]};
+    }
+    REGISTER_MULTIVAR_SCOPE(RegistrationScope::BothParticle, momentum, momentum, "px", "py", "pz");
     
     /**
      * @brief Variable for the transverse momentum of a particle.
@@ -681,149 +768,25 @@ namespace pvars
     REGISTER_VAR_SCOPE(RegistrationScope::BothParticle, azimuthal_angle, azimuthal_angle);
 
     /**
-     * @brief Variable for the photon softmax score of the particle.
-     * @details The photon softmax score represents the confidence that the
-     * network has in the particle being a photon. The score is between 0 and 1,
-     * with 1 being the most confident that the particle is a photon.
-     * @tparam T the type of particle (true or reco).
-     * @param p the particle to apply the variable on.
-     * @return the photon softmax score of the particle.
-     */
-    template<class T>
-    double photon_softmax(const caf::SRParticleDLPProxy & p)
-    {
-        return p.pid_scores[0];
-    }
-    REGISTER_VAR_SCOPE(RegistrationScope::RecoParticle, photon_softmax, photon_softmax);
-
-    /**
-     * @brief Variable for the electron softmax score of the particle.
-     * @details The electron softmax score represents the confidence that the
-     * network has in the particle being an electron. The score is between 0 and 1,
-     * with 1 being the most confident that the particle is an electron.
-     * @tparam T the type of particle (true or reco).
-     * @param p the particle to apply the variable on.
-     * @return the electron softmax score of the particle.
-     */
-    template<class T>
-    double electron_softmax(const caf::SRParticleDLPProxy & p)
-    {
-        return p.pid_scores[1];
-    }
-    REGISTER_VAR_SCOPE(RegistrationScope::RecoParticle, electron_softmax, electron_softmax);
-    
-    /**
-     * @brief Variable for the muon softmax score of the particle.
-     * @details The muon softmax score represents the confidence that the
-     * network has in the particle being a muon. The score is between 0 and 1,
-     * with 1 being the most confident that the particle is a muon.
-     * @tparam T the type of particle (true or reco).
-     * @param p the particle to apply the variable on.
-     * @return the muon softmax score of the particle.
-     */
-    template<class T>
-    double muon_softmax(const caf::SRParticleDLPProxy & p)
-    {
-        return p.pid_scores[2];
-    }
-    REGISTER_VAR_SCOPE(RegistrationScope::RecoParticle, muon_softmax, muon_softmax);
-
-    /**
-     * @brief Variable for the pion softmax score of the particle.
-     * @details The pion softmax score represents the confidence that the
-     * network has in the particle being a pion. The score is between 0 and 1,
-     * with 1 being the most confident that the particle is a pion.
-     * @tparam T the type of particle (true or reco).
-     * @param p the particle to apply the variable on.
-     * @return the pion softmax score of the particle.
-     */
-    template<class T>
-    double pion_softmax(const caf::SRParticleDLPProxy & p)
-    {
-        return p.pid_scores[3];
-    }
-    REGISTER_VAR_SCOPE(RegistrationScope::RecoParticle, pion_softmax, pion_softmax);
-
-    /**
-     * @brief Variable for the proton softmax score of the particle.
-     * @details The proton softmax score represents the confidence that the
-     * network has in the particle being a proton. The score is between 0 and 1,
-     * with 1 being the most confident that the particle is a proton.
-     * @tparam p the type of particle (true or reco).
-     * @param p the particle to apply the variable on.
-     * @return the proton softmax score of the particle.
-     */
-    template<class T>
-    double proton_softmax(const caf::SRParticleDLPProxy & p)
-    {
-        return p.pid_scores[4];
-    }
-    REGISTER_VAR_SCOPE(RegistrationScope::RecoParticle, proton_softmax, proton_softmax);
-
-    /**
-     * @brief Variable for the "MIP" softmax score of the particle.
-     * @details The "MIP" softmax score is calculated as the sum of the softmax
-     * scores for the muon and pion. The score represents the confidence that
-     * the network has in the particle being a minimum ionizing particle.
-     * @tparam T the type of particle (true or reco).
-     * @param p the particle to apply the variable on.
-     * @return the "MIP" softmax score of the particle.
-     */
-    template<class T>
-    double mip_softmax(const caf::SRParticleDLPProxy & p)
-    {
-        return p.pid_scores[2] + p.pid_scores[3];
-    }
-    REGISTER_VAR_SCOPE(RegistrationScope::RecoParticle, mip_softmax, mip_softmax);
-
-    /**
-     * @brief Variable for the "hadron" softmax score of the particle.
-     * @details The "hadron" softmax score is calculated as the sum of the softmax
-     * scores for the pion and proton. The score represents the confidence that
-     * the network has in the particle being a hadron.
-     * @tparam T the type of particle (true or reco).
-     * @param p the particle to apply the variable on.
-     * @return the "hadron" softmax score of the particle.
-     */
-    template<class T>
-    double hadron_softmax(const caf::SRParticleDLPProxy & p)
-    {
-        return p.pid_scores[3] + p.pid_scores[4];
-    }
-    REGISTER_VAR_SCOPE(RegistrationScope::RecoParticle, hadron_softmax, hadron_softmax);
-
-    /**
-     * @brief Variable for the primary softmax score of the particle.
-     * @details The primary softmax score represents the confidence that the
-     * network has in the particle being a primary particle. The score is between
-     * 0 and 1, with 1 being the most confident that the particle is a primary
-     * particle.
-     * @tparam T the type of particle (true or reco).
-     * @param p the particle to apply the variable on.
-     * @return the primary softmax score of the particle.
-     */
-    template<class T>
-    double primary_softmax(const caf::SRParticleDLPProxy & p)
-    {
-        return p.primary_scores[1];
-    }
-    REGISTER_VAR_SCOPE(RegistrationScope::RecoParticle, primary_softmax, primary_softmax);
-
-    /**
-     * @brief Variable for the secondary softmax score of the particle.
-     * @details The secondary softmax score represents the confidence that the
-     * network has in the particle being a secondary particle. The score is between
-     * 0 and 1, with 1 being the most confident that the particle is a secondary
-     * particle.
+     * @brief Multi-output variable for the softmax scores of the particle.
+     * @details Reads the PID and primary scores once and fills the components
+     * photon_softmax, electron_softmax, muon_softmax, pion_softmax, and
+     * proton_softmax (the confidence of the network in each particle type,
+     * between 0 and 1), mip_softmax (muon + pion) and hadron_softmax (pion +
+     * proton), and primary_softmax and secondary_softmax (the confidence of
+     * the network in the particle being a primary or secondary particle).
      * @tparam T the type of particle (true or reco).
      * @param p the particle to apply the variable on.
-     * @return the secondary softmax score of the particle.
+     * @return the softmax scores of the particle.
      */
     template<class T>
-    double secondary_softmax(const caf::SRParticleDLPProxy & p)
+    std::array<double, 9> softmax(const caf::SRParticleDLPProxy & p)
     {
-        return p.primary_scores[0];
+        const double photon(p.pid_scores[0]), electron(p.pid_scores[1]), muon(p.pid_scores[2]);
+        const double pion(p.pid_scores[3]), proton(p.pid_scores[4]);
+        return {photon, electron, muon, pion, proton, muon + pion, pion + proton,
+                (double)p.primary_scores[1], (double)p.primary_scores[0]};
     }
-    REGISTER_VAR_SCOPE(RegistrationScope::RecoParticle, secondary_softmax, secondary_softmax);
+    REGISTER_MULTIVAR_SCOPE(RegistrationScope::RecoParticle, softmax, softmax, "photon_softmax", "electron_softmax", "muon_softmax", "pion_softmax", "proton_softmax", "mip_softmax", "hadron_softmax", "primary_softmax", "secondary_softmax");
 }
 #endif // PARTICLE_VARIABLES_H
\ No newline at end of file
@@ -0,0 +1,192 @@
+/**
+ * @file reader.h
+ * @brief Header file for the SpectrumLoader-free tree writer of the SPINE
+ * analysis framework.
+ * @details Tree-writing jobs use only a small part of the machinery of
+ * ana::SpectrumLoader (spectra, systematic shifts, exposure bookkeeping of
+ * each registered object) and of ana::Tree (the rows of each tree are
+ * buffered in vectors and copied to a TTree at the end). The tree writer
+ * loops over the "recTree" of the input files itself and delivers each spill
+ * to the same SpillMultiVars, writing the rows of each tree directly to a
+ * TTree with the same layout as ana::Tree (one double branch per variable,
+ * then the "Run," "Subrun," and "Evt" branches, and the "POT" and "Livetime"
+ * histograms). It is not a record view over bound leaves: the record is still the SRProxy
+ * of the StandardRecord, which reads each leaf lazily on first access, so
+ * that all registered cuts and variables work unchanged. The saving is the
+ * SpectrumLoader and ana::Tree bookkeeping only; on the I/O side, the
+ * TTreeCache of each file learns the branches accessed during the first
+ * spills and then prefetches only those.
+ * @author mueller@fnal.gov
+ */
+#ifndef READER_H
+#define READER_H
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <iostream>
+
+#include "sbnana/CAFAna/Core/MultiVar.h"
+#include "sbnanaobj/StandardRecord/Proxy/SRProxy.h"
+
+#include "TDirectory.h"
+#include "TTree.h"
+
+/**
+ * @namespace reader
+ * @brief Namespace for the SpectrumLoader-free tree writer.
+ */
+namespace reader
+{
+    class Loader;
+
+    /**
+     * @brief Expand the path of the input files of a sample.
+     * @details The path is a wildcard (e.g., "/path/to/files*.flat.root") or
+     * a single file. SAM definitions are only supported by the
+     * ana::SpectrumLoader backend.
+     * @param path The path of the input files.
+     * @return The input files, in lexicographic order.
+     * @throw std::runtime_error if no file matches the path.
+     */
+    std::vector<std::string> expand(const std::string & path);
+
+    /**
+     * @class Tree
+     * @brief Output tree of the SpectrumLoader-free tree writer.
+     * @details This is the counterpart of ana::Tree: each spill is passed to
+     * the SpillMultiVars of the tree, in order, and the values are written as
+     * rows of the TTree. All SpillMultiVars must return the same number of
+     * values for a spill.
+     */
+    class Tree
+    {
+        public:
+            /**
+             * @brief Constructor for the Tree class.
+             * @details The tree registers itself with the loader.
+             * @param name The name of the tree.
+             * @param names The names of the branches.
+             * @param loader The loader delivering the spills.
+             * @param vars The SpillMultiVars implementing the branches.
+             */
+            Tree(const std::string & name, const std::vector<std::string> & names, Loader & loader,
+                 const std::vector<ana::SpillMultiVar> & vars);
+
+            /**
+             * @brief Destructor for the Tree class.
+             */
+            ~Tree();
+
+            Tree(const Tree &) = delete;
+            Tree & operator=(const Tree &) = delete;
+
+            /**
+             * @brief Fill the rows of a spill.
+             * @param sr The spill.
+             * @return void
+             * @throw std::runtime_error if the SpillMultiVars return
+             * different numbers of values.
+             */
+            void Fill(const caf::Proxy<caf::StandardRecord> & sr);
+
+            /**
+             * @brief Write the tree and the exposure histograms.
+             * @param dir The directory to write to.
+             * @return void
+             */
+            void SaveTo(TDirectory * dir) const;
+
+        private:
+            std::string name_;
+            std::vector<std::string> names_;
+            Loader & loader_;
+            std::vector<ana::SpillMultiVar> vars_;
+            TTree * tree_;
+            std::vector<double> values_;
+            int run_ = 0;
+            int subrun_ = 0;
+            int evt_ = 0;
+    };
+
+    /**
+     * @class Loader
+     * @brief Loop over the spills of the input files of a sample.
+     * @details The exposure of the sample is the sum of the "TotalPOT" and
+     * "TotalEvents" histograms of the input files.
+     */
+    class Loader
+    {
+        public:
+            /**
+             * @brief Constructor for the Loader class.
+             * @param files The input files.
+             */
+            explicit Loader(std::vector<std::string> files);
+
+            /**
+             * @brief Register a tree to be filled with each spill.
+             * @param tree The tree.
+             * @return void
+             */
+            void Register(Tree * tree) { trees_.push_back(tree); }
+
+            /**
+             * @brief Configure the TTreeCache of the input files.
+             * @param bytes The size of the cache (zero disables it).
+             * @param learn The number of spills over which the cache learns
+             * the accessed branches.
+             * @return void
+             */
+            void SetCache(long long bytes, long long learn);
+
+            /**
+             * @brief Loop over the spills of all input files.
+             * @return void
+             * @throw std::runtime_error if a file or its "recTree" cannot be
+             * read.
+             */
+            void Go();
+
+            /**
+             * @brief Get the POT of the sample.
+             * @return The POT.
+             */
+            double GetPOT() const { return pot_; }
+
+            /**
+             * @brief Get the livetime of the sample.
+             * @return The livetime (number of triggers).
+             */
+            double GetLivetime() const { return livetime_; }
+
+            /**
+             * @brief Get the number of spills read.
+             * @return The number of spills.
+             */
+            size_t GetSpills() const { return spills_; }
+
+        private:
+            std::vector<std::string> files_;
+            std::vector<Tree *> trees_;
+            long long cache_bytes_ = 100 * 1024 * 1024;
+            long long cache_learn_ = 10;
+            double pot_ = 0;
+            double livetime_ = 0;
+            size_t spills_ = 0;
+    };
+
+    /**
+     * @brief Compare the output files of two backends.
+     * @details The trees are compared entry by entry and value by value
+     * (NaN values compare equal), and the histograms bin by bin with a
+     * relative tolerance of 1e-9 (the exposure is summed in a different
+     * order by the two backends). Objects missing from either file are
+     * mismatches.
+     * @param a The first directory.
+     * @param b The second directory.
+     * @param log The stream to report the mismatches to.
+     * @return The number of mismatching objects.
+     */
+    size_t compare(TDirectory * a, TDirectory * b, std::ostream & log);
+}
+#endif // READER_H
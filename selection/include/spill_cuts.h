@@ -13,6 +13,8 @@
  */
 #ifndef SPILL_CUTS_H
 #define SPILL_CUTS_H
+#include <cmath>
+
 #include "sbnanaobj/StandardRecord/Proxy/SRProxy.h"
 
 #include "framework.h"
@@ -91,7 +91,7 @@ namespace utilities
      * @param run the run number to check.
      * @return true if the run is in the list of good runs, false otherwise.
      */
-    bool is_icarus_good_run(unsigned int run)
+    inline bool is_icarus_good_run(unsigned int run)
     {
         return std::find(icarus_good_runs_run2.begin(), icarus_good_runs_run2.end(), run) != icarus_good_runs_run2.end();
     }
@@ -223,7 +223,6 @@ namespace vars
      */
     template<class T>
     double vertex_x(const T & obj) { return obj.vertex[0]; }
-    REGISTER_VAR_SCOPE(RegistrationScope::Both, vertex_x, vertex_x);
 
     /**
      * @brief Variable for the y-coordinate of the interaction vertex.
@@ -235,7 +234,6 @@ namespace vars
      */
     template<class T>
     double vertex_y(const T & obj) { return obj.vertex[1]; }
-    REGISTER_VAR_SCOPE(RegistrationScope::Both, vertex_y, vertex_y);
 
     /**
      * @brief Variable for the z-coordinate of the interaction vertex.
@@ -247,7 +245,18 @@ namespace vars
      */
     template<class T>
     double vertex_z(const T & obj) { return obj.vertex[2]; }
-    REGISTER_VAR_SCOPE(RegistrationScope::Both, vertex_z, vertex_z);
+
+    /**
+     * @brief Multi-output variable for the coordinates of the interaction
+     * vertex.
+     * @details Fills the components vertex_x, vertex_y, and vertex_z.
+     * @tparam T the type of interaction (true or reco).
+     * @param obj the interaction to apply the variable on.
+     * @return the coordinates of the interaction vertex.
+     */
+    template<class T>
+    std::array<double, 3> vertex(const T & obj) { return {obj.vertex[0], obj.vertex[1], obj.vertex[2]}; }
+    REGISTER_MULTIVAR_SCOPE(RegistrationScope::Both, vertex, vertex, "vertex_x", "vertex_y", "vertex_z");
 
     /**
      * @brief Variable for the transverse momentum of the interaction counting
@@ -445,7 +454,7 @@ namespace vars
                     hadronic_pl = utilities::add(hadronic_pl, this_pl);
             }
         }
-        return utilities::magnitude(utilities::add(hadronic_pl, lepton_pl)) - 1000*vars::visible_energy(obj);
+        return utilities::magnitude(utilities::add(hadronic_pl, lepton_pl)) - 1000*memo::cached<vars::visible_energy<T>>(obj);
     }
     REGISTER_VAR_SCOPE(RegistrationScope::Both, dpL, dpL);
 
@@ -493,7 +502,7 @@ namespace vars
         if(l_ke == 0 || p_ke == 0)
             return PLACEHOLDERVALUE;
         else
-            return utilities::magnitude(utilities::add(l_pl, p_pl)) - 1000*vars::visible_energy(obj);
+            return utilities::magnitude(utilities::add(l_pl, p_pl)) - 1000*memo::cached<vars::visible_energy<T>>(obj);
     }
     REGISTER_VAR_SCOPE(RegistrationScope::Both, dpL_lp, dpL_lp);
 
@@ -509,7 +518,7 @@ namespace vars
      * applied by the definition of a preprocessor macro (BEAM_IS_NUMI).
      */
     template<class T>
-    double pn(const T & obj) { return std::sqrt(std::pow(vars::dpT(obj), 2) + std::pow(vars::dpL(obj), 2)); }
+    double pn(const T & obj) { return std::sqrt(std::pow(memo::cached<vars::dpT<T>>(obj), 2) + std::pow(memo::cached<vars::dpL<T>>(obj), 2)); }
     REGISTER_VAR_SCOPE(RegistrationScope::Both, pn, pn);
 
     /**
@@ -525,7 +534,7 @@ namespace vars
      * applied by the definition of a preprocessor macro (BEAM_IS_NUMI).
      */
     template<class T>
-    double pn_lp(const T & obj) { return std::sqrt(std::pow(vars::dpT_lp(obj), 2) + std::pow(vars::dpL_lp(obj), 2)); }
+    double pn_lp(const T & obj) { return std::sqrt(std::pow(memo::cached<vars::dpT_lp<T>>(obj), 2) + std::pow(memo::cached<vars::dpL_lp<T>>(obj), 2)); }
     REGISTER_VAR_SCOPE(RegistrationScope::Both, pn_lp, pn_lp);
 
     /**
@@ -0,0 +1,176 @@
+/**
+ * @file weights.h
+ * @brief Header file declaring the weight-map reweighting of the SPINE
+ * analysis framework.
+ * @details Flux, cross-section tune, and data-driven corrections are usually
+ * provided as TH1/TH2/TH3 maps in some set of interaction variables (e.g.,
+ * the neutrino energy and PDG code). This module loads such maps from local
+ * ROOT files at startup and registers weight variables that evaluate the
+ * product of a set of maps for each interaction in the selection pass, so
+ * that the weight is written as a regular branch of the output trees. Each
+ * map is converted to a flat array of bin contents, and each axis to an
+ * edge table with an O(1) bin lookup: a direct computation for uniform
+ * binning, and a uniform grid of cells indexing the bins otherwise (see
+ * @ref Axis). The weights are configured with a [[weight]] table array:
+ * @code
+ * [[weight]]
+ * name = 'cv_weight'               # registered as true_cv_weight and reco_cv_weight
+ * path = 'weights.root'            # default file of the maps
+ * [[weight.map]]
+ * histogram = 'flux/numu'          # TH1, TH2, or TH3
+ * axes = ['neutrino_energy', 'pdg'] # one registered variable per dimension
+ * outside = 'clamp'                # out-of-range values: "clamp" or "unit"
+ * [[weight.map]]
+ * path = 'tune.root'               # overrides the default file
+ * histogram = 'xsec_tune'
+ * axes = ['neutrino_energy']
+ * @endcode
+ * The axis variables are looked up with the prefix of the record type of the
+ * weight ("true_" or "reco_"), so a weight is available for either record
+ * type as long as its axis variables are. A NaN axis value gives a NaN
+ * weight.
+ * @author mueller@fnal.gov
+ */
+#ifndef WEIGHTS_H
+#define WEIGHTS_H
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+
+#include "configuration.h"
+
+/**
+ * @namespace weights
+ * @brief Namespace for the weight-map reweighting.
+ */
+namespace weights
+{
+    /**
+     * @class Axis
+     * @brief The edge table of an axis of a weight map.
+     * @details Uniform axes compute the bin directly from the value. For
+     * non-uniform axes, the range is divided into uniform cells no wider than
+     * the narrowest bin (up to a maximum number of cells), each storing the
+     * bin of its lower edge; the bin of a value is then the bin of its cell,
+     * corrected by at most a few comparisons with the neighboring edges.
+     */
+    class Axis
+    {
+        public:
+            /**
+             * @brief Constructor for the Axis class.
+             * @param edges The bin edges (increasing, at least two).
+             * @throw std::runtime_error if the edges are not increasing.
+             */
+            explicit Axis(std::vector<double> edges);
+
+            /**
+             * @brief Find the bin of a value.
+             * @param x The value (not NaN).
+             * @return The bin (0 to bins() - 1), -1 below the range, or
+             * bins() above the range.
+             */
+            long find(double x) const;
+
+            /**
+             * @brief Get the number of bins.
+             * @return The number of bins.
+             */
+            size_t bins() const { return edges_.size() - 1; }
+
+            /**
+             * @brief Check if the axis has uniform binning.
+             * @return True if the bin is computed directly.
+             */
+            bool uniform() const { return uniform_; }
+
+        private:
+            std::vector<double> edges_;
+            double low_;
+            double high_;
+            double scale_;
+            bool uniform_;
+            std::vector<uint32_t> table_;
+    };
+
+    /**
+     * @enum Outside
+     * @brief The treatment of values outside the range of a map.
+     * @details Clamp uses the first (last) bin for values below (above) the
+     * range; Unit gives a factor of one.
+     */
+    enum class Outside { Clamp = 0, Unit = 1 };
+
+    /**
+     * @class Map
+     * @brief A weight map in one to three variables.
+     * @details The bin contents are stored in a flat array with the first
+     * axis running fastest. The map is immutable once constructed, so it is
+     * shared by all threads.
+     */
+    class Map
+    {
+        public:
+            /**
+             * @brief Constructor for the Map class.
+             * @param name The name of the map (for diagnostics).
+             * @param axes The axes (one to three).
+             * @param values The bin contents (the product of the numbers of
+             * bins of the axes, first axis fastest).
+             * @param outside The treatment of values outside the range.
+             * @throw std::runtime_error if the dimensions do not match.
+             */
+            Map(std::string name, std::vector<Axis> axes, std::vector<double> values, Outside outside);
+
+            /**
+             * @brief Evaluate the map.
+             * @param x The values of the axis variables (one per axis).
+             * @return The content of the bin of the values.
+             */
+            double operator()(const double * x) const;
+
+            /**
+             * @brief Get the number of axes.
+             * @return The number of axes.
+             */
+            size_t dimension() const { return axes_.size(); }
+
+            /**
+             * @brief Get the name of the map.
+             * @return The name.
+             */
+            const std::string & name() const { return name_; }
+
+        private:
+            std::string name_;
+            std::vector<Axis> axes_;
+            std::vector<double> values_;
+            Outside outside_;
+    };
+
+    /**
+     * @brief Read a weight map from a ROOT file.
+     * @param path The path of the file.
+     * @param histogram The name of the histogram (TH1, TH2, or TH3).
+     * @param outside The treatment of values outside the range.
+     * @return The map.
+     * @throw std::runtime_error if the file or the histogram cannot be read.
+     */
+    std::shared_ptr<const Map> read_map(const std::string & path, const std::string & histogram, Outside outside);
+
+    /**
+     * @brief Load the weight maps and register the weight variables.
+     * @details Each [[weight]] table registers the variables "true_<name>"
+     * and "reco_<name>", which evaluate the product of the maps of the table
+     * for an interaction. The maps are read once, even if shared between
+     * weights. Configurations without a [[weight]] table are unaffected.
+     * @param config The configuration.
+     * @return void
+     * @throw cfg::ConfigurationError if a weight is not valid.
+     * @throw std::runtime_error if a map cannot be read or a name is
+     * already registered.
+     */
+    void configure(const cfg::ConfigurationTable & config);
+}
+#endif // WEIGHTS_H
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""
+Records and reports the compile time and peak memory of each translation
+unit of the selection. With the SPINE_BUILD_BENCHMARK option, CMake runs
+each compiler command through the "record" mode of this script, which
+appends a line to a log. The "report" mode (the build_benchmark target)
+summarizes the log.
+
+Usage
+-----
+build_benchmark.py record <log> -- <compiler command...>
+build_benchmark.py report <log>
+"""
+import os
+import sys
+import time
+import fcntl
+import resource
+import subprocess
+
+def output_of(command) -> str:
+    """
+    Finds the output file of a compiler command.
+
+    Parameters
+    ----------
+    command : list[str]
+        The compiler command.
+
+    Returns
+    -------
+    str
+        The argument of the "-o" option, or the last argument if absent.
+    """
+    for i, arg in enumerate(command[:-1]):
+        if arg == '-o':
+            return command[i + 1]
+    return command[-1]
+
+def record(log, command) -> int:
+    """
+    Runs a compiler command and appends its wall time and peak resident
+    memory to the log.
+
+    Parameters
+    ----------
+    log : str
+        The path of the log.
+    command : list[str]
+        The compiler command.
+
+    Returns
+    -------
+    int
+        The return code of the compiler.
+    """
+    start = time.monotonic()
+    code = subprocess.call(command)
+    seconds = time.monotonic() - start
+    memory = resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss
+    with open(log, 'a') as f:
+        fcntl.flock(f, fcntl.LOCK_EX)
+        f.write(f'{seconds:.3f}\t{memory}\t{output_of(command)}\n')
+    return code
+
+def report(log) -> int:
+    """
+    Prints the compile time and peak memory of each translation unit,
+    slowest first, keeping the latest measurement of each unit.
+
+    Parameters
+    ----------
+    log : str
+        The path of the log.
+
+    Returns
+    -------
+    int
+        Zero, or one if the log does not exist.
+    """
+    if not os.path.exists(log):
+        print(f'No measurements in {log}; configure with -DSPINE_BUILD_BENCHMARK=ON and rebuild.')
+        return 1
+    units = dict()
+    with open(log) as f:
+        for line in f:
+            seconds, memory, output = line.rstrip('\n').split('\t', 2)
+            units[output] = (float(seconds), int(memory))
+    rows = sorted(units.items(), key=lambda u: -u[1][0])
+    total = f'Total ({len(rows)} units)'
+    width = max([len(total)] + [len(os.path.relpath(o)) for o in units])
+    print(f'{"Translation unit":<{width}}  {"Time [s]":>9}  {"Memory [MB]":>11}')
+    for output, (seconds, memory) in rows:
+        print(f'{os.path.relpath(output):<{width}}  {seconds:>9.2f}  {memory / 1024:>11.1f}')
+    print(f'{total:<{width}}  {sum(u[0] for u in units.values()):>9.2f}  '
+          f'{max(u[1] for u in units.values()) / 1024:>11.1f}')
+    return 0
+
+if __name__ == '__main__':
+    if len(sys.argv) >= 3 and sys.argv[1] == 'report':
+        sys.exit(report(sys.argv[2]))
+    if len(sys.argv) >= 5 and sys.argv[1] == 'record' and sys.argv[3] == '--':
+        sys.exit(record(sys.argv[2], sys.argv[4:]))
+    print(__doc__)
+    sys.exit(2)
@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+"""
+Times the selection of toml/multivar_benchmark.toml with and without the
+sharing of the tuples of the multi-output variables (general.share_multivars)
+and checks that both runs write the same trees. The validate program first
+writes the synthetic workload (see the "--workload" mode of validate.cc),
+then main runs the configuration with the sharing on and off, alternating
+between the two so that drifts of the machine affect both alike. The best
+of several repetitions is reported.
+
+Usage
+-----
+multivar_benchmark.py [--build <dir>] [--events <n>] [--repeat <n>]
+"""
+import os
+import sys
+import time
+import argparse
+import subprocess
+
+SOURCE = os.path.abspath(os.path.join(os.path.dirname(__file__), '..', '..'))
+CONFIG = os.path.join(SOURCE, 'selection', 'toml', 'multivar_benchmark.toml')
+
+def run(command, cwd) -> float:
+    """
+    Runs a command, failing if it fails.
+
+    Parameters
+    ----------
+    command : list[str]
+        The command.
+    cwd : str
+        The working directory of the command.
+
+    Returns
+    -------
+    float
+        The wall time of the command in seconds.
+    """
+    print('+ ' + ' '.join(command), flush=True)
+    start = time.monotonic()
+    code = subprocess.call(command, cwd=cwd, stdout=subprocess.DEVNULL)
+    if code != 0:
+        sys.exit(f'Command failed with code {code}: {" ".join(command)}')
+    return time.monotonic() - start
+
+def configure(directory, shared) -> str:
+    """
+    Writes a copy of the benchmark configuration with the sharing set.
+
+    Parameters
+    ----------
+    directory : str
+        The directory of the workload.
+    shared : bool
+        Whether the tuples are shared.
+
+    Returns
+    -------
+    str
+        The path of the configuration.
+    """
+    name = 'shared' if shared else 'unshared'
+    with open(CONFIG) as f:
+        text = f.read()
+    text = text.replace('output = "multivar_benchmark"', f'output = "multivar_benchmark_{name}"')
+    text = text.replace('share_multivars = true', f'share_multivars = {"true" if shared else "false"}')
+    path = os.path.join(directory, f'multivar_benchmark_{name}.toml')
+    with open(path, 'w') as f:
+        f.write(text)
+    return path
+
+def contents(path) -> dict:
+    """
+    Reads the branches of the trees of a ROOT file.
+
+    Parameters
+    ----------
+    path : str
+        The path of the file.
+
+    Returns
+    -------
+    dict[str, dict[str, list[float]]]
+        The values of each branch of each tree, keyed by path, with NaN
+        (the value of an object without a match) replaced by None so that
+        the values compare equal (empty if uproot is not available).
+    """
+    try:
+        import uproot
+    except ImportError:
+        return dict()
+    with uproot.open(path) as f:
+        return {k: {b: [None if v != v else v for v in f[k][b].array(library='np').tolist()] for b in f[k].keys()}
+                for k, c in f.classnames().items() if c == 'TTree'}
+
+def main() -> int:
+    """
+    Runs the benchmark and reports the speedup of the shared tuples.
+
+    Returns
+    -------
+    int
+        Zero on success, or one if the outputs differ.
+    """
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--build', default=os.path.join(SOURCE, 'build'), help='the build directory')
+    parser.add_argument('--events', type=int, default=20000, help='the number of events of the workload')
+    parser.add_argument('--repeat', type=int, default=3, help='the number of timed repetitions')
+    args = parser.parse_args()
+
+    build_dir = os.path.abspath(args.build)
+    main_program = os.path.join(build_dir, 'selection', 'main')
+    validate = os.path.join(build_dir, 'selection', 'validate')
+    work_dir = os.path.join(build_dir, 'multivar_benchmark')
+    os.makedirs(work_dir, exist_ok=True)
+    run([validate, '--workload', str(args.events), 'pgo_workload.root'], cwd=work_dir)
+
+    configs = {'shared': configure(work_dir, True), 'unshared': configure(work_dir, False)}
+    times = dict()
+    for _ in range(args.repeat):
+        for name, config in configs.items():
+            times[name] = min(run([main_program, config], cwd=work_dir), times.get(name, float('inf')))
+
+    s, u = times['shared'], times['unshared']
+    print(f'{"Unshared [s]":>12}  {"Shared [s]":>10}  {"Speedup":>7}')
+    print(f'{u:>12.2f}  {s:>10.2f}  {u / s:>6.2f}x')
+
+    outputs = {name: contents(os.path.join(work_dir, f'multivar_benchmark_{name}.root')) for name in configs}
+    if outputs['shared'] != outputs['unshared']:
+        print('The outputs with and without the shared tuples differ.')
+        return 1
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
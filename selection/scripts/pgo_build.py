@@ -0,0 +1,211 @@
+#!/usr/bin/env python3
+"""
+Builds the selection and systematics programs with profile-guided and
+link-time optimization, and reports the speedup against the plain release
+build. The build runs in three stages, each in a subdirectory of the build
+directory:
+
+1. release: a plain release build of main, validate, and run_systematics.
+   Its validate program writes the synthetic training workload (see the
+   "--workload" mode of validate.cc).
+2. pgo (SPINE_PGO=GENERATE): an instrumented build of main and
+   run_systematics, which is trained on the workload: main runs the
+   selection of toml/pgo_training.toml, and run_systematics the
+   systematics of systematics/toml/pgo_training.toml on its output.
+3. pgo (SPINE_PGO=USE, SPINE_LTO=ON): the same build directory, rebuilt
+   with the collected profiles and link-time optimization.
+
+The workload is then timed with the release and optimized programs (the
+best of several repetitions), and the outputs of the selection are checked
+to have the same entries. See cmake/ProfileGuided.cmake for the options.
+
+Usage
+-----
+pgo_build.py [--build <dir>] [--events <n>] [--repeat <n>] [--jobs <n>] [--no-lto]
+"""
+import os
+import sys
+import glob
+import time
+import shutil
+import argparse
+import subprocess
+
+SOURCE = os.path.abspath(os.path.join(os.path.dirname(__file__), '..', '..'))
+SELECTION_CONFIG = os.path.join(SOURCE, 'selection', 'toml', 'pgo_training.toml')
+SYSTEMATICS_CONFIG = os.path.join(SOURCE, 'systematics', 'toml', 'pgo_training.toml')
+
+def run(command, cwd=None) -> float:
+    """
+    Runs a command, failing if it fails.
+
+    Parameters
+    ----------
+    command : list[str]
+        The command.
+    cwd : str, optional
+        The working directory of the command.
+
+    Returns
+    -------
+    float
+        The wall time of the command in seconds.
+    """
+    print('+ ' + ' '.join(command), flush=True)
+    start = time.monotonic()
+    code = subprocess.call(command, cwd=cwd, stdout=subprocess.DEVNULL if cwd else None)
+    if code != 0:
+        sys.exit(f'Command failed with code {code}: {" ".join(command)}')
+    return time.monotonic() - start
+
+def build(directory, options, targets, jobs) -> None:
+    """
+    Configures and builds targets of the project.
+
+    Parameters
+    ----------
+    directory : str
+        The build directory.
+    options : dict[str, str]
+        The cache options of the configuration.
+    targets : list[str]
+        The targets to build.
+    jobs : int
+        The number of parallel build jobs.
+
+    Returns
+    -------
+    None
+    """
+    run(['cmake', '-S', SOURCE, '-B', directory, '-DCMAKE_BUILD_TYPE=Release']
+        + [f'-D{k}={v}' for k, v in options.items()])
+    run(['cmake', '--build', directory, '-j', str(jobs), '--target'] + targets)
+
+def programs(directory) -> dict:
+    """
+    Finds the programs of a build directory.
+
+    Parameters
+    ----------
+    directory : str
+        The build directory.
+
+    Returns
+    -------
+    dict[str, str]
+        The paths of the programs, keyed by name.
+    """
+    return {'main': os.path.join(directory, 'selection', 'main'),
+            'validate': os.path.join(directory, 'selection', 'validate'),
+            'run_systematics': os.path.join(directory, 'systematics', 'run_systematics')}
+
+def workload(paths, directory) -> dict:
+    """
+    Runs the training workload.
+
+    Parameters
+    ----------
+    paths : dict[str, str]
+        The paths of the programs.
+    directory : str
+        The directory of the workload.
+
+    Returns
+    -------
+    dict[str, float]
+        The wall time of each program in seconds.
+    """
+    return {'main': run([paths['main'], SELECTION_CONFIG], cwd=directory),
+            'run_systematics': run([paths['run_systematics'], SYSTEMATICS_CONFIG], cwd=directory)}
+
+def entries(path) -> dict:
+    """
+    Counts the entries of the trees of a ROOT file.
+
+    Parameters
+    ----------
+    path : str
+        The path of the file.
+
+    Returns
+    -------
+    dict[str, int]
+        The number of entries of each tree, keyed by path (empty if uproot is
+        not available).
+    """
+    try:
+        import uproot
+    except ImportError:
+        return dict()
+    with uproot.open(path) as f:
+        return {k: f[k].num_entries for k, c in f.classnames().items() if c == 'TTree'}
+
+def main() -> int:
+    """
+    Runs the stages of the profile-guided build and reports the speedup.
+
+    Returns
+    -------
+    int
+        Zero on success, or one if the outputs differ.
+    """
+    parser = argparse.ArgumentParser(description=__doc__.split('\n\n')[0])
+    parser.add_argument('--build', default=os.path.join(SOURCE, 'build_pgo'), help='the build directory')
+    parser.add_argument('--events', type=int, default=20000, help='the number of events of the workload')
+    parser.add_argument('--repeat', type=int, default=3, help='the number of timed repetitions')
+    parser.add_argument('--jobs', type=int, default=os.cpu_count(), help='the number of parallel build jobs')
+    parser.add_argument('--no-lto', action='store_true', help='skip the link-time optimization')
+    args = parser.parse_args()
+
+    build_dir = os.path.abspath(args.build)
+    release_dir = os.path.join(build_dir, 'release')
+    pgo_dir = os.path.join(build_dir, 'pgo')
+    profiles = os.path.join(pgo_dir, 'profiles')
+    work_dir = os.path.join(build_dir, 'workload')
+    os.makedirs(work_dir, exist_ok=True)
+
+    # Stage 1: the plain release build and the workload.
+    build(release_dir, {'SPINE_PGO': 'OFF', 'SPINE_LTO': 'OFF'}, ['main', 'validate', 'run_systematics'], args.jobs)
+    release = programs(release_dir)
+    run([release['validate'], '--workload', str(args.events), 'pgo_workload.root'], cwd=work_dir)
+
+    # Stage 2: the instrumented build, trained on the workload. Stale
+    # profiles of a previous training are removed first.
+    shutil.rmtree(profiles, ignore_errors=True)
+    build(pgo_dir, {'SPINE_PGO': 'GENERATE', 'SPINE_PGO_DIR': profiles, 'SPINE_LTO': 'OFF'}, ['main', 'run_systematics'], args.jobs)
+    optimized = programs(pgo_dir)
+    workload(optimized, work_dir)
+
+    # Clang writes raw profiles, which are merged into one profile.
+    raw = glob.glob(os.path.join(profiles, '*.profraw'))
+    if raw:
+        run([os.environ.get('LLVM_PROFDATA', 'llvm-profdata'), 'merge', '-output=' + os.path.join(profiles, 'default.profdata')] + raw)
+
+    # Stage 3: the optimized build in the same directory.
+    build(pgo_dir, {'SPINE_PGO': 'USE', 'SPINE_PGO_DIR': profiles, 'SPINE_LTO': 'OFF' if args.no_lto else 'ON'},
+          ['main', 'run_systematics'], args.jobs)
+
+    # Time the workload with both builds, alternating between the builds so
+    # that drifts of the machine affect both alike.
+    times = {'release': dict(), 'optimized': dict()}
+    outputs = dict()
+    for _ in range(args.repeat):
+        for name, paths in (('release', release), ('optimized', optimized)):
+            for program, seconds in workload(paths, work_dir).items():
+                times[name][program] = min(seconds, times[name].get(program, float('inf')))
+            outputs[name] = entries(os.path.join(work_dir, 'pgo_training.root'))
+
+    print(f'{"Program":<16}  {"Release [s]":>11}  {"PGO+LTO [s]":>11}  {"Speedup":>7}')
+    for program in ('main', 'run_systematics'):
+        r, o = times['release'][program], times['optimized'][program]
+        print(f'{program:<16}  {r:>11.2f}  {o:>11.2f}  {r / o:>6.2f}x')
+    r, o = sum(times['release'].values()), sum(times['optimized'].values())
+    print(f'{"Total":<16}  {r:>11.2f}  {o:>11.2f}  {r / o:>6.2f}x')
+
+    if outputs['release'] != outputs['optimized']:
+        print('The outputs of the release and optimized builds differ.')
+        return 1
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
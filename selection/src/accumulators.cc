@@ -0,0 +1,278 @@
+/**
+ * @file accumulators.cc
+ * @brief Implementation of the in-pass sufficient-statistics accumulators of
+ * the SPINE analysis framework.
+ * @details This file contains the implementation of the statistics, the
+ * wrapping of the tree variables, and the output declared in
+ * accumulators.h.
+ * @author mueller@fnal.gov
+ */
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+#include "sbnanaobj/StandardRecord/Proxy/SRProxy.h"
+
+#include "TTree.h"
+#include "TH2D.h"
+
+#include "accumulators.h"
+
+namespace accumulators
+{
+    // Read the configuration of an accumulator.
+    Config configure(const cfg::ConfigurationTable & table)
+    {
+        Config config;
+        config.name = table.get_string_field("name");
+        config.reco = table.get_string_field("reco");
+        config.truth = table.get_string_field("true");
+        config.bin = table.get_string_field("bin");
+        config.weight = table.get_string_field("weight", "");
+        if(!table.has_field("edges"))
+            throw cfg::ConfigurationError("Accumulator " + config.name + " has no bin edges.");
+        config.edges = table.get_double_vector("edges");
+        if(config.edges.size() < 2 || !std::is_sorted(config.edges.begin(), config.edges.end(), std::less_equal<double>()))
+            throw cfg::ConfigurationError("The bin edges of accumulator " + config.name + " must be increasing.");
+        if(table.has_field("sketch"))
+        {
+            const std::vector<double> sketch(table.get_double_vector("sketch"));
+            if(sketch.size() != 3 || sketch[0] < 1 || !(sketch[2] > sketch[1]))
+                throw cfg::ConfigurationError("Field sketch of accumulator " + config.name + " must be [bins, low edge, high edge].");
+            config.sketch_bins = static_cast<size_t>(sketch[0]);
+            config.sketch_low = sketch[1];
+            config.sketch_high = sketch[2];
+        }
+        const std::string residual(table.get_string_field("residual", "relative"));
+        if(residual != "relative" && residual != "difference")
+            throw cfg::ConfigurationError("Illegal residual '" + residual + "' for accumulator " + config.name + ".");
+        config.relative = (residual == "relative");
+        return config;
+    }
+
+    // Add a (reco, true) pair.
+    void Bin::add(double reco, double truth, double w)
+    {
+        const double total(sum_w + w);
+        if(total == 0)
+            return;
+        const double dx(reco - mean_reco), dy(truth - mean_true);
+        mean_reco += w / total * dx;
+        mean_true += w / total * dy;
+        m2_reco += w * dx * (reco - mean_reco);
+        m2_true += w * dy * (truth - mean_true);
+        c_reco_true += w * dx * (truth - mean_true);
+        sum_w = total;
+        sum_w2 += w * w;
+        ++count;
+    }
+
+    // Merge the statistics of another bin.
+    void Bin::merge(const Bin & other)
+    {
+        const double total(sum_w + other.sum_w);
+        if(total != 0)
+        {
+            const double dx(other.mean_reco - mean_reco), dy(other.mean_true - mean_true);
+            const double f(sum_w * other.sum_w / total);
+            m2_reco += other.m2_reco + dx * dx * f;
+            m2_true += other.m2_true + dy * dy * f;
+            c_reco_true += other.c_reco_true + dx * dy * f;
+            mean_reco += dx * other.sum_w / total;
+            mean_true += dy * other.sum_w / total;
+        }
+        sum_w = total;
+        sum_w2 += other.sum_w2;
+        count += other.count;
+        if(sketch.size() < other.sketch.size())
+            sketch.resize(other.sketch.size());
+        for(size_t i(0); i < other.sketch.size(); ++i)
+            sketch[i] += other.sketch[i];
+    }
+
+    // Get the weighted standard deviation of reco - true.
+    double Bin::resolution() const
+    {
+        if(sum_w == 0)
+            return std::numeric_limits<double>::quiet_NaN();
+        return std::sqrt(std::max(0.0, (m2_reco + m2_true - 2 * c_reco_true) / sum_w));
+    }
+
+    // Get the slope of the regression of the reco value on the true value.
+    double Bin::slope() const
+    {
+        return m2_true > 0 ? c_reco_true / m2_true : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    // Get a quantile of a residual sketch.
+    double quantile(const Config & config, const Bin & bin, double q)
+    {
+        double total(0);
+        for(double c : bin.sketch)
+            total += c;
+        if(config.sketch_bins == 0 || !(total > 0))
+            return std::numeric_limits<double>::quiet_NaN();
+        const double width((config.sketch_high - config.sketch_low) / config.sketch_bins);
+        const double target(std::clamp(q, 0.0, 1.0) * total);
+        double cumulative(bin.sketch[0]);
+        if(target <= cumulative)
+            return config.sketch_low;
+        for(size_t i(1); i <= config.sketch_bins; ++i)
+        {
+            const double c(bin.sketch[i]);
+            if(c > 0 && target <= cumulative + c)
+                return config.sketch_low + (i - 1 + (target - cumulative) / c) * width;
+            cumulative += c;
+        }
+        return config.sketch_high;
+    }
+
+    // Constructor for the Accumulator class.
+    Accumulator::Accumulator(std::string tree, Config config)
+        : tree_(std::move(tree)), config_(std::move(config)), bins_(config_.edges.size() - 1)
+    {
+        for(Bin & b : bins_)
+            b.sketch.assign(config_.sketch_bins > 0 ? config_.sketch_bins + 2 : 0, 0.0);
+    }
+
+    // Wrap the SpillMultiVars of the tree to accumulate their values.
+    std::vector<ana::SpillMultiVar> Accumulator::wrap(const std::vector<std::string> & names, const std::vector<ana::SpillMultiVar> & vars)
+    {
+        auto index = [&](const std::string & branch) -> long
+        {
+            if(branch.empty())
+                return -1;
+            auto it(std::find(names.begin(), names.end(), branch));
+            if(it == names.end())
+                throw std::runtime_error("Accumulator " + config_.name + " uses branch " + branch + ", which is not in tree " + tree_ + ".");
+            return it - names.begin();
+        };
+        const std::vector<std::pair<long, std::vector<double> *>> targets{
+            {index(config_.reco), &reco_}, {index(config_.truth), &truth_}, {index(config_.bin), &bin_}, {index(config_.weight), &weight_}};
+
+        std::vector<ana::SpillMultiVar> result;
+        for(size_t k(0); k < vars.size(); ++k)
+        {
+            std::vector<std::vector<double> *> keep;
+            for(const auto & [i, target] : targets)
+                if(i == static_cast<long>(k))
+                    keep.push_back(target);
+            const bool last(k + 1 == vars.size());
+            if(keep.empty() && !last)
+            {
+                result.push_back(vars[k]);
+                continue;
+            }
+            ana::SpillMultiVar var(vars[k]);
+            result.push_back(ana::SpillMultiVar([this, var, keep, last](const caf::Proxy<caf::StandardRecord> * sr) -> std::vector<double>
+            {
+                std::vector<double> values(var(sr));
+                for(std::vector<double> * target : keep)
+                    *target = values;
+                if(last)
+                    flush();
+                return values;
+            }));
+        }
+        return result;
+    }
+
+    // Add the rows of the values kept for a spill.
+    void Accumulator::flush()
+    {
+        const bool weighted(!config_.weight.empty());
+        const size_t rows(std::min({reco_.size(), truth_.size(), bin_.size(), weighted ? weight_.size() : bin_.size()}));
+        const double width(config_.sketch_bins > 0 ? (config_.sketch_high - config_.sketch_low) / config_.sketch_bins : 0);
+        for(size_t r(0); r < rows; ++r)
+        {
+            const double reco(reco_[r]), truth(truth_[r]), x(bin_[r]), w(weighted ? weight_[r] : 1.0);
+            if(std::isnan(reco) || std::isnan(truth) || std::isnan(x) || std::isnan(w) || w == 0)
+                continue;
+            if(x < config_.edges.front() || x >= config_.edges.back())
+                continue;
+            const size_t b(std::upper_bound(config_.edges.begin(), config_.edges.end(), x) - config_.edges.begin() - 1);
+            Bin & bin(bins_[b]);
+            bin.add(reco, truth, w);
+            if(config_.sketch_bins > 0)
+            {
+                const double residual(config_.relative ? (reco - truth) / truth : reco - truth);
+                size_t s(0);
+                if(std::isnan(residual) || residual >= config_.sketch_high)
+                    s = config_.sketch_bins + 1;
+                else if(residual >= config_.sketch_low)
+                    s = std::min(config_.sketch_bins, static_cast<size_t>((residual - config_.sketch_low) / width) + 1);
+                bin.sketch[s] += w;
+            }
+        }
+        reco_.clear();
+        truth_.clear();
+        bin_.clear();
+        weight_.clear();
+    }
+
+    // Write the statistics (and the sketch) to a directory.
+    std::string Accumulator::SaveTo(TDirectory * dir) const
+    {
+        TDirectory::TContext context(dir);
+        const std::string name(tree_ + "_" + config_.name);
+        TTree tree(name.c_str(), name.c_str());
+        tree.SetDirectory(nullptr);
+        int index;
+        Long64_t count;
+        double low, high, sum_w, sum_w2, mean_reco, mean_true, m2_reco, m2_true, c_reco_true;
+        double bias, resolution, slope, intercept, median, width68;
+        tree.Branch("bin", &index, "bin/I");
+        tree.Branch("low", &low, "low/D");
+        tree.Branch("high", &high, "high/D");
+        tree.Branch("count", &count, "count/L");
+        tree.Branch("sum_w", &sum_w, "sum_w/D");
+        tree.Branch("sum_w2", &sum_w2, "sum_w2/D");
+        tree.Branch("mean_reco", &mean_reco, "mean_reco/D");
+        tree.Branch("mean_true", &mean_true, "mean_true/D");
+        tree.Branch("m2_reco", &m2_reco, "m2_reco/D");
+        tree.Branch("m2_true", &m2_true, "m2_true/D");
+        tree.Branch("c_reco_true", &c_reco_true, "c_reco_true/D");
+        tree.Branch("bias", &bias, "bias/D");
+        tree.Branch("resolution", &resolution, "resolution/D");
+        tree.Branch("slope", &slope, "slope/D");
+        tree.Branch("intercept", &intercept, "intercept/D");
+        tree.Branch("median", &median, "median/D");
+        tree.Branch("width68", &width68, "width68/D");
+        for(size_t b(0); b < bins_.size(); ++b)
+        {
+            const Bin & bin(bins_[b]);
+            index = static_cast<int>(b);
+            low = config_.edges[b];
+            high = config_.edges[b + 1];
+            count = static_cast<Long64_t>(bin.count);
+            sum_w = bin.sum_w;
+            sum_w2 = bin.sum_w2;
+            mean_reco = bin.mean_reco;
+            mean_true = bin.mean_true;
+            m2_reco = bin.m2_reco;
+            m2_true = bin.m2_true;
+            c_reco_true = bin.c_reco_true;
+            bias = bin.bias();
+            resolution = bin.resolution();
+            slope = bin.slope();
+            intercept = bin.intercept();
+            median = quantile(config_, bin, 0.5);
+            width68 = 0.5 * (quantile(config_, bin, 0.84) - quantile(config_, bin, 0.16));
+            tree.Fill();
+        }
+        dir->WriteTObject(&tree, name.c_str());
+
+        if(config_.sketch_bins > 0)
+        {
+            TH2D sketch((name + "_sketch").c_str(), (name + ";" + config_.bin + ";" + (config_.relative ? "(reco - true) / true" : "reco - true")).c_str(),
+                        bins_.size(), config_.edges.data(), config_.sketch_bins, config_.sketch_low, config_.sketch_high);
+            sketch.SetDirectory(nullptr);
+            for(size_t b(0); b < bins_.size(); ++b)
+                for(size_t s(0); s < config_.sketch_bins + 2; ++s)
+                    sketch.SetBinContent(b + 1, s, bins_[b].sketch[s]);
+            dir->WriteTObject(&sketch, (name + "_sketch").c_str());
+        }
+        return name;
+    }
+}
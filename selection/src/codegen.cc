@@ -0,0 +1,296 @@
+/**
+ * @file codegen.cc
+ * @brief Implementation of the generation of specialized selection
+ * libraries.
+ * @details This file contains the implementation of the recording of the
+ * functions looked up by the selection, the generation and compilation of
+ * the translation unit calling them directly, and the loading of the
+ * compiled library.
+ * @author mueller@fnal.gov
+ */
+#include <set>
+#include <map>
+#include <cmath>
+#include <mutex>
+#include <tuple>
+#include <cstdio>
+#include <limits>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include <link.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "sbnanaobj/StandardRecord/Proxy/SRProxy.h"
+
+#include "codegen.h"
+#include "codegen_config.h"
+
+namespace
+{
+    /**
+     * @struct Record
+     * @brief A function looked up by the selection, bound to a parameter set.
+     */
+    struct Record
+    {
+        std::string value;              ///< The return type of the function.
+        std::string type;               ///< The type of object the function is applied to.
+        std::string name;               ///< The registered name of the function.
+        std::vector<double> params;     ///< The parameters of the function.
+
+        bool operator<(const Record & other) const
+        {
+            return std::tie(value, type, name, params) < std::tie(other.value, other.type, other.name, other.params);
+        }
+    };
+
+    // The recorded functions.
+    std::mutex mutex;
+    bool recording(false);
+    std::set<Record> records;
+
+    /**
+     * @brief Write a parameter as an exact C++ literal.
+     * @param v The parameter.
+     * @return The literal (a hexadecimal floating point literal if finite).
+     */
+    std::string literal(double v)
+    {
+        if(std::isnan(v))
+            return "std::numeric_limits<double>::quiet_NaN()";
+        if(std::isinf(v))
+            return std::string(v < 0 ? "-" : "") + "std::numeric_limits<double>::infinity()";
+        char buffer[64];
+        std::snprintf(buffer, sizeof(buffer), "%a", v);
+        return buffer;
+    }
+
+    /**
+     * @brief Create a directory and its parents.
+     * @param path The path of the directory.
+     * @return void
+     */
+    void make_directories(const std::string & path)
+    {
+        for(size_t pos(path.find('/', 1)); ; pos = path.find('/', pos + 1))
+        {
+            mkdir(path.substr(0, pos).c_str(), 0755);
+            if(pos == std::string::npos)
+                break;
+        }
+    }
+}
+
+namespace codegen
+{
+    // Build the key of a function bound to a parameter set.
+    std::string key(const std::string & name, const std::vector<double> & params)
+    {
+        std::string result(name + "|");
+        char buffer[64];
+        for(size_t i(0); i < params.size(); ++i)
+        {
+            std::snprintf(buffer, sizeof(buffer), "%a", params[i]);
+            result += (i > 0 ? "," : "") + std::string(buffer);
+        }
+        return result;
+    }
+
+    // Look up a function bound to a parameter set.
+    template<typename ValueT, typename EventT>
+    std::function<std::function<ValueT(const EventT&)>(const std::vector<double>&)> lookup(const std::string & name)
+    {
+        using FnT = std::function<ValueT(const EventT&)>;
+        std::function<FnT(const std::vector<double>&)> factory(Registry<std::function<FnT(const std::vector<double>&)>>::instance().get(name));
+        return [factory, name](const std::vector<double> & params) -> FnT
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if(recording)
+                    records.insert(Record{type_key<ValueT>(), type_key<EventT>(), name, params});
+            }
+            const std::string k(key(name, params));
+            if(Registry<FnT>::instance().is_registered(k))
+                return Registry<FnT>::instance().get(k);
+            return factory(params);
+        };
+    }
+
+    // Enable the recording of the functions looked up by the selection.
+    void record()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        recording = true;
+    }
+
+    // Compute the hash identifying the library of a configuration.
+    std::string config_hash(const std::string & path)
+    {
+        std::ifstream input(path, std::ios::binary);
+        if(!input)
+            throw std::runtime_error("Unable to read configuration file " + path + ".");
+        std::ostringstream contents;
+        contents << input.rdbuf();
+
+        uint64_t hash(0xcbf29ce484222325ULL);
+        auto mix = [&hash](const std::string & bytes)
+        {
+            for(unsigned char c : bytes)
+            {
+                hash ^= c;
+                hash *= 0x100000001b3ULL;
+            }
+        };
+        mix(contents.str());
+
+        // The executable and every loaded library (e.g., the registration
+        // library) contribute their size and modification time. The
+        // executable is listed with an empty name.
+        std::vector<std::string> objects;
+        dl_iterate_phdr([](struct dl_phdr_info * info, size_t, void * data) -> int
+        {
+            const std::string name(info->dlpi_name && info->dlpi_name[0] != '\0' ? info->dlpi_name : "/proc/self/exe");
+            static_cast<std::vector<std::string> *>(data)->push_back(name);
+            return 0;
+        }, &objects);
+        for(const std::string & object : objects)
+        {
+            struct stat st;
+            if(stat(object.c_str(), &st) == 0)
+                mix(std::to_string(st.st_size) + ":" + std::to_string(st.st_mtime));
+        }
+        mix(SPINE_CODEGEN_COMMAND);
+
+        char buffer[17];
+        std::snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long)hash);
+        return buffer;
+    }
+
+    // Load a generated library.
+    bool load(const std::string & path)
+    {
+        if(access(path.c_str(), R_OK) != 0)
+            return false;
+        void * handle(dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL));
+        if(!handle)
+        {
+            std::cerr << "Unable to load compiled selection " << path << " (" << dlerror() << "); using the interpreted selection." << std::endl;
+            return false;
+        }
+        auto entry = reinterpret_cast<size_t (*)()>(dlsym(handle, "spine_register_compiled"));
+        if(!entry)
+        {
+            std::cerr << "Compiled selection " << path << " has no entry point; using the interpreted selection." << std::endl;
+            dlclose(handle);
+            return false;
+        }
+        size_t n(entry());
+        std::cout << "Loaded compiled selection " << path << " (" << n << " functions)." << std::endl;
+        return true;
+    }
+
+    // Write the translation unit of the recorded functions.
+    size_t generate(const std::string & path, const std::string & config)
+    {
+        std::map<std::pair<std::string, std::string>, std::vector<std::pair<std::string, size_t>>> entries;
+        std::ostringstream functions;
+        size_t n(0);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for(const Record & r : records)
+            {
+                // Functions registered without a symbol (e.g., outside of the
+                // registration macros) stay on the interpreted path.
+                const std::string symbol_key(r.value + "/" + r.type + "/" + r.name);
+                if(!SymbolRegistry::instance().is_registered(symbol_key))
+                    continue;
+                const std::string symbol(SymbolRegistry::instance().get(symbol_key));
+                const size_t split(symbol.rfind('|'));
+                const std::string fn(symbol.substr(0, split));
+                if(fn.empty())
+                    continue;
+                const bool parametrized(symbol.substr(split + 1) == "1");
+
+                functions << "\n    // " << key(r.name, r.params) << "\n";
+                if(parametrized)
+                {
+                    functions << "    const std::vector<double> p" << n << "{";
+                    for(size_t i(0); i < r.params.size(); ++i)
+                        functions << (i > 0 ? ", " : "") << literal(r.params[i]);
+                    functions << "};\n";
+                }
+                functions << "    " << r.value << " f" << n << "(const " << r.type << " & e) { return "
+                          << fn << "(e" << (parametrized ? ", p" + std::to_string(n) : "") << "); }\n";
+                entries[std::make_pair(r.value, r.type)].emplace_back(key(r.name, r.params), n);
+                ++n;
+            }
+        }
+
+        const size_t slash(path.rfind('/'));
+        if(slash != std::string::npos && slash > 0)
+            make_directories(path.substr(0, slash));
+        std::ofstream output(path);
+        if(!output)
+            throw std::runtime_error("Unable to write compiled selection source " + path + ".");
+        output << "/**\n"
+               << " * @file " << path.substr(slash == std::string::npos ? 0 : slash + 1) << "\n"
+               << " * @brief Specialized cuts and variables of the configuration " << config << ".\n"
+               << " * @details Generated by codegen::generate; do not edit.\n"
+               << " */\n"
+               << "#define SPINE_NO_REGISTRATION\n"
+               << "#include <limits>\n"
+               << "#include \"library.h\"\n"
+               << "#include \"codegen.h\"\n\n"
+               << "namespace\n{" << functions.str();
+        size_t array(0);
+        for(const auto & [types, list] : entries)
+        {
+            output << "\n    const codegen::Entry<" << types.first << ", " << types.second << "> entries" << array++ << "[] = {\n";
+            for(const auto & [k, index] : list)
+                output << "        {\"" << k << "\", &f" << index << "},\n";
+            output << "    };\n";
+        }
+        output << "}\n\n"
+               << "extern \"C\" size_t spine_register_compiled()\n{\n";
+        for(size_t i(0); i < array; ++i)
+            output << "    codegen::install(entries" << i << ");\n";
+        output << "    return " << n << ";\n}\n";
+        return n;
+    }
+
+    // Compile a generated translation unit into a shared library.
+    bool compile(const std::string & source, const std::string & library)
+    {
+        const std::string temporary(library + ".tmp" + std::to_string(getpid()));
+        const std::string command(std::string(SPINE_CODEGEN_COMMAND) + " -o '" + temporary + "' '" + source + "'");
+        std::cout << "Compiling selection library " << library << std::endl;
+        if(std::system(command.c_str()) != 0 || std::rename(temporary.c_str(), library.c_str()) != 0)
+        {
+            std::remove(temporary.c_str());
+            std::cerr << "Unable to compile selection library " << library << "." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Explicit instantiations for the types of the registries.
+    template std::function<CutFn<TType>(const std::vector<double>&)> lookup<bool, TType>(const std::string &);
+    template std::function<CutFn<RType>(const std::vector<double>&)> lookup<bool, RType>(const std::string &);
+    template std::function<CutFn<TParticleType>(const std::vector<double>&)> lookup<bool, TParticleType>(const std::string &);
+    template std::function<CutFn<RParticleType>(const std::vector<double>&)> lookup<bool, RParticleType>(const std::string &);
+    template std::function<CutFn<EventType>(const std::vector<double>&)> lookup<bool, EventType>(const std::string &);
+    template std::function<CutFn<SpillType>(const std::vector<double>&)> lookup<bool, SpillType>(const std::string &);
+    template std::function<VarFn<TType>(const std::vector<double>&)> lookup<double, TType>(const std::string &);
+    template std::function<VarFn<RType>(const std::vector<double>&)> lookup<double, RType>(const std::string &);
+    template std::function<VarFn<MCTruth>(const std::vector<double>&)> lookup<double, MCTruth>(const std::string &);
+    template std::function<VarFn<TParticleType>(const std::vector<double>&)> lookup<double, TParticleType>(const std::string &);
+    template std::function<VarFn<RParticleType>(const std::vector<double>&)> lookup<double, RParticleType>(const std::string &);
+    template std::function<VarFn<EventType>(const std::vector<double>&)> lookup<double, EventType>(const std::string &);
+    template std::function<SelectorFn<TType>(const std::vector<double>&)> lookup<size_t, TType>(const std::string &);
+    template std::function<SelectorFn<RType>(const std::vector<double>&)> lookup<size_t, RType>(const std::string &);
+}
@@ -0,0 +1,241 @@
+/**
+ * @file columnar.cc
+ * @brief Implementation of the in-memory columnar export of the selection
+ * results.
+ * @details This file contains the implementation of the columnar table, its
+ * export through the Arrow C Data Interface, and its publication to POSIX
+ * shared memory.
+ * @author mueller@fnal.gov
+ */
+#include <cstring>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "columnar.h"
+
+namespace
+{
+    // The names of the index columns, as written by ana::Tree.
+    const char * index_names[3] = {"Run", "Subrun", "Evt"};
+
+    /**
+     * @brief Private data of an exported schema or array.
+     * @details This keeps the table alive for as long as the consumer holds
+     * the exported structures, and owns the arrays of child pointers.
+     */
+    struct Exported
+    {
+        std::shared_ptr<const columnar::Table> table;
+        std::vector<std::string> names;
+        std::vector<ArrowSchema> schemas;
+        std::vector<ArrowSchema *> schema_ptrs;
+        std::vector<ArrowArray> arrays;
+        std::vector<ArrowArray *> array_ptrs;
+        std::vector<const void *> buffers;
+    };
+
+    // Release a child schema (owned by the parent).
+    void release_child_schema(ArrowSchema * schema)
+    {
+        schema->release = nullptr;
+    }
+
+    // Release a child array (owned by the parent).
+    void release_child_array(ArrowArray * array)
+    {
+        array->release = nullptr;
+    }
+
+    // Release the top-level schema.
+    void release_schema(ArrowSchema * schema)
+    {
+        for(int64_t i(0); i < schema->n_children; ++i)
+            if(schema->children[i]->release)
+                schema->children[i]->release(schema->children[i]);
+        delete static_cast<Exported *>(schema->private_data);
+        schema->release = nullptr;
+    }
+
+    // Release the top-level array.
+    void release_array(ArrowArray * array)
+    {
+        for(int64_t i(0); i < array->n_children; ++i)
+            if(array->children[i]->release)
+                array->children[i]->release(array->children[i]);
+        delete static_cast<Exported *>(array->private_data);
+        array->release = nullptr;
+    }
+
+    /**
+     * @brief Escape a string for use in the JSON schema.
+     * @param s The string to escape.
+     * @return The escaped string.
+     */
+    std::string escape(const std::string & s)
+    {
+        std::string result;
+        for(char c : s)
+        {
+            if(c == '"' || c == '\\')
+                result += '\\';
+            result += c;
+        }
+        return result;
+    }
+
+    // Placeholder data buffer for empty columns (buffers must not be null).
+    alignas(64) const double empty_buffer[1] = {0};
+
+    // Round up to the Arrow buffer alignment.
+    size_t align(size_t n)
+    {
+        return (n + 63) & ~size_t(63);
+    }
+}
+
+namespace columnar
+{
+    // Constructor for the Table class.
+    Table::Table(const std::string & name, const std::vector<std::string> & names)
+        : name_(name), names_(names), values_(names.size()) {}
+
+    // Append the index columns for the rows of a spill.
+    void Table::append_index(int32_t run, int32_t subrun, int32_t event, size_t n)
+    {
+        index_[0].insert(index_[0].end(), n, run);
+        index_[1].insert(index_[1].end(), n, subrun);
+        index_[2].insert(index_[2].end(), n, event);
+    }
+
+    // Append the values of a branch column for a spill.
+    void Table::append(size_t column, const std::vector<double> & values)
+    {
+        values_[column].insert(values_[column].end(), values.begin(), values.end());
+    }
+
+    // Get the names of all columns (index columns first).
+    std::vector<std::string> Table::column_names() const
+    {
+        std::vector<std::string> result(index_names, index_names + 3);
+        result.insert(result.end(), names_.begin(), names_.end());
+        return result;
+    }
+
+    // Get the data buffer of a column.
+    const void * Table::data(size_t column) const
+    {
+        return column < 3 ? (const void *)index_[column].data() : (const void *)values_[column - 3].data();
+    }
+
+    // Get the size of the data buffer of a column.
+    size_t Table::bytes(size_t column) const
+    {
+        return column < 3 ? index_[column].size() * sizeof(int32_t) : values_[column - 3].size() * sizeof(double);
+    }
+
+    // Export a table through the Arrow C Data Interface.
+    void export_table(const std::shared_ptr<const Table> & table, ArrowSchema * schema, ArrowArray * array)
+    {
+        const size_t n(table->columns());
+        const int64_t rows(table->rows());
+
+        // The schema and the array are released independently, so each gets
+        // its own private data (both referencing the table).
+        Exported * s(new Exported{table, table->column_names(), std::vector<ArrowSchema>(n), {}, {}, {}, {}});
+        for(size_t i(0); i < n; ++i)
+        {
+            s->schemas[i] = ArrowSchema{table->format(i), s->names[i].c_str(), nullptr, 0, 0,
+                                        nullptr, nullptr, &release_child_schema, nullptr};
+            s->schema_ptrs.push_back(&s->schemas[i]);
+        }
+        *schema = ArrowSchema{"+s", "", nullptr, 0, (int64_t)n, s->schema_ptrs.data(), nullptr, &release_schema, s};
+
+        // Each child array has two buffers: no validity bitmap (the missing
+        // values are NaN, as in the ROOT output) and the data buffer.
+        Exported * a(new Exported{table, {}, {}, {}, std::vector<ArrowArray>(n), {}, std::vector<const void *>(2 * n + 1, nullptr)});
+        for(size_t i(0); i < n; ++i)
+        {
+            a->buffers[2 * i + 1] = rows > 0 ? table->data(i) : empty_buffer;
+            a->arrays[i] = ArrowArray{rows, 0, 0, 2, 0, &a->buffers[2 * i], nullptr, nullptr, &release_child_array, nullptr};
+            a->array_ptrs.push_back(&a->arrays[i]);
+        }
+        *array = ArrowArray{rows, 0, 0, 1, (int64_t)n, &a->buffers[2 * n], a->array_ptrs.data(), nullptr, &release_array, a};
+    }
+
+    // Publish a table to a POSIX shared memory segment.
+    void publish(const Table & table, const std::string & shm_name)
+    {
+        // Lay out the data buffers after the header and the JSON schema. The
+        // offsets depend on the length of the schema, which in turn depends on
+        // the offsets, so the schema is padded to a fixed width per column.
+        const size_t n(table.columns());
+        const std::vector<std::string> names(table.column_names());
+        std::vector<size_t> offsets(n);
+        std::string schema;
+        size_t reserve(128 + escape(table.name()).size());
+        for(const std::string & name : names)
+            reserve += escape(name).size() + 128;
+        size_t offset(align(32 + reserve));
+        std::ostringstream json;
+        json << "{\"name\": \"" << escape(table.name()) << "\", \"rows\": " << table.rows() << ", \"columns\": [";
+        for(size_t i(0); i < n; ++i)
+        {
+            offsets[i] = offset;
+            json << (i > 0 ? ", " : "") << "{\"name\": \"" << escape(names[i]) << "\", \"format\": \"" << table.format(i)
+                 << "\", \"offset\": " << offset << ", \"length\": " << table.bytes(i) << "}";
+            offset = align(offset + table.bytes(i));
+        }
+        json << "]}";
+        schema = json.str();
+        if(schema.size() > reserve)
+            throw std::logic_error("The schema of table " + table.name() + " exceeds its reserved space.");
+        const size_t total(std::max<size_t>(offset, align(32 + reserve)));
+
+        shm_unlink(shm_name.c_str());
+        int fd(shm_open(shm_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644));
+        if(fd < 0)
+            throw std::runtime_error("Unable to create shared memory segment " + shm_name + ".");
+        if(ftruncate(fd, total) != 0)
+        {
+            close(fd);
+            shm_unlink(shm_name.c_str());
+            throw std::runtime_error("Unable to size shared memory segment " + shm_name + ".");
+        }
+        void * map(mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+        close(fd);
+        if(map == MAP_FAILED)
+        {
+            shm_unlink(shm_name.c_str());
+            throw std::runtime_error("Unable to map shared memory segment " + shm_name + ".");
+        }
+
+        char * base(static_cast<char *>(map));
+        const uint32_t version(1), reserved(0);
+        const uint64_t length(schema.size()), rows(table.rows());
+        std::memcpy(base, "SPINEARW", 8);
+        std::memcpy(base + 8, &version, 4);
+        std::memcpy(base + 12, &reserved, 4);
+        std::memcpy(base + 16, &length, 8);
+        std::memcpy(base + 24, &rows, 8);
+        std::memcpy(base + 32, schema.data(), schema.size());
+        for(size_t i(0); i < n; ++i)
+            if(table.bytes(i) > 0)
+                std::memcpy(base + offsets[i], table.data(i), table.bytes(i));
+        munmap(map, total);
+    }
+
+    // Build the name of the shared memory segment of a table.
+    std::string segment_name(const std::string & prefix, const std::string & sample, const std::string & tree)
+    {
+        std::string name(prefix + "_" + sample + "_" + tree);
+        for(char & c : name)
+            if(c == '/' || c == ' ')
+                c = '_';
+        return "/" + name;
+    }
+}
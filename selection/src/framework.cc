@@ -7,7 +7,14 @@
  * @author mueller@fnal.gov
  */
 #include <map>
+#include <mutex>
+#include <atomic>
 #include <string>
+#include <vector>
+#include <iomanip>
+#include <sstream>
+#include <unordered_map>
+#include <cmath>
 #include <functional>
 #include <stdexcept>
 
@@ -16,6 +23,53 @@
 
 #include "framework.h"
 #include "configuration.h"
+#include "memo.h"
+#include "matching.h"
+#include "trace.h"
+#include "codegen.h"
+
+namespace
+{
+    /**
+     * @brief Wrap the functions produced by a factory with tracepoints.
+     * @details The primary template is used for any registry value that is
+     * not a factory of the framework and leaves it unchanged.
+     * @tparam ValueT The type of the registry value.
+     */
+    template<typename ValueT>
+    struct Traced
+    {
+        static ValueT wrap(ValueT fn, uint32_t) { return fn; }
+    };
+
+    /**
+     * @brief Wrap the functions produced by a factory with tracepoints.
+     * @details The functions produced by the factory fire the "fn_enter" and
+     * "fn_exit" probes with the id of the registry name (see
+     * @ref trace::name_id) and the address of the object.
+     * @tparam R The return type of the produced functions.
+     * @tparam E The argument type of the produced functions.
+     */
+    template<typename R, typename E>
+    struct Traced<std::function<std::function<R(const E&)>(const std::vector<double>&)>>
+    {
+        using FactoryT = std::function<std::function<R(const E&)>(const std::vector<double>&)>;
+        static FactoryT wrap(FactoryT factory, uint32_t id)
+        {
+            return [factory, id](const std::vector<double> & pars) -> std::function<R(const E&)>
+            {
+                std::function<R(const E&)> fn(factory(pars));
+                return [fn, id](const E & e) -> R
+                {
+                    SPINE_PROBE2(fn_enter, id, &e);
+                    R result(fn(e));
+                    SPINE_PROBE2(fn_exit, id, &e);
+                    return result;
+                };
+            };
+        }
+    };
+}
 
 // Get the singleton instance of the Registry.
 template<typename ValueT>
@@ -43,6 +97,7 @@ void Registry<ValueT>::register_fn(const std::string & name, ValueT fn)
         throw std::runtime_error("Function " + name + " is already registered.");
     }
     // Register the function
+    trace::name_id(name);
     registry_[name] = std::move(fn);
 }
 
@@ -55,168 +110,447 @@ ValueT Registry<ValueT>::get(const std::string & name)
     {
         throw std::runtime_error("Function " + name + " is not registered.");
     }
-    // Retrieve the function
-    return registry_[name];
+    // Retrieve the function (wrapped with tracepoints if compiled in).
+    if constexpr(trace::enabled)
+        return Traced<ValueT>::wrap(registry_[name], trace::name_id(name));
+    else
+        return registry_[name];
 }
 
-// Build a single SpillMultiVar for a single branch variable.
-NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
-                             const cfg::ConfigurationTable & var,
-                             const std::string & mode,
-                             const std::string & override_type,
-                             const bool ismc)
+namespace
 {
     /**
-     * @brief Determine the type of the cuts.
-     * @details The type of the first cut is used to determine the type of the
-     * cuts, and therefore whether the selection is applied in a loop over true
-     * or reco events. This type is used to branch the code into the appropriate
-     * path. First, we check if the mode is a valid option. If not, we throw an
-     * exception.
+     * @brief The cut functions configured by a list of cut subtables, sorted
+     * by the type of object they are applied to.
      */
-    Mode exec_mode;
-    if(mode == "true") exec_mode = Mode::True;
-    else if(mode == "reco") exec_mode = Mode::Reco;
-    else if(mode == "event") exec_mode = Mode::Event;
-    else throw std::runtime_error("Illegal mode '" + mode + "' for variable " + var.get_string_field("name"));
+    struct CutSet
+    {
+        std::vector<CutFn<TType>> true_cut_functions;
+        std::vector<CutFn<RType>> reco_cut_functions;
+        std::vector<CutFn<TParticleType>> true_particle_cut_functions;
+        std::vector<CutFn<RParticleType>> reco_particle_cut_functions;
+        std::vector<CutFn<EventType>> event_cut_functions;
+    };
 
-    std::vector<CutFn<TType>> true_cut_functions;
-    std::vector<CutFn<RType>> reco_cut_functions;
-    std::vector<CutFn<TParticleType>> true_particle_cut_functions;
-    std::vector<CutFn<RParticleType>> reco_particle_cut_functions;
-    std::vector<CutFn<EventType>> event_cut_functions;
-    for(const auto & cut : cuts)
+    /**
+     * @brief Build the cut functions configured by a list of cut subtables.
+     * @details Each subtable has the fields "name" (prefixed with '!' to
+     * invert the cut), "type," and, optionally, "parameters." Spill cuts are
+     * transformed into event cuts which are only applied to data.
+     * @param cuts The list of cut subtables.
+     * @return The cut functions sorted by type.
+     * @throw std::runtime_error if a cut is not registered or has an illegal
+     * type.
+     */
+    CutSet parse_cuts(const std::vector<cfg::ConfigurationTable> & cuts)
     {
-        // Retrieve the cut name and check for negation.
-        std::string name = cut.get_string_field("name");
-        bool invert = false;
-        if(name.at(0) == '!')
-        {
-            invert = true;
-            name = name.substr(1); // Remove the negation character.
-        }
-         
-        if(!cut.has_field("type"))
-            throw std::runtime_error("Cut " + name + " does not have a type field.");
-        if(cut.get_string_field("type") == "true")
+        CutSet set;
+        for(const auto & cut : cuts)
         {
-            std::string cut_name = "true_" + name;
-            std::vector<double> params;
-            if(cut.has_field("parameters"))
-                params = cut.get_double_vector("parameters");
-            auto factory = CutFactoryRegistry<TType>::instance().get(cut_name);
-            if(invert)
+            // Retrieve the cut name and check for negation.
+            std::string name = cut.get_string_field("name");
+            bool invert = false;
+            if(name.at(0) == '!')
             {
-                // If the cut is inverted, we need to negate the function.
-                auto fn = factory(params);
-                true_cut_functions.push_back([fn](const TType & e) { return !fn(e); });
+                invert = true;
+                name = name.substr(1); // Remove the negation character.
             }
-            else
-                // Otherwise, we just add the function as is.
-                true_cut_functions.push_back(factory(params));
-        }
-        else if(cut.get_string_field("type") == "reco")
-        {
-            std::string cut_name = "reco_" + name;
-            std::vector<double> params;
-            if(cut.has_field("parameters"))
-                params = cut.get_double_vector("parameters");
-            auto factory = CutFactoryRegistry<RType>::instance().get(cut_name);
-            if(invert)
+         
+            if(!cut.has_field("type"))
+                throw std::runtime_error("Cut " + name + " does not have a type field.");
+            if(cut.get_string_field("type") == "true")
             {
-                // If the cut is inverted, we need to negate the function.
-                auto fn = factory(params);
-                reco_cut_functions.push_back([fn](const RType & e) { return !fn(e); });
+                std::string cut_name = "true_" + name;
+                std::vector<double> params;
+                if(cut.has_field("parameters"))
+                    params = cut.get_double_vector("parameters");
+                auto factory = codegen::lookup<bool, TType>(cut_name);
+                if(invert)
+                {
+                    // If the cut is inverted, we need to negate the function.
+                    auto fn = factory(params);
+                    set.true_cut_functions.push_back([fn](const TType & e) { return !fn(e); });
+                }
+                else
+                    // Otherwise, we just add the function as is.
+                    set.true_cut_functions.push_back(factory(params));
             }
-            else
-                // Otherwise, we just add the function as is.
-                reco_cut_functions.push_back(factory(params));
-        }
-        else if(cut.get_string_field("type") == "true_particle")
-        {
-            std::string cut_name = "true_particle_" + name;
-            std::vector<double> params;
-            if(cut.has_field("parameters"))
-                params = cut.get_double_vector("parameters");
-            auto factory = CutFactoryRegistry<TParticleType>::instance().get(cut_name);
-            if(invert)
+            else if(cut.get_string_field("type") == "reco")
             {
-                // If the cut is inverted, we need to negate the function.
-                auto fn = factory(params);
-                true_particle_cut_functions.push_back([fn](const TParticleType & e) { return !fn(e); });
+                std::string cut_name = "reco_" + name;
+                std::vector<double> params;
+                if(cut.has_field("parameters"))
+                    params = cut.get_double_vector("parameters");
+                auto factory = codegen::lookup<bool, RType>(cut_name);
+                if(invert)
+                {
+                    // If the cut is inverted, we need to negate the function.
+                    auto fn = factory(params);
+                    set.reco_cut_functions.push_back([fn](const RType & e) { return !fn(e); });
+                }
+                else
+                    // Otherwise, we just add the function as is.
+                    set.reco_cut_functions.push_back(factory(params));
             }
-            else
-                // Otherwise, we just add the function as is.
-                true_particle_cut_functions.push_back(factory(params));
-        }
-        else if(cut.get_string_field("type") == "reco_particle")
-        {
-            std::string cut_name = "reco_particle_" + name;
-            std::vector<double> params;
-            if(cut.has_field("parameters"))
-                params = cut.get_double_vector("parameters");
-            auto factory = CutFactoryRegistry<RParticleType>::instance().get(cut_name);
-            if(invert)
+            else if(cut.get_string_field("type") == "true_particle")
             {
-                // If the cut is inverted, we need to negate the function.
-                auto fn = factory(params);
-                reco_particle_cut_functions.push_back([fn](const RParticleType & e) { return !fn(e); });
+                std::string cut_name = "true_particle_" + name;
+                std::vector<double> params;
+                if(cut.has_field("parameters"))
+                    params = cut.get_double_vector("parameters");
+                auto factory = codegen::lookup<bool, TParticleType>(cut_name);
+                if(invert)
+                {
+                    // If the cut is inverted, we need to negate the function.
+                    auto fn = factory(params);
+                    set.true_particle_cut_functions.push_back([fn](const TParticleType & e) { return !fn(e); });
+                }
+                else
+                    // Otherwise, we just add the function as is.
+                    set.true_particle_cut_functions.push_back(factory(params));
             }
-            else
-                // Otherwise, we just add the function as is.
-                reco_particle_cut_functions.push_back(factory(params));
-        }
-        else if(cut.get_string_field("type") == "event")
-        {
-            std::string cut_name = "event_" + name;
-            std::vector<double> params;
-            if(cut.has_field("parameters"))
-                params = cut.get_double_vector("parameters");
-            auto factory = CutFactoryRegistry<EventType>::instance().get(cut_name);
-            if(invert)
+            else if(cut.get_string_field("type") == "reco_particle")
             {
-                // If the cut is inverted, we need to negate the function.
-                auto fn = factory(params);
-                event_cut_functions.push_back([fn](const EventType & e) { return !fn(e); });
+                std::string cut_name = "reco_particle_" + name;
+                std::vector<double> params;
+                if(cut.has_field("parameters"))
+                    params = cut.get_double_vector("parameters");
+                auto factory = codegen::lookup<bool, RParticleType>(cut_name);
+                if(invert)
+                {
+                    // If the cut is inverted, we need to negate the function.
+                    auto fn = factory(params);
+                    set.reco_particle_cut_functions.push_back([fn](const RParticleType & e) { return !fn(e); });
+                }
+                else
+                    // Otherwise, we just add the function as is.
+                    set.reco_particle_cut_functions.push_back(factory(params));
             }
-            else
-                // Otherwise, we just add the function as is.
-                event_cut_functions.push_back(factory(params));
-        }
-        else if(cut.get_string_field("type") == "spill")
-        {
-            std::string cut_name = "spill_" + name;
-            std::vector<double> params;
-            if(cut.has_field("parameters"))
-                params = cut.get_double_vector("parameters");
-            auto factory = CutFactoryRegistry<SpillType>::instance().get(cut_name);
-
-            // Transform this to a simple event-level cut.
-            auto fn = [factory, params](const EventType & e) {
-                if(!e.hdr.ismc)
-                    return factory(params)(e.hdr.spillbnbinfo);
+            else if(cut.get_string_field("type") == "event")
+            {
+                std::string cut_name = "event_" + name;
+                std::vector<double> params;
+                if(cut.has_field("parameters"))
+                    params = cut.get_double_vector("parameters");
+                auto factory = codegen::lookup<bool, EventType>(cut_name);
+                if(invert)
+                {
+                    // If the cut is inverted, we need to negate the function.
+                    auto fn = factory(params);
+                    set.event_cut_functions.push_back([fn](const EventType & e) { return !fn(e); });
+                }
                 else
-                    return true; // If it's MC, we don't apply the spill cut.
-            };
-            if(invert)
+                    // Otherwise, we just add the function as is.
+                    set.event_cut_functions.push_back(factory(params));
+            }
+            else if(cut.get_string_field("type") == "spill")
             {
-                // If the cut is inverted, we need to negate the function.
-                event_cut_functions.push_back([fn](const EventType & e) {
+                std::string cut_name = "spill_" + name;
+                std::vector<double> params;
+                if(cut.has_field("parameters"))
+                    params = cut.get_double_vector("parameters");
+                auto factory = codegen::lookup<bool, SpillType>(cut_name);
+
+                // Transform this to a simple event-level cut.
+                auto fn = [factory, params](const EventType & e) {
                     if(!e.hdr.ismc)
-                        return !fn(e);
+                        return factory(params)(e.hdr.spillbnbinfo);
                     else
-                        return true; // If it's MC, we don't invert.
-                });
+                        return true; // If it's MC, we don't apply the spill cut.
+                };
+                if(invert)
+                {
+                    // If the cut is inverted, we need to negate the function.
+                    set.event_cut_functions.push_back([fn](const EventType & e) {
+                        if(!e.hdr.ismc)
+                            return !fn(e);
+                        else
+                            return true; // If it's MC, we don't invert.
+                    });
+                }
+                else
+                    // Otherwise, we just add the function as is.
+                    set.event_cut_functions.push_back(fn);
             }
             else
-                // Otherwise, we just add the function as is.
-                event_cut_functions.push_back(fn);
+            {
+                throw std::runtime_error("Illegal cut type '" + cut.get_string_field("type") + "' for cut " + cut.get_string_field("name"));
+            }
         }
-        else
+        return set;
+    }
+
+    /**
+     * @brief Compose a list of cut functions into a single cut function.
+     * @tparam T The type of object the cuts are applied to.
+     * @param fns The list of cut functions.
+     * @return The logical "and" of the cut functions, or std::nullopt if the
+     * list is empty.
+     */
+    template<typename T>
+    std::optional<CutFn<T>> compose(const std::vector<CutFn<T>> & fns)
+    {
+        if(fns.empty())
+            return std::nullopt;
+        return CutFn<T>([fns](const T & e) -> bool {
+            return std::all_of(fns.begin(), fns.end(), [&e](auto & f) { return f(e); });
+        });
+    }
+
+    /**
+     * @brief Build the key identifying the cut program of a branch variable.
+     * @details Two branch variables with the same key apply the same cuts to
+     * the same interactions, so they can share a single selection (see
+     * @ref spill_multivar_helper). The key covers the mode, the sample type,
+     * the matching policy, and the name, type, and parameters of each cut.
+     * @param cuts The list of cut subtables.
+     * @param mode The mode of the selection.
+     * @param ismc Whether the sample is simulation.
+     * @param policy The truth-reco interaction matching policy.
+     * @return The key of the cut program.
+     */
+    std::string selection_key(const std::vector<cfg::ConfigurationTable> & cuts,
+                              const std::string & mode,
+                              const bool ismc,
+                              const std::shared_ptr<const matching::Policy> & policy)
+    {
+        std::ostringstream key;
+        key << std::setprecision(17) << mode << "|" << ismc << "|" << policy.get();
+        for(const auto & cut : cuts)
+        {
+            key << "|" << cut.get_string_field("type") << ":" << cut.get_string_field("name");
+            if(cut.has_field("parameters"))
+                for(double p : cut.get_double_vector("parameters"))
+                    key << ":" << p;
+        }
+        return key.str();
+    }
+}
+
+// Check if the conditions gating a branch variable pass for a true row.
+bool ComputeIf::passes(const EventType & sr, const TType & obj, size_t match_id) const
+{
+    if(event_cut && !(*event_cut)(sr)) return false;
+    if(true_cut && !(*true_cut)(obj)) return false;
+    if(reco_cut && (match_id == kNoMatch || !(*reco_cut)(sr.dlp[match_id]))) return false;
+    return true;
+}
+
+// Check if the conditions gating a branch variable pass for a reco row.
+bool ComputeIf::passes(const EventType & sr, const RType & obj, size_t match_id) const
+{
+    if(event_cut && !(*event_cut)(sr)) return false;
+    if(reco_cut && !(*reco_cut)(obj)) return false;
+    if(true_cut && (match_id == kNoMatch || !(*true_cut)(sr.dlp_true[match_id]))) return false;
+    return true;
+}
+
+namespace
+{
+    // Whether the components of the multi-output variables share their tuple.
+    std::atomic<bool> share_multivars(true);
+
+    /**
+     * @brief Get the components of a multi-output variable.
+     * @tparam EventT The type of object the variable is applied to.
+     * @param name The registered name of the variable.
+     * @return The names of the components (empty if the name is not a
+     * multi-output variable).
+     */
+    template<typename EventT>
+    std::vector<std::string> components_of(const std::string & name)
+    {
+        MultiVarRegistry<EventT> & registry(MultiVarRegistry<EventT>::instance());
+        return registry.is_registered(name) ? registry.get(name).components : std::vector<std::string>();
+    }
+
+    /**
+     * @brief Get the components of the multi-output variable named by a
+     * branch variable.
+     * @details The record type follows the resolution of
+     * @ref construct_branch: a selector applies a particle variable to the
+     * selected particle of the interaction.
+     * @param var The branch variable subtable.
+     * @param type The type of the variable.
+     * @return The names of the components (empty if the variable is not a
+     * multi-output variable).
+     */
+    std::vector<std::string> multivar_components(const cfg::ConfigurationTable & var, const std::string & type)
+    {
+        const std::string name(var.get_string_field("name"));
+        const bool selector(var.has_field("selector"));
+        if(type == "true") return selector ? components_of<TParticleType>("true_particle_" + name) : components_of<TType>("true_" + name);
+        if(type == "reco") return selector ? components_of<RParticleType>("reco_particle_" + name) : components_of<RType>("reco_" + name);
+        if(type == "true_particle") return components_of<TParticleType>("true_particle_" + name);
+        if(type == "reco_particle") return components_of<RParticleType>("reco_particle_" + name);
+        if(type == "mctruth") return components_of<MCTruth>("true_" + name);
+        if(type == "event") return components_of<EventType>("event_" + name);
+        return std::vector<std::string>();
+    }
+
+    /**
+     * @brief Get the columns of a multi-output variable for a spill.
+     * @details The SpillMultiVar of the tuple variable (see
+     * @ref register_multivar) is evaluated once per spill and thread, with
+     * the rows of the calling thread installed (see @ref multivar_rows). Each
+     * of its values is the index of the row holding the tuple of a selected
+     * object, or kNoMatchValue for an object without a value, and is split
+     * into one value per component. The columns are cached until the
+     * memoization context moves to the next spill.
+     * @param tuple The SpillMultiVar of the tuple variable.
+     * @param sr The record of the spill.
+     * @param n The number of components.
+     * @return The columns of the components.
+     */
+    const std::vector<std::vector<double>> & multivar_columns(const ana::SpillMultiVar & tuple,
+                                                              const caf::Proxy<caf::StandardRecord> * sr,
+                                                              size_t n)
+    {
+        struct Entry
+        {
+            uint64_t generation = 0;
+            std::vector<std::vector<double>> columns;
+        };
+        static thread_local std::unordered_map<const ana::SpillMultiVar *, Entry> cache;
+        Entry & entry(cache[&tuple]);
+        const uint64_t generation(memo::SpillContext::current().generation());
+        if(entry.generation == generation)
+            return entry.columns;
+
+        // The rows are restored even if the evaluation throws.
+        struct Install
         {
-            throw std::runtime_error("Illegal cut type '" + cut.get_string_field("type") + "' for cut " + cut.get_string_field("name"));
+            std::vector<std::vector<double>> * previous;
+            explicit Install(std::vector<std::vector<double>> * rows) : previous(multivar_rows()) { multivar_rows() = rows; }
+            ~Install() { multivar_rows() = previous; }
+        };
+        std::vector<std::vector<double>> rows;
+        std::vector<double> values;
+        {
+            Install install(&rows);
+            values = tuple(sr);
+        }
+
+        entry.columns.assign(n, std::vector<double>());
+        for(std::vector<double> & column : entry.columns)
+            column.reserve(values.size());
+        for(const double v : values)
+        {
+            for(size_t k(0); k < n; ++k)
+                entry.columns[k].push_back(std::isnan(v) ? kNoMatchValue : rows[static_cast<size_t>(v)][k]);
         }
+        entry.generation = generation;
+        return entry.columns;
+    }
+}
+
+// Get the rows of the multi-output variable being evaluated.
+std::vector<std::vector<double>> *& multivar_rows()
+{
+    static thread_local std::vector<std::vector<double>> * rows(nullptr);
+    return rows;
+}
+
+// Check if the components of the multi-output variables share their tuple.
+bool shared_multivars()
+{
+    return share_multivars.load();
+}
+
+// Enable or disable the sharing of the tuples of the multi-output variables.
+void set_shared_multivars(bool enabled)
+{
+    share_multivars.store(enabled);
+}
+
+// Build the SpillMultiVars of the branches of a branch variable.
+std::vector<NamedSpillMultiVar> construct(const std::vector<cfg::ConfigurationTable> & cuts,
+                                          const cfg::ConfigurationTable & var,
+                                          const std::string & mode,
+                                          const std::string & override_type,
+                                          const bool ismc,
+                                          const std::shared_ptr<const matching::Policy> & policy)
+{
+    // A multi-output variable fills one branch per component. The tuple is
+    // itself a registered variable, so a single SpillMultiVar is built for
+    // it as if it had been configured by name, and the branches read their
+    // columns of its output. Without sharing, each branch is built from its
+    // component instead.
+    const std::string name(var.get_string_field("name"));
+    const std::vector<std::string> components(multivar_components(var, override_type.empty() ? var.get_string_field("type") : override_type));
+    if(components.empty())
+        return {construct_branch(cuts, var, name, mode, override_type, ismc, policy)};
+    std::vector<NamedSpillMultiVar> result;
+    result.reserve(components.size());
+    if(!shared_multivars())
+    {
+        for(const std::string & component : components)
+            result.push_back(construct_branch(cuts, var, component, mode, override_type, ismc, policy));
+        return result;
+    }
+
+    // The branch names replace the name of the variable in the name of the
+    // tuple branch (e.g., "reco_particle_momentum" to "reco_particle_px").
+    NamedSpillMultiVar tuple_branch(construct_branch(cuts, var, name, mode, override_type, ismc, policy));
+    const std::string prefix(tuple_branch.first.substr(0, tuple_branch.first.size() - name.size()));
+    auto tuple(std::make_shared<const ana::SpillMultiVar>(tuple_branch.second));
+    const size_t n(components.size());
+    for(size_t k(0); k < n; ++k)
+    {
+        result.emplace_back(prefix + components[k], ana::SpillMultiVar([tuple, k, n](const caf::Proxy<caf::StandardRecord> * sr) -> std::vector<double>
+        {
+            return multivar_columns(*tuple, sr, n)[k];
+        }));
     }
+    return result;
+}
+
+// Build a single SpillMultiVar for a single branch.
+NamedSpillMultiVar construct_branch(const std::vector<cfg::ConfigurationTable> & cuts,
+                                    const cfg::ConfigurationTable & var,
+                                    const std::string & name,
+                                    const std::string & mode,
+                                    const std::string & override_type,
+                                    const bool ismc,
+                                    const std::shared_ptr<const matching::Policy> & policy)
+{
+    /**
+     * @brief Determine the type of the cuts.
+     * @details The type of the first cut is used to determine the type of the
+     * cuts, and therefore whether the selection is applied in a loop over true
+     * or reco events. This type is used to branch the code into the appropriate
+     * path. First, we check if the mode is a valid option. If not, we throw an
+     * exception.
+     */
+    Mode exec_mode;
+    if(mode == "true") exec_mode = Mode::True;
+    else if(mode == "reco") exec_mode = Mode::Reco;
+    else if(mode == "event") exec_mode = Mode::Event;
+    else throw std::runtime_error("Illegal mode '" + mode + "' for variable " + name);
+
+    CutSet set(parse_cuts(cuts));
+    const auto & true_cut_functions = set.true_cut_functions;
+    const auto & reco_cut_functions = set.reco_cut_functions;
+    const auto & true_particle_cut_functions = set.true_particle_cut_functions;
+    const auto & reco_particle_cut_functions = set.reco_particle_cut_functions;
+    const auto & event_cut_functions = set.event_cut_functions;
+
+    // Build the (optional) conditions gating the evaluation of the variable.
+    std::shared_ptr<const ComputeIf> compute_if;
+    if(var.has_field("compute_if"))
+    {
+        CutSet gate(parse_cuts(var.get_subtables("compute_if")));
+        if(!gate.true_particle_cut_functions.empty() || !gate.reco_particle_cut_functions.empty())
+            throw std::runtime_error("Particle cuts are not supported in compute_if for variable " + name);
+        if(exec_mode == Mode::Event && (!gate.true_cut_functions.empty() || !gate.reco_cut_functions.empty()))
+            throw std::runtime_error("Only event cuts are supported in compute_if in event mode for variable " + name);
+        compute_if = std::make_shared<const ComputeIf>(ComputeIf{compose(gate.true_cut_functions),
+                                                                 compose(gate.reco_cut_functions),
+                                                                 compose(gate.event_cut_functions)});
+    }
+
+    // Branch variables with the same cuts share the per-spill selection.
+    const std::string selection(exec_mode == Mode::Event ? std::string() : selection_key(cuts, mode, ismc, policy));
 
     /**
      * @brief Compose a common cut function.
@@ -248,7 +582,7 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
          * configuration of the variable. The variable name is used to retrieve the
          * function from the registry.
          */
-        std::string var_name = var.get_string_field("name");
+        std::string var_name = name;
         std::string var_type = (override_type.empty() ? var.get_string_field("type") : override_type);
         std::vector<double> varPars;
         if(var.has_field("parameters"))
@@ -263,12 +597,12 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
 
                 // Retrieve the selector function.
                 std::string selector_name = "true_" + var.get_string_field("selector");
-                auto selector_factory = SelectorFactoryRegistry<TType>::instance().get(selector_name);
+                auto selector_factory = codegen::lookup<size_t, TType>(selector_name);
                 auto selector = selector_factory(std::vector<double>{});
                                 
                 // Retrieve the particle-level variable function.
                 var_name = "true_particle_" + var_name;
-                auto factory = VarFactoryRegistry<TParticleType>::instance().get(var_name);
+                auto factory = codegen::lookup<double, TParticleType>(var_name);
                 auto var_fn = factory(varPars);
                 
                 VarFn<TType> var_fn_with_selector = [var_fn, selector](const TType & e) -> double
@@ -285,12 +619,15 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
                     true_particle_cut,
                     var_fn_with_selector,
                     event_cut,
-                    ismc));
+                    ismc,
+                    policy,
+                    compute_if,
+                    selection));
             }
             else
             {
                 var_name = "true_" + var_name;
-                auto factory = VarFactoryRegistry<TType>::instance().get(var_name);
+                auto factory = codegen::lookup<double, TType>(var_name);
                 auto var_fn = factory(varPars);
                 return std::make_pair(var_name, spill_multivar_helper<TType, RType, TParticleType, TType>(
                     true_cut,
@@ -298,7 +635,10 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
                     true_particle_cut,
                     var_fn,
                     event_cut,
-                    ismc));
+                    ismc,
+                    policy,
+                    compute_if,
+                    selection));
             }
         }
         
@@ -311,12 +651,12 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
 
                 // Retrieve the selector function.
                 std::string selector_name = "reco_" + var.get_string_field("selector");
-                auto selector_factory = SelectorFactoryRegistry<RType>::instance().get(selector_name);
+                auto selector_factory = codegen::lookup<size_t, RType>(selector_name);
                 auto selector = selector_factory(std::vector<double>{});
                                 
                 // Retrieve the particle-level variable function.
                 var_name = "reco_particle_" + var_name;
-                auto factory = VarFactoryRegistry<RParticleType>::instance().get(var_name);
+                auto factory = codegen::lookup<double, RParticleType>(var_name);
                 auto var_fn = factory(varPars);
                 
                 VarFn<RType> var_fn_with_selector = [var_fn, selector](const RType & e) -> double
@@ -333,12 +673,15 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
                     true_particle_cut,
                     var_fn_with_selector,
                     event_cut,
-                    ismc));
+                    ismc,
+                    policy,
+                    compute_if,
+                    selection));
             }
             else
             {
                 var_name = "reco_" + var_name;
-                auto factory = VarFactoryRegistry<RType>::instance().get(var_name);
+                auto factory = codegen::lookup<double, RType>(var_name);
                 auto var_fn = factory(varPars);
                 return std::make_pair(var_name, spill_multivar_helper<TType, RType, TParticleType, RType>(
                     true_cut,
@@ -346,13 +689,16 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
                     true_particle_cut,
                     var_fn,
                     event_cut,
-                    ismc));
+                    ismc,
+                    policy,
+                    compute_if,
+                    selection));
             }
         }
         else if(var_type == "mctruth")
         {
             var_name = "true_" + var_name;
-            auto factory = VarFactoryRegistry<MCTruth>::instance().get(var_name);
+            auto factory = codegen::lookup<double, MCTruth>(var_name);
             auto var_fn = factory(varPars);
             return std::make_pair(var_name, spill_multivar_helper<TType, RType, TParticleType, MCTruth>(
                 true_cut,
@@ -360,12 +706,15 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
                 true_particle_cut,
                 var_fn,
                 event_cut,
-                ismc));
+                ismc,
+                policy,
+                compute_if,
+                selection));
         }
         else if(var_type == "true_particle")
         {
             var_name = "true_particle_" + var_name;
-            auto factory = VarFactoryRegistry<TParticleType>::instance().get(var_name);
+            auto factory = codegen::lookup<double, TParticleType>(var_name);
             auto var_fn = factory(varPars);
             return std::make_pair(var_name, spill_multivar_helper<TType, RType, TParticleType, TParticleType>(
                 true_cut,
@@ -373,12 +722,15 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
                 true_particle_cut,
                 var_fn,
                 event_cut,
-                ismc));
+                ismc,
+                policy,
+                compute_if,
+                selection));
         }
         else if(var_type == "reco_particle")
         {
             var_name = "reco_particle_" + var_name;
-            auto factory = VarFactoryRegistry<RParticleType>::instance().get(var_name);
+            auto factory = codegen::lookup<double, RParticleType>(var_name);
             auto var_fn = factory(varPars);
             return std::make_pair(var_name, spill_multivar_helper<TType, RType, TParticleType, RParticleType>(
                 true_cut,
@@ -386,7 +738,10 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
                 true_particle_cut,
                 var_fn,
                 event_cut,
-                ismc));
+                ismc,
+                policy,
+                compute_if,
+                selection));
         }
         else
         {
@@ -401,7 +756,7 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
          * configuration of the variable. The variable name is used to retrieve the
          * function from the registry.
          */
-        std::string var_name = var.get_string_field("name");
+        std::string var_name = name;
         std::string var_type = (override_type.empty() ? var.get_string_field("type") : override_type);
         std::vector<double> varPars;
         if(var.has_field("parameters"))
@@ -416,12 +771,12 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
 
                 // Retrieve the selector function.
                 std::string selector_name = "true_" + var.get_string_field("selector");
-                auto selector_factory = SelectorFactoryRegistry<TType>::instance().get(selector_name);
+                auto selector_factory = codegen::lookup<size_t, TType>(selector_name);
                 auto selector = selector_factory(std::vector<double>{});
                                 
                 // Retrieve the particle-level variable function.
                 var_name = "true_particle_" + var_name;
-                auto factory = VarFactoryRegistry<TParticleType>::instance().get(var_name);
+                auto factory = codegen::lookup<double, TParticleType>(var_name);
                 auto var_fn = factory(varPars);
                 
                 VarFn<TType> var_fn_with_selector = [var_fn, selector](const TType & e) -> double
@@ -438,12 +793,15 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
                     true_particle_cut,
                     var_fn_with_selector,
                     event_cut,
-                    ismc));
+                    ismc,
+                    policy,
+                    compute_if,
+                    selection));
             }
             else
             {
                 var_name = "true_" + var_name;
-                auto factory = VarFactoryRegistry<TType>::instance().get(var_name);
+                auto factory = codegen::lookup<double, TType>(var_name);
                 auto var_fn = factory(varPars);
                 return std::make_pair(var_name, spill_multivar_helper<RType, TType, TParticleType, TType>(
                     reco_cut,
@@ -451,7 +809,10 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
                     true_particle_cut,
                     var_fn,
                     event_cut,
-                    ismc));
+                    ismc,
+                    policy,
+                    compute_if,
+                    selection));
             }
         }
         else if(var_type == "reco" || (var.has_field("selector") && var_type == "reco_particle"))
@@ -463,12 +824,12 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
 
                 // Retrieve the selector function.
                 std::string selector_name = "reco_" + var.get_string_field("selector");
-                auto selector_factory = SelectorFactoryRegistry<RType>::instance().get(selector_name);
+                auto selector_factory = codegen::lookup<size_t, RType>(selector_name);
                 auto selector = selector_factory(std::vector<double>{});
 
                 // Retrieve the particle-level variable function.
                 var_name = "reco_particle_" + var_name;
-                auto factory = VarFactoryRegistry<RParticleType>::instance().get(var_name);
+                auto factory = codegen::lookup<double, RParticleType>(var_name);
                 auto var_fn = factory(varPars);
 
                 VarFn<RType> var_fn_with_selector = [var_fn, selector](const RType & e) -> double
@@ -485,12 +846,15 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
                     reco_particle_cut,
                     var_fn_with_selector,
                     event_cut,
-                    ismc));
+                    ismc,
+                    policy,
+                    compute_if,
+                    selection));
             }
             else
             {
                 var_name = "reco_" + var_name;
-                auto factory = VarFactoryRegistry<RType>::instance().get(var_name);
+                auto factory = codegen::lookup<double, RType>(var_name);
                 auto var_fn = factory(varPars);
                 return std::make_pair(var_name, spill_multivar_helper<RType, TType, TParticleType, RType>(
                     reco_cut,
@@ -498,13 +862,16 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
                     true_particle_cut,
                     var_fn,
                     event_cut,
-                    ismc));
+                    ismc,
+                    policy,
+                    compute_if,
+                    selection));
             }
         }
         else if(var_type == "mctruth")
         {
             var_name = "true_" + var_name;
-            auto factory = VarFactoryRegistry<MCTruth>::instance().get(var_name);
+            auto factory = codegen::lookup<double, MCTruth>(var_name);
             auto var_fn = factory(varPars);
             return std::make_pair(var_name, spill_multivar_helper<RType, TType, TParticleType, MCTruth>(
                 reco_cut,
@@ -512,12 +879,15 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
                 true_particle_cut,
                 var_fn,
                 event_cut,
-                ismc));
+                ismc,
+                policy,
+                compute_if,
+                selection));
         }
         else if(var_type == "true_particle")
         {
             var_name = "true_particle_" + var_name;
-            auto factory = VarFactoryRegistry<TParticleType>::instance().get(var_name);
+            auto factory = codegen::lookup<double, TParticleType>(var_name);
             auto var_fn = factory(varPars);
             return std::make_pair(var_name, spill_multivar_helper<RType, TType, RParticleType, TParticleType>(
                 reco_cut,
@@ -525,12 +895,15 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
                 reco_particle_cut,
                 var_fn,
                 event_cut,
-                ismc));
+                ismc,
+                policy,
+                compute_if,
+                selection));
         }
         else if(var_type == "reco_particle")
         {
             var_name = "reco_particle_" + var_name;
-            auto factory = VarFactoryRegistry<RParticleType>::instance().get(var_name);
+            auto factory = codegen::lookup<double, RParticleType>(var_name);
             auto var_fn = factory(varPars);
             return std::make_pair(var_name, spill_multivar_helper<RType, TType, RParticleType, RParticleType>(
                 reco_cut,
@@ -538,7 +911,10 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
                 reco_particle_cut,
                 var_fn,
                 event_cut,
-                ismc));
+                ismc,
+                policy,
+                compute_if,
+                selection));
         }
         else
         {
@@ -553,7 +929,7 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
          * configuration of the variable. The variable name is used to retrieve the
          * function from the registry.
          */
-        std::string var_name = var.get_string_field("name");
+        std::string var_name = name;
         std::string var_type = (override_type.empty() ? var.get_string_field("type") : override_type);
         std::vector<double> varPars;
         if(var.has_field("parameters"))
@@ -562,9 +938,9 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
         if(var_type == "event")
         {
             var_name = "event_" + var_name;
-            auto factory = VarFactoryRegistry<EventType>::instance().get(var_name);
+            auto factory = codegen::lookup<double, EventType>(var_name);
             auto var_fn = factory(varPars);
-            return std::make_pair(var_name, spill_multivar_helper(event_cut, var_fn));
+            return std::make_pair(var_name, spill_multivar_helper(event_cut, var_fn, compute_if));
         }
         else
         {
@@ -573,6 +949,152 @@ NamedSpillMultiVar construct(const std::vector<cfg::ConfigurationTable> & cuts,
     }
 }
 
+namespace
+{
+    // Whether the selections are shared between the branches of a tree.
+    std::atomic<bool> share_selections(true);
+
+    /**
+     * @class Selection
+     * @brief The cut program of a tree, evaluated once per spill.
+     * @details The selection holds the cuts on the broadcast interactions,
+     * the (optional) cuts on their matches, and the event cut of a tree. For
+     * each spill, it evaluates the cut program over all interactions once and
+     * caches the indices of the selected interactions. The branch variables
+     * of the tree then each loop over the selected interactions only, which
+     * replaces the interleaved evaluation of the cuts and of one variable per
+     * interaction by a tight loop over a single variable.
+     * @tparam CutsOn The type of the broadcast interactions.
+     * @tparam CompsOn The type of the complementary interactions.
+     */
+    template<typename CutsOn, typename CompsOn>
+    class Selection
+    {
+        public:
+            /**
+             * @struct Rows
+             * @brief The selected interactions of a spill.
+             * @details The "relaxed" rows skip the cuts on the matches for
+             * data (there is no truth to match to), which is the historical
+             * behavior of the interaction-level variables in the reco mode.
+             * The particle-level variables use the "strict" rows.
+             */
+            struct Rows
+            {
+                std::vector<size_t> strict;
+                std::vector<size_t> relaxed;
+            };
+
+            Selection(CutFn<CutsOn> cuts, std::optional<CutFn<CompsOn>> comps, CutFn<EventType> event_cut, bool ismc)
+                : cuts_(std::move(cuts)), comps_(std::move(comps)), event_cut_(std::move(event_cut)), ismc_(ismc) {}
+
+            /**
+             * @brief Check if the spill passes the event cut.
+             * @param sr The spill.
+             * @return True if the spill passes the event cut.
+             */
+            bool event(const EventType & sr) const
+            {
+                thread_local std::unordered_map<const Selection *, std::pair<uint64_t, bool>> cache;
+                const uint64_t generation(memo::SpillContext::current().generation());
+                auto & [g, result] = cache[this];
+                if(g != generation)
+                {
+                    result = event_cut_(sr);
+                    g = generation;
+                }
+                return result;
+            }
+
+            /**
+             * @brief Get the selected interactions of the spill.
+             * @param sr The spill.
+             * @param matches The truth-reco matching of the spill.
+             * @return The selected interactions.
+             */
+            const Rows & rows(const EventType & sr, const matching::Matching & matches) const
+            {
+                thread_local std::unordered_map<const Selection *, std::pair<uint64_t, Rows>> cache;
+                const uint64_t generation(memo::SpillContext::current().generation());
+                auto & [g, result] = cache[this];
+                if(g == generation)
+                    return result;
+                g = generation;
+                result.strict.clear();
+                result.relaxed.clear();
+                if constexpr(std::is_same_v<CutsOn, TType>)
+                {
+                    for(size_t index(0); index < sr.dlp_true.size(); ++index)
+                    {
+                        size_t match_id(matches.true_to_reco[index]);
+                        if(cuts_(sr.dlp_true[index]) && (!comps_ || (match_id != kNoMatch && (*comps_)(sr.dlp[match_id]))))
+                            result.strict.push_back(index);
+                    }
+                    result.relaxed = result.strict;
+                }
+                else
+                {
+                    for(size_t index(0); index < sr.dlp.size(); ++index)
+                    {
+                        if(!cuts_(sr.dlp[index]))
+                            continue;
+                        size_t match_id(matches.reco_to_true[index]);
+                        bool comp(!comps_ || (match_id != kNoMatch && (*comps_)(sr.dlp_true[match_id])));
+                        if(comp)
+                            result.strict.push_back(index);
+                        if(comp || !ismc_)
+                            result.relaxed.push_back(index);
+                    }
+                }
+                return result;
+            }
+
+        private:
+            CutFn<CutsOn> cuts_;
+            std::optional<CutFn<CompsOn>> comps_;
+            CutFn<EventType> event_cut_;
+            bool ismc_;
+    };
+
+    /**
+     * @brief Get the selection for a cut program.
+     * @details Branches constructed from the same cut configuration (see
+     * @ref construct) share a single selection, so the cut program of a tree
+     * is evaluated once per spill irrespective of the number of branches.
+     * @tparam CutsOn The type of the broadcast interactions.
+     * @tparam CompsOn The type of the complementary interactions.
+     * @param key The key of the cut configuration (empty for no sharing).
+     * @param cuts The cuts on the broadcast interactions.
+     * @param comps The cuts on the complementary interactions.
+     * @param event_cut The event cut.
+     * @param ismc Whether the sample is simulation.
+     * @return The (possibly shared) selection.
+     */
+    template<typename CutsOn, typename CompsOn>
+    std::shared_ptr<const Selection<CutsOn, CompsOn>> get_selection(const std::string & key,
+                                                                     const CutFn<CutsOn> & cuts,
+                                                                     const std::optional<CutFn<CompsOn>> & comps,
+                                                                     const CutFn<EventType> & event_cut,
+                                                                     bool ismc)
+    {
+        if(key.empty() || !share_selections.load())
+            return std::make_shared<const Selection<CutsOn, CompsOn>>(cuts, comps, event_cut, ismc);
+        static std::mutex mutex;
+        static std::map<std::string, std::shared_ptr<const Selection<CutsOn, CompsOn>>> selections;
+        std::lock_guard<std::mutex> lock(mutex);
+        auto & selection = selections[key];
+        if(!selection)
+            selection = std::make_shared<const Selection<CutsOn, CompsOn>>(cuts, comps, event_cut, ismc);
+        return selection;
+    }
+}
+
+// Enable or disable the sharing of the selections between branches.
+void set_shared_selections(bool enabled)
+{
+    share_selections.store(enabled);
+}
+
 // Helper method for constructing a SpillMultiVar object.
 template<typename CutsOn, typename CompsOn, typename PCutsOn, typename VarOn>
 ana::SpillMultiVar spill_multivar_helper(
@@ -581,15 +1103,35 @@ ana::SpillMultiVar spill_multivar_helper(
     const CutFn<PCutsOn> & pcuts,
     const VarFn<VarOn> & var,
     const CutFn<EventType> & event_cut,
-    const bool ismc
+    const bool ismc,
+    const std::shared_ptr<const matching::Policy> & policy,
+    const std::shared_ptr<const ComputeIf> & compute_if,
+    const std::string & selection_key
 )
 {
-    return ana::SpillMultiVar([comps, cuts, pcuts, var, ismc, event_cut](const caf::Proxy<caf::StandardRecord> * sr) -> std::vector<double>
+    std::shared_ptr<const matching::Policy> matcher(policy ? policy : matching::default_policy());
+    std::shared_ptr<const Selection<CutsOn, CompsOn>> selection(get_selection(selection_key, cuts, comps, event_cut, ismc));
+    return ana::SpillMultiVar([pcuts, var, ismc, matcher, compute_if, selection](const caf::Proxy<caf::StandardRecord> * sr) -> std::vector<double>
     {
         std::vector<double> values;
 
         // Check if this event passes the event cut.
-        if(!event_cut(*sr)) return values;
+        if(!selection->event(*sr)) return values;
+
+        // Retrieve the truth-reco interaction matching for this spill. This
+        // is computed once per spill and policy, and shared by all variables.
+        const matching::Matching & matches(matcher->match(*sr));
+
+        // Retrieve the interactions selected by the cut program of the tree.
+        // This is evaluated once per spill and shared by all branches.
+        const auto & rows(selection->rows(*sr, matches));
+
+        // Check the (optional) conditions gating the evaluation of the
+        // variable for a row that passed the selection.
+        auto compute = [&](const CutsOn & obj, size_t match_id) -> bool
+        {
+            return !compute_if || compute_if->passes(*sr, obj, match_id);
+        };
 
         // Case: configuration parameter "mode" is set to "true."
         if constexpr (std::is_same_v<CutsOn, TType>)
@@ -609,50 +1151,42 @@ ana::SpillMultiVar spill_multivar_helper(
                 }
             }
 
-            // Iterate over the true interactions.
-            for(auto const& i : sr->dlp_true)
+            // Iterate over the selected true interactions.
+            for(const size_t index : rows.strict)
             {
+                auto const & i = sr->dlp_true[index];
+
                 // Check for match
-                size_t match_id = (i.match_ids.size() > 0) ? (size_t)i.match_ids[0] : kNoMatch;
+                size_t match_id = matches.true_to_reco[index];
 
                 if constexpr(std::is_same_v<VarOn, RType>)
                 {
-                    if(cuts(i) && (!comps || (match_id != kNoMatch && (*comps)(sr->dlp[match_id]))))                    
-                    {
-                        values.push_back(match_id != kNoMatch ? var(sr->dlp[match_id]) : kNoMatchValue);
-                    }
+                    values.push_back(match_id != kNoMatch && compute(i, match_id) ? var(sr->dlp[match_id]) : kNoMatchValue);
                 }
                 else if constexpr(std::is_same_v<VarOn, TType>)
                 {
-                    if(cuts(i) && (!comps || (match_id != kNoMatch && (*comps)(sr->dlp[match_id]))))
-                    {
-                        values.push_back(var(i));
-                    }
+                    values.push_back(compute(i, match_id) ? var(i) : kNoMatchValue);
                 }
                 else if constexpr(std::is_same_v<VarOn, MCTruth>)
                 {
-                    if(cuts(i) && (!comps || (match_id != kNoMatch && (*comps)(sr->dlp[match_id]))))
-                    {
-                        values.push_back(i.nu_id >= 0 ? var(sr->mc.nu[i.nu_id]) : kNoMatchValue);
-                    }
+                    values.push_back(i.nu_id >= 0 && compute(i, match_id) ? var(sr->mc.nu[i.nu_id]) : kNoMatchValue);
                 }
                 else if constexpr(std::is_same_v<VarOn, TParticleType> || std::is_same_v<VarOn, RParticleType>)
                 {
-                    if(cuts(i) && (!comps || (match_id != kNoMatch && (*comps)(sr->dlp[match_id]))))
+                    const bool evaluate(compute(i, match_id));
+                    for(auto const & j : i.particles)
                     {
-                        for(auto const & j : i.particles)
+                        if(pcuts(j))
                         {
-                            if(pcuts(j))
+                            if constexpr(std::is_same_v<VarOn, TParticleType>)
+                                values.push_back(evaluate ? var(j) : kNoMatchValue);
+                            else if constexpr(std::is_same_v<VarOn, RParticleType>)
                             {
-                                if constexpr(std::is_same_v<VarOn, TParticleType>)
-                                    values.push_back(var(j));
-                                else if constexpr(std::is_same_v<VarOn, RParticleType>)
-                                {
-                                    if(j.match_ids.size() > 0 && particles.find(j.match_ids[0]) != particles.end())
-                                        values.push_back(var(*particles[j.match_ids[0]]));
-                                    else
-                                        values.push_back(kNoMatchValue); // No match found.
-                                }
+                                auto match = (evaluate && j.match_ids.size() > 0) ? particles.find(j.match_ids[0]) : particles.end();
+                                if(match != particles.end())
+                                    values.push_back(var(*match->second));
+                                else
+                                    values.push_back(kNoMatchValue); // No match found.
                             }
                         }
                     }
@@ -678,58 +1212,53 @@ ana::SpillMultiVar spill_multivar_helper(
                 }
             }
 
-            // Iterate over the reco interactions.
-            for(auto const& i : sr->dlp)
+            // Iterate over the selected reco interactions (see above). The
+            // interaction-level variables keep the data rows without a
+            // match, while the particle-level variables do not.
+            constexpr bool particle_level(std::is_same_v<VarOn, TParticleType> || std::is_same_v<VarOn, RParticleType>);
+            for(const size_t index : (particle_level ? rows.strict : rows.relaxed))
             {
+                auto const & i = sr->dlp[index];
+
                 // Check for match
-                size_t match_id = (i.match_ids.size() > 0) ? (size_t)i.match_ids[0] : kNoMatch;
+                size_t match_id = matches.reco_to_true[index];
 
                 if constexpr(std::is_same_v<VarOn, TType>)
                 {
-                    if(cuts(i) && (!comps || (match_id != kNoMatch && (*comps)(sr->dlp_true[match_id])) || !ismc))
-                    {
-                        values.push_back(ismc && match_id != kNoMatch ? var(sr->dlp_true[match_id]) : kNoMatchValue);
-                    }
+                    values.push_back(ismc && match_id != kNoMatch && compute(i, match_id) ? var(sr->dlp_true[match_id]) : kNoMatchValue);
                 }
                 else if constexpr(std::is_same_v<VarOn, RType>)
                 {
-                    if(cuts(i) && (!comps || (match_id != kNoMatch && (*comps)(sr->dlp_true[match_id])) || !ismc))
-                    {
-                        values.push_back(var(i));
-                    }
+                    values.push_back(compute(i, match_id) ? var(i) : kNoMatchValue);
                 }
                 else if constexpr(std::is_same_v<VarOn, MCTruth>)
                 {
-                    if(cuts(i) && (!comps || (match_id != kNoMatch && (*comps)(sr->dlp_true[match_id])) || !ismc))
+                    if(!ismc || match_id == kNoMatch || !compute(i, match_id))
                     {
-                        if(!ismc || match_id == kNoMatch)
-                        {
-                            values.push_back(kNoMatchValue);
-                        }
-                        else
-                        {
-                            int64_t nu_id = sr->dlp_true[match_id].nu_id;
-                            values.push_back(nu_id >= 0 ? var(sr->mc.nu[nu_id]) : kNoMatchValue);
-                        }
+                        values.push_back(kNoMatchValue);
+                    }
+                    else
+                    {
+                        int64_t nu_id = sr->dlp_true[match_id].nu_id;
+                        values.push_back(nu_id >= 0 ? var(sr->mc.nu[nu_id]) : kNoMatchValue);
                     }
                 }
-                else if constexpr(std::is_same_v<VarOn, TParticleType> || std::is_same_v<VarOn, RParticleType>)
+                else if constexpr(particle_level)
                 {
-                    if(cuts(i) && (!comps || (match_id != kNoMatch && (*comps)(sr->dlp_true[match_id]))))
+                    const bool evaluate(compute(i, match_id));
+                    for(auto const & j : i.particles)
                     {
-                        for(auto const & j : i.particles)
+                        if(pcuts(j))
                         {
-                            if(pcuts(j))
+                            if constexpr(std::is_same_v<VarOn, RParticleType>)
+                                values.push_back(evaluate ? var(j) : kNoMatchValue);
+                            else if constexpr(std::is_same_v<VarOn, TParticleType>)
                             {
-                                if constexpr(std::is_same_v<VarOn, RParticleType>)
-                                    values.push_back(var(j));
-                                else if constexpr(std::is_same_v<VarOn, TParticleType>)
-                                {
-                                    if(j.match_ids.size() > 0 && particles.find(j.match_ids[0]) != particles.end())
-                                        values.push_back(var(*particles[j.match_ids[0]]));
-                                    else
-                                        values.push_back(kNoMatchValue); // No match found.
-                                }
+                                auto match = (evaluate && j.match_ids.size() > 0) ? particles.find(j.match_ids[0]) : particles.end();
+                                if(match != particles.end())
+                                    values.push_back(var(*match->second));
+                                else
+                                    values.push_back(kNoMatchValue); // No match found.
                             }
                         }
                     }
@@ -744,13 +1273,14 @@ ana::SpillMultiVar spill_multivar_helper(
 
 // Helper method for constructing a SpillMultiVar object when run in the
 // "event" mode.
-ana::SpillMultiVar spill_multivar_helper(const CutFn<EventType> & cut, const VarFn<EventType> & var)
+ana::SpillMultiVar spill_multivar_helper(const CutFn<EventType> & cut, const VarFn<EventType> & var,
+                                         const std::shared_ptr<const ComputeIf> & compute_if)
 {
-    return ana::SpillMultiVar([cut, var](const caf::Proxy<caf::StandardRecord> * sr) -> std::vector<double>
+    return ana::SpillMultiVar([cut, var, compute_if](const caf::Proxy<caf::StandardRecord> * sr) -> std::vector<double>
     {
         std::vector<double> values;
-        if(cut(*sr))        
-            values.push_back(var(*sr));
+        if(cut(*sr))
+            values.push_back(!compute_if || !compute_if->event_cut || (*compute_if->event_cut)(*sr) ? var(*sr) : kNoMatchValue);
         return values;
     });
 }
@@ -780,14 +1310,14 @@ std::vector<NamedSpillMultiVar> construct_exposure_vars(const std::vector<cfg::C
             if(cut.get_string_field("type") == "event")
             {
                 name = "event_" + name;
-                auto factory = CutFactoryRegistry<EventType>::instance().get(name);
+                auto factory = codegen::lookup<bool, EventType>(name);
                 auto cut_fn = factory(params);
                 cut_functions.push_back(cut_fn);
             }
             else if(cut.get_string_field("type") == "spill")
             {
                 name = "spill_" + name;
-                auto factory = CutFactoryRegistry<SpillType>::instance().get(name);
+                auto factory = codegen::lookup<bool, SpillType>(name);
                 auto cut_fn = factory(params);
                 
                 // We do not transform this to an event-level cut because we
@@ -858,4 +1388,30 @@ template class Registry<VarFactory<EventType>>;
 
 // Explicit instantiation for selector registries
 template class Registry<SelectorFactory<TType>>;
-template class Registry<SelectorFactory<RType>>;
\ No newline at end of file
+template class Registry<SelectorFactory<RType>>;
+
+// Explicit instantiation for the multi-output variable registries
+template class Registry<MultiVar<TType>>;
+template class Registry<MultiVar<RType>>;
+template class Registry<MultiVar<MCTruth>>;
+template class Registry<MultiVar<TParticleType>>;
+template class Registry<MultiVar<RParticleType>>;
+template class Registry<MultiVar<EventType>>;
+
+// Explicit instantiation for the registries of the compiled functions (see
+// codegen::install) and of the symbols of the registered functions.
+template class Registry<CutFn<TType>>;
+template class Registry<CutFn<RType>>;
+template class Registry<CutFn<TParticleType>>;
+template class Registry<CutFn<RParticleType>>;
+template class Registry<CutFn<EventType>>;
+template class Registry<CutFn<SpillType>>;
+template class Registry<VarFn<TType>>;
+template class Registry<VarFn<RType>>;
+template class Registry<VarFn<MCTruth>>;
+template class Registry<VarFn<TParticleType>>;
+template class Registry<VarFn<RParticleType>>;
+template class Registry<VarFn<EventType>>;
+template class Registry<SelectorFn<TType>>;
+template class Registry<SelectorFn<RType>>;
+template class Registry<std::string>;
\ No newline at end of file
@@ -6,33 +6,30 @@
  * file, initializing the analysis framework, and running the analysis.
  * @author mueller@fnal.gov
  */
-#define PLACEHOLDERVALUE std::numeric_limits<double>::quiet_NaN()
-#define PROTON_BINDING_ENERGY 30.9 // MeV
-#define BEAM_IS_NUMI false
-
 #include <iostream>
 #include <string>
 #include <memory>
+#include <chrono>
+
+// The cuts and variables are registered by the registration library (see
+// src/registrations/); only the declarations are needed here.
+#define SPINE_NO_REGISTRATION
+#include "definitions.h"
 
 #include "sbnanaobj/StandardRecord/Proxy/SRProxy.h"
 
 #include "configuration.h"
 #include "framework.h"
 #include "scorers.h"
-#include "cuts.h"
-#include "muon2024/cuts_muon2024.h"
-#include "variables.h"
-#include "muon2024/variables_muon2024.h"
-#include "mctruth.h"
-#include "event_cuts.h"
-#include "event_variables.h"
-#include "spill_cuts.h"
-#include "selectors.h"
+#include "placement.h"
+#include "monitor.h"
+#include "matching.h"
+#include "trace.h"
+#include "codegen.h"
+#include "weights.h"
+#include "accumulators.h"
 #include "analysis.h"
 
-std::shared_ptr<VarFn<RParticleType>> pvars::primfn = std::make_shared<VarFn<RParticleType>>(pvars::default_primary_classification<RParticleType>);
-std::shared_ptr<VarFn<RParticleType>> pvars::pidfn = std::make_shared<VarFn<RParticleType>>(pvars::default_pid<RParticleType>);
-
 template<typename T>
 void set_fcn(std::shared_ptr<VarFn<T>> & fcn, const std::string & name)
 {
@@ -51,10 +48,13 @@ int main(int argc, char * argv[])
     // Check if the configuration file is provided as a command line argument
     if (argc < 2)
     {
-        std::cerr << "Usage: " << argv[0] << " <configuration_file>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <configuration_file> [--follow]" << std::endl;
         return 1;
     }
 
+    // In follow mode, the sample directories are polled for new files.
+    bool follow(argc > 2 && std::string(argv[2]) == "--follow");
+
     // Load the configuration file
     cfg::ConfigurationTable config;
     try
@@ -70,6 +70,60 @@ int main(int argc, char * argv[])
         set_fcn(pvars::primfn, config.get_string_field("general.primfn", "default_primary_classification"));
         set_fcn(pvars::pidfn, config.get_string_field("general.pidfn", "default_pid"));
 
+        // Configure the output mode (single file or one file per sample).
+        analysis.SetOutputMode(config.get_string_field("general.output_mode", "single"),
+                               config.get_int_field("general.sample_threads", 1));
+
+        // Configure the (optional) columnar export of the output trees to
+        // POSIX shared memory.
+        if(config.get_bool_field("general.export", false))
+            analysis.SetExport(config.get_string_field("general.export_prefix", "spine"));
+
+        // Configure the backend reading the input files. The "benchmark"
+        // mode runs both backends and compares their outputs.
+        const std::string reader(config.get_string_field("general.reader", "spectrumloader"));
+        const bool benchmark(reader == "benchmark");
+        analysis.SetReader(benchmark ? "spectrumloader" : reader,
+                           static_cast<long long>(config.get_int_field("general.reader_cache_mb", 100)) * 1024 * 1024);
+
+        // Configure the (optional) detection of slow spills.
+        monitor::configure(config.get_double_field("general.slow_spill_percentile", 0.0),
+                           config.get_int_field("general.slow_spill_warmup", 100),
+                           config.get_int_field("general.slow_spill_max", 100));
+
+        // Configure the per-spill memoization of registered functions.
+        memo::SpillContext::set_enabled(config.get_bool_field("general.memoize", true));
+
+        // Configure the sharing of the per-spill cut programs between the
+        // branch variables of a tree.
+        set_shared_selections(config.get_bool_field("general.share_selection", true));
+
+        // Configure the sharing of the tuples of the multi-output variables
+        // between the branches of their components.
+        set_shared_multivars(config.get_bool_field("general.share_multivars", true));
+
+        // Load the (optional) weight maps and register their weight
+        // variables, which are then used as regular branch variables.
+        weights::configure(config);
+
+        // Load the (optional) compiled selection library of this
+        // configuration. If there is none yet, the functions looked up while
+        // building the trees are recorded and compiled for the next runs.
+        bool generate(false);
+        std::string codegen_stem;
+        if(config.get_bool_field("general.codegen", false))
+        {
+            codegen_stem = config.get_string_field("general.codegen_cache", ".spine_codegen") + "/selection_" + codegen::config_hash(argv[1]);
+            generate = !codegen::load(codegen_stem + ".so");
+            if(generate)
+                codegen::record();
+        }
+
+        // Configure the placement of the threads on the NUMA nodes.
+        placement::configure(config.get_string_field("general.placement", "none"));
+        if(placement::policy() != placement::Policy::None)
+            std::cout << "Thread placement: " << placement::describe() << std::endl;
+
         // Configure the samples in the analysis
         std::vector<cfg::ConfigurationTable> samples = config.get_subtables("sample");
         std::vector<std::unique_ptr<ana::SpectrumLoader>> loaders;
@@ -83,10 +137,19 @@ int main(int argc, char * argv[])
                 continue;
             }
 
-            // Create a SpectrumLoader for each sample
-            std::unique_ptr<ana::SpectrumLoader> loader = std::make_unique<ana::SpectrumLoader>(sample.get_string_field("path"));
-            analysis.AddLoader(sample.get_string_field("name"), loader.get(), sample.get_bool_field("ismc"));
-            loaders.push_back(std::move(loader));
+            // Create a SpectrumLoader for each sample. In follow mode, the
+            // loaders are instead created for each batch of new files, and
+            // the SpectrumLoader-free tree writer needs none.
+            if(follow || reader == "treewriter")
+            {
+                analysis.AddSample(sample.get_string_field("name"), sample.get_string_field("path"), sample.get_bool_field("ismc"));
+            }
+            else
+            {
+                std::unique_ptr<ana::SpectrumLoader> loader = std::make_unique<ana::SpectrumLoader>(sample.get_string_field("path"));
+                analysis.AddLoader(sample.get_string_field("name"), loader.get(), sample.get_bool_field("ismc"), sample.get_string_field("path"));
+                loaders.push_back(std::move(loader));
+            }
 
             // Main loop over the trees defined in the configuration
             std::vector<cfg::ConfigurationTable> trees(config.get_subtables("tree"));
@@ -95,6 +158,12 @@ int main(int argc, char * argv[])
                 std::vector<cfg::ConfigurationTable> cuts = tree.get_subtables("cut");
                 std::vector<cfg::ConfigurationTable> vars = tree.get_subtables("branch");
                 std::string mode = tree.get_string_field("mode");
+                // Configure the truth-reco interaction matching policy. Trees
+                // with the same configuration share a single matching per spill.
+                std::shared_ptr<const matching::Policy> policy = matching::get_policy(
+                    tree.get_string_field("match_policy", "first"),
+                    tree.get_double_field("match_threshold", 0.0),
+                    tree.get_string_field("match_energy", "visible_energy"));
                 
                 std::map<std::string, ana::SpillMultiVar> vars_map;
                 for(const auto & var : vars)
@@ -103,17 +172,17 @@ int main(int argc, char * argv[])
                     // variables: one for "true" and one for "reco".
                     if(var.get_string_field("type") == "both")
                     {
-                        NamedSpillMultiVar thisvar_true = construct(cuts, var, mode, "true", sample.get_bool_field("ismc"));
-                        NamedSpillMultiVar thisvar_reco = construct(cuts, var, mode, "reco", sample.get_bool_field("ismc"));
-                        vars_map.try_emplace(thisvar_true.first, thisvar_true.second);
-                        vars_map.try_emplace(thisvar_reco.first, thisvar_reco.second);
+                        for(const NamedSpillMultiVar & thisvar : construct(cuts, var, mode, "true", sample.get_bool_field("ismc"), policy))
+                            vars_map.try_emplace(thisvar.first, thisvar.second);
+                        for(const NamedSpillMultiVar & thisvar : construct(cuts, var, mode, "reco", sample.get_bool_field("ismc"), policy))
+                            vars_map.try_emplace(thisvar.first, thisvar.second);
                     }
                     else if(var.get_string_field("type") == "both_particle")
                     {
-                        NamedSpillMultiVar thisvar_true = construct(cuts, var, mode, "true_particle", sample.get_bool_field("ismc"));
-                        NamedSpillMultiVar thisvar_reco = construct(cuts, var, mode, "reco_particle", sample.get_bool_field("ismc"));
-                        vars_map.try_emplace(thisvar_true.first, thisvar_true.second);
-                        vars_map.try_emplace(thisvar_reco.first, thisvar_reco.second);
+                        for(const NamedSpillMultiVar & thisvar : construct(cuts, var, mode, "true_particle", sample.get_bool_field("ismc"), policy))
+                            vars_map.try_emplace(thisvar.first, thisvar.second);
+                        for(const NamedSpillMultiVar & thisvar : construct(cuts, var, mode, "reco_particle", sample.get_bool_field("ismc"), policy))
+                            vars_map.try_emplace(thisvar.first, thisvar.second);
                     }
                     else if(var.get_string_field("type") == "true"
                             || var.get_string_field("type") == "reco"
@@ -122,8 +191,8 @@ int main(int argc, char * argv[])
                             || var.get_string_field("type") == "reco_particle"
                             || var.get_string_field("type") == "event")
                     {
-                        NamedSpillMultiVar thisvar = construct(cuts, var, mode, var.get_string_field("type"), sample.get_bool_field("ismc"));
-                        vars_map.try_emplace(thisvar.first, thisvar.second);
+                        for(const NamedSpillMultiVar & thisvar : construct(cuts, var, mode, var.get_string_field("type"), sample.get_bool_field("ismc"), policy))
+                            vars_map.try_emplace(thisvar.first, thisvar.second);
                     }
                     else
                     {
@@ -132,6 +201,34 @@ int main(int argc, char * argv[])
                 }
                 analysis.AddTreeForSample(sample.get_string_field("name"), tree.get_string_field("name"), vars_map, tree.get_bool_field("sim_only"));
 
+                // Optionally cluster the rows of the tree by a category branch.
+                if(tree.has_field("cluster_by"))
+                    analysis.SetClustering(tree.get_string_field("name"), tree.get_string_field("cluster_by"));
+
+                // Optionally prescale the rows of chosen categories of the
+                // tree, with a compensating weight branch.
+                if(tree.has_field("prescale"))
+                {
+                    ana::Prescale prescale{tree.get_string_field("prescale_by"), {}, static_cast<uint64_t>(tree.get_int_field("prescale_seed", 0))};
+                    for(const auto & entry : tree.get_subtables("prescale"))
+                    {
+                        const int64_t factor(entry.get_int_field("factor"));
+                        if(factor < 1)
+                            throw cfg::ConfigurationError("Prescale factors of tree " + tree.get_string_field("name") + " must be positive.");
+                        prescale.factors[entry.get_double_field("category")] = static_cast<uint64_t>(factor);
+                    }
+                    analysis.SetPrescale(tree.get_string_field("name"), prescale);
+                }
+
+                // Optionally accumulate binned statistics of the branches of
+                // the tree, possibly instead of writing the tree itself.
+                analysis.SetTreeOutput(tree.get_string_field("name"), tree.get_bool_field("write", true));
+                if(tree.has_field("accumulator"))
+                {
+                    for(const auto & accumulator : tree.get_subtables("accumulator"))
+                        analysis.AddAccumulator(sample.get_string_field("name"), tree.get_string_field("name"), accumulators::configure(accumulator));
+                }
+
                 // Add the exposure tree.
                 if(tree.get_bool_field("add_exposure", false))
                 {
@@ -149,7 +246,51 @@ int main(int argc, char * argv[])
             }
         }
 
-        analysis.Go();
+        // Write the translation unit of the recorded functions.
+        if(generate)
+            codegen::generate(codegen_stem + ".cc", argv[1]);
+
+        // Write the id to name map of the tracepoint arguments.
+        if(trace::enabled)
+            trace::write_symbol_map(config.get_string_field("general.output") + ".symbols.tsv");
+
+        const auto start(std::chrono::steady_clock::now());
+        if(follow)
+        {
+            analysis.Follow(config.get_int_field("general.follow_interval", 60),
+                            config.get_int_field("general.follow_settle", 30),
+                            config.get_int_field("general.follow_max_files", 0),
+                            config.get_int_field("general.follow_iterations", 0));
+        }
+        else if(benchmark)
+            analysis.Benchmark();
+        else
+            analysis.Go();
+        placement::report("selection", "spills", analysis.GetSpills(),
+                          std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+                          config.get_string_field("general.placement_log", ""));
+
+        // Compile the selection library for the next runs.
+        if(generate)
+            codegen::compile(codegen_stem + ".cc", codegen_stem + ".so");
+
+        // Write the slow spills and, optionally, copy them to small CAF
+        // files for offline profiling.
+        if(monitor::enabled())
+        {
+            const std::string output(config.get_string_field("general.output"));
+            monitor::write(output + ".slow_spills.tsv");
+            if(config.get_bool_field("general.slow_spill_dump", false))
+            {
+                for(const auto & sample : samples)
+                {
+                    if(sample.get_bool_field("disable", false))
+                        continue;
+                    const std::string name(sample.get_string_field("name"));
+                    monitor::dump(name, sample.get_string_field("path"), output + "_slow_" + name + ".root");
+                }
+            }
+        }
     }
     catch(const cfg::ConfigurationError &e)
     {
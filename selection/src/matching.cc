@@ -0,0 +1,279 @@
+/**
+ * @file matching.cc
+ * @brief Implementation of the spill-level truth-reco interaction matching
+ * engine of the SPINE analysis framework.
+ * @details This file contains the implementation of the matching policies
+ * and the per-spill cache of their results.
+ * @author mueller@fnal.gov
+ */
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "sbnanaobj/StandardRecord/Proxy/SRProxy.h"
+
+#include "framework.h"
+#include "matching.h"
+#include "memo.h"
+
+namespace
+{
+    /**
+     * @brief Get the overlap-qualified candidates of an interaction.
+     * @details The candidates are the entries of the match list of the
+     * interaction that point to a valid index of the complementary collection
+     * and have an overlap of at least the threshold.
+     * @tparam T The type of the interaction.
+     * @param obj The interaction.
+     * @param size The size of the complementary collection.
+     * @param threshold The minimum overlap.
+     * @return The list of (index, overlap) pairs.
+     */
+    template<typename T>
+    std::vector<std::pair<size_t, double>> candidates(const T & obj, size_t size, double threshold)
+    {
+        std::vector<std::pair<size_t, double>> result;
+        for(size_t k(0); k < obj.match_ids.size(); ++k)
+        {
+            int64_t id(obj.match_ids[k]);
+            double overlap(k < obj.match_overlaps.size() ? (double)obj.match_overlaps[k] : 0.0);
+            if(id < 0 || (size_t)id >= size || overlap < threshold)
+                continue;
+            result.emplace_back((size_t)id, overlap);
+        }
+        return result;
+    }
+
+    /**
+     * @brief Match the interactions of one collection to the complementary
+     * collection, one interaction at a time.
+     * @details This implements the directional policies ("first", "iou", and
+     * "best_energy"), which do not enforce a one-to-one matching.
+     * @tparam T The type of the interactions to match.
+     * @param objs The interactions to match.
+     * @param size The size of the complementary collection.
+     * @param kind The kind of the policy.
+     * @param threshold The minimum overlap.
+     * @param energy The energies of the interactions to match.
+     * @param other The energies of the complementary collection.
+     * @return The matched index for each interaction, or kNoMatch.
+     */
+    template<typename T>
+    std::vector<size_t> match_directional(const T & objs, size_t size, matching::Kind kind, double threshold,
+                                          const std::vector<double> & energy, const std::vector<double> & other)
+    {
+        std::vector<size_t> result(objs.size(), kNoMatch);
+        for(size_t i(0); i < objs.size(); ++i)
+        {
+            if(kind == matching::Kind::First)
+            {
+                // Historical behavior: the first entry, irrespective of the
+                // overlap (provided it points to a valid interaction).
+                if(objs[i].match_ids.size() > 0)
+                {
+                    int64_t id(objs[i].match_ids[0]);
+                    if(id >= 0 && (size_t)id < size)
+                        result[i] = (size_t)id;
+                }
+                continue;
+            }
+
+            double best(-std::numeric_limits<double>::infinity());
+            for(const auto & [id, overlap] : candidates(objs[i], size, threshold))
+            {
+                double score(kind == matching::Kind::IoU ? overlap : -std::abs(other[id] - energy[i]));
+                if(score > best)
+                {
+                    best = score;
+                    result[i] = id;
+                }
+            }
+        }
+        return result;
+    }
+}
+
+namespace matching
+{
+    // Constructor for the Policy class.
+    Policy::Policy(Kind kind, double threshold, VarFn<TType> true_energy, VarFn<RType> reco_energy)
+        : kind_(kind), threshold_(threshold), true_energy_(std::move(true_energy)), reco_energy_(std::move(reco_energy)) {}
+
+    // Get the matching for the spill.
+    const Matching & Policy::match(const EventType & sr) const
+    {
+        // The cache is thread-local like the memoization context, and is
+        // invalidated with the generation of the context.
+        thread_local std::unordered_map<const Policy *, std::pair<uint64_t, Matching>> cache;
+        const uint64_t generation(memo::SpillContext::current().generation());
+        auto & [g, result] = cache[this];
+        if(g != generation)
+        {
+            compute(sr, result);
+            g = generation;
+        }
+        return result;
+    }
+
+    // Compute the matching for the spill.
+    void Policy::compute(const EventType & sr, Matching & result) const
+    {
+        const size_t ntrue(sr.dlp_true.size());
+        const size_t nreco(sr.dlp.size());
+
+        if(kind_ == Kind::OneToOne)
+        {
+            // Symmetrize the overlaps: either side may list the pair.
+            std::vector<double> weights(ntrue * nreco, 0.0);
+            for(size_t t(0); t < ntrue; ++t)
+                for(const auto & [r, overlap] : candidates(sr.dlp_true[t], nreco, threshold_))
+                    weights[t * nreco + r] = std::max(weights[t * nreco + r], overlap);
+            for(size_t r(0); r < nreco; ++r)
+                for(const auto & [t, overlap] : candidates(sr.dlp[r], ntrue, threshold_))
+                    weights[t * nreco + r] = std::max(weights[t * nreco + r], overlap);
+
+            result.true_to_reco = assign(weights, ntrue, nreco);
+            result.reco_to_true.assign(nreco, kNoMatch);
+            for(size_t t(0); t < ntrue; ++t)
+                if(result.true_to_reco[t] != kNoMatch)
+                    result.reco_to_true[result.true_to_reco[t]] = t;
+            return;
+        }
+
+        std::vector<double> true_energy, reco_energy;
+        if(kind_ == Kind::BestEnergy)
+        {
+            for(size_t t(0); t < ntrue; ++t)
+                true_energy.push_back(true_energy_(sr.dlp_true[t]));
+            for(size_t r(0); r < nreco; ++r)
+                reco_energy.push_back(reco_energy_(sr.dlp[r]));
+        }
+        result.true_to_reco = match_directional(sr.dlp_true, nreco, kind_, threshold_, true_energy, reco_energy);
+        result.reco_to_true = match_directional(sr.dlp, ntrue, kind_, threshold_, reco_energy, true_energy);
+    }
+
+    // Get the shared policy for a configuration.
+    std::shared_ptr<const Policy> get_policy(const std::string & name, double threshold, const std::string & energy)
+    {
+        Kind kind;
+        if(name == "first") kind = Kind::First;
+        else if(name == "iou") kind = Kind::IoU;
+        else if(name == "one_to_one") kind = Kind::OneToOne;
+        else if(name == "best_energy") kind = Kind::BestEnergy;
+        else throw std::runtime_error("Illegal match policy '" + name + "'.");
+
+        // The energy variable only distinguishes "best_energy" policies.
+        const std::string variable(kind == Kind::BestEnergy ? energy : std::string());
+        static std::mutex mutex;
+        static std::map<std::tuple<Kind, double, std::string>, std::shared_ptr<const Policy>> policies;
+        std::lock_guard<std::mutex> lock(mutex);
+        auto & policy = policies[std::make_tuple(kind, threshold, variable)];
+        if(!policy)
+        {
+            VarFn<TType> true_energy;
+            VarFn<RType> reco_energy;
+            if(kind == Kind::BestEnergy)
+            {
+                true_energy = VarFactoryRegistry<TType>::instance().get("true_" + variable)({});
+                reco_energy = VarFactoryRegistry<RType>::instance().get("reco_" + variable)({});
+            }
+            policy = std::make_shared<const Policy>(kind, threshold, true_energy, reco_energy);
+        }
+        return policy;
+    }
+
+    // Get the shared policy reproducing the historical behavior.
+    std::shared_ptr<const Policy> default_policy()
+    {
+        return get_policy("first");
+    }
+
+    // Solve the assignment problem maximizing the total weight.
+    std::vector<size_t> assign(const std::vector<double> & weights, size_t nrows, size_t ncols)
+    {
+        std::vector<size_t> result(nrows, kNoMatch);
+        if(nrows == 0 || ncols == 0)
+            return result;
+
+        // The algorithm below requires n <= m, so work on the transpose if
+        // there are more rows than columns. Costs are negated weights.
+        const bool transpose(nrows > ncols);
+        const size_t n(transpose ? ncols : nrows);
+        const size_t m(transpose ? nrows : ncols);
+        auto cost = [&](size_t i, size_t j) -> double
+        {
+            return transpose ? -weights[j * ncols + i] : -weights[i * ncols + j];
+        };
+
+        // Hungarian algorithm with potentials (1-indexed, column 0 is the
+        // virtual starting column).
+        const double inf(std::numeric_limits<double>::infinity());
+        std::vector<double> u(n + 1, 0), v(m + 1, 0);
+        std::vector<size_t> p(m + 1, 0), way(m + 1, 0);
+        for(size_t i(1); i <= n; ++i)
+        {
+            p[0] = i;
+            size_t j0(0);
+            std::vector<double> minv(m + 1, inf);
+            std::vector<bool> used(m + 1, false);
+            do
+            {
+                used[j0] = true;
+                size_t i0(p[j0]), j1(0);
+                double delta(inf);
+                for(size_t j(1); j <= m; ++j)
+                {
+                    if(used[j])
+                        continue;
+                    double cur(cost(i0 - 1, j - 1) - u[i0] - v[j]);
+                    if(cur < minv[j])
+                    {
+                        minv[j] = cur;
+                        way[j] = j0;
+                    }
+                    if(minv[j] < delta)
+                    {
+                        delta = minv[j];
+                        j1 = j;
+                    }
+                }
+                for(size_t j(0); j <= m; ++j)
+                {
+                    if(used[j])
+                    {
+                        u[p[j]] += delta;
+                        v[j] -= delta;
+                    }
+                    else
+                        minv[j] -= delta;
+                }
+                j0 = j1;
+            } while(p[j0] != 0);
+            do
+            {
+                size_t j1(way[j0]);
+                p[j0] = p[j1];
+                j0 = j1;
+            } while(j0 != 0);
+        }
+
+        // Read off the assignment, dropping pairs without any overlap.
+        for(size_t j(1); j <= m; ++j)
+        {
+            if(p[j] == 0)
+                continue;
+            size_t row(transpose ? j - 1 : p[j] - 1);
+            size_t col(transpose ? p[j] - 1 : j - 1);
+            if(weights[row * ncols + col] > 0)
+                result[row] = col;
+        }
+        return result;
+    }
+}
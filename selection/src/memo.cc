@@ -0,0 +1,62 @@
+/**
+ * @file memo.cc
+ * @brief Implementation of the per-spill memoization context.
+ * @details This file contains the implementation of the non-template members
+ * of the per-spill memoization context declared in memo.h.
+ * @author mueller@fnal.gov
+ */
+#include <atomic>
+
+#include "memo.h"
+#include "trace.h"
+
+namespace memo
+{
+    // Global switch for memoization. This is set once at configuration time,
+    // but is read by every thread evaluating a spill.
+    static std::atomic<bool> memo_enabled(true);
+
+    // Get the context of the calling thread.
+    SpillContext & SpillContext::current()
+    {
+        static thread_local SpillContext context;
+        return context;
+    }
+
+    // Mark the start of the evaluation of a new spill.
+    void SpillContext::begin_spill()
+    {
+        end_spill();
+        ++spill_;
+        ++generation_;
+        open_ = true;
+        SPINE_PROBE1(spill_begin, spill_);
+    }
+
+    // Mark the end of the evaluation of the current spill.
+    void SpillContext::end_spill()
+    {
+        if(!open_)
+            return;
+        SPINE_PROBE1(spill_end, spill_);
+        open_ = false;
+    }
+
+    // Force the invalidation of all cached results.
+    void SpillContext::invalidate()
+    {
+        ++generation_;
+    }
+
+    // Enable or disable memoization globally.
+    void SpillContext::set_enabled(bool enabled)
+    {
+        memo_enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    // Check if memoization is enabled.
+    bool SpillContext::enabled()
+    {
+        return memo_enabled.load(std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,333 @@
+/**
+ * @file monitor.cc
+ * @brief Implementation of the slow-spill detector.
+ * @details This file contains the implementation of the streaming quantile
+ * estimator, the processing time measurement of the output trees, and the
+ * writing of the recorded slow spills.
+ * @author mueller@fnal.gov
+ */
+#include <map>
+#include <set>
+#include <mutex>
+#include <tuple>
+#include <cmath>
+#include <chrono>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+#include "sbnanaobj/StandardRecord/Proxy/SRProxy.h"
+
+#include "TFile.h"
+#include "TChain.h"
+#include "TLeaf.h"
+#include "TH1.h"
+
+#include "monitor.h"
+
+namespace
+{
+    /**
+     * @struct TreeState
+     * @brief The processing time measurement of a tree of a sample.
+     */
+    struct TreeState
+    {
+        TreeState(const std::string & sample, const std::string & tree, double p)
+            : quantile(p) { current.sample = sample; current.tree = tree; }
+
+        monitor::Quantile quantile;
+        monitor::Record current;
+        bool started = false;
+        double ns = 0;
+        size_t spills = 0;
+        size_t recorded = 0;
+        double total = 0;
+        double max = 0;
+    };
+
+    // The configuration of the detector.
+    double configured_percentile(0);
+    size_t configured_warmup(0);
+    size_t configured_max(0);
+
+    // The measurements of the trees and the recorded spills.
+    std::mutex mutex;
+    std::map<std::pair<std::string, std::string>, std::unique_ptr<TreeState>> states;
+    std::vector<monitor::Record> slow;
+
+    /**
+     * @brief Complete the measurement of the current spill of a tree.
+     * @param state The measurement of the tree.
+     * @return void
+     */
+    void complete(TreeState & state)
+    {
+        if(!state.started)
+            return;
+        const double ms(state.ns * 1e-6);
+        const double threshold(state.quantile.value());
+        if(state.quantile.count() >= configured_warmup && ms > threshold && state.recorded < configured_max)
+        {
+            state.current.time = ms;
+            state.current.threshold = threshold;
+            std::lock_guard<std::mutex> lock(mutex);
+            slow.push_back(state.current);
+            ++state.recorded;
+        }
+        state.quantile.add(ms);
+        state.total += ms;
+        state.max = std::max(state.max, ms);
+        ++state.spills;
+        state.started = false;
+        state.ns = 0;
+    }
+
+    /**
+     * @brief Start the measurement of a new spill of a tree.
+     * @details The identity and size statistics of the spill are captured
+     * here, as the record of the previous spill is no longer available once
+     * the spill is found to be slow.
+     * @param state The measurement of the tree.
+     * @param sr The spill.
+     * @return void
+     */
+    void start(TreeState & state, const caf::Proxy<caf::StandardRecord> & sr)
+    {
+        complete(state);
+        monitor::Record & r(state.current);
+        r.run = sr.hdr.run;
+        r.subrun = sr.hdr.subrun;
+        r.event = sr.hdr.evt;
+        r.interactions = sr.ndlp;
+        r.true_interactions = sr.ndlp_true;
+        r.particles = 0;
+        for(const auto & i : sr.dlp)
+            r.particles += i.particles.size();
+        r.flashes = sr.nopflashes;
+        state.started = true;
+    }
+}
+
+namespace monitor
+{
+    // Constructor for the Quantile class.
+    Quantile::Quantile(double p)
+        : p_(p), n_{0, 1, 2, 3, 4}, np_{0, 2 * p, 4 * p, 2 + 2 * p, 4}, dn_{0, p / 2, p, (1 + p) / 2, 1} {}
+
+    // Add an observation.
+    void Quantile::add(double x)
+    {
+        if(count_ < 5)
+        {
+            q_[count_++] = x;
+            if(count_ == 5)
+                std::sort(q_.begin(), q_.end());
+            return;
+        }
+        ++count_;
+
+        // Find the cell of the observation and update the extreme markers.
+        size_t k;
+        if(x < q_[0]) { q_[0] = x; k = 0; }
+        else if(x < q_[1]) k = 0;
+        else if(x < q_[2]) k = 1;
+        else if(x < q_[3]) k = 2;
+        else if(x <= q_[4]) k = 3;
+        else { q_[4] = x; k = 3; }
+        for(size_t i(k + 1); i < 5; ++i)
+            n_[i] += 1;
+        for(size_t i(0); i < 5; ++i)
+            np_[i] += dn_[i];
+
+        // Adjust the heights of the middle markers if they are off by more
+        // than one position from their desired positions.
+        for(size_t i(1); i < 4; ++i)
+        {
+            const double d(np_[i] - n_[i]);
+            if((d >= 1 && n_[i + 1] - n_[i] > 1) || (d <= -1 && n_[i - 1] - n_[i] < -1))
+            {
+                const double s(d > 0 ? 1 : -1);
+                const double parabolic(q_[i] + s / (n_[i + 1] - n_[i - 1])
+                                       * ((n_[i] - n_[i - 1] + s) * (q_[i + 1] - q_[i]) / (n_[i + 1] - n_[i])
+                                          + (n_[i + 1] - n_[i] - s) * (q_[i] - q_[i - 1]) / (n_[i] - n_[i - 1])));
+                if(q_[i - 1] < parabolic && parabolic < q_[i + 1])
+                    q_[i] = parabolic;
+                else
+                {
+                    const size_t j(s > 0 ? i + 1 : i - 1);
+                    q_[i] += s * (q_[j] - q_[i]) / (n_[j] - n_[i]);
+                }
+                n_[i] += s;
+            }
+        }
+    }
+
+    // Get the current estimate of the quantile.
+    double Quantile::value() const
+    {
+        if(count_ == 0)
+            return 0;
+        if(count_ < 5)
+        {
+            std::array<double, 5> sorted(q_);
+            std::sort(sorted.begin(), sorted.begin() + count_);
+            return sorted[(size_t)std::lround(p_ * (count_ - 1))];
+        }
+        return q_[2];
+    }
+
+    // Configure the slow-spill detector.
+    void configure(double percentile, size_t warmup, size_t max_records)
+    {
+        configured_percentile = (percentile > 0 && percentile < 100) ? percentile : 0;
+        configured_warmup = warmup;
+        configured_max = max_records;
+    }
+
+    // Check if the slow-spill detector is enabled.
+    bool enabled()
+    {
+        return configured_percentile > 0;
+    }
+
+    // Wrap the SpillMultiVars of a tree with the processing time measurement.
+    std::vector<ana::SpillMultiVar> wrap(const std::string & sample, const std::string & tree,
+                                         const std::vector<ana::SpillMultiVar> & vars)
+    {
+        TreeState * state;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::unique_ptr<TreeState> & s(states[std::make_pair(sample, tree)]);
+            if(!s)
+                s = std::make_unique<TreeState>(sample, tree, configured_percentile / 100.0);
+            state = s.get();
+        }
+
+        // The Tree evaluates each of its SpillMultiVars once per spill, in
+        // order, so the first one marks the start of a new spill.
+        std::vector<ana::SpillMultiVar> result;
+        for(size_t k(0); k < vars.size(); ++k)
+        {
+            ana::SpillMultiVar var(vars[k]);
+            result.push_back(ana::SpillMultiVar([var, state, k](const caf::Proxy<caf::StandardRecord> * sr) -> std::vector<double>
+            {
+                if(k == 0)
+                    start(*state, *sr);
+                const auto t0(std::chrono::steady_clock::now());
+                std::vector<double> values(var(sr));
+                state->ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+                return values;
+            }));
+        }
+        return result;
+    }
+
+    // Complete the last spill of the trees of a sample.
+    void flush(const std::string & sample)
+    {
+        std::vector<TreeState *> sample_states;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for(auto & [key, state] : states)
+                if(key.first == sample)
+                    sample_states.push_back(state.get());
+        }
+        for(TreeState * state : sample_states)
+        {
+            complete(*state);
+            if(state->spills == 0)
+                continue;
+            std::lock_guard<std::mutex> lock(mutex);
+            std::cout << "Spill processing time (" << sample << "/" << state->current.tree << "): "
+                      << state->spills << " spills, mean " << state->total / state->spills << " ms, p"
+                      << configured_percentile << " " << state->quantile.value() << " ms, max "
+                      << state->max << " ms, " << state->recorded << " slow spill(s) recorded." << std::endl;
+        }
+    }
+
+    // Get the recorded slow spills.
+    std::vector<Record> records()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return slow;
+    }
+
+    // Write the recorded slow spills to a tab-separated table.
+    void write(const std::string & path)
+    {
+        std::ofstream out(path);
+        if(!out)
+            throw std::runtime_error("Unable to write slow spill table " + path + ".");
+        out << "sample\ttree\trun\tsubrun\tevent\ttime_ms\tthreshold_ms\tinteractions\ttrue_interactions\tparticles\tflashes\n";
+        for(const Record & r : records())
+        {
+            out << r.sample << "\t" << r.tree << "\t" << r.run << "\t" << r.subrun << "\t" << r.event << "\t"
+                << r.time << "\t" << r.threshold << "\t" << r.interactions << "\t" << r.true_interactions << "\t"
+                << r.particles << "\t" << r.flashes << "\n";
+        }
+    }
+
+    // Copy the recorded slow spills of a sample to a small CAF file.
+    size_t dump(const std::string & sample, const std::string & inputs, const std::string & path)
+    {
+        std::set<std::tuple<uint32_t, uint32_t, uint32_t>> wanted;
+        for(const Record & r : records())
+            if(r.sample == sample)
+                wanted.emplace(r.run, r.subrun, r.event);
+        if(wanted.empty())
+            return 0;
+
+        // Find the entries of the spills, reading only the header branches.
+        // The POT recorded in the headers of the copied spills is summed on
+        // the way.
+        TChain chain("recTree");
+        chain.Add(inputs.c_str());
+        chain.SetBranchStatus("*", 0);
+        for(const char * b : {"rec.hdr.run", "rec.hdr.subrun", "rec.hdr.evt", "rec.hdr.pot"})
+            chain.SetBranchStatus(b, 1);
+        std::vector<Long64_t> entries;
+        double pot(0);
+        const Long64_t n(chain.GetEntries());
+        for(Long64_t i(0); i < n; ++i)
+        {
+            chain.GetEntry(i);
+            auto value = [&](const char * name) -> uint32_t { return (uint32_t)chain.GetLeaf(name)->GetValue(); };
+            if(wanted.count(std::make_tuple(value("rec.hdr.run"), value("rec.hdr.subrun"), value("rec.hdr.evt"))))
+            {
+                entries.push_back(i);
+                if(TLeaf * leaf = chain.GetLeaf("rec.hdr.pot"))
+                    pot += leaf->GetValue();
+            }
+        }
+        chain.SetBranchStatus("*", 1);
+
+        TFile output(path.c_str(), "RECREATE");
+        if(output.IsZombie())
+            throw std::runtime_error("Unable to write slow spill file " + path + ".");
+        TTree * tree(chain.CloneTree(0));
+        for(Long64_t i : entries)
+        {
+            chain.GetEntry(i);
+            tree->Fill();
+        }
+        output.cd();
+        tree->Write();
+
+        // Write the exposure of the copied spills only: one event per spill
+        // and the POT of their headers.
+        TH1D total_pot("TotalPOT", "TotalPOT", 1, 0, 1);
+        TH1D total_events("TotalEvents", "TotalEvents", 1, 0, 1);
+        total_pot.SetDirectory(nullptr);
+        total_events.SetDirectory(nullptr);
+        total_pot.SetBinContent(1, pot);
+        total_events.SetBinContent(1, (double)entries.size());
+        output.WriteTObject(&total_pot, "TotalPOT");
+        output.WriteTObject(&total_events, "TotalEvents");
+        output.Close();
+        std::cout << "Copied " << entries.size() << " slow spill(s) of sample '" << sample << "' to " << path << std::endl;
+        return entries.size();
+    }
+}
@@ -0,0 +1,252 @@
+/**
+ * @file reader.cc
+ * @brief Implementation of the SpectrumLoader-free tree writer of the SPINE
+ * analysis framework.
+ * @details This file contains the implementation of the loader, the output
+ * trees, and the comparison of the outputs declared in reader.h.
+ * @author mueller@fnal.gov
+ */
+#include <set>
+#include <cmath>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <glob.h>
+
+#include "TFile.h"
+#include "TKey.h"
+#include "TH1.h"
+#include "TH1D.h"
+#include "TLeaf.h"
+
+#include "reader.h"
+#include "memo.h"
+
+namespace reader
+{
+    // Expand the path of the input files of a sample.
+    std::vector<std::string> expand(const std::string & path)
+    {
+        std::vector<std::string> files;
+        glob_t g;
+        if(glob(path.c_str(), 0, nullptr, &g) == 0)
+        {
+            for(size_t i(0); i < g.gl_pathc; ++i)
+                files.push_back(g.gl_pathv[i]);
+        }
+        globfree(&g);
+        if(files.empty())
+            throw std::runtime_error("No input files match " + path + " (the SpectrumLoader-free tree writer does not support SAM definitions).");
+        return files;
+    }
+
+    // Constructor for the Tree class.
+    Tree::Tree(const std::string & name, const std::vector<std::string> & names, Loader & loader,
+               const std::vector<ana::SpillMultiVar> & vars)
+        : name_(name), names_(names), loader_(loader), vars_(vars), values_(names.size())
+    {
+        TDirectory::TContext context(nullptr);
+        tree_ = new TTree(name_.c_str(), name_.c_str());
+        tree_->SetDirectory(nullptr);
+        for(size_t k(0); k < names_.size(); ++k)
+            tree_->Branch(names_[k].c_str(), &values_[k], (names_[k] + "/D").c_str());
+        tree_->Branch("Run", &run_, "Run/I");
+        tree_->Branch("Subrun", &subrun_, "Subrun/I");
+        tree_->Branch("Evt", &evt_, "Evt/I");
+        loader_.Register(this);
+    }
+
+    // Destructor for the Tree class.
+    Tree::~Tree()
+    {
+        delete tree_;
+    }
+
+    // Fill the rows of a spill.
+    void Tree::Fill(const caf::Proxy<caf::StandardRecord> & sr)
+    {
+        std::vector<std::vector<double>> columns(vars_.size());
+        for(size_t k(0); k < vars_.size(); ++k)
+        {
+            columns[k] = vars_[k](&sr);
+            if(columns[k].size() != columns[0].size())
+                throw std::runtime_error("Branch " + names_[k] + " of tree " + name_ + " has " + std::to_string(columns[k].size())
+                                         + " rows in a spill (expected " + std::to_string(columns[0].size()) + ").");
+        }
+        if(columns.empty() || columns[0].empty())
+            return;
+        run_ = sr.hdr.run;
+        subrun_ = sr.hdr.subrun;
+        evt_ = sr.hdr.evt;
+        for(size_t r(0); r < columns[0].size(); ++r)
+        {
+            for(size_t k(0); k < columns.size(); ++k)
+                values_[k] = columns[k][r];
+            tree_->Fill();
+        }
+    }
+
+    // Write the tree and the exposure histograms.
+    void Tree::SaveTo(TDirectory * dir) const
+    {
+        TDirectory::TContext context(dir);
+        dir->WriteTObject(tree_, name_.c_str());
+        TH1D pot("POT", "POT", 1, 0, 1);
+        pot.SetDirectory(nullptr);
+        pot.SetBinContent(1, loader_.GetPOT());
+        dir->WriteTObject(&pot, "POT", "Overwrite");
+        TH1D livetime("Livetime", "Livetime", 1, 0, 1);
+        livetime.SetDirectory(nullptr);
+        livetime.SetBinContent(1, loader_.GetLivetime());
+        dir->WriteTObject(&livetime, "Livetime", "Overwrite");
+    }
+
+    // Constructor for the Loader class.
+    Loader::Loader(std::vector<std::string> files)
+        : files_(std::move(files)) {}
+
+    // Configure the TTreeCache of the input files.
+    void Loader::SetCache(long long bytes, long long learn)
+    {
+        cache_bytes_ = bytes;
+        cache_learn_ = learn;
+    }
+
+    // Loop over the spills of all input files.
+    void Loader::Go()
+    {
+        for(const std::string & path : files_)
+        {
+            std::unique_ptr<TFile> file(TFile::Open(path.c_str(), "READ"));
+            if(!file || file->IsZombie())
+                throw std::runtime_error("Unable to open input file " + path + ".");
+            if(TH1 * h = file->Get<TH1>("TotalPOT"))
+                pot_ += h->Integral(0, h->GetNbinsX() + 1);
+            if(TH1 * h = file->Get<TH1>("TotalEvents"))
+                livetime_ += h->Integral(0, h->GetNbinsX() + 1);
+            TTree * tree(file->Get<TTree>("recTree"));
+            if(tree == nullptr)
+                throw std::runtime_error("Input file " + path + " has no recTree.");
+
+            // The cache learns the branches read by the SpillMultiVars in the
+            // first spills and then prefetches only those.
+            tree->SetCacheSize(cache_bytes_);
+            if(cache_bytes_ > 0)
+            {
+                tree->SetCacheLearnEntries(cache_learn_);
+                tree->SetCacheEntryRange(0, tree->GetEntries());
+            }
+
+            long n(0);
+            caf::Proxy<caf::StandardRecord> sr(file.get(), tree, "rec", n, 0);
+            const long entries(tree->GetEntries());
+            for(n = 0; n < entries; ++n)
+            {
+                tree->LoadTree(n);
+                memo::SpillContext::current().begin_spill();
+                for(Tree * t : trees_)
+                    t->Fill(sr);
+                memo::SpillContext::current().end_spill();
+                ++spills_;
+            }
+        }
+    }
+
+    // Compare the output files of two backends.
+    size_t compare(TDirectory * a, TDirectory * b, std::ostream & log)
+    {
+        size_t mismatches(0);
+        std::set<std::string> names;
+        for(TDirectory * d : {a, b})
+            for(TObject * obj : *d->GetListOfKeys())
+                names.insert(obj->GetName());
+
+        for(const std::string & name : names)
+        {
+            const std::string path(std::string(a->GetPath()) + "/" + name);
+            TKey * ka(a->GetKey(name.c_str())), * kb(b->GetKey(name.c_str()));
+            if(!ka || !kb)
+            {
+                log << "  " << path << ": missing from the " << (ka ? "second" : "first") << " output" << std::endl;
+                ++mismatches;
+                continue;
+            }
+            std::unique_ptr<TObject> oa(ka->ReadObj()), ob(kb->ReadObj());
+            auto same = [](double x, double y) { return x == y || (std::isnan(x) && std::isnan(y)); };
+
+            if(TDirectory * da = dynamic_cast<TDirectory *>(oa.get()))
+            {
+                TDirectory * db(dynamic_cast<TDirectory *>(ob.get()));
+                if(!db)
+                {
+                    log << "  " << path << ": not a directory in the second output" << std::endl;
+                    ++mismatches;
+                }
+                else
+                    mismatches += compare(da, db, log);
+                oa.release();
+                ob.release();
+            }
+            else if(TTree * ta = dynamic_cast<TTree *>(oa.get()))
+            {
+                TTree * tb(dynamic_cast<TTree *>(ob.get()));
+                if(!tb || ta->GetEntries() != tb->GetEntries() || ta->GetNbranches() != tb->GetNbranches())
+                {
+                    log << "  " << path << ": " << ta->GetEntries() << " vs " << (tb ? tb->GetEntries() : 0) << " entries, "
+                        << ta->GetNbranches() << " vs " << (tb ? tb->GetNbranches() : 0) << " branches" << std::endl;
+                    ++mismatches;
+                    continue;
+                }
+                std::vector<std::pair<TLeaf *, TLeaf *>> leaves;
+                for(TObject * obj : *ta->GetListOfLeaves())
+                {
+                    TLeaf * la(static_cast<TLeaf *>(obj));
+                    TLeaf * lb(tb->GetLeaf(la->GetName()));
+                    if(!lb)
+                    {
+                        log << "  " << path << ": branch " << la->GetName() << " missing from the second output" << std::endl;
+                        ++mismatches;
+                        continue;
+                    }
+                    leaves.emplace_back(la, lb);
+                }
+                size_t differences(0);
+                for(Long64_t i(0); i < ta->GetEntries(); ++i)
+                {
+                    ta->GetEntry(i);
+                    tb->GetEntry(i);
+                    for(const auto & [la, lb] : leaves)
+                    {
+                        if(same(la->GetValue(), lb->GetValue()))
+                            continue;
+                        if(differences++ == 0)
+                            log << "  " << path << ": entry " << i << ", branch " << la->GetName() << ": "
+                                << la->GetValue() << " vs " << lb->GetValue() << std::endl;
+                    }
+                }
+                if(differences > 0)
+                {
+                    log << "  " << path << ": " << differences << " differing values" << std::endl;
+                    ++mismatches;
+                }
+            }
+            else if(TH1 * ha = dynamic_cast<TH1 *>(oa.get()))
+            {
+                TH1 * hb(dynamic_cast<TH1 *>(ob.get()));
+                bool equal(hb && ha->GetNcells() == hb->GetNcells());
+                for(int i(0); equal && i < ha->GetNcells(); ++i)
+                {
+                    const double x(ha->GetBinContent(i)), y(hb->GetBinContent(i));
+                    equal = std::abs(x - y) <= 1e-9 * std::max(std::abs(x), std::abs(y));
+                }
+                if(!equal)
+                {
+                    log << "  " << path << ": histograms differ (integral " << ha->Integral() << " vs "
+                        << (hb ? hb->Integral() : 0) << ")" << std::endl;
+                    ++mismatches;
+                }
+            }
+        }
+        return mismatches;
+    }
+}
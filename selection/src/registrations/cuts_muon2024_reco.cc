@@ -0,0 +1,14 @@
+/**
+ * @file cuts_muon2024_reco.cc
+ * @brief Registration of the muon2024 cuts (muon2024/cuts_muon2024.h) for the
+ * reco interaction type.
+ * @author mueller@fnal.gov
+ */
+#define SPINE_REGISTER_HEADER "muon2024/cuts_muon2024.h"
+#define SPINE_REGISTER_TYPE RType
+#include "definitions.h"
+
+#include "sbnanaobj/StandardRecord/Proxy/SRProxy.h"
+
+#include "framework.h"
+#include "muon2024/cuts_muon2024.h"
@@ -0,0 +1,13 @@
+/**
+ * @file cuts_reco.cc
+ * @brief Registration of the cuts (cuts.h) for the reco interaction type.
+ * @author mueller@fnal.gov
+ */
+#define SPINE_REGISTER_HEADER "cuts.h"
+#define SPINE_REGISTER_TYPE RType
+#include "definitions.h"
+
+#include "sbnanaobj/StandardRecord/Proxy/SRProxy.h"
+
+#include "framework.h"
+#include "cuts.h"
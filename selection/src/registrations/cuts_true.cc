@@ -0,0 +1,13 @@
+/**
+ * @file cuts_true.cc
+ * @brief Registration of the cuts (cuts.h) for the true interaction type.
+ * @author mueller@fnal.gov
+ */
+#define SPINE_REGISTER_HEADER "cuts.h"
+#define SPINE_REGISTER_TYPE TType
+#include "definitions.h"
+
+#include "sbnanaobj/StandardRecord/Proxy/SRProxy.h"
+
+#include "framework.h"
+#include "cuts.h"
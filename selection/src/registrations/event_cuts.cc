@@ -0,0 +1,13 @@
+/**
+ * @file event_cuts.cc
+ * @brief Registration of the event cuts (event_cuts.h) for the event type.
+ * @author mueller@fnal.gov
+ */
+#define SPINE_REGISTER_HEADER "event_cuts.h"
+#define SPINE_REGISTER_TYPE EventType
+#include "definitions.h"
+
+#include "sbnanaobj/StandardRecord/Proxy/SRProxy.h"
+
+#include "framework.h"
+#include "event_cuts.h"
@@ -0,0 +1,14 @@
+/**
+ * @file event_variables.cc
+ * @brief Registration of the event variables (event_variables.h) for the event
+ * type.
+ * @author mueller@fnal.gov
+ */
+#define SPINE_REGISTER_HEADER "event_variables.h"
+#define SPINE_REGISTER_TYPE EventType
+#include "definitions.h"
+
+#include "sbnanaobj/StandardRecord/Proxy/SRProxy.h"
+
+#include "framework.h"
+#include "event_variables.h"
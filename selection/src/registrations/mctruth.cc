@@ -0,0 +1,14 @@
+/**
+ * @file mctruth.cc
+ * @brief Registration of the MC truth variables (mctruth.h) for the MC truth
+ * type.
+ * @author mueller@fnal.gov
+ */
+#define SPINE_REGISTER_HEADER "mctruth.h"
+#define SPINE_REGISTER_TYPE MCTruth
+#include "definitions.h"
+
+#include "sbnanaobj/StandardRecord/Proxy/SRProxy.h"
+
+#include "framework.h"
+#include "mctruth.h"
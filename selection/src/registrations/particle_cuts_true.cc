@@ -0,0 +1,14 @@
+/**
+ * @file particle_cuts_true.cc
+ * @brief Registration of the particle cuts (particle_cuts.h) for the true
+ * particle type.
+ * @author mueller@fnal.gov
+ */
+#define SPINE_REGISTER_HEADER "particle_cuts.h"
+#define SPINE_REGISTER_TYPE TParticleType
+#include "definitions.h"
+
+#include "sbnanaobj/StandardRecord/Proxy/SRProxy.h"
+
+#include "framework.h"
+#include "particle_cuts.h"
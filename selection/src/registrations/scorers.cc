@@ -0,0 +1,20 @@
+/**
+ * @file scorers.cc
+ * @brief Registration of the scorers (scorers.h) for the reco particle type.
+ * @details This unit also defines the configurable primary classification
+ * and PID functions, which default to the nominal SPINE outputs.
+ * @author mueller@fnal.gov
+ */
+#define SPINE_REGISTER_HEADER "scorers.h"
+#define SPINE_REGISTER_TYPE RParticleType
+#include "definitions.h"
+
+#include <memory>
+
+#include "sbnanaobj/StandardRecord/Proxy/SRProxy.h"
+
+#include "framework.h"
+#include "scorers.h"
+
+std::shared_ptr<VarFn<RParticleType>> pvars::primfn = std::make_shared<VarFn<RParticleType>>(pvars::default_primary_classification<RParticleType>);
+std::shared_ptr<VarFn<RParticleType>> pvars::pidfn = std::make_shared<VarFn<RParticleType>>(pvars::default_pid<RParticleType>);
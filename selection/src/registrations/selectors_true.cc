@@ -0,0 +1,14 @@
+/**
+ * @file selectors_true.cc
+ * @brief Registration of the selectors (selectors.h) for the true interaction
+ * type.
+ * @author mueller@fnal.gov
+ */
+#define SPINE_REGISTER_HEADER "selectors.h"
+#define SPINE_REGISTER_TYPE TType
+#include "definitions.h"
+
+#include "sbnanaobj/StandardRecord/Proxy/SRProxy.h"
+
+#include "framework.h"
+#include "selectors.h"
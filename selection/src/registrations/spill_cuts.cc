@@ -0,0 +1,13 @@
+/**
+ * @file spill_cuts.cc
+ * @brief Registration of the spill cuts (spill_cuts.h) for the spill type.
+ * @author mueller@fnal.gov
+ */
+#define SPINE_REGISTER_HEADER "spill_cuts.h"
+#define SPINE_REGISTER_TYPE SpillType
+#include "definitions.h"
+
+#include "sbnanaobj/StandardRecord/Proxy/SRProxy.h"
+
+#include "framework.h"
+#include "spill_cuts.h"
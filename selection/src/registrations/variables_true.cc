@@ -0,0 +1,14 @@
+/**
+ * @file variables_true.cc
+ * @brief Registration of the variables (variables.h) for the true interaction
+ * type.
+ * @author mueller@fnal.gov
+ */
+#define SPINE_REGISTER_HEADER "variables.h"
+#define SPINE_REGISTER_TYPE TType
+#include "definitions.h"
+
+#include "sbnanaobj/StandardRecord/Proxy/SRProxy.h"
+
+#include "framework.h"
+#include "variables.h"
@@ -241,7 +241,12 @@ void match_conditions(const std::vector<row_t> & rows, const std::vector<conditi
 {
     for(const auto & condition : conditions)
     {
+        // Several rows may share the metadata of the condition (e.g., the
+        // rows of one event, or events sharing their header), so a mismatch
+        // is only reported if none of them matches.
         bool found = false;
+        bool matched = false;
+        const row_t * mismatched = nullptr;
         for(const auto & row : rows)
         {
             if(match_metadata(row, condition))
@@ -262,34 +267,36 @@ void match_conditions(const std::vector<row_t> & rows, const std::vector<conditi
                 }
                 if(match)
                 {
-                    if(condition.first.find('!') == std::string::npos)
-                    {
-                        std::cout << "\033[32mValidation passed:\033[0m   " << condition.first << "." << std::endl;
-                        found = true;
-                        break;
-                    }
-                    else
-                    {
-                        // If the condition starts with '!', it means we expect it to not match.
-                        std::cout << "\033[31mValidation failed:\033[0m   " << condition.first.substr(1) << "." << std::endl;
-                        found = true;
-                        break;
-                    }
+                    matched = true;
+                    break;
                 }
-                else if(found && !match)                
+                if(mismatched == nullptr)
+                    mismatched = &row;
+            }
+        }
+        if(matched)
+        {
+            if(condition.first.find('!') == std::string::npos)
+                std::cout << "\033[32mValidation passed:\033[0m   " << condition.first << "." << std::endl;
+            else
+            {
+                // If the condition starts with '!', it means we expect it to not match.
+                std::cout << "\033[31mValidation failed:\033[0m   " << condition.first.substr(1) << "." << std::endl;
+            }
+        }
+        else if(mismatched != nullptr)
+        {
+            std::cerr << "\033[33mValidation mismatch:\033[0m " << condition.first << "." << std::endl;
+
+            // Print the fields that are mismatched.
+            const row_t & row(*mismatched);
+            for(const auto & field : condition.second)
+            {
+                if(row.find(field.first) == row.end() || row.at(field.first) != field.second)
                 {
-                    std::cerr << "\033[33mValidation mismatch:\033[0m " << condition.first << "." << std::endl;
-                    
-                    // Print the fields that are mismatched.
-                    for(const auto & field : condition.second)
-                    {
-                        if(row.find(field.first) == row.end() || row.at(field.first) != field.second)
-                        {
-                            std::cout << "    " << field.first
-                                        << " - expected: " << field.second
-                                        << ", got: " << (row.find(field.first) != row.end() ? std::to_string(row.at(field.first)) : "N/A") << std::endl;
-                        }
-                    }
+                    std::cout << "    " << field.first
+                                << " - expected: " << field.second
+                                << ", got: " << (row.find(field.first) != row.end() ? std::to_string(row.at(field.first)) : "N/A") << std::endl;
                 }
             }
         }
@@ -8,6 +8,8 @@
  * @author mueller@fnal.gov
  */
 #include <iostream>
+#include <string>
+#include <random>
 
 #include "sbnanaobj/StandardRecord/StandardRecord.h"
 #include "sbnanaobj/StandardRecord/SRInteractionDLP.h"
@@ -33,6 +35,8 @@
  *                 testing.
  * - `--validate`: Validate the output of the framework against the expected
  *                 results.
+ * - `--workload [events] [path]`: Generate the (larger, randomized) training
+ *                 input of the profile-guided build.
  * @return int The exit code of the program. Returns 0 on success, non-zero
  * on failure.
  */
@@ -41,15 +45,15 @@ int main(int argc, char * argv[])
     // Check if the command line arguments are valid.
     if(argc < 2)
     {
-        std::cerr << "Usage: " << argv[0] << " --generate | --validate" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " --generate | --validate | --workload [events] [path]" << std::endl;
         return 1;
     }
 
     // Check the command line arguments for the mode.
     std::string mode = argv[1];
-    if(mode != "--generate" && mode != "--validate")
+    if(mode != "--generate" && mode != "--validate" && mode != "--workload")
     {
-        std::cerr << "Invalid mode: " << mode << ". Use --generate or --validate." << std::endl;
+        std::cerr << "Invalid mode: " << mode << ". Use --generate, --validate, or --workload." << std::endl;
         return 1;
     }
 
@@ -91,6 +95,13 @@ int main(int argc, char * argv[])
          * - ES03: This represents the case where a reco interaction and a
          *   truth interaction are present, and they are matched. Both have
          *   no valid flash matches, so they are not selected.
+         * 
+         * - ES04: This represents two consecutive events sharing their header
+         *   (run, subrun, and event numbers) and interaction counts, as
+         *   duplicated simulation headers do. Each has a matched pair of
+         *   selected interactions, but the vertices differ between the two
+         *   events, so that values cached for the first event cannot be
+         *   mistaken for those of the second.
          */
         // Open the file and initialize everything.
         TFile sim("validation_simlike.root", "RECREATE");
@@ -207,6 +218,20 @@ int main(int argc, char * argv[])
         mark_contained(&rec->dlp[0], &rec->dlp_true[0]);
         write_event(rec, 1, 3, 3, pot, nevt, t);
 
+        // ES04A
+        rec->dlp.push_back(generate_interaction<caf::SRInteractionDLP>(0, 0, fs));
+        rec->dlp_true.push_back(generate_interaction<caf::SRInteractionTruthDLP>(0, 0, fs));
+        pair(rec->dlp[0], rec->dlp_true[0]);
+        write_event(rec, 2, 0, 0, pot, nevt, t);
+
+        // ES04B
+        rec->dlp.push_back(generate_interaction<caf::SRInteractionDLP>(0, 0, fs));
+        rec->dlp_true.push_back(generate_interaction<caf::SRInteractionTruthDLP>(0, 0, fs));
+        pair(rec->dlp[0], rec->dlp_true[0]);
+        rec->dlp[0].vertex[0] = -150.0;
+        rec->dlp_true[0].vertex[0] = -150.0;
+        write_event(rec, 2, 0, 0, pot, nevt, t);
+
         // Write the tree and histograms to the file.
         t->Write();
         pot->Write();
@@ -269,6 +294,88 @@ int main(int argc, char * argv[])
         return 0;
     }
 
+    // If the mode is workload, we generate the training input of the
+    // profile-guided build (see scripts/pgo_build.py). The events combine the
+    // structures of the validation events (matched and unmatched
+    // interactions and particles, with and without flash matches and
+    // containment) in fixed proportions, with randomized multiplicities,
+    // vertices, and energies, so that the cuts and variables take each of
+    // their branches about as often as on a real sample. The generator is
+    // seeded, so the workload is identical between builds.
+    if(mode == "--workload")
+    {
+        const int64_t events(argc > 2 ? std::stoll(argv[2]) : 20000);
+        const std::string path(argc > 3 ? argv[3] : "pgo_workload.root");
+        std::mt19937_64 rng(20240601);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        std::poisson_distribution<int64_t> count(0.7);
+
+        TFile file(path.c_str(), "RECREATE");
+        TH1F * pot = new TH1F("TotalPOT", "TotalPOT", 1, 0, 1);
+        TH1F * nevt = new TH1F("TotalEvents", "TotalEvents", 1, 0, 1);
+        TTree * t = new TTree("recTree", "Standard Record Tree");
+        caf::StandardRecord * rec = new caf::StandardRecord();
+        t->Branch("rec", &rec);
+
+        for(int64_t e(0); e < events; ++e)
+        {
+            // One or two interactions per event, most of them with a muon.
+            const int64_t interactions(unit(rng) < 0.3 ? 2 : 1);
+            int64_t poffset(0);
+            for(int64_t i(0); i < interactions; ++i)
+            {
+                multiplicity_t mult;
+                for(int64_t & m : mult)
+                    m = count(rng);
+                mult[2] += unit(rng) < 0.6;
+                const bool fm(unit(rng) < 0.7);
+                rec->dlp.push_back(generate_interaction<caf::SRInteractionDLP>(i, poffset, mult, fm));
+                rec->dlp_true.push_back(generate_interaction<caf::SRInteractionTruthDLP>(i, 0, mult, fm));
+                caf::SRInteractionDLP & reco(rec->dlp.back());
+                caf::SRInteractionTruthDLP & truth(rec->dlp_true.back());
+                poffset += reco.particles.size();
+
+                // Vertices spread across (and beyond) the active volume.
+                reco.vertex[0] = truth.vertex[0] = -400.0 + 800.0 * unit(rng);
+                reco.vertex[1] = truth.vertex[1] = -200.0 + 400.0 * unit(rng);
+                reco.vertex[2] = truth.vertex[2] = -1000.0 + 2000.0 * unit(rng);
+
+                // Energies spread around the scale of the validation events,
+                // with a reconstructed energy smeared by up to 10%.
+                for(size_t p(0); p < reco.particles.size(); ++p)
+                {
+                    const double ke(ENERGY_SCALE * (0.05 + 4.0 * unit(rng)));
+                    const double smeared(ke * (0.9 + 0.2 * unit(rng)));
+                    truth.particles[p].ke = ke;
+                    truth.particles[p].energy_init = ke;
+                    reco.particles[p].ke = smeared;
+                    reco.particles[p].csda_ke = smeared;
+                    reco.particles[p].mcs_ke = smeared;
+                    reco.particles[p].calo_ke = smeared;
+                    if(unit(rng) < 0.9)
+                        pair(reco.particles[p], truth.particles[p]);
+                }
+                if(unit(rng) < 0.8)
+                    pair(reco, truth);
+                if(unit(rng) < 0.5)
+                    mark_contained(&reco, &truth);
+            }
+            write_event(rec, 1, e / 1000, e % 1000, pot, nevt, t, unit(rng) < 0.1 ? 2000 : 500);
+        }
+
+        // Write the tree and histograms to the file.
+        t->Write();
+        pot->Write();
+        nevt->Write();
+        file.Close();
+
+        // Clean up the allocated memory.
+        delete rec;
+
+        std::cout << "Wrote " << events << " events to " << path << "." << std::endl;
+        return 0;
+    }
+
     // If the mode is validate, we run the validation logic.
     if(mode == "--validate")
     {
@@ -1243,6 +1350,74 @@ int main(int argc, char * argv[])
         // Check if each condition_t entry is present in the rows vector.
         match_conditions(rows, conditions);
 
+        /**
+         * @brief The ninth set of events to validate is the "sim-like" events
+         * sharing their header, run through two trees with the same cuts.
+         * @details This set of events tests the invalidation of the per-spill
+         * caches (memoized results, selections, matches, and multi-output
+         * variables), which must happen for every record rather than when
+         * the header changes. The two trees share their selection; the
+         * first reads the vertex_x component (memoized per object) and the
+         * second the vertex multi-output variable (split from one
+         * evaluation). A stale cache in either shows up as the vertex of the
+         * first event repeated for the second.
+         * 
+         * - SDUP00: This represents the first event, with a vertex at -210.
+         * 
+         * - SDUP01: This represents the second event, with the same header
+         *   and a vertex at -150.
+         */
+        std::cout << "\n\033[1mSimulation-like events sharing their header \033[0m" << std::endl;
+
+        for(const std::string tree : {"test_duplicates_a", "test_duplicates_b"})
+        {
+            // Read the event data from the TTree in the ROOT file.
+            rows = read_event_data("events/test_simlike/" + tree);
+
+            // Expected results for validation.
+            conditions = {
+                {"SDUP00 (" + tree + ")", {{"Run", 2}, {"Subrun", 0}, {"Evt", 0}, {"reco_vertex_x", -210.0}, {"true_vertex_x", -210.0}}},
+                {"SDUP01 (" + tree + ")", {{"Run", 2}, {"Subrun", 0}, {"Evt", 0}, {"reco_vertex_x", -150.0}, {"true_vertex_x", -150.0}}},
+            };
+
+            // Check if each condition_t entry is present in the rows vector.
+            match_conditions(rows, conditions);
+        }
+
+        /**
+         * @brief The tenth set of events to validate is the selected
+         * "sim-like" events, prescaled by a category that is NaN for the
+         * unmatched interactions.
+         * @details This set of events tests that a NaN category (no match)
+         * has no prescale factor. The only configured category is absent
+         * from the events and has a very large factor, so every row must be
+         * kept with a weight of one. A NaN category looked up in the map of
+         * factors would instead match that category and drop the row.
+         *
+         * - SPRE00: This represents an unmatched interaction (ES00A), with a
+         *   NaN category.
+         *
+         * - SPRE01: This represents an unmatched interaction (ES00D), with a
+         *   NaN category.
+         *
+         * - SPRE02: This represents a matched interaction (ES02A), with a
+         *   category without a factor.
+         */
+        std::cout << "\n\033[1mSimulation-like events prescaled by a NaN category \033[0m" << std::endl;
+
+        // Read the event data from the TTree in the ROOT file.
+        rows = read_event_data("events/test_simlike/test_prescale_nan");
+
+        // Expected results for validation.
+        conditions = {
+            {"SPRE00", {{"Run", 1}, {"Subrun", 0}, {"Evt", 0}, {"true_vertex_x", kNaN}, {"prescale_weight", 1.0}}},
+            {"SPRE01", {{"Run", 1}, {"Subrun", 3}, {"Evt", 0}, {"true_vertex_x", kNaN}, {"prescale_weight", 1.0}}},
+            {"SPRE02", {{"Run", 1}, {"Subrun", 0}, {"Evt", 2}, {"true_vertex_x", -210.0}, {"prescale_weight", 1.0}}},
+        };
+
+        // Check if each condition_t entry is present in the rows vector.
+        match_conditions(rows, conditions);
+
         // Finished!
         std::cout << "\n\033[1m---        DONE        ---\033[0m" << std::endl;
         f.Close();
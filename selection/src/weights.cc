@@ -0,0 +1,248 @@
+/**
+ * @file weights.cc
+ * @brief Implementation of the weight-map reweighting of the SPINE analysis
+ * framework.
+ * @details This file contains the implementation of the edge tables, the
+ * weight maps, and the registration of the weight variables declared in
+ * weights.h.
+ * @author mueller@fnal.gov
+ */
+#include <map>
+#include <cmath>
+#include <tuple>
+#include <limits>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+
+#include "TFile.h"
+#include "TH1.h"
+#include "TAxis.h"
+
+#include "sbnanaobj/StandardRecord/Proxy/SRProxy.h"
+
+#include "framework.h"
+#include "codegen.h"
+#include "weights.h"
+
+namespace
+{
+    /**
+     * @brief Get the bin edges of an axis of a histogram.
+     * @param axis The axis.
+     * @return The bin edges.
+     */
+    std::vector<double> edges(const TAxis * axis)
+    {
+        std::vector<double> result(axis->GetNbins() + 1);
+        for(int i(0); i < axis->GetNbins(); ++i)
+            result[i] = axis->GetBinLowEdge(i + 1);
+        result.back() = axis->GetBinUpEdge(axis->GetNbins());
+        return result;
+    }
+
+    /**
+     * @brief Register a weight variable for a record type.
+     * @details The axis variables are looked up when the weight is bound, so
+     * a weight whose axes are not registered for the record type only fails
+     * if it is used.
+     * @tparam EventT The record type (TType or RType).
+     * @param prefix The prefix of the record type ("true_" or "reco_").
+     * @param name The name of the weight.
+     * @param maps The maps of the weight.
+     * @param axes The names of the axis variables of each map.
+     * @return void
+     */
+    template<typename EventT>
+    void register_weight(const std::string & prefix, const std::string & name, const std::vector<std::shared_ptr<const weights::Map>> & maps,
+                         const std::vector<std::vector<std::string>> & axes)
+    {
+        VarFactoryRegistry<EventT>::instance().register_fn(prefix + name, [prefix, maps, axes](const std::vector<double> &) -> VarFn<EventT>
+        {
+            std::vector<std::vector<VarFn<EventT>>> fns(maps.size());
+            for(size_t m(0); m < maps.size(); ++m)
+                for(const std::string & axis : axes[m])
+                    fns[m].push_back(codegen::lookup<double, EventT>(prefix + axis)({}));
+            return [maps, fns](const EventT & e) -> double
+            {
+                double weight(1), x[3];
+                for(size_t m(0); m < maps.size(); ++m)
+                {
+                    for(size_t k(0); k < fns[m].size(); ++k)
+                    {
+                        x[k] = fns[m][k](e);
+                        if(std::isnan(x[k]))
+                            return std::numeric_limits<double>::quiet_NaN();
+                    }
+                    weight *= (*maps[m])(x);
+                }
+                return weight;
+            };
+        });
+    }
+}
+
+namespace weights
+{
+    // Constructor for the Axis class.
+    Axis::Axis(std::vector<double> edges)
+        : edges_(std::move(edges))
+    {
+        if(edges_.size() < 2)
+            throw std::runtime_error("A weight map axis needs at least one bin.");
+        double narrowest(std::numeric_limits<double>::infinity());
+        for(size_t i(1); i < edges_.size(); ++i)
+        {
+            if(!(edges_[i] > edges_[i - 1]))
+                throw std::runtime_error("The edges of a weight map axis must be increasing.");
+            narrowest = std::min(narrowest, edges_[i] - edges_[i - 1]);
+        }
+        low_ = edges_.front();
+        high_ = edges_.back();
+        const size_t n(bins());
+        const double width((high_ - low_) / n);
+        uniform_ = true;
+        for(size_t i(0); uniform_ && i <= n; ++i)
+            uniform_ = std::abs(edges_[i] - (low_ + i * width)) <= 1e-9 * (high_ - low_);
+
+        // The cells of non-uniform axes are no wider than the narrowest bin,
+        // so a value is at most one bin away from the bin of its cell.
+        size_t cells(n);
+        if(!uniform_)
+        {
+            const double needed(std::ceil((high_ - low_) / narrowest));
+            cells = static_cast<size_t>(std::clamp(needed, static_cast<double>(n), 65536.0));
+            table_.resize(cells);
+            for(size_t c(0); c < cells; ++c)
+            {
+                const double x(low_ + c * (high_ - low_) / cells);
+                table_[c] = static_cast<uint32_t>(std::upper_bound(edges_.begin(), edges_.end(), x) - edges_.begin() - 1);
+            }
+        }
+        scale_ = cells / (high_ - low_);
+    }
+
+    // Find the bin of a value.
+    long Axis::find(double x) const
+    {
+        if(x < low_)
+            return -1;
+        if(x >= high_)
+            return static_cast<long>(bins());
+        long bin(static_cast<long>((x - low_) * scale_));
+        if(uniform_)
+            return std::min(bin, static_cast<long>(bins()) - 1);
+        bin = table_[std::min<size_t>(bin, table_.size() - 1)];
+        while(bin + 1 < static_cast<long>(bins()) && x >= edges_[bin + 1])
+            ++bin;
+        while(bin > 0 && x < edges_[bin])
+            --bin;
+        return bin;
+    }
+
+    // Constructor for the Map class.
+    Map::Map(std::string name, std::vector<Axis> axes, std::vector<double> values, Outside outside)
+        : name_(std::move(name)), axes_(std::move(axes)), values_(std::move(values)), outside_(outside)
+    {
+        if(axes_.empty() || axes_.size() > 3)
+            throw std::runtime_error("Weight map " + name_ + " has " + std::to_string(axes_.size()) + " axes (expected one to three).");
+        size_t size(1);
+        for(const Axis & axis : axes_)
+            size *= axis.bins();
+        if(values_.size() != size)
+            throw std::runtime_error("Weight map " + name_ + " has " + std::to_string(values_.size()) + " values (expected "
+                                     + std::to_string(size) + ").");
+    }
+
+    // Evaluate the map.
+    double Map::operator()(const double * x) const
+    {
+        size_t index(0), stride(1);
+        for(size_t k(0); k < axes_.size(); ++k)
+        {
+            const long n(axes_[k].bins());
+            long bin(axes_[k].find(x[k]));
+            if(bin < 0 || bin >= n)
+            {
+                if(outside_ == Outside::Unit)
+                    return 1.0;
+                bin = std::clamp(bin, 0L, n - 1);
+            }
+            index += bin * stride;
+            stride *= n;
+        }
+        return values_[index];
+    }
+
+    // Read a weight map from a ROOT file.
+    std::shared_ptr<const Map> read_map(const std::string & path, const std::string & histogram, Outside outside)
+    {
+        std::unique_ptr<TFile> file(TFile::Open(path.c_str(), "READ"));
+        if(!file || file->IsZombie())
+            throw std::runtime_error("Unable to open weight map file " + path + ".");
+        TH1 * h(file->Get<TH1>(histogram.c_str()));
+        if(h == nullptr)
+            throw std::runtime_error("No weight map " + histogram + " in " + path + ".");
+
+        const int dimension(h->GetDimension());
+        std::vector<Axis> axes;
+        axes.emplace_back(edges(h->GetXaxis()));
+        if(dimension > 1)
+            axes.emplace_back(edges(h->GetYaxis()));
+        if(dimension > 2)
+            axes.emplace_back(edges(h->GetZaxis()));
+
+        const int nx(h->GetNbinsX()), ny(dimension > 1 ? h->GetNbinsY() : 1), nz(dimension > 2 ? h->GetNbinsZ() : 1);
+        std::vector<double> values;
+        values.reserve(static_cast<size_t>(nx) * ny * nz);
+        for(int k(1); k <= nz; ++k)
+            for(int j(1); j <= ny; ++j)
+                for(int i(1); i <= nx; ++i)
+                    values.push_back(h->GetBinContent(h->GetBin(i, dimension > 1 ? j : 0, dimension > 2 ? k : 0)));
+        return std::make_shared<const Map>(path + ":" + histogram, std::move(axes), std::move(values), outside);
+    }
+
+    // Load the weight maps and register the weight variables.
+    void configure(const cfg::ConfigurationTable & config)
+    {
+        if(!config.has_field("weight"))
+            return;
+
+        std::map<std::tuple<std::string, std::string, Outside>, std::shared_ptr<const Map>> loaded;
+        for(const cfg::ConfigurationTable & weight : config.get_subtables("weight"))
+        {
+            const std::string name(weight.get_string_field("name"));
+            const std::string default_path(weight.get_string_field("path", ""));
+            std::vector<std::shared_ptr<const Map>> maps;
+            std::vector<std::vector<std::string>> axes;
+            for(const cfg::ConfigurationTable & m : weight.get_subtables("map"))
+            {
+                const std::string path(m.get_string_field("path", default_path));
+                const std::string histogram(m.get_string_field("histogram"));
+                if(path.empty())
+                    throw cfg::ConfigurationError("Weight " + name + " has a map without a path.");
+                const std::string outside_name(m.get_string_field("outside", "clamp"));
+                Outside outside;
+                if(outside_name == "clamp") outside = Outside::Clamp;
+                else if(outside_name == "unit") outside = Outside::Unit;
+                else throw cfg::ConfigurationError("Illegal out-of-range treatment '" + outside_name + "' for weight " + name + ".");
+
+                std::shared_ptr<const Map> & map(loaded[std::make_tuple(path, histogram, outside)]);
+                if(!map)
+                    map = read_map(path, histogram, outside);
+                if(!m.has_field("axes"))
+                    throw cfg::ConfigurationError("Weight " + name + " has a map without axes.");
+                std::vector<std::string> names(m.get_string_vector("axes"));
+                if(names.size() != map->dimension())
+                    throw cfg::ConfigurationError("Weight " + name + " has " + std::to_string(names.size()) + " axis variables for "
+                                                  + map->name() + " (expected " + std::to_string(map->dimension()) + ").");
+                maps.push_back(map);
+                axes.push_back(std::move(names));
+            }
+            if(maps.empty())
+                throw cfg::ConfigurationError("Weight " + name + " has no maps.");
+            register_weight<TType>("true_", name, maps, axes);
+            register_weight<RType>("reco_", name, maps, axes);
+        }
+    }
+}
@@ -181,6 +181,18 @@ namespace cfg
          */
         int64_t get_int_field(const std::string & field) const;
 
+        /**
+         * @brief Get the requested integer field from the ConfigurationTable.
+         * @details This function gets the requested integer field from the
+         * ConfigurationTable. If the field is not present, the function returns
+         * the default value.
+         * @param field The name of the field that is requested.
+         * @param default_value The default value to return if the field is not
+         * present.
+         * @return The value of the requested integer field.
+         */
+        int64_t get_int_field(const std::string & field, int64_t default_value) const;
+
         /**
          * @brief Get the requested double field from the ConfigurationTable.
          * @details This function gets the requested double field from the
@@ -192,6 +204,18 @@ namespace cfg
          */
         double get_double_field(const std::string & field) const;
 
+        /**
+         * @brief Get the requested double field from the ConfigurationTable.
+         * @details This function gets the requested double field from the
+         * ConfigurationTable. If the field is not present, the function returns
+         * the default value.
+         * @param field The name of the field that is requested.
+         * @param default_value The default value to return if the field is not
+         * present.
+         * @return The value of the requested double field.
+         */
+        double get_double_field(const std::string & field, double default_value) const;
+
         /**
          * @brief Get a list of all doubles matching the requested field name.
          * @details This function gets a list of all doubles matching the
@@ -0,0 +1,145 @@
+/**
+ * @file manifest.h
+ * @brief Header of the Manifest class, which indexes the per-sample output
+ * files of an analysis.
+ * @details When the selection writes one output file per sample, the set of
+ * output files is described by a small TOML manifest. The manifest maps each
+ * sample (and the trees it contains) to the file(s) holding it, along with
+ * the exposure totals of each file. Downstream readers (run_systematics and
+ * spineplot) use the manifest to resolve the "events/<sample>/<tree>" paths
+ * that would otherwise be read from a single output file.
+ * @author mueller@fnal.gov
+ */
+#ifndef MANIFEST_H
+#define MANIFEST_H
+#include <string>
+#include <vector>
+
+namespace cfg
+{
+    /**
+     * @class Manifest
+     * @brief Index of the output files of an analysis.
+     * @details The manifest is a list of file entries. Each entry describes a
+     * single output file containing (part of) the results for a single sample.
+     * A sample may be spread over several files, in which case the trees are
+     * meant to be concatenated and the exposure summed across the entries.
+     * Paths are stored relative to the directory containing the manifest.
+     */
+    class Manifest
+    {
+    public:
+        /**
+         * @struct Entry
+         * @brief A single output file in the manifest.
+         */
+        struct Entry
+        {
+            std::string sample;             ///< The name of the sample.
+            std::string path;               ///< The path to the file (relative to the manifest).
+            std::vector<std::string> trees; ///< The trees stored for the sample.
+            double pot = 0;                 ///< The POT exposure of the file.
+            double livetime = 0;            ///< The livetime exposure of the file.
+            std::vector<std::string> inputs; ///< The input files processed into the file (follow mode).
+        };
+
+        /**
+         * @brief Default constructor for the Manifest class.
+         */
+        Manifest() = default;
+
+        /**
+         * @brief Constructor for the Manifest class.
+         * @param output The base name of the analysis output.
+         */
+        explicit Manifest(const std::string & output) : output(output) {}
+
+        /**
+         * @brief Read a manifest from a TOML file.
+         * @param path The path to the manifest file.
+         * @return The manifest.
+         * @throw ConfigurationError if the manifest cannot be parsed.
+         */
+        static Manifest read(const std::string & path);
+
+        /**
+         * @brief Check if a path refers to a manifest (rather than a ROOT
+         * file).
+         * @param path The path to check.
+         * @return True if the path has the manifest extension.
+         */
+        static bool is_manifest(const std::string & path);
+
+        /**
+         * @brief Write the manifest to a TOML file.
+         * @details The manifest is first written to a temporary file, which is
+         * then renamed to the destination. Readers therefore never observe a
+         * partially written manifest.
+         * @param path The path to the manifest file.
+         * @return void
+         */
+        void write(const std::string & path) const;
+
+        /**
+         * @brief Add an entry to the manifest.
+         * @param entry The entry to add.
+         * @return void
+         */
+        void add(const Entry & entry) { entries.push_back(entry); }
+
+        /**
+         * @brief Get all entries of the manifest.
+         * @return The entries of the manifest.
+         */
+        const std::vector<Entry> & get_entries() const { return entries; }
+
+        /**
+         * @brief Get the entries for a single sample.
+         * @param sample The name of the sample.
+         * @return The entries for the sample, in the order they were added.
+         */
+        std::vector<Entry> get_entries(const std::string & sample) const;
+
+        /**
+         * @brief Get the names of the samples in the manifest.
+         * @return The unique sample names, in the order of first appearance.
+         */
+        std::vector<std::string> get_samples() const;
+
+        /**
+         * @brief Get the total POT exposure of a sample.
+         * @param sample The name of the sample.
+         * @return The POT summed over all entries of the sample.
+         */
+        double get_pot(const std::string & sample) const;
+
+        /**
+         * @brief Get the total livetime exposure of a sample.
+         * @param sample The name of the sample.
+         * @return The livetime summed over all entries of the sample.
+         */
+        double get_livetime(const std::string & sample) const;
+
+        /**
+         * @brief Resolve the path of an entry relative to the manifest.
+         * @param entry The entry to resolve.
+         * @return The path to the file of the entry.
+         */
+        std::string resolve(const Entry & entry) const;
+
+        /**
+         * @brief Get the input files processed into any entry of the
+         * manifest.
+         * @details This is used by the follow mode to resume from a previous
+         * run without reprocessing any of the input files.
+         * @return The input files of all entries.
+         */
+        std::vector<std::string> get_inputs() const;
+
+    private:
+        std::string output;          ///< The base name of the analysis output.
+        std::string directory;       ///< The directory containing the manifest.
+        std::vector<Entry> entries;  ///< The file entries.
+    };
+}
+#endif // MANIFEST_H
@@ -0,0 +1,143 @@
+/**
+ * @file placement.h
+ * @brief Header file for the placement of threads and memory on the NUMA
+ * nodes of multi-socket machines.
+ * @details On multi-socket nodes, a thread reading memory allocated on the
+ * other socket pays the cross-socket latency and bandwidth on every access,
+ * which visibly slows the ROOT decompression and the event loop. The
+ * components in this file bind the threads of the selection and systematics
+ * programs to the CPUs of a NUMA node according to a configurable policy:
+ *   - "none": the threads are not bound (the default).
+ *   - "node": each sample is assigned a node (round-robin). The threads
+ *     processing the sample are bound to the CPUs of the node and allocate
+ *     their memory preferably on the node.
+ *   - "core": as "node", but each sample thread (the thread reading and
+ *     evaluating a sample) is pinned to a dedicated core of the node of the
+ *     sample. The samples assigned to a node take its cores in turn. Threads
+ *     not tied to a sample (e.g., the main thread of the systematics and the
+ *     ROOT thread pool it spawns) are bound to the node as under "node."
+ * A thread is only rebound when it moves to another node (or core), so the
+ * thread-local caches it filled stay on the node it was placed on.
+ *
+ * Only the threads named above are placed explicitly. The selection runs
+ * without ROOT's implicit multi-threading, so its input is decompressed on
+ * the (placed) sample threads. The ROOT thread pool of the systematics is
+ * not placed by this file: its threads are created after the main thread is
+ * placed and inherit its CPU mask, so they stay on the node, but they are
+ * never pinned to cores, and threads ROOT or TBB create otherwise are not
+ * covered. Both programs report their throughput under the configured
+ * policy (see @ref report); comparing policies means one run per policy.
+ *
+ * Memory is placed by first touch, so buffers allocated by a thread after it
+ * is placed (e.g., the thread-local memoization caches) are local to the
+ * node. The topology is read from sysfs and restricted to the CPUs the
+ * process is allowed to run on (e.g., by the batch system). No external
+ * library (libnuma, hwloc) is required.
+ * @author mueller@fnal.gov
+ */
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+#include <string>
+#include <vector>
+
+/**
+ * @namespace placement
+ * @brief Namespace for the placement of threads and memory on NUMA nodes.
+ */
+namespace placement
+{
+    /**
+     * @enum Policy
+     * @brief The placement policies (see placement.h).
+     */
+    enum class Policy { None, Node, Core };
+
+    /**
+     * @brief Configure the placement policy.
+     * @details This reads the topology of the machine and must be called
+     * before any thread is placed.
+     * @param policy The name of the policy ("none", "node", or "core").
+     * @return void
+     * @throw std::runtime_error if the policy is unknown.
+     */
+    void configure(const std::string & policy);
+
+    /**
+     * @brief Get the configured placement policy.
+     * @return The policy.
+     */
+    Policy policy();
+
+    /**
+     * @brief Get the name of the configured placement policy.
+     * @return The name of the policy.
+     */
+    std::string policy_name();
+
+    /**
+     * @brief Get the number of NUMA nodes available to the process.
+     * @return The number of nodes with at least one allowed CPU.
+     */
+    size_t nodes();
+
+    /**
+     * @brief Get the CPUs of a NUMA node available to the process.
+     * @param node The index of the node.
+     * @return The CPUs of the node.
+     */
+    const std::vector<int> & cpus(size_t node);
+
+    /**
+     * @brief Get the node assigned to a sample.
+     * @param index The index of the sample.
+     * @return The index of the node (round-robin over the nodes).
+     */
+    size_t sample_node(size_t index);
+
+    /**
+     * @brief Place the calling thread as the reader thread of a node.
+     * @details The thread is bound to the CPUs of the node and its memory
+     * allocations are directed to the node. This does nothing under the
+     * "none" policy or if the thread is already bound to the node.
+     * @param node The index of the node.
+     * @return True if the thread was placed.
+     */
+    bool place_reader(size_t node);
+
+    /**
+     * @brief Place the calling thread as the thread of a sample.
+     * @details The thread is placed on the node of the sample (see
+     * @ref sample_node). Under the "core" policy, it is pinned to a single
+     * core of the node, chosen by the rank of the sample among the samples
+     * of the node (modulo the number of cores). This does nothing under the
+     * "none" policy or if the thread is already placed there.
+     * @param index The index of the sample.
+     * @return True if the thread was placed.
+     */
+    bool place_sample(size_t index);
+
+    /**
+     * @brief Describe the topology and the configured policy.
+     * @return A one-line description (e.g., "policy core, 2 nodes: 0-15,
+     * 16-31").
+     */
+    std::string describe();
+
+    /**
+     * @brief Report the throughput of a run under the configured policy.
+     * @details The throughput is printed and, if @p log is not empty,
+     * appended to a tab-separated table with the host name, the program, the
+     * policy, the number of nodes, the count, the wall time, and the rate.
+     * Collecting the tables of runs with different policies on the same type
+     * of node allows the policy to be chosen per node type.
+     * @param program The name of the program (e.g., "selection").
+     * @param unit The unit of the count (e.g., "spills").
+     * @param count The number of units processed.
+     * @param seconds The wall time of the run.
+     * @param log The path of the table (empty for none).
+     * @return void
+     * @throw std::runtime_error if the table cannot be written.
+     */
+    void report(const std::string & program, const std::string & unit, double count, double seconds, const std::string & log);
+}
+#endif // PLACEMENT_H
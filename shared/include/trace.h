@@ -0,0 +1,73 @@
+/**
+ * @file trace.h
+ * @brief Header of the static tracepoints placed at the stage boundaries of
+ * the selection and systematics pipelines.
+ * @details When built with the SPINE_TRACE CMake option, the SPINE_PROBE
+ * macros expand to USDT (SystemTap SDT) probes under the "spine" provider.
+ * These are a single nop in the instruction stream until a tracer (perf,
+ * bpftrace, SystemTap) attaches to them. Without the option, the macros
+ * expand to nothing and their arguments are not evaluated.
+ *
+ * Registered cuts, variables, and tree branches are identified in the probes
+ * by a small integer id. The id to name mapping is written as a symbol map by
+ * @ref trace::write_symbol_map, which allows, e.g., bpftrace to attribute
+ * time to named functions:
+ * @code
+ * bpftrace -e 'usdt:./main:spine:fn_enter { @t[tid] = nsecs; }
+ *              usdt:./main:spine:fn_exit /@t[tid]/ { @ns[arg0] = sum(nsecs - @t[tid]); }'
+ * @endcode
+ * @author mueller@fnal.gov
+ */
+#ifndef TRACE_H
+#define TRACE_H
+#include <string>
+#include <cstdint>
+
+#if defined(SPINE_TRACE)
+#include <sys/sdt.h>
+#define SPINE_PROBE(name) DTRACE_PROBE(spine, name)
+#define SPINE_PROBE1(name, a) DTRACE_PROBE1(spine, name, a)
+#define SPINE_PROBE2(name, a, b) DTRACE_PROBE2(spine, name, a, b)
+#define SPINE_PROBE3(name, a, b, c) DTRACE_PROBE3(spine, name, a, b, c)
+#else
+#define SPINE_PROBE(name) ((void)0)
+#define SPINE_PROBE1(name, a) ((void)0)
+#define SPINE_PROBE2(name, a, b) ((void)0)
+#define SPINE_PROBE3(name, a, b, c) ((void)0)
+#endif
+
+/**
+ * @namespace trace
+ * @brief Namespace for the static tracepoint support.
+ */
+namespace trace
+{
+    /**
+     * @brief Flag indicating whether the tracepoints are compiled in.
+     */
+#if defined(SPINE_TRACE)
+    constexpr bool enabled = true;
+#else
+    constexpr bool enabled = false;
+#endif
+
+    /**
+     * @brief Get the id of a name for use as a probe argument.
+     * @details The first call for a name assigns the next free id (starting
+     * at one). Subsequent calls return the same id.
+     * @param name The name (e.g., the registry name of a function).
+     * @return The id of the name.
+     */
+    uint32_t name_id(const std::string & name);
+
+    /**
+     * @brief Write the id to name mapping to a file.
+     * @details The file contains one "<id>\t<name>" line per name, in order
+     * of increasing id.
+     * @param path The path of the symbol map.
+     * @return void
+     * @throw std::runtime_error if the file cannot be written.
+     */
+    void write_symbol_map(const std::string & path);
+}
+#endif // TRACE_H
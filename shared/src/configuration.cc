@@ -104,6 +104,15 @@ namespace cfg
         return *value;
     }
 
+    // Retrieve the requested integer field from the configuration table.
+    int64_t ConfigurationTable::get_int_field(const std::string & field, int64_t default_value) const
+    {
+        std::optional<int64_t> value(config.at_path(field).value<int64_t>());
+        if(!value)
+            return default_value;
+        return *value;
+    }
+
     // Retrieve the requested double field from the configuration table.
     double ConfigurationTable::get_double_field(const std::string & field) const
     {
@@ -113,6 +122,15 @@ namespace cfg
         return *value;
     }
 
+    // Retrieve the requested double field from the configuration table.
+    double ConfigurationTable::get_double_field(const std::string & field, double default_value) const
+    {
+        std::optional<double> value(config.at_path(field).value<double>());
+        if(!value)
+            return default_value;
+        return *value;
+    }
+
     // Retrieve the requested vector of doubles from the configuration table.
     std::vector<double> ConfigurationTable::get_double_vector(const std::string & field) const
     {
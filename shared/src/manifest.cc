@@ -0,0 +1,184 @@
+/**
+ * @file manifest.cc
+ * @brief Implementation of the Manifest class.
+ * @details This file contains the implementation of the Manifest class, which
+ * indexes the per-sample output files of an analysis. The manifest is stored
+ * as a TOML file and read/written using the toml++ library.
+ * @author mueller@fnal.gov
+ */
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+
+#include "configuration.h"
+#include "manifest.h"
+#include "toml++/toml.h"
+
+namespace cfg
+{
+    // Read a manifest from a TOML file.
+    Manifest Manifest::read(const std::string & path)
+    {
+        toml::table root;
+        try
+        {
+            root = toml::parse_file(path);
+        }
+        catch(const std::exception & e)
+        {
+            throw ConfigurationError(e.what());
+        }
+
+        Manifest manifest(root["output"].value_or(std::string()));
+        size_t pos(path.find_last_of('/'));
+        manifest.directory = (pos == std::string::npos) ? std::string() : path.substr(0, pos + 1);
+
+        const toml::array * files = root["file"].as_array();
+        if(files == nullptr)
+            return manifest;
+        for(const toml::node & node : *files)
+        {
+            const toml::table * t = node.as_table();
+            if(t == nullptr)
+                throw ConfigurationError("Malformed file entry in manifest " + path + ".");
+            Entry entry;
+            entry.sample = (*t)["sample"].value_or(std::string());
+            entry.path = (*t)["path"].value_or(std::string());
+            entry.pot = (*t)["pot"].value_or(0.0);
+            entry.livetime = (*t)["livetime"].value_or(0.0);
+            if(const toml::array * trees = (*t)["trees"].as_array())
+                for(const toml::node & tree : *trees)
+                    entry.trees.push_back(tree.value_or(std::string()));
+            if(const toml::array * inputs = (*t)["inputs"].as_array())
+                for(const toml::node & input : *inputs)
+                    entry.inputs.push_back(input.value_or(std::string()));
+            if(entry.sample.empty() || entry.path.empty())
+                throw ConfigurationError("File entry without sample or path in manifest " + path + ".");
+            manifest.entries.push_back(entry);
+        }
+        return manifest;
+    }
+
+    // Check if a path refers to a manifest.
+    bool Manifest::is_manifest(const std::string & path)
+    {
+        const std::string extension(".toml");
+        return path.size() >= extension.size()
+            && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+    }
+
+    // Write the manifest to a TOML file.
+    void Manifest::write(const std::string & path) const
+    {
+        toml::table root;
+        root.insert("output", output);
+        toml::array files;
+        for(const Entry & entry : entries)
+        {
+            toml::array trees;
+            for(const std::string & tree : entry.trees)
+                trees.push_back(tree);
+            toml::table file{
+                {"sample", entry.sample},
+                {"path", entry.path},
+                {"trees", trees},
+                {"pot", entry.pot},
+                {"livetime", entry.livetime}
+            };
+            if(!entry.inputs.empty())
+            {
+                toml::array inputs;
+                for(const std::string & input : entry.inputs)
+                    inputs.push_back(input);
+                file.insert("inputs", inputs);
+            }
+            files.push_back(file);
+        }
+        root.insert("file", files);
+
+        // The per-sample totals are a convenience for monitoring; readers
+        // always recompute them from the file entries.
+        toml::array summary;
+        for(const std::string & sample : get_samples())
+            summary.push_back(toml::table{
+                {"name", sample},
+                {"files", static_cast<int64_t>(get_entries(sample).size())},
+                {"pot", get_pot(sample)},
+                {"livetime", get_livetime(sample)}
+            });
+        root.insert("sample", summary);
+
+        const std::string tmp(path + ".tmp");
+        {
+            std::ofstream out(tmp);
+            if(!out)
+                throw ConfigurationError("Unable to write manifest " + path + ".");
+            out << root << "\n";
+        }
+        if(std::rename(tmp.c_str(), path.c_str()) != 0)
+            throw ConfigurationError("Unable to move manifest into place at " + path + ".");
+    }
+
+    // Get the entries for a single sample.
+    std::vector<Manifest::Entry> Manifest::get_entries(const std::string & sample) const
+    {
+        std::vector<Entry> result;
+        for(const Entry & entry : entries)
+            if(entry.sample == sample)
+                result.push_back(entry);
+        return result;
+    }
+
+    // Get the names of the samples in the manifest.
+    std::vector<std::string> Manifest::get_samples() const
+    {
+        std::vector<std::string> samples;
+        for(const Entry & entry : entries)
+        {
+            bool seen(false);
+            for(const std::string & s : samples)
+                seen = seen || (s == entry.sample);
+            if(!seen)
+                samples.push_back(entry.sample);
+        }
+        return samples;
+    }
+
+    // Get the total POT exposure of a sample.
+    double Manifest::get_pot(const std::string & sample) const
+    {
+        double pot(0);
+        for(const Entry & entry : entries)
+            if(entry.sample == sample)
+                pot += entry.pot;
+        return pot;
+    }
+
+    // Get the total livetime exposure of a sample.
+    double Manifest::get_livetime(const std::string & sample) const
+    {
+        double livetime(0);
+        for(const Entry & entry : entries)
+            if(entry.sample == sample)
+                livetime += entry.livetime;
+        return livetime;
+    }
+
+    // Resolve the path of an entry relative to the manifest.
+    std::string Manifest::resolve(const Entry & entry) const
+    {
+        if(!entry.path.empty() && entry.path[0] == '/')
+            return entry.path;
+        return directory + entry.path;
+    }
+
+    // Get the input files processed into any entry of the manifest.
+    std::vector<std::string> Manifest::get_inputs() const
+    {
+        std::vector<std::string> inputs;
+        for(const Entry & entry : entries)
+            inputs.insert(inputs.end(), entry.inputs.begin(), entry.inputs.end());
+        return inputs;
+    }
+}
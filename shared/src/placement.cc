@@ -0,0 +1,270 @@
+/**
+ * @file placement.cc
+ * @brief Implementation of the placement of threads and memory on NUMA nodes.
+ * @details This file contains the discovery of the topology from sysfs, the
+ * binding of the threads with sched_setaffinity, the direction of their
+ * memory allocations with set_mempolicy, and the reporting of the throughput.
+ * @author mueller@fnal.gov
+ */
+#include <mutex>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "placement.h"
+
+namespace
+{
+    /**
+     * @struct Node
+     * @brief The CPUs of a NUMA node available to the process.
+     */
+    struct Node
+    {
+        int id;                     ///< The id of the node in sysfs.
+        std::vector<int> cpus;      ///< The allowed CPUs of the node.
+    };
+
+    // The configured policy and topology.
+    placement::Policy configured_policy(placement::Policy::None);
+    std::vector<Node> topology;
+    std::mutex report_mutex;
+
+    // The node and the pinned core (-1 for the whole node) of the calling
+    // thread.
+    thread_local long current(-1);
+    thread_local int current_cpu(-1);
+
+    /**
+     * @brief Parse a sysfs CPU list (e.g., "0-7,16-23").
+     * @param list The CPU list.
+     * @return The CPUs of the list.
+     */
+    std::vector<int> parse_cpulist(const std::string & list)
+    {
+        std::vector<int> result;
+        std::stringstream ss(list);
+        std::string range;
+        while(std::getline(ss, range, ','))
+        {
+            if(range.empty() || range == "\n")
+                continue;
+            const size_t dash(range.find('-'));
+            const int first(std::stoi(range.substr(0, dash)));
+            const int last(dash == std::string::npos ? first : std::stoi(range.substr(dash + 1)));
+            for(int c(first); c <= last; ++c)
+                result.push_back(c);
+        }
+        return result;
+    }
+
+    /**
+     * @brief Read the NUMA nodes of the machine, restricted to the CPUs the
+     * process is allowed to run on.
+     * @details A single node with all allowed CPUs is returned if the
+     * topology is not available (e.g., in a container without sysfs).
+     * @return The nodes with at least one allowed CPU.
+     */
+    std::vector<Node> read_topology()
+    {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+            for(int c(0); c < CPU_SETSIZE; ++c)
+                CPU_SET(c, &allowed);
+
+        std::vector<Node> nodes;
+        if(DIR * dir = opendir("/sys/devices/system/node"))
+        {
+            while(dirent * entry = readdir(dir))
+            {
+                const std::string name(entry->d_name);
+                if(name.rfind("node", 0) != 0 || name.size() == 4 || name.find_first_not_of("0123456789", 4) != std::string::npos)
+                    continue;
+                std::ifstream input("/sys/devices/system/node/" + name + "/cpulist");
+                std::string list;
+                std::getline(input, list);
+                Node node{std::stoi(name.substr(4)), {}};
+                for(int c : parse_cpulist(list))
+                    if(c < CPU_SETSIZE && CPU_ISSET(c, &allowed))
+                        node.cpus.push_back(c);
+                if(!node.cpus.empty())
+                    nodes.push_back(node);
+            }
+            closedir(dir);
+        }
+        std::sort(nodes.begin(), nodes.end(), [](const Node & a, const Node & b) { return a.id < b.id; });
+
+        if(nodes.empty())
+        {
+            Node node{0, {}};
+            for(int c(0); c < CPU_SETSIZE; ++c)
+                if(CPU_ISSET(c, &allowed))
+                    node.cpus.push_back(c);
+            nodes.push_back(node);
+        }
+        return nodes;
+    }
+
+    /**
+     * @brief Bind the calling thread to a set of CPUs and direct its memory
+     * allocations to a node.
+     * @param cpus The CPUs.
+     * @param node The node.
+     * @return True if the thread was bound.
+     */
+    bool bind(const std::vector<int> & cpus, const Node & node)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for(int c : cpus)
+            CPU_SET(c, &set);
+        if(sched_setaffinity(0, sizeof(set), &set) != 0)
+            return false;
+
+#if defined(SYS_set_mempolicy)
+        // MPOL_PREFERRED: allocate on the node, falling back to the other
+        // nodes when it is full. The policy is not required for first-touch
+        // placement, but also covers pages touched by other threads on
+        // behalf of this one (e.g., by the allocator).
+        constexpr int mpol_preferred(1);
+        constexpr size_t bits(8 * sizeof(unsigned long));
+        if(node.id >= 0 && static_cast<size_t>(node.id) < 4 * bits)
+        {
+            unsigned long mask[4] = {0, 0, 0, 0};
+            mask[node.id / bits] |= 1UL << (node.id % bits);
+            syscall(SYS_set_mempolicy, mpol_preferred, mask, 4 * bits + 1);
+        }
+#endif
+        return true;
+    }
+}
+
+namespace placement
+{
+    // Configure the placement policy.
+    void configure(const std::string & policy)
+    {
+        if(policy == "none")
+            configured_policy = Policy::None;
+        else if(policy == "node")
+            configured_policy = Policy::Node;
+        else if(policy == "core")
+            configured_policy = Policy::Core;
+        else
+            throw std::runtime_error("Unknown placement policy '" + policy + "' (expected none, node, or core).");
+
+        topology = read_topology();
+    }
+
+    // Get the configured placement policy.
+    Policy policy()
+    {
+        return configured_policy;
+    }
+
+    // Get the name of the configured placement policy.
+    std::string policy_name()
+    {
+        switch(configured_policy)
+        {
+            case Policy::Node: return "node";
+            case Policy::Core: return "core";
+            default: return "none";
+        }
+    }
+
+    // Get the number of NUMA nodes available to the process.
+    size_t nodes()
+    {
+        return std::max<size_t>(topology.size(), 1);
+    }
+
+    // Get the CPUs of a NUMA node available to the process.
+    const std::vector<int> & cpus(size_t node)
+    {
+        if(node >= topology.size())
+            throw std::runtime_error("No NUMA node " + std::to_string(node) + " (the placement is not configured or the node does not exist).");
+        return topology[node].cpus;
+    }
+
+    // Get the node assigned to a sample.
+    size_t sample_node(size_t index)
+    {
+        return index % nodes();
+    }
+
+    // Place the calling thread as the reader thread of a node.
+    bool place_reader(size_t node)
+    {
+        if(configured_policy == Policy::None || node >= topology.size() || (current == static_cast<long>(node) && current_cpu < 0))
+            return false;
+        if(!bind(topology[node].cpus, topology[node]))
+            return false;
+        current = node;
+        current_cpu = -1;
+        return true;
+    }
+
+    // Place the calling thread as the thread of a sample.
+    bool place_sample(size_t index)
+    {
+        const size_t node(sample_node(index));
+        if(configured_policy != Policy::Core)
+            return place_reader(node);
+        if(node >= topology.size())
+            return false;
+        const Node & n(topology[node]);
+        const int cpu(n.cpus[(index / nodes()) % n.cpus.size()]);
+        if(current == static_cast<long>(node) && current_cpu == cpu)
+            return false;
+        if(!bind({cpu}, n))
+            return false;
+        current = node;
+        current_cpu = cpu;
+        return true;
+    }
+
+    // Describe the topology and the configured policy.
+    std::string describe()
+    {
+        std::ostringstream out;
+        out << "policy " << policy_name() << ", " << topology.size() << " node" << (topology.size() == 1 ? "" : "s") << ":";
+        for(const Node & node : topology)
+        {
+            out << " [node " << node.id << ": " << node.cpus.size() << " cpus]";
+        }
+        return out.str();
+    }
+
+    // Report the throughput of a run under the configured policy.
+    void report(const std::string & program, const std::string & unit, double count, double seconds, const std::string & log)
+    {
+        const double rate(seconds > 0 ? count / seconds : 0.0);
+        std::lock_guard<std::mutex> lock(report_mutex);
+        std::cout << "Throughput (" << program << ", placement " << policy_name() << "): " << count << " " << unit
+                  << " in " << seconds << " s (" << rate << " " << unit << "/s)." << std::endl;
+        if(log.empty())
+            return;
+
+        const bool header(!std::ifstream(log).good());
+        std::ofstream out(log, std::ios::app);
+        if(!out)
+            throw std::runtime_error("Unable to write placement log " + log + ".");
+        if(header)
+            out << "host\tprogram\tpolicy\tnodes\tunit\tcount\tseconds\trate\n";
+        char host[256] = "unknown";
+        gethostname(host, sizeof(host) - 1);
+        out << host << "\t" << program << "\t" << policy_name() << "\t" << nodes() << "\t" << unit << "\t"
+            << count << "\t" << seconds << "\t" << rate << "\n";
+    }
+}
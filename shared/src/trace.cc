@@ -0,0 +1,47 @@
+/**
+ * @file trace.cc
+ * @brief Implementation of the static tracepoint support.
+ * @details This file contains the registry of the names used as probe
+ * arguments and the writer of the corresponding symbol map.
+ * @author mueller@fnal.gov
+ */
+#include <mutex>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "trace.h"
+
+namespace
+{
+    std::mutex names_mutex;
+    std::vector<std::string> names;
+    std::unordered_map<std::string, uint32_t> ids;
+}
+
+namespace trace
+{
+    // Get the id of a name for use as a probe argument.
+    uint32_t name_id(const std::string & name)
+    {
+        std::lock_guard<std::mutex> lock(names_mutex);
+        auto it(ids.find(name));
+        if(it != ids.end())
+            return it->second;
+        names.push_back(name);
+        return ids[name] = names.size();
+    }
+
+    // Write the id to name mapping to a file.
+    void write_symbol_map(const std::string & path)
+    {
+        std::lock_guard<std::mutex> lock(names_mutex);
+        std::ofstream out(path);
+        if(!out)
+            throw std::runtime_error("Unable to write symbol map " + path + ".");
+        for(size_t i(0); i < names.size(); ++i)
+            out << i + 1 << "\t" << names[i] << "\n";
+    }
+}
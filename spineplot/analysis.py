@@ -13,6 +13,7 @@ from roc import ROCCurve
 from ternary import Ternary
 from style import Style
 from variable import Variable
+from manifest import open_output
 
 class ConfigException(Exception):
     pass
@@ -45,7 +46,8 @@ class Analysis:
         toml_path : str
             The path to the TOML configuration file for the analysis.
         rf_path : str
-            The path to the ROOT file containing the data.
+            The path to the ROOT file containing the data, or to the
+            manifest of per-sample files.
 
         Returns
         -------
@@ -55,7 +57,7 @@ class Analysis:
         self._config = toml.load(self._toml_path)
         for table in self._config.get('this_includes', []):
             Analysis.handle_include(self._config, table)
-        rf = uproot.open(rf_path)
+        rf = open_output(rf_path)
 
         # Load the output path
         if 'output' not in self._config.keys():
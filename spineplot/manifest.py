@@ -0,0 +1,223 @@
+import os
+import numpy as np
+import pandas as pd
+import toml
+import uproot
+
+class Manifest:
+    """
+    A class designed to provide transparent access to the per-sample
+    output files of an analysis. When the selection framework is run
+    with the "per_sample" output mode, each sample is written to its
+    own ROOT file and a small TOML manifest maps the samples to the
+    files holding them. This class mimics the interface of the single
+    output file by resolving the "events/<sample>" paths to the
+    corresponding file. A sample may be spread over several files
+    (e.g., the parts written by the follow mode of the selection), in
+    which case the parts are merged transparently (see `Merged`).
+
+    Attributes
+    ----------
+    _path : str
+        The path to the manifest file.
+    _entries : list[dict]
+        The file entries of the manifest. Each entry contains the
+        sample name, the path to the file (relative to the manifest),
+        the list of trees, and the exposure totals of the file.
+    _files : dict
+        The uproot file handles opened so far, keyed by the sample
+        name. Each value is a list with one handle per part.
+    """
+    def __init__(self, path) -> None:
+        """
+        Initializes the Manifest object by reading the TOML manifest.
+
+        Parameters
+        ----------
+        path : str
+            The path to the manifest file.
+
+        Returns
+        -------
+        None
+        """
+        self._path = path
+        self._entries = toml.load(path).get('file', list())
+        self._files = dict()
+
+    def _resolve(self, entry) -> str:
+        """
+        Resolves the path of a file entry relative to the directory
+        containing the manifest.
+
+        Parameters
+        ----------
+        entry : dict
+            The file entry to resolve.
+
+        Returns
+        -------
+        str
+            The path to the file of the entry.
+        """
+        if os.path.isabs(entry['path']):
+            return entry['path']
+        return os.path.join(os.path.dirname(self._path), entry['path'])
+
+    def __getitem__(self, key):
+        """
+        Retrieves an object by its path in the single-file layout
+        ("events/<sample>/..."). The files holding the sample are opened
+        on first access.
+
+        Parameters
+        ----------
+        key : str
+            The path of the object.
+
+        Returns
+        -------
+        object
+            The uproot object at the requested path, or a Merged object
+            if the sample is spread over several files.
+        """
+        parts = key.split('/')
+        if len(parts) < 2:
+            raise KeyError(f"Unable to resolve the sample of '{key}' from the manifest ('{self._path}').")
+        sample = parts[1]
+        if sample not in self._files:
+            entries = [e for e in self._entries if e['sample'] == sample]
+            if len(entries) == 0:
+                raise KeyError(f"Sample '{sample}' not found in the manifest ('{self._path}').")
+            self._files[sample] = [uproot.open(self._resolve(e)) for e in entries]
+        if len(self._files[sample]) == 1:
+            return self._files[sample][0][key]
+        return Merged([f[key] for f in self._files[sample]])
+
+class Merged:
+    """
+    A class designed to present the same object in several files as a
+    single object. Directories and trees are indexed part by part,
+    the arrays of trees and branches are concatenated, and histograms
+    are summed. Only the subset of the uproot interface used by
+    spineplot is supported.
+
+    Attributes
+    ----------
+    _parts : list
+        The uproot objects, one per part.
+    """
+    def __init__(self, parts) -> None:
+        """
+        Initializes the Merged object with the given parts.
+
+        Parameters
+        ----------
+        parts : list
+            The uproot objects, one per part.
+
+        Returns
+        -------
+        None
+        """
+        self._parts = parts
+
+    def __getitem__(self, key):
+        return Merged([p[key] for p in self._parts])
+
+    def keys(self, **kwargs):
+        return self._parts[0].keys(**kwargs)
+
+    def arrays(self, *args, library='ak', **kwargs):
+        arrays = [p.arrays(*args, library=library, **kwargs) for p in self._parts]
+        if library == 'pd':
+            return pd.concat(arrays, ignore_index=True)
+        if library == 'np':
+            return {k: np.concatenate([a[k] for a in arrays]) for k in arrays[0]}
+        import awkward as ak
+        return ak.concatenate(arrays)
+
+    def array(self, *args, library='ak', **kwargs):
+        arrays = [p.array(*args, library=library, **kwargs) for p in self._parts]
+        if library == 'np':
+            return np.concatenate(arrays)
+        if library == 'pd':
+            return pd.concat(arrays, ignore_index=True)
+        import awkward as ak
+        return ak.concatenate(arrays)
+
+    def to_numpy(self, **kwargs):
+        values, *edges = self._parts[0].to_numpy(**kwargs)
+        for p in self._parts[1:]:
+            values = values + p.to_numpy(**kwargs)[0]
+        return (values, *edges)
+
+def open_output(path):
+    """
+    Opens the output of the selection framework. The output is either
+    a single ROOT file or a TOML manifest of per-sample files. In both
+    cases the returned object can be indexed by the path of an object
+    in the single-file layout.
+
+    Parameters
+    ----------
+    path : str
+        The path to the ROOT file or manifest.
+
+    Returns
+    -------
+    uproot.reading.ReadOnlyDirectory or Manifest
+        The handle to the output.
+    """
+    if path.endswith('.toml'):
+        return Manifest(path)
+    return uproot.open(path)
+
+def read_categories(directory, tree, branch, categories, library='pd', **kwargs):
+    """
+    Reads the rows of a tree belonging to a subset of categories. If
+    the tree was clustered by the category branch in the selection
+    (the "cluster_by" option of a tree), the "<tree>_index" tree gives
+    the range of rows of each category and only those ranges are read.
+    Otherwise, the full tree is read and filtered.
+
+    Parameters
+    ----------
+    directory : uproot.reading.ReadOnlyDirectory or Merged
+        The directory containing the tree (e.g., "events/<sample>").
+    tree : str
+        The name of the tree.
+    branch : str
+        The name of the category branch.
+    categories : list
+        The category values to read.
+    library : str
+        The library of the returned arrays ('pd' or 'np').
+    **kwargs
+        Additional keyword arguments passed to `arrays` (e.g., the
+        list of branches to read).
+
+    Returns
+    -------
+    pandas.DataFrame or dict
+        The rows of the requested categories.
+    """
+    if isinstance(directory, Merged):
+        parts = [read_categories(p, tree, branch, categories, library, **kwargs) for p in directory._parts]
+        if library == 'pd':
+            return pd.concat(parts, ignore_index=True)
+        return {k: np.concatenate([p[k] for p in parts]) for k in parts[0]}
+
+    if f'{tree}_index' not in directory:
+        data = directory[tree].arrays(library='pd', **kwargs)
+        data = data[data[branch].isin(categories)] if branch in data.columns else data.iloc[0:0]
+        return data.reset_index(drop=True) if library == 'pd' else {k: data[k].to_numpy() for k in data.columns}
+
+    index = directory[f'{tree}_index'].arrays(['category', 'first', 'count'], library='np')
+    parts = [directory[tree].arrays(entry_start=int(f), entry_stop=int(f + n), library=library, **kwargs)
+             for c, f, n in zip(index['category'], index['first'], index['count']) if c in categories]
+    if len(parts) == 0:
+        return directory[tree].arrays(entry_start=0, entry_stop=0, library=library, **kwargs)
+    if library == 'pd':
+        return pd.concat(parts, ignore_index=True)
+    return {k: np.concatenate([p[k] for p in parts]) for k in parts[0]}
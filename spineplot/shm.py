@@ -0,0 +1,152 @@
+import os
+import json
+import mmap
+import struct
+import numpy as np
+
+_MAGIC = b'SPINEARW'
+_FORMATS = {'i': np.int32, 'g': np.float64}
+
+class SharedTable:
+    """
+    A class designed to map a table published by the selection
+    framework to POSIX shared memory (see the "export" option of the
+    selection). The columns are stored as Arrow buffers, so they are
+    mapped without copying or decoding: the numpy arrays and pyarrow
+    arrays returned by this class are views of the shared memory.
+
+    Attributes
+    ----------
+    _name : str
+        The name of the shared memory segment.
+    _map : mmap.mmap
+        The mapping of the segment.
+    _schema : dict
+        The schema of the table, listing the name, Arrow format string,
+        offset, and length of each column.
+    """
+    def __init__(self, name) -> None:
+        """
+        Initializes the SharedTable object by mapping the segment.
+
+        Parameters
+        ----------
+        name : str
+            The name of the shared memory segment (with or without the
+            leading '/').
+
+        Returns
+        -------
+        None
+        """
+        self._name = name.lstrip('/')
+        with open(os.path.join('/dev/shm', self._name), 'rb') as f:
+            self._map = mmap.mmap(f.fileno(), 0, prot=mmap.PROT_READ)
+        magic, version, _, length, rows = struct.unpack_from('=8sIIQQ', self._map, 0)
+        if magic != _MAGIC:
+            raise ValueError(f'Shared memory segment {name} is not a SPINE table.')
+        if version != 1:
+            raise ValueError(f'Unsupported SPINE table version {version} in {name}.')
+        self._schema = json.loads(bytes(self._map[32:32 + length]).decode())
+        self._rows = rows
+
+    @property
+    def name(self) -> str:
+        return self._schema['name']
+
+    @property
+    def columns(self) -> list:
+        return [c['name'] for c in self._schema['columns']]
+
+    def __len__(self) -> int:
+        return self._rows
+
+    def numpy(self) -> dict:
+        """
+        Returns the columns of the table as numpy arrays viewing the
+        shared memory.
+
+        Returns
+        -------
+        dict
+            The columns of the table, keyed by name.
+        """
+        result = dict()
+        for c in self._schema['columns']:
+            dtype = _FORMATS[c['format']]
+            result[c['name']] = np.frombuffer(self._map, dtype=dtype, count=c['length'] // np.dtype(dtype).itemsize, offset=c['offset'])
+        return result
+
+    def arrow(self):
+        """
+        Returns the table as a pyarrow Table whose buffers view the
+        shared memory.
+
+        Returns
+        -------
+        pyarrow.Table
+            The table.
+        """
+        import pyarrow as pa
+        types = {'i': pa.int32(), 'g': pa.float64()}
+        buffer = pa.py_buffer(self._map)
+        arrays = [pa.Array.from_buffers(types[c['format']], self._rows, [None, buffer.slice(c['offset'], c['length'])])
+                  for c in self._schema['columns']]
+        return pa.Table.from_arrays(arrays, names=self.columns)
+
+    def pandas(self):
+        """
+        Returns the table as a pandas DataFrame. With pyarrow available,
+        the DataFrame is built from the Arrow table without copying the
+        columns where pandas allows it.
+
+        Returns
+        -------
+        pandas.DataFrame
+            The table.
+        """
+        try:
+            return self.arrow().to_pandas(split_blocks=True, self_destruct=False)
+        except ImportError:
+            import pandas as pd
+            return pd.DataFrame(self.numpy(), copy=False)
+
+def list_tables(prefix='spine') -> list:
+    """
+    Lists the tables published to shared memory with the given prefix.
+
+    Parameters
+    ----------
+    prefix : str
+        The prefix of the segment names (the "export_prefix" option of
+        the selection).
+
+    Returns
+    -------
+    list[str]
+        The names of the segments.
+    """
+    if not os.path.isdir('/dev/shm'):
+        return list()
+    return sorted(f for f in os.listdir('/dev/shm') if f.startswith(f'{prefix}_'))
+
+def open_table(sample, tree, prefix='spine') -> SharedTable:
+    """
+    Maps the table of a tree of a sample published to shared memory.
+
+    Parameters
+    ----------
+    sample : str
+        The name of the sample.
+    tree : str
+        The name of the tree.
+    prefix : str
+        The prefix of the segment names.
+
+    Returns
+    -------
+    SharedTable
+        The mapped table.
+    """
+    name = f'{prefix}_{sample}_{tree}'.replace('/', '_').replace(' ', '_')
+    return SharedTable(name)
@@ -0,0 +1,99 @@
+/**
+ * @file convergence.h
+ * @brief Header file for the UniverseConvergence class, which monitors the
+ * convergence of a multisim covariance matrix as universes are added.
+ * @details Multisim systematics are typically evaluated with hundreds to
+ * thousands of universes, but for quick-look studies the covariance matrix
+ * is often stable long before all universes have been used. The
+ * UniverseConvergence class accumulates the covariance matrix one universe at
+ * a time and, after each block of universes, compares the diagonal
+ * uncertainties to those of the previous block. The evaluation may be stopped
+ * once the relative change falls below a configured tolerance.
+ * @author mueller@fnal.gov
+ */
+#ifndef CONVERGENCE_H
+#define CONVERGENCE_H
+#include <vector>
+#include <string>
+
+/**
+ * @namespace sys
+ * @brief Namespace for organizing generic systematics.
+ */
+namespace sys
+{
+    /**
+     * @class UniverseConvergence
+     * @brief Streaming multisim covariance with a convergence criterion.
+     * @details Each universe contributes the deviation of its binned
+     * prediction from the nominal prediction. The covariance matrix is the
+     * mean of the outer products of these deviations, which is accumulated in
+     * a single pass. After every block of universes, the relative change of
+     * the diagonal uncertainties (square root of the diagonal) with respect to
+     * the previous block is computed; the covariance is considered converged
+     * when this change is below the tolerance and at least the minimum number
+     * of universes has been added.
+     */
+    class UniverseConvergence
+    {
+    public:
+        /**
+         * @brief Constructor for the UniverseConvergence class.
+         * @param name The name used when reporting the convergence.
+         * @param nbins The number of bins of the binned prediction.
+         * @param block The number of universes per block.
+         * @param tolerance The tolerance on the relative change of the
+         * diagonal uncertainties between blocks.
+         * @param min_universes The minimum number of universes before the
+         * covariance may be considered converged.
+         */
+        UniverseConvergence(const std::string & name, size_t nbins, size_t block, double tolerance, size_t min_universes);
+
+        /**
+         * @brief Add a universe to the covariance.
+         * @details The relative change is evaluated (and reported) at the
+         * end of each block.
+         * @param deviation The deviation of the binned prediction of the
+         * universe from the nominal prediction.
+         * @return True if the covariance has converged.
+         */
+        bool add(const std::vector<double> & deviation);
+
+        /**
+         * @brief Check if the covariance has converged.
+         * @return True if the covariance has converged.
+         */
+        bool converged() const { return is_converged; }
+
+        /**
+         * @brief Get the number of universes added.
+         * @return The number of universes added.
+         */
+        size_t count() const { return nuniv; }
+
+        /**
+         * @brief Get the relative change at the end of the last block.
+         * @return The maximum relative change of the diagonal uncertainties.
+         */
+        double change() const { return last_change; }
+
+        /**
+         * @brief Get the current covariance matrix.
+         * @return The covariance matrix in row-major order.
+         */
+        std::vector<double> covariance() const;
+
+    private:
+        std::string name;               ///< The name used when reporting.
+        size_t nbins;                   ///< The number of bins.
+        size_t block;                   ///< The number of universes per block.
+        double tolerance;               ///< The tolerance on the relative change.
+        size_t min_universes;           ///< The minimum number of universes.
+        size_t nuniv;                   ///< The number of universes added.
+        bool is_converged;              ///< Whether the covariance has converged.
+        double last_change;             ///< The relative change of the last block.
+        std::vector<double> sum;        ///< The sum of the outer products of the deviations.
+        std::vector<double> previous;   ///< The diagonal uncertainties at the end of the previous block.
+    };
+}
+#endif // CONVERGENCE_H
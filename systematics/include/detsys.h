@@ -15,6 +15,7 @@
 #include <vector>
 
 #include "configuration.h"
+#include "inputs.h"
 #include "utilities.h"
 
 #include "TH1D.h"
@@ -74,10 +75,10 @@ namespace sys::detsys
          * used to read the histograms that define the variations.
          * @param table The configuration table.
          * @param output The output file.
-         * @param input The input file.
+         * @param input The input file(s).
          * @see cfg::ConfigurationTable
          */
-        DetsysCalculator(cfg::ConfigurationTable & table, TFile * output, TFile * input);
+        DetsysCalculator(cfg::ConfigurationTable & table, TFile * output, sys::InputFiles & input);
 
         /**
          * @brief Default constructor for the DetsysCalculator class.
@@ -0,0 +1,109 @@
+/**
+ * @file inputs.h
+ * @brief Header file for the InputFiles class, which resolves the input
+ * objects of the systematics framework from either a single ROOT file or a
+ * manifest of per-sample files.
+ * @details The selection framework either writes all samples to a single ROOT
+ * file or one ROOT file per sample along with a manifest (see
+ * @ref cfg::Manifest). The InputFiles class hides this difference from the
+ * rest of the systematics framework: objects are requested by their path
+ * within the single-file layout ("events/<sample>/<object>") and are resolved
+ * to the file holding the sample. A sample may be spread over several files
+ * (e.g., the parts written by the follow mode of the selection), in which case
+ * trees are chained and histograms are summed across the parts.
+ * @author mueller@fnal.gov
+ */
+#ifndef INPUTS_H
+#define INPUTS_H
+#include <map>
+#include <vector>
+#include <string>
+
+#include "TFile.h"
+#include "TDirectory.h"
+#include "TObject.h"
+
+#include "manifest.h"
+
+/**
+ * @namespace sys
+ * @brief Namespace for organizing generic systematics.
+ */
+namespace sys
+{
+    /**
+     * @class InputFiles
+     * @brief Resolves input objects from a ROOT file or a manifest.
+     */
+    class InputFiles
+    {
+    public:
+        /**
+         * @brief Constructor for the InputFiles class.
+         * @details If @p path is a manifest, the per-sample files are opened
+         * lazily when an object of the sample is first requested. Otherwise,
+         * @p path is opened as a single ROOT file.
+         * @param path The path to the ROOT file or manifest.
+         */
+        explicit InputFiles(const std::string & path);
+
+        /**
+         * @brief Destructor for the InputFiles class.
+         * @details Closes all opened files.
+         */
+        ~InputFiles();
+
+        InputFiles(const InputFiles &) = delete;
+        InputFiles & operator=(const InputFiles &) = delete;
+
+        /**
+         * @brief Retrieve an object by its path in the single-file layout.
+         * @details If the sample is spread over several files, a TTree is
+         * returned as a TChain over all parts and a TH1 as the sum over all
+         * parts. Other objects are taken from the first part.
+         * @param path The path of the object.
+         * @return A pointer to the object, or nullptr if it does not exist.
+         */
+        TObject * Get(const std::string & path);
+
+        /**
+         * @brief Retrieve an object of a given type by its path in the
+         * single-file layout.
+         * @tparam T The type of the object.
+         * @param path The path of the object.
+         * @return A pointer to the object, or nullptr if it does not exist or
+         * has a different type.
+         */
+        template<class T>
+        T * Get(const std::string & path) { return dynamic_cast<T *>(Get(path)); }
+
+        /**
+         * @brief Close all opened files.
+         * @return void
+         */
+        void Close();
+
+    private:
+        /**
+         * @brief Resolve the files holding the object specified in the path.
+         * @param path The path of the object.
+         * @return The files holding the object (one per part of the sample).
+         * @throw std::runtime_error if the sample is not in the manifest.
+         */
+        const std::vector<TFile *> & resolve(const std::string & path);
+
+        /**
+         * @brief Merge an object across the parts of a sample.
+         * @param path The path of the object.
+         * @param parts The files holding the parts of the sample.
+         * @return The merged object, or nullptr if it does not exist.
+         */
+        TObject * merge(const std::string & path, const std::vector<TFile *> & parts);
+
+        TFile * single;                                         ///< The single input file (if not a manifest).
+        cfg::Manifest manifest;                                 ///< The manifest (if any).
+        std::map<std::string, std::vector<TFile *>> files;      ///< The per-sample files opened so far.
+        std::map<std::string, TObject *> merged;                ///< The merged objects created so far.
+    };
+}
+#endif // INPUTS_H
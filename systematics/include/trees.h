@@ -14,6 +14,7 @@
 #include <iostream>
 
 #include "detsys.h"
+#include "inputs.h"
 #include "configuration.h"
 
 #include "TFile.h"
@@ -45,10 +46,10 @@ namespace sys::trees
      * as the input TTree.
      * @param table The table that contains the configuration for the tree.
      * @param output The output TFile.
-     * @param input The input TFile.
+     * @param input The input file(s).
      * @return void
      */
-    void copy_tree(cfg::ConfigurationTable & table, TFile * output, TFile * input);
+    void copy_tree(cfg::ConfigurationTable & table, TFile * output, sys::InputFiles & input);
 
     /**
      * @brief Add reweightable systematics to the output TTree.
@@ -60,9 +61,9 @@ namespace sys::trees
      * universe weights for matched neutrinos.
      * @param table The table that contains the configuration for the tree.
      * @param output The output TFile.
-     * @param input The input TFile.
+     * @param input The input file(s).
      * @return void
      */
-    void copy_with_weight_systematics(cfg::ConfigurationTable & config, cfg::ConfigurationTable & table, TFile * output, TFile * input, sys::detsys::DetsysCalculator & calc);
+    void copy_with_weight_systematics(cfg::ConfigurationTable & config, cfg::ConfigurationTable & table, TFile * output, sys::InputFiles & input, sys::detsys::DetsysCalculator & calc);
 }
 #endif
\ No newline at end of file
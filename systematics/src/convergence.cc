@@ -0,0 +1,61 @@
+/**
+ * @file convergence.cc
+ * @brief Implementation of the UniverseConvergence class.
+ * @details This file contains the implementation of the UniverseConvergence
+ * class, which monitors the convergence of a multisim covariance matrix as
+ * universes are added.
+ * @author mueller@fnal.gov
+ */
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+
+#include "convergence.h"
+
+// Constructor for the UniverseConvergence class.
+sys::UniverseConvergence::UniverseConvergence(const std::string & name, size_t nbins, size_t block, double tolerance, size_t min_universes)
+    : name(name), nbins(nbins), block(std::max<size_t>(block, 1)), tolerance(tolerance), min_universes(min_universes),
+      nuniv(0), is_converged(false), last_change(std::numeric_limits<double>::infinity()),
+      sum(nbins * nbins, 0.0) {}
+
+// Add a universe to the covariance.
+bool sys::UniverseConvergence::add(const std::vector<double> & deviation)
+{
+    for(size_t i(0); i < nbins; ++i)
+        for(size_t j(0); j < nbins; ++j)
+            sum[i * nbins + j] += deviation[i] * deviation[j];
+    ++nuniv;
+    if(nuniv % block != 0)
+        return is_converged;
+
+    // End of a block: compare the diagonal uncertainties to the previous
+    // block. Bins without any uncertainty do not constrain the change.
+    std::vector<double> sigma(nbins);
+    for(size_t i(0); i < nbins; ++i)
+        sigma[i] = std::sqrt(sum[i * nbins + i] / nuniv);
+    if(!previous.empty())
+    {
+        last_change = 0;
+        for(size_t i(0); i < nbins; ++i)
+            if(previous[i] > 0)
+                last_change = std::max(last_change, std::abs(sigma[i] - previous[i]) / previous[i]);
+        is_converged = nuniv >= min_universes && last_change < tolerance;
+        std::cout << "Progressive universes (" << name << "): " << nuniv << " universes, relative change "
+                  << last_change << (is_converged ? " (converged)" : "") << std::endl;
+    }
+    previous = sigma;
+    return is_converged;
+}
+
+// Get the current covariance matrix.
+std::vector<double> sys::UniverseConvergence::covariance() const
+{
+    std::vector<double> result(sum);
+    if(nuniv > 0)
+        for(double & v : result)
+            v /= nuniv;
+    return result;
+}
@@ -24,7 +24,7 @@
 
 // Constructor for the DetsysCalculator class that initializes the class using
 // the configuration table, the output file, and the input file. 
-sys::detsys::DetsysCalculator::DetsysCalculator(cfg::ConfigurationTable & table, TFile * output, TFile * input)
+sys::detsys::DetsysCalculator::DetsysCalculator(cfg::ConfigurationTable & table, TFile * output, sys::InputFiles & input)
 {
     // Roll random z-scores to create a set of universes for later.
     std::random_device rd;
@@ -49,11 +49,11 @@ sys::detsys::DetsysCalculator::DetsysCalculator(cfg::ConfigurationTable & table,
         double pot(0);
         // Check if the variation has an exposure tree instead of a histogram.
         std::string exp_tree_name = table.get_string_field("variations.origin") + variation + "/" + table.get_string_field("variations.tree") + "_exposure";
-        if(input->Get(exp_tree_name.c_str()))
+        if(input.Get(exp_tree_name))
         {
             // If the exposure tree exists, use it to calculate the POT.
             // The tree has a branch "pot" that we need to sum over.
-            TTree * exp_tree = input->Get<TTree>(exp_tree_name.c_str());
+            TTree * exp_tree = input.Get<TTree>(exp_tree_name);
             double pot_value;
             exp_tree->SetBranchAddress("pot", &pot_value);
             for(int i(0); i < exp_tree->GetEntries(); ++i)
@@ -67,13 +67,13 @@ sys::detsys::DetsysCalculator::DetsysCalculator(cfg::ConfigurationTable & table,
         {
             // If the exposure tree does not exist, use the POT histogram.
             std::string pot_name = table.get_string_field("variations.origin") + variation + '/' + "POT";
-            TH1D * h = (TH1D *) input->Get(pot_name.c_str());
+            TH1D * h = input.Get<TH1D>(pot_name);
             pot = h->GetBinContent(1) / 1e18; // Convert to 1e18 POT
         }
         std::cout << "Variation " << variation << " has " << pot << "e18 POT." << std::endl;
 
         std::string name = table.get_string_field("variations.origin") + variation + '/' + table.get_string_field("variations.tree");
-        TTree * t = input->Get<TTree>(name.c_str());
+        TTree * t = input.Get<TTree>(name);
         double value;
         t->SetBranchAddress(variable.c_str(), &value);
         std::vector<double> bins = table.get_double_vector("variations.bins");
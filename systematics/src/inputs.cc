@@ -0,0 +1,135 @@
+/**
+ * @file inputs.cc
+ * @brief Implementation of the InputFiles class.
+ * @details This file contains the implementation of the InputFiles class,
+ * which resolves the input objects of the systematics framework from either a
+ * single ROOT file or a manifest of per-sample files.
+ * @author mueller@fnal.gov
+ */
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "inputs.h"
+
+#include "TFile.h"
+#include "TDirectory.h"
+#include "TTree.h"
+#include "TChain.h"
+#include "TH1.h"
+
+// Constructor for the InputFiles class.
+sys::InputFiles::InputFiles(const std::string & path) : single(nullptr)
+{
+    if(cfg::Manifest::is_manifest(path))
+        manifest = cfg::Manifest::read(path);
+    else
+    {
+        single = TFile::Open(path.c_str(), "READ");
+        if(single == nullptr || single->IsZombie())
+            throw std::runtime_error("Unable to open input file " + path + ".");
+    }
+}
+
+// Destructor for the InputFiles class.
+sys::InputFiles::~InputFiles()
+{
+    Close();
+}
+
+// Retrieve an object by its path in the single-file layout.
+TObject * sys::InputFiles::Get(const std::string & path)
+{
+    if(single != nullptr)
+        return single->Get(path.c_str());
+    const std::vector<TFile *> & parts(resolve(path));
+    if(parts.size() == 1)
+        return parts.front()->Get(path.c_str());
+    return merge(path, parts);
+}
+
+// Close all opened files.
+void sys::InputFiles::Close()
+{
+    // The merged objects may reference the files, so they go first.
+    for(auto & [path, object] : merged)
+        delete object;
+    merged.clear();
+    if(single != nullptr)
+    {
+        single->Close();
+        delete single;
+        single = nullptr;
+    }
+    for(auto & [sample, parts] : files)
+    {
+        for(TFile * file : parts)
+        {
+            file->Close();
+            delete file;
+        }
+    }
+    files.clear();
+}
+
+// Resolve the files holding the object specified in the path.
+const std::vector<TFile *> & sys::InputFiles::resolve(const std::string & path)
+{
+    // Objects are addressed as "events/<sample>/<object>".
+    size_t start(path.find('/'));
+    size_t end(start == std::string::npos ? start : path.find('/', start + 1));
+    if(end == std::string::npos)
+        throw std::runtime_error("Unable to resolve the sample of " + path + " from the manifest.");
+    std::string sample(path.substr(start + 1, end - start - 1));
+
+    auto it(files.find(sample));
+    if(it != files.end())
+        return it->second;
+
+    std::vector<cfg::Manifest::Entry> entries(manifest.get_entries(sample));
+    if(entries.empty())
+        throw std::runtime_error("Sample " + sample + " not found in the manifest.");
+    std::vector<TFile *> parts;
+    for(const cfg::Manifest::Entry & entry : entries)
+    {
+        TFile * file = TFile::Open(manifest.resolve(entry).c_str(), "READ");
+        if(file == nullptr || file->IsZombie())
+            throw std::runtime_error("Unable to open " + manifest.resolve(entry) + ".");
+        parts.push_back(file);
+    }
+    return files[sample] = parts;
+}
+
+// Merge an object across the parts of a sample.
+TObject * sys::InputFiles::merge(const std::string & path, const std::vector<TFile *> & parts)
+{
+    auto it(merged.find(path));
+    if(it != merged.end())
+        return it->second;
+
+    TObject * object = parts.front()->Get(path.c_str());
+    if(object == nullptr)
+        return nullptr;
+
+    TObject * result(object);
+    if(TTree * tree = dynamic_cast<TTree *>(object))
+    {
+        TChain * chain = new TChain(tree->GetName());
+        for(TFile * file : parts)
+            chain->Add((std::string(file->GetName()) + "/" + path).c_str());
+        result = chain;
+    }
+    else if(TH1 * hist = dynamic_cast<TH1 *>(object))
+    {
+        TH1 * sum = (TH1 *) hist->Clone();
+        sum->SetDirectory(nullptr);
+        for(size_t i(1); i < parts.size(); ++i)
+            if(TH1 * h = parts[i]->Get<TH1>(path.c_str()))
+                sum->Add(h);
+        result = sum;
+    }
+    else
+        return object;
+    merged[path] = result;
+    return result;
+}
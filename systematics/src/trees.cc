@@ -9,22 +9,30 @@
  * @author mueller@fnal.gov
  */
 #include <iostream>
+#include <map>
+#include <cmath>
+#include <limits>
+#include <algorithm>
 
 #include "trees.h"
 #include "detsys.h"
+#include "inputs.h"
 #include "utilities.h"
 #include "configuration.h"
+#include "trace.h"
 #include "systematic.h"
 #include "weight_reader.h"
+#include "convergence.h"
 
 #include "TFile.h"
 #include "TDirectory.h"
+#include "TROOT.h"
 #include "TTree.h"
 #include "TH1D.h"
 #include "TH2D.h"
 
 // Copy the input TTree to the output TTree.
-void sys::trees::copy_tree(cfg::ConfigurationTable & table, TFile * output, TFile * input)
+void sys::trees::copy_tree(cfg::ConfigurationTable & table, TFile * output, sys::InputFiles & input)
 {
     /**
      * @brief Create the output subdirectory following the nesting outlined
@@ -42,10 +50,10 @@ void sys::trees::copy_tree(cfg::ConfigurationTable & table, TFile * output, TFil
     if(!directory->GetListOfKeys()->Contains("POT"))
     {
         std::cout << "Copying POT and Livetime histograms." << std::endl;
-        TDirectory * parent = (TDirectory *) input;
-        parent = get_parent_directory(parent, table.get_string_field("origin").c_str());
-        TH1D * pot = (TH1D *) parent->Get("POT");
-        TH1D * livetime = (TH1D *) parent->Get("Livetime");
+        std::string origin(table.get_string_field("origin"));
+        std::string parent(origin.substr(0, origin.find_last_of('/') + 1));
+        TH1D * pot = input.Get<TH1D>(parent + "POT");
+        TH1D * livetime = input.Get<TH1D>(parent + "Livetime");
         directory->WriteObject(pot, "POT");
         directory->WriteObject(livetime, "Livetime");
     }
@@ -64,7 +72,7 @@ void sys::trees::copy_tree(cfg::ConfigurationTable & table, TFile * output, TFil
      * a single array to store the values of the double branches and three
      * separate variables to store the values of the int branches.
      */
-    TTree * input_tree = (TTree *) input->Get(table.get_string_field("origin").c_str());
+    TTree * input_tree = input.Get<TTree>(table.get_string_field("origin"));
     int run, subrun, event;
     double br[input_tree->GetNbranches()-3];
     for (int i = 0; i < input_tree->GetNbranches()-3; i++)
@@ -105,7 +113,7 @@ void sys::trees::copy_tree(cfg::ConfigurationTable & table, TFile * output, TFil
 }
 
 // Add reweightable systematics to the output TTree.
-void sys::trees::copy_with_weight_systematics(cfg::ConfigurationTable & config, cfg::ConfigurationTable & table, TFile * output, TFile * input, sys::detsys::DetsysCalculator & calc)
+void sys::trees::copy_with_weight_systematics(cfg::ConfigurationTable & config, cfg::ConfigurationTable & table, TFile * output, sys::InputFiles & input, sys::detsys::DetsysCalculator & calc)
 {
     /**
      * @brief Create the output subdirectory following the nesting outlined
@@ -123,10 +131,10 @@ void sys::trees::copy_with_weight_systematics(cfg::ConfigurationTable & config,
     if(!directory->GetListOfKeys()->Contains("POT"))
     {
         std::cout << "Copying POT and Livetime histograms." << std::endl;
-        TDirectory * parent = (TDirectory *) input;
-        parent = get_parent_directory(parent, table.get_string_field("origin").c_str());
-        TH1D * pot = (TH1D *) parent->Get("POT");
-        TH1D * livetime = (TH1D *) parent->Get("Livetime");
+        std::string origin(table.get_string_field("origin"));
+        std::string parent(origin.substr(0, origin.find_last_of('/') + 1));
+        TH1D * pot = input.Get<TH1D>(parent + "POT");
+        TH1D * livetime = input.Get<TH1D>(parent + "Livetime");
         directory->WriteObject(pot, "POT");
         directory->WriteObject(livetime, "Livetime");
     }
@@ -141,7 +149,7 @@ void sys::trees::copy_with_weight_systematics(cfg::ConfigurationTable & config,
      * one quirk, however, as we would also like to have access to the
      * "true_neutrino_id" branch in the input TTree directly.
      */
-    TTree * input_tree = (TTree *) input->Get(table.get_string_field("origin").c_str());
+    TTree * input_tree = input.Get<TTree>(table.get_string_field("origin"));
     std::map<std::string, double> brs;
     double nu_id;
     Int_t run, subrun, event;
@@ -247,6 +255,7 @@ void sys::trees::copy_with_weight_systematics(cfg::ConfigurationTable & config,
      * sequential order.
      */
     std::vector<std::string> table_types = table.get_string_vector("table_types");
+    int autoflush(config.get_int_field("output.autoflush", 1000));
     for(const std::string & s : table_types)
     {
         systrees[s] = new TTree((s+"Tree").c_str(), (s+"Tree").c_str());
@@ -255,7 +264,8 @@ void sys::trees::copy_with_weight_systematics(cfg::ConfigurationTable & config,
         systrees[s]->Branch("Subrun", &subrun);
         systrees[s]->Branch("Evt", &event);
         systrees[s]->SetDirectory(directory);
-        systrees[s]->SetAutoFlush(1000);
+        systrees[s]->SetAutoFlush(autoflush);
+        systrees[s]->SetImplicitMT(ROOT::IsImplicitMTEnabled());
     }
 
     for(cfg::ConfigurationTable & t : config.get_subtables("sys"))
@@ -271,7 +281,176 @@ void sys::trees::copy_with_weight_systematics(cfg::ConfigurationTable & config,
 
     sys::WeightReader reader(config.get_string_field("input.weights"));
 
+    /**
+     * @brief Configure the (optional) progressive evaluation of the
+     * multisim universes.
+     * @details In the progressive mode, the first "warmup" matched
+     * candidates are buffered along with all of their universe weights. The
+     * universes of each multisim systematic are then added to a streaming
+     * covariance (see @ref UniverseConvergence) in blocks until the relative
+     * change of the diagonal uncertainties falls below the tolerance. Only
+     * the universes needed for convergence are read, filled, and written for
+     * the remaining candidates. The number of universes used for each
+     * systematic is recorded in the "ProgressiveUniverses" TTree.
+     */
+    bool progressive(config.get_bool_field("progressive.enabled", false));
+    size_t warmup(config.get_int_field("progressive.warmup", 1000));
+    std::map<std::string, size_t> limits;
+    for(auto & [key, value] : systematics)
+        limits[key] = std::numeric_limits<size_t>::max();
+
+    // Read the universe weights of a neutrino (up to the configured limit).
+    auto read_weights = [&](size_t idn) -> std::map<std::string, std::vector<float>>
+    {
+        std::map<std::string, std::vector<float>> weights;
+        for(auto & [key, value] : systematics)
+        {
+            if(value->get_type() != Type::kMULTISIM && value->get_type() != Type::kMULTISIGMA)
+                continue;
+            reader.set(value->get_index());
+            size_t n(std::min<size_t>(reader.get_nuniv(idn), limits[key]));
+            std::vector<float> & w(weights[key]);
+            w.reserve(n);
+            for(size_t u(0); u < n; ++u)
+                w.push_back(reader.get_weight(idn, u));
+        }
+        return weights;
+    };
+
+    /**
+     * @brief Write a matched signal candidate to the output TTrees.
+     * @details This retrieves the selected signal candidate that has been
+     * matched with the parent neutrino, copies the values to the output
+     * TTree, and stores the universe weights (truncated to the configured
+     * limit) for each of the configured systematics.
+     */
     double nominal_count(0);
+    auto emit = [&](size_t entry, const std::map<std::string, std::vector<float>> & weights)
+    {
+        input_tree->GetEntry(entry);
+        calc.increment_nominal_count(1.0);
+        nominal_count += 1.0;
+        output_tree->Fill();
+
+        for(auto & [key, value] : systematics)
+        {
+            value->get_weights()->clear();
+            if(value->get_type() == Type::kMULTISIM || value->get_type() == Type::kMULTISIGMA)
+            {
+                const std::vector<float> & w(weights.at(key));
+                size_t n(std::min(w.size(), limits[key]));
+                for(SysVariable & sv : sysvariables)
+                {
+                    syst_t syskey = std::make_pair(sv.name, value->get_index());
+                    if(results1d.find(syskey) == results1d.end())
+                    {
+                        results1d[syskey] = new TH1D((sv.name + "_" + key + "_1d").c_str(), (sv.name + "_" + key + "_1d").c_str(), 1000, -0.25, 0.25);
+                        results1d[syskey]->SetDirectory(nullptr);
+                        results2d[syskey] = new TH2D((sv.name + "_" + key + "_2d").c_str(), (sv.name + "_" + key + "_2d").c_str(), sv.nbins, sv.min, sv.max, n, 0, n);
+                        results2d[syskey]->SetDirectory(nullptr);
+                    }
+                    for(size_t u(0); u < n; ++u)
+                    {
+                        value->get_weights()->push_back(w[u]);
+                        results2d[syskey]->Fill(brs[sv.name], u, w[u]);
+                    }
+                }
+            }
+            else
+            {
+                for(double & z : calc.get_zscores(key))
+                    value->get_weights()->push_back(calc.get_weight(key, brs[calc.get_variable()], z));
+                for(SysVariable & sv : sysvariables)
+                    calc.add_value(sv.name, brs[sv.name], key, brs[calc.get_variable()]);
+            }
+        } // End of loop over the configured systematics.
+
+        /**
+         * @brief Fill the systematic TTrees.
+         * @details This block fills the systematic TTrees with the universe
+         * weights for the parent neutrino. Each configured systematic should
+         * have its weights vector populated by the above loop.
+         */
+        for(auto & [key, value] : systrees)
+            value->Fill();
+    };
+
+    /**
+     * @brief Decide the number of universes of each multisim systematic
+     * from the buffered candidates and write the buffered candidates.
+     */
+    struct Buffered
+    {
+        size_t entry;
+        std::vector<double> values;
+        std::map<std::string, std::vector<float>> weights;
+    };
+    std::vector<Buffered> buffer;
+    auto flush = [&]()
+    {
+        for(auto & [key, value] : systematics)
+        {
+            if(value->get_type() != Type::kMULTISIM)
+                continue;
+            size_t available(0);
+            for(const Buffered & b : buffer)
+                available = std::max(available, b.weights.at(key).size());
+
+            // One monitor per systematic variable, fed with the deviation of
+            // the binned prediction of each universe from the nominal one.
+            std::vector<UniverseConvergence> monitors;
+            std::vector<std::vector<double>> nominal;
+            std::vector<std::vector<int>> bins;
+            for(SysVariable & sv : sysvariables)
+            {
+                monitors.emplace_back(sv.name + "_" + key, sv.nbins, config.get_int_field("progressive.block", 50),
+                                      config.get_double_field("progressive.tolerance", 0.01),
+                                      config.get_int_field("progressive.min_universes", 100));
+                size_t v(nominal.size());
+                nominal.emplace_back(sv.nbins, 0.0);
+                bins.emplace_back();
+                for(const Buffered & b : buffer)
+                {
+                    int bin((int)std::floor((b.values[v] - sv.min) / (sv.max - sv.min) * sv.nbins));
+                    bins.back().push_back(bin >= 0 && bin < (int)sv.nbins ? bin : -1);
+                    if(bins.back().back() >= 0)
+                        nominal.back()[bin] += 1.0;
+                }
+            }
+
+            size_t used(available);
+            for(size_t u(0); u < available; ++u)
+            {
+                bool converged(!monitors.empty());
+                for(size_t v(0); v < monitors.size(); ++v)
+                {
+                    std::vector<double> deviation(nominal[v].size(), 0.0);
+                    for(size_t c(0); c < buffer.size(); ++c)
+                    {
+                        const std::vector<float> & w(buffer[c].weights.at(key));
+                        if(bins[v][c] >= 0 && u < w.size())
+                            deviation[bins[v][c]] += w[u];
+                    }
+                    for(size_t b(0); b < deviation.size(); ++b)
+                        deviation[b] -= nominal[v][b];
+                    converged = monitors[v].add(deviation) && converged;
+                }
+                if(converged)
+                {
+                    used = u + 1;
+                    break;
+                }
+            }
+            limits[key] = used;
+            std::cout << "Systematic " << key << " uses " << used << " of " << available << " universes." << std::endl;
+        }
+
+        for(const Buffered & b : buffer)
+            emit(b.entry, b.weights);
+        buffer.clear();
+        progressive = false;
+    };
+
     while(reader.next())
     {
         /**
@@ -279,9 +458,8 @@ void sys::trees::copy_with_weight_systematics(cfg::ConfigurationTable & config,
          * @details This block loops over the neutrinos in the CAF input
          * files. The loop is used to populate the output TTree with the
          * selected signal candidates and the universe weights for matched
-         * neutrinos. The loop also retrieves the selected signal candidate
-         * that has been matched with the parent neutrino and copies the
-         * values to the output TTree.
+         * neutrinos. In the progressive mode, the candidates are buffered
+         * until the number of universes has been decided.
          */
         for(size_t idn(0); idn < reader.get_nnu(); ++idn)
         {
@@ -292,70 +470,44 @@ void sys::trees::copy_with_weight_systematics(cfg::ConfigurationTable & config,
                 index = std::make_tuple(reader.get_run(), reader.get_subrun(), reader.get_event(), idn, (double)reader.get_energy(idn));
             if(candidates.find(index) != candidates.end())
             {
-                /**
-                 * @brief Retrieve the selected signal candidate and copy
-                 * the values to the output TTree.
-                 * @details This block retrieves the selected signal
-                 * candidate that has been matched with the parent neutrino
-                 * and copies the values to the output TTree.
-                 */
-                input_tree->GetEntry(candidates[index]);
-                run = reader.get_run();
-                subrun = reader.get_subrun();
-                event = reader.get_event();
-                calc.increment_nominal_count(1.0);
-                nominal_count += 1.0;
-                output_tree->Fill();
-
-                /**
-                 * @brief Store the universe weights in the output TTree.
-                 * @details This block stores the universe weights in the
-                 * output TTree for each of the configured systematics.  
-                 */
-                for(auto & [key, value] : systematics)
+                SPINE_PROBE1(sys_fill_begin, idn);
+                if(progressive)
                 {
-                    value->get_weights()->clear();
-                    if(value->get_type() == Type::kMULTISIM || value->get_type() == Type::kMULTISIGMA)
-                    {
-                        for(SysVariable & sv : sysvariables)
-                        {
-                            syst_t syskey = std::make_pair(sv.name, value->get_index());
-                            reader.set(value->get_index());
-                            if(results1d.find(syskey) == results1d.end())
-                            {
-                                results1d[syskey] = new TH1D((sv.name + "_" + key + "_1d").c_str(), (sv.name + "_" + key + "_1d").c_str(), 1000, -0.25, 0.25);
-                                results1d[syskey]->SetDirectory(nullptr);
-                                results2d[syskey] = new TH2D((sv.name + "_" + key + "_2d").c_str(), (sv.name + "_" + key + "_2d").c_str(), sv.nbins, sv.min, sv.max, reader.get_nuniv(idn), 0, reader.get_nuniv(idn));
-                                results2d[syskey]->SetDirectory(nullptr);
-                            }
-                            for(size_t u(0); u < reader.get_nuniv(idn); ++u)
-                            {
-                                value->get_weights()->push_back(reader.get_weight(idn, u));
-                                results2d[syskey]->Fill(brs[sv.name], u, reader.get_weight(idn, u));
-                            }
-                        }
-                    }
-                    else
-                    {
-                        for(double & z : calc.get_zscores(key))
-                            value->get_weights()->push_back(calc.get_weight(key, brs[calc.get_variable()], z));
-                        for(SysVariable & sv : sysvariables)
-                            calc.add_value(sv.name, brs[sv.name], key, brs[calc.get_variable()]);
-                    }
-                } // End of loop over the configured systematics.
-
-                /**
-                 * @brief Fill the systematic TTrees.
-                 * @details This block fills the systematic TTrees with
-                 * the universe weights for the parent neutrino. Each
-                 * configured systematic should have its weights vector
-                 * populated by the above loop.
-                 */
-                for(auto & [key, value] : systrees)
-                    value->Fill();
+                    Buffered b{candidates[index], {}, read_weights(idn)};
+                    input_tree->GetEntry(b.entry);
+                    for(SysVariable & sv : sysvariables)
+                        b.values.push_back(brs[sv.name]);
+                    buffer.push_back(std::move(b));
+                    if(buffer.size() >= warmup)
+                        flush();
+                }
+                else
+                    emit(candidates[index], read_weights(idn));
+                SPINE_PROBE1(sys_fill_end, idn);
             } // End of block for matched signal candidates.
         }
     }
+    if(progressive)
+        flush();
+
+    // Record the number of universes used for each multisim systematic.
+    if(config.get_bool_field("progressive.enabled", false))
+    {
+        TTree * used_tree = new TTree("ProgressiveUniverses", "ProgressiveUniverses");
+        std::string used_name;
+        ULong64_t used_count;
+        used_tree->Branch("name", &used_name);
+        used_tree->Branch("universes", &used_count);
+        for(auto & [key, value] : systematics)
+        {
+            if(value->get_type() != Type::kMULTISIM)
+                continue;
+            used_name = key;
+            used_count = limits[key];
+            used_tree->Fill();
+        }
+        directory->WriteObject(used_tree, "ProgressiveUniverses");
+    }
 
     // Write the output TTree to the output file.
     directory->WriteObject(output_tree, table.get_string_field("name").c_str());
@@ -13,6 +13,7 @@
 #include <sstream>
 
 #include "weight_reader.h"
+#include "trace.h"
 
 #include "TChain.h"
 #include "TTreeReader.h"
@@ -87,6 +88,7 @@ sys::WeightReader::WeightReader(const std::string & input)
 // Advance to the next entry in the TChain.
 bool sys::WeightReader::next()
 {
+    SPINE_PROBE1(weights_next, entry);
     this->progress_bar(entry+1, chain.GetEntries());
     if(!chain.GetTree() || !reader) return false;
     if(entry >= (size_t)chain.GetEntries()) return false;